@@ -9,15 +9,107 @@
 #include <getopt.h>
 #include <assert.h>
 #include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "wisun_fsk_common.h"
+#include "wisun_fsk_dsp.h"
+#include "wisun_fsk_index.h"
+#include "wisun_fsk_cache.h"
+#include "wisun_fsk_pcap.h"
+#include "wisun_fsk_spsc.h"
+#include "wisun_fsk_uring.h"
+#include "wisun_fsk_sdt.h"
 
 #define URH_WIRUN_FSK_PLUGIN_VERSION		"1.0.5"
 
-#define number_is_even(n)			(((n) & 1) == 0)
-
 static int option_verbose = 0;
 static int option_human = 0;
 static int option_hexi = 0, option_hexo = 0;
+static int option_repair = 0;	/* max bit errors repaired by FCS32 */
+static int option_auto = 0;	/* detect FEC and interleaving by PHR */
+static int option_template = 0;	/* encode variants of the first packet */
+static const char *option_build_index = NULL;	/* index of --stream file */
+static const char *option_index_file = NULL;	/* decode indexed frames */
+static int option_dump_index = 0;		/* print the --index entries */
+static const char *option_cache = NULL;	/* decode result cache file */
+static const char *option_pcap_input = NULL;	/* encode the pcap frames */
+static const char *option_soft_output = NULL;	/* --demod soft symbols */
+static int option_pipeline = 0;	/* stage per thread --stream decode */
+static int option_batch = 0;	/* --stream all files of a directory */
+
+/* --filter expression, the terms are and'ed and the filters are or'ed */
+struct wisun_2fsk_filter {
+	int		frame_type;	/* -1: any */
+	uint32_t	pan;		/* IEEE_802154_PAN_NONE: any */
+	uint8_t		dst_mode, src_mode;	/* IEEE_802154_ADDR_NONE: any */
+	uint64_t	dst, src;
+};
+
+#define WISUN_2FSK_MAX_FILTERS	8
+static struct wisun_2fsk_filter option_filters[WISUN_2FSK_MAX_FILTERS];
+static int option_filters_count = 0;
+
+/* write the encoded packet as 2-(G)FSK baseband IQ samples */
+struct wisun_2fsk_iq_output {
+	const char		*filename;	/* NULL: print the bits */
+	enum iq_sample_format	format;
+	unsigned int		sps;
+	float			mod_index;
+	float			bt;
+};
+
+/* write the decoded frames to a pcap/pcapng file instead of printing */
+struct wisun_2fsk_pcap_output {
+	const char			*filename;	/* NULL: print */
+	uint32_t			linktype;
+	int				wisun_tlvs;	/* TAP: SFD, FEC mode */
+	double				symbol_rate;	/* bit offset to time */
+	uint64_t			start_ns;
+	struct wisun_fsk_pcap_writer	*w;
+};
+
+static struct wisun_2fsk_pcap_output option_pcap = {
+	.linktype = LINKTYPE_IEEE802_15_4_NOFCS,
+	.symbol_rate = 50000,
+};
+
+/* --simulate: encode random frames, pass the channel and decode them */
+enum wisun_2fsk_sim_channel {
+	WISUN_2FSK_SIM_AWGN,	/* points: Eb/N0 in dB */
+	WISUN_2FSK_SIM_FLIP,	/* points: bit error rate */
+	WISUN_2FSK_SIM_BURST,	/* points: burst start rate per bit */
+};
+
+struct wisun_2fsk_sim_options {
+	enum wisun_2fsk_sim_channel	channel;
+	size_t				burst_len;
+	const char			*points;	/* NULL: default */
+	size_t				frames;		/* per point */
+	size_t				length;		/* PSDU bytes */
+	uint64_t			seed;
+};
+
+static struct wisun_2fsk_sim_options option_sim = {
+	.channel = WISUN_2FSK_SIM_AWGN,
+	.burst_len = 8,
+	.frames = 1000,
+	.length = 100,
+	.seed = 1,
+};
+
+static struct wisun_2fsk_iq_output option_iq_output = {
+	.format = IQ_FORMAT_CF32,
+	.sps = 8,
+	.mod_index = 1.0f,
+	.bt = 0.5f,
+};
 
 #if DEBUG > 0
 static const char *str01_strstr_endp(const char *str01, const char **endp,
@@ -255,8 +347,21 @@ static size_t strict_strhex_to_buffer(const char *s, uint8_t *buf, size_t bufsz)
 
 static void print_hex_bytes(const uint8_t *buf, size_t byte_size)
 {
-	for (size_t i = 0; i < byte_size; i++)
-		printf("%02x", buf[i]);
+	static const char hex[] = "0123456789abcdef";
+	char line[256];
+	size_t len = 0;
+
+	/* the bulk encoders print millions of lines, don't printf each byte */
+	for (size_t i = 0; i < byte_size; i++) {
+		line[len++] = hex[buf[i] >> 4];
+		line[len++] = hex[buf[i] & 0xf];
+		if (len == sizeof(line)) {
+			fwrite(line, 1, len, stdout);
+			len = 0;
+		}
+	}
+
+	fwrite(line, 1, len, stdout);
 }
 
 static uint16_t buffer_peek_u16_b1b0(const uint8_t *buf)
@@ -273,7 +378,7 @@ static void print_bit(int b, size_t *bit_idx, size_t split_group_count)
 		(*bit_idx)++;
 	}
 
-	printf("%d", !!b);
+	putchar('0' + !!b);
 }
 
 static void print_binary_bits_lsbfirst(const uint8_t *buf, size_t start_bit,
@@ -291,6 +396,25 @@ static void print_binary_bits_lsbfirst(const uint8_t *buf, size_t start_bit,
 		start_byte++;
 	}
 
+	if (!split_group_count) {
+		/* the whole bytes are printed in lines, not char by char */
+		char line[512];
+		size_t len = 0;
+
+		for (size_t byte = start_byte; byte < end_byte; byte++) {
+			for (int bit = 0; bit < 8; bit++)
+				line[len++] = '0' + ((buf[byte] >> bit) & 1);
+
+			if (len == sizeof(line)) {
+				fwrite(line, 1, len, stdout);
+				len = 0;
+			}
+		}
+
+		fwrite(line, 1, len, stdout);
+		start_byte = end_byte;
+	}
+
 	for (size_t byte = start_byte; byte < end_byte; byte++) {
 		uint8_t b = buf[byte];
 
@@ -789,40 +913,157 @@ static void wisun_2fsk_print_packet(const uint8_t *buf, size_t binary_size,
 	printf("\n");
 }
 
-static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
-				    int interleaving, int skip_verify)
+struct wisun_2fsk_frame {
+	enum wisun_2fsk_sfd_type	type;
+	size_t				preamble_sz;
+	uint16_t			phr;		/* in fixed order */
+	size_t				phy_payload_sz;	/* phr + psdu */
+	size_t				input_bits;	/* bits taken from input */
+	uint64_t			offset;		/* SHR offset in input */
+	int				channel;	/* -1 if not channelized */
+	double				cfo;		/* Hz, --cfo channels */
+	const char			*source;	/* --batch input file */
+	uint32_t			fcs32;		/* computed when decoding */
+	int				fcs32_ready;
+	int				use_rsc;	/* coded frames only */
+	int				interleaving;
+	int				quiet;		/* no per frame errors */
+	uint8_t				buf[8192];
+};
+
+static void wisun_2fsk_frame_init(struct wisun_2fsk_frame *f, size_t preamble_sz,
+				  enum wisun_2fsk_sfd_type type)
 {
-	size_t preamble_sz, binary_size, byte_size, phy_payload_sz;
-	enum wisun_2fsk_sfd_type type;
-	uint8_t *p_phy_payload, buf[8192] = { 0 };
+	f->type = type;
+	f->preamble_sz = preamble_sz;
+	f->phr = 0;
+	f->phy_payload_sz = 0;
+	f->input_bits = 0;
+	f->offset = 0;
+	f->channel = -1;
+	f->cfo = 0.0;
+	f->source = NULL;
+	f->fcs32 = 0;
+	f->fcs32_ready = 0;
+	f->use_rsc = 0;
+	f->interleaving = 0;
+	f->quiet = 0;
+}
+
+/* the errors of a bad frame, they are not printed if the decoder expects
+ * them, e.g. the simulated frames and the false SFD in noise.
+ */
+static void wisun_2fsk_frame_error(const struct wisun_2fsk_frame *f,
+				   const char *msg)
+{
+	if (!f->quiet)
+		fprintf(stderr, "%s\n", msg);
+}
+
+/* the decoded PSDU bytes covered by the running FCS32 of the fused decoder.
+ * The short PSDU is padded when computing FCS, leave it to the verify.
+ */
+static size_t wisun_2fsk_fused_fcs32_bytes(uint16_t phr)
+{
+	size_t frame_length = phr >> 5;
+
+	if ((phr & WISUN_2FSK_PHR_FCS_TYPE_CRC16) || frame_length < 8)
+		return 0;
+
+	return frame_length;
+}
+
+/* the PHR block is decoded, setup the decoder for the PSDU blocks */
+static void wisun_2fsk_fused_setup_psdu(struct fec_block_decoder *d,
+					uint16_t phr)
+{
+	d->whitening = !!(phr & WISUN_2FSK_PHR_DATA_WHITENING);
+	d->pn9_pos = 0;
+	d->crc = IEEE_802154_FCS32_INIT;
+	d->crc_bytes = wisun_2fsk_fused_fcs32_bytes(phr);
+}
+
+static void wisun_2fsk_fused_save_fcs32(struct wisun_2fsk_frame *f,
+					const struct fec_block_decoder *d)
+{
+	f->fcs32_ready = wisun_2fsk_fused_fcs32_bytes(f->phr) > 0;
+	f->fcs32 = d->crc ^ 0xffffffff;
+}
+
+/* single pass decode of the coded PHY payload, see fec_block_decode */
+static int wisun_2fsk_frame_decode_fused(struct wisun_2fsk_frame *f,
+					 uint8_t *p_phy_payload,
+					 size_t phy_payload_sz,
+					 int use_rsc, int interleaving)
+{
+	struct fec_block_decoder d;
+	size_t whitening_sz, pad_sz;
 	uint16_t phr;
-	const char *endp;
-	int idx;
 
-	idx = wisun_2fsk_str01_find_shr(str01, &preamble_sz, &type);
-	if (idx < 0) {
-		fprintf(stderr, "2-FSK SHR is not found\n");
-		return idx;
+	if (phy_payload_sz <= sizeof(phr) * 2)
+		return -1;
+
+	fec_block_decoder_init(&d, use_rsc, interleaving);
+	if (fec_block_decode(&d, p_phy_payload, 1, p_phy_payload) < 0) {
+		WISUN_FSK_SDT3(fec_fail, 0, use_rsc, interleaving);
+		wisun_2fsk_frame_error(f, "Error: decode PHR failed");
+		return -1;
 	}
 
-	binary_size = str01_to_buffer(str01 + idx, &endp, buf, sizeof(buf), 1);
-	if (*endp != '\0') {
-		fprintf(stderr, "input binary string is bad after:\n");
-		fprintf(stderr, "%s\n", endp);
+	phr = wisun_2fsk_fix_phr_order(buffer_peek_u16_b1b0(p_phy_payload));
+	pad_sz = number_is_even(sizeof(phr) + (phr >> 5)) ? 2 : 1;
+	whitening_sz = ((phr >> 5) + pad_sz) * 2;
+
+	if (phy_payload_sz < sizeof(phr) * 2 + whitening_sz) {
+		wisun_2fsk_frame_error(f, "Error: PHY payload is truncated");
+		return -1;
+	}
+
+	wisun_2fsk_fused_setup_psdu(&d, phr);
+	if (d.whitening)
+		WISUN_FSK_SDT2(whitening, whitening_sz, 0);
+	if (fec_block_decode(&d, p_phy_payload + sizeof(phr) * 2,
+			     whitening_sz / 4, p_phy_payload + sizeof(phr)) < 0) {
+		/* the coded bits are counted from the PHR */
+		WISUN_FSK_SDT3(fec_fail, d.blocks * 32, use_rsc, interleaving);
+		wisun_2fsk_frame_error(f, "Error: decode PHY payload failed");
 		return -1;
 	}
 
+	f->phr = phr;
+	f->phy_payload_sz = sizeof(phr) + (phr >> 5);
+	f->input_bits = f->preamble_sz
+			+ (2 /* sfd */ + sizeof(phr) * 2 + whitening_sz) * 8;
+	wisun_2fsk_fused_save_fcs32(f, &d);
+
+	return 0;
+}
+
+/* decode the frame stage by stage, the result of each stage is printed in
+ * verbose mode.
+ */
+static int wisun_2fsk_frame_decode_staged(struct wisun_2fsk_frame *f,
+					  size_t binary_size,
+					  int use_rsc, int interleaving)
+{
+	size_t preamble_sz = f->preamble_sz, byte_size, phy_payload_sz;
+	uint8_t *p_phy_payload, *buf = f->buf;
+	uint16_t phr;
+
 	byte_size = binary_size / 8;
 	if (binary_size % 8)
 		byte_size++;
 
 	/* phy_payload_sz: all data after sfd, including phr, data and crc */
 	p_phy_payload = buf + preamble_sz / 8 + 2 /* sfd */;
+	if (byte_size <= (size_t)(p_phy_payload - buf))
+		return -1;
+
 	phy_payload_sz = byte_size - (p_phy_payload - buf);
 	if (phy_payload_sz <= sizeof(phr))
 		return -1;
 
-	if (type == WISUN_2FSK_SFD_CODED0 || type == WISUN_2FSK_SFD_CODED1) {
+	if (f->type == WISUN_2FSK_SFD_CODED0 || f->type == WISUN_2FSK_SFD_CODED1) {
 		uint8_t *p_whitening;
 		size_t whitening_sz, pad_sz;
 		size_t decode_bits = 0;
@@ -832,7 +1073,6 @@ static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
 
 		/* phr is 2bytes, it will become 4bytes after convolutional */
 		p_whitening = p_phy_payload + sizeof(phr) * 2;
-		whitening_sz = byte_size - (p_whitening - buf);
 		if (phy_payload_sz <= sizeof(phr) * 2)
 			return -1;
 
@@ -858,7 +1098,9 @@ static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
 		}
 
 		if (ret < 0) {
-			fprintf(stderr, "Error: decode PHR failed\n");
+			WISUN_FSK_SDT3(fec_fail, decode_bits * 2, use_rsc,
+				       interleaving);
+			wisun_2fsk_frame_error(f, "Error: decode PHR failed");
 			return ret;
 		}
 
@@ -879,7 +1121,14 @@ static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
 		/* the length will be double after convolutional */
 		whitening_sz *= 2;
 
+		if (phy_payload_sz < sizeof(phr) * 2 + whitening_sz) {
+			wisun_2fsk_frame_error(f,
+					"Error: PHY payload is truncated");
+			return -1;
+		}
+
 		if (phr & WISUN_2FSK_PHR_DATA_WHITENING) {
+			WISUN_FSK_SDT2(whitening, whitening_sz, 0);
 			pn9_payload_decode(p_whitening, whitening_sz);
 			if (option_verbose > 0) {
 				printf("After Whitening decode:\n");
@@ -906,20 +1155,24 @@ static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
 			ret = rsc_decode(&m, p_whitening,
 					 whitening_sz * 8,
 					 p_phy_payload + sizeof(phr),
-					 sizeof(buf) - (p_phy_payload - buf)
+					 sizeof(f->buf) - (p_phy_payload - buf)
 					 - sizeof(phr),
 					 &decode_bits);
 		} else {
 			ret = nrnsc_decode(&m, p_whitening,
 					   whitening_sz * 8,
 					   p_phy_payload + sizeof(phr),
-					   sizeof(buf) - (p_phy_payload - buf)
+					   sizeof(f->buf) - (p_phy_payload - buf)
 					   - sizeof(phr),
 					   &decode_bits);
 		}
 
 		if (ret < 0) {
-			fprintf(stderr, "Error: decode PHY payload failed\n");
+			WISUN_FSK_SDT3(fec_fail,
+				       sizeof(phr) * 2 * 8 + decode_bits * 2,
+				       use_rsc, interleaving);
+			wisun_2fsk_frame_error(f,
+					"Error: decode PHY payload failed");
 			return ret;
 		}
 
@@ -941,6 +1194,8 @@ static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
 
 		/* fix the phy_payload_sz based on PHR */
 		phy_payload_sz = sizeof(phr) + phr_frame_length;
+		f->input_bits = preamble_sz
+				+ (2 /* sfd */ + sizeof(phr) * 2 + whitening_sz) * 8;
 
 		if (option_verbose > 0) {
 			printf("After decode:\n");
@@ -959,6 +1214,7 @@ static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
 			return -1;
 
 		if (phr & WISUN_2FSK_PHR_DATA_WHITENING) {
+			WISUN_FSK_SDT2(whitening, phr_frame_length, 0);
 			pn9_payload_decode(p_phy_payload + sizeof(phr),
 					   phr_frame_length);
 
@@ -975,218 +1231,3255 @@ static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
 
 		/* fix phy_payload_sz to drop tail garbages */
 		phy_payload_sz = sizeof(phr) + phr_frame_length;
+		f->input_bits = preamble_sz + (2 /* sfd */ + phy_payload_sz) * 8;
 	}
 
-	binary_size = preamble_sz + (2 /* sfd */ + phy_payload_sz) * 8;
+	f->phr = phr;
+	f->phy_payload_sz = phy_payload_sz;
+
+	return 0;
+}
 
-	if (!skip_verify) {
-		bool good = false;
+/* decode the frame in place, @binary_size bits of the raw input start from
+ * the preamble are already saved in f->buf in lsb first mode.
+ */
+static int wisun_2fsk_frame_decode(struct wisun_2fsk_frame *f,
+				   size_t binary_size,
+				   int use_rsc, int interleaving)
+{
+	size_t byte_size = roundup8(binary_size);
+	uint8_t *p_phy_payload = f->buf + f->preamble_sz / 8 + 2 /* sfd */;
 
-		if (!(phr & WISUN_2FSK_PHR_FCS_TYPE_CRC16))
-			good = ieee_802154_fcs32_buf_is_good(
-						p_phy_payload + sizeof(phr),
-						phy_payload_sz - sizeof(phr));
-		else
-			fprintf(stderr, "warnning: FCS16 is not supported\n");
+	f->use_rsc = use_rsc;
+	f->interleaving = interleaving;
 
-		if (!good) {
-			fprintf(stderr, "Error: verify 802.15.4 packet "
-				"failed\n");
+	if ((f->type == WISUN_2FSK_SFD_CODED0 || f->type == WISUN_2FSK_SFD_CODED1)
+	    && !option_verbose) {
+		if (byte_size <= (size_t)(p_phy_payload - f->buf))
 			return -1;
-		}
-	}
 
-	if (option_verbose > 0)
-		printf("After packet decode\n");
+		return wisun_2fsk_frame_decode_fused(f, p_phy_payload,
+				byte_size - (p_phy_payload - f->buf),
+				use_rsc, interleaving);
+	}
 
-	wisun_2fsk_print_packet(buf, binary_size, preamble_sz, type,
-				phy_payload_sz - sizeof(phr));
-	return 0;
+	return wisun_2fsk_frame_decode_staged(f, binary_size, use_rsc,
+					      interleaving);
 }
 
-static size_t wisun_2fsk_fec_padding(uint8_t *buf, size_t frame_length,
-				     enum wisun_2fsk_sfd_type type,
-				     uint8_t memory_state)
+static bool wisun_2fsk_frame_verify(const struct wisun_2fsk_frame *f)
 {
-	static const uint8_t rsc_tail_bits[] = {
-		[0] = 0b000,
-		[1] = 0b001,
-		[2] = 0b011,
-		[3] = 0b010,
-		[4] = 0b111,
-		[5] = 0b110,
-		[6] = 0b100,
-		[7] = 0b101,
-	};
-	uint8_t pad[2] = { 0b11010000, 0b11010000 };
-	size_t len = 2 /* Lphr */ + frame_length;
-	size_t pad_sz = 1 + number_is_even(len);
+	const uint8_t *p_psdu = f->buf + f->preamble_sz / 8 + 2 + sizeof(f->phr);
+	bool good = false;
 
-	memory_state &= 0b111;
+	if (f->phr & WISUN_2FSK_PHR_FCS_TYPE_CRC16)
+		wisun_2fsk_frame_error(f, "warnning: FCS16 is not supported");
+	else if (f->fcs32_ready)
+		good = f->fcs32 == IEEE_802154_FCS32_GOOD;
+	else
+		good = ieee_802154_fcs32_buf_is_good(p_psdu,
+				f->phy_payload_sz - sizeof(f->phr));
 
-	if (type != WISUN_2FSK_SFD_CODED0 && type != WISUN_2FSK_SFD_CODED1) {
-		/* no padding */
-		return 0;
+	/* PHR and PSDU bytes */
+	WISUN_FSK_SDT2(crc_result, good, f->phy_payload_sz);
+	return good;
+}
+
+/* locate and flip the bit errors in PSDU by the FCS32 syndrome */
+static bool wisun_2fsk_frame_repair(struct wisun_2fsk_frame *f)
+{
+	uint8_t *p_psdu = f->buf + f->preamble_sz / 8 + 2 + sizeof(f->phr);
+	size_t bits[2];
+	int n;
+
+	if (option_repair == 0 || (f->phr & WISUN_2FSK_PHR_FCS_TYPE_CRC16))
+		return false;
+
+	n = ieee_802154_fcs32_repair(p_psdu, f->phy_payload_sz - sizeof(f->phr),
+				     option_repair, bits);
+	if (n <= 0)
+		return false;
+
+	f->fcs32_ready = 0;
+
+	if (option_verbose) {
+		fprintf(stderr, "repaired %d bit error%s at PSDU bit %zu", n,
+			n > 1 ? "s" : "", bits[0]);
+		if (n > 1)
+			fprintf(stderr, ", %zu", bits[1]);
+		fprintf(stderr, "\n");
 	}
 
-	if (type == WISUN_2FSK_SFD_CODED0) /* RSC */
-		pad[0] |= rsc_tail_bits[memory_state];
+	return true;
+}
 
-	memcpy(buf, pad, pad_sz);
-	return pad_sz;
+/* verify the frame and try to repair it by --repair if the FCS32 is bad */
+static bool wisun_2fsk_frame_check(struct wisun_2fsk_frame *f)
+{
+	if (wisun_2fsk_frame_verify(f) || wisun_2fsk_frame_repair(f))
+		return true;
+
+	wisun_2fsk_frame_error(f, "Error: verify 802.15.4 packet failed");
+	return false;
 }
 
-/*
- * XXX: encode packet with RSC doesn't work now.
- */
-static int wisun_2fsk_packet_encode(const char *arg,
-				    size_t preamble_sz,
-				    enum wisun_2fsk_sfd_type type,
-				    uint16_t phr_options,
-				    int use_rsc,
-				    int interleaving)
+static int wisun_2fsk_filter_parse_addr(const char *s, uint8_t *ret_mode,
+					uint64_t *ret_addr)
 {
-	size_t group_sz = option_human ? 4 : 0;
-	uint8_t buf[4096] = { 0 }, data[1024] = { 0 }, fec[2048] = { 0 };
-	struct wisun_2fsk_fec_encoder encoder = { 0 };
-	size_t frame_length = 0, data_res = 0, data_idx = 0, whitening_sz = 0;
-	uint8_t *p_frame, *p_phr, *p_whitening;
-	uint8_t pad[2];
-	size_t pad_sz = 0;
-	struct bufwrite b;
-	uint16_t phr = 0;
+	uint64_t addr = 0;
+	int digits = 0;
 
-	encoder.buf = fec;
-	encoder.bufsz = sizeof(fec);
+	if (!strncmp(s, "0x", 2) || !strncmp(s, "0X", 2))
+		s += 2;
 
-	/* reverse space for phr, crc, padding and tail bits */
-	p_phr = data;
-	data_idx = sizeof(phr);
-	data_res = sizeof(phr);
-	data_res += phr_options & WISUN_2FSK_PHR_FCS_TYPE_CRC16 ? 2 : 4;
+	/* the extended address may be written as 00:11:22:...:77 */
+	for (; *s != '\0'; s++) {
+		if (*s == ':')
+			continue;
+		if (!isxdigit(*s) || ++digits > 16)
+			return -1;
+		addr = (addr << 4) | (isdigit(*s) ? *s - '0'
+					: tolower(*s) - 'a' + 10);
+	}
 
-	bufwrite_init(&b, buf, sizeof(buf));
+	if (digits == 0)
+		return -1;
 
-	/* fill the WISUN_2FSK_PREAMBLE bits in lsb first */
-	for (size_t i = 0; i < preamble_sz / 8; i++)
-		bufwrite_push_le8(&b, 0xaa);
+	*ret_mode = digits <= 4 ? IEEE_802154_ADDR_SHORT : IEEE_802154_ADDR_EXT;
+	*ret_addr = addr;
+	return 0;
+}
 
-	/* fill SFD */
-	bufwrite_push_le16(&b, wisun_2fsk_sfd_value(type));
+/* parse "type=data,pan=0xabcd,dst=0xffff,src=00:11:22:33:44:55:66:77" */
+static int wisun_2fsk_filter_parse(const char *arg,
+				   struct wisun_2fsk_filter *filter)
+{
+	static const char *const types[] = {
+		[IEEE_802154_FRAME_BEACON]	= "beacon",
+		[IEEE_802154_FRAME_DATA]	= "data",
+		[IEEE_802154_FRAME_ACK]		= "ack",
+		[IEEE_802154_FRAME_CMD]		= "cmd",
+	};
+	char term[64];
 
-	if (option_hexi) {
-		frame_length = strict_strhex_to_buffer(arg, &data[data_idx],
-						       sizeof(data) - data_res);
-		if (!frame_length)
-			return -1;
-	} else {
-		size_t binary_size;
+	filter->frame_type = -1;
+	filter->pan = IEEE_802154_PAN_NONE;
+	filter->dst_mode = filter->src_mode = IEEE_802154_ADDR_NONE;
 
-		binary_size = strict_str01_to_buffer(arg, &data[data_idx],
-						     sizeof(data) - data_res,
-						     1);
-		if (!binary_size)
-			return -1;
+	while (*arg != '\0') {
+		const char *comma = strchr(arg, ',');
+		size_t len = comma ? (size_t)(comma - arg) : strlen(arg);
+		char *value, *endp;
+		int ret = -1;
 
-		if (binary_size % 8) {
-			fprintf(stderr, "not byte aligned\n");
+		if (len >= sizeof(term)) {
+			fprintf(stderr, "bad filter: %s\n", arg);
 			return -1;
 		}
+		memcpy(term, arg, len);
+		term[len] = '\0';
+		arg += len + !!comma;
+
+		/* a term without value never matches a name below */
+		value = strchr(term, '=');
+		if (value)
+			*value++ = '\0';
+		else
+			value = term + len;
 
-		frame_length = binary_size / 8;
-	}
+		if (!strcmp(term, "type")) {
+			for (size_t i = 0; i < ARRAY_SIZE(types); i++) {
+				if (!strcmp(value, types[i])) {
+					filter->frame_type = i;
+					ret = 0;
+				}
+			}
+		} else if (!strcmp(term, "pan")) {
+			unsigned long pan = strtoul(value, &endp, 16);
 
-	if (option_verbose > 0) {
-		printf("Input:\n");
-		print_binary_bits_lsbfirst(&data[data_idx], 0,
-					   frame_length * 8 - 1,
-					   group_sz);
-		putchar('\n');
+			if (endp != value && *endp == '\0' && pan <= 0xffff) {
+				filter->pan = pan;
+				ret = 0;
+			}
+		} else if (!strcmp(term, "dst")) {
+			ret = wisun_2fsk_filter_parse_addr(value,
+							   &filter->dst_mode,
+							   &filter->dst);
+		} else if (!strcmp(term, "src")) {
+			ret = wisun_2fsk_filter_parse_addr(value,
+							   &filter->src_mode,
+							   &filter->src);
+		}
+
+		if (ret < 0) {
+			fprintf(stderr, "bad filter term: %s\n", term);
+			return -1;
+		}
 	}
 
-	/* append crc */
-	if (phr_options & WISUN_2FSK_PHR_FCS_TYPE_CRC16) {
-		fprintf(stderr, "FCS16 is not supported now\n");
-		return -1;
-	} else {
-		uint32_t c32 = ieee_802154_fcs32(IEEE_802154_FCS32_INIT,
-						 &data[data_idx],
-						 frame_length);
+	return 0;
+}
 
-		data_idx += frame_length;
-		data[data_idx++] = (c32 >>  0) & 0xff;
-		data[data_idx++] = (c32 >>  8) & 0xff;
-		data[data_idx++] = (c32 >> 16) & 0xff;
-		data[data_idx++] = (c32 >> 24) & 0xff;
-		frame_length += 4;
-	}
+static bool wisun_2fsk_filter_match(const struct wisun_2fsk_filter *filter,
+				    const struct ieee_802154_mhr *mhr)
+{
+	if (filter->frame_type >= 0 && filter->frame_type != mhr->frame_type)
+		return false;
 
-	/* fill phr */
-	phr = wisun_2fsk_make_phr(phr_options, frame_length);
-	p_phr[0] = (phr >> 0) & 0xff;
-	p_phr[1] = (phr >> 8) & 0xff;
+	if (filter->pan != IEEE_802154_PAN_NONE && filter->pan != mhr->dst_pan
+	    && filter->pan != mhr->src_pan)
+		return false;
 
-	if (option_verbose > 0) {
-		printf("PHR, DATA, CRC:\n");
-		print_binary_bits_lsbfirst(data, 0,
-					   (frame_length + sizeof(phr)) * 8 - 1,
-					   group_sz);
-		putchar('\n');
-	}
+	if (filter->dst_mode != IEEE_802154_ADDR_NONE
+	    && (filter->dst_mode != mhr->dst_mode || filter->dst != mhr->dst_addr))
+		return false;
 
-	if (type != WISUN_2FSK_SFD_CODED0 && type != WISUN_2FSK_SFD_CODED1)
-		goto push_data;
+	if (filter->src_mode != IEEE_802154_ADDR_NONE
+	    && (filter->src_mode != mhr->src_mode || filter->src != mhr->src_addr))
+		return false;
 
-	/* encode it */
-	if (use_rsc) {
-		encoder.m = RSC_INIT_M;
-		foreach_bit_in_buffer_lsbfirst(data, data_idx * 8,
-					       wisun_2fsk_rsc_input_bit,
-					       &encoder);
+	return true;
+}
 
-		if (option_verbose > 0) {
-			printf("Memory state(M0-M2): %d%d%d\n",
-				(encoder.m >> 2) & 1,
-				(encoder.m >> 1) & 1,
-				(encoder.m >> 0) & 1);
-		}
+/* the MHR is parsed only when --filter is used, the frames which have no
+ * valid MHR never match.
+ */
+static bool wisun_2fsk_frame_match_filters(const struct wisun_2fsk_frame *f)
+{
+	const uint8_t *p_psdu = f->buf + f->preamble_sz / 8 + 2 + sizeof(f->phr);
+	size_t fcs_sz = f->phr & WISUN_2FSK_PHR_FCS_TYPE_CRC16 ? 2 : 4;
+	size_t psdu_sz = f->phy_payload_sz - sizeof(f->phr);
+	struct ieee_802154_mhr mhr;
 
-		pad_sz = wisun_2fsk_fec_padding(pad, frame_length, type,
-						encoder.m);
-		foreach_bit_in_buffer_lsbfirst(pad, pad_sz * 8,
-					       wisun_2fsk_rsc_input_bit,
-					       &encoder);
-	} else {
-		encoder.m = NRNSC_INIT_M;
-		foreach_bit_in_buffer_lsbfirst(data, data_idx * 8,
-					       wisun_2fsk_nrnsc_input_bit,
-					       &encoder);
+	if (option_filters_count == 0)
+		return true;
 
-		pad_sz = wisun_2fsk_fec_padding(pad, frame_length, type, 0);
-		foreach_bit_in_buffer_lsbfirst(pad, pad_sz * 8,
-					       wisun_2fsk_nrnsc_input_bit,
-					       &encoder);
-	}
+	if (psdu_sz < fcs_sz
+	    || ieee_802154_mhr_parse(p_psdu, psdu_sz - fcs_sz, &mhr) < 0)
+		return false;
 
-	if (option_verbose > 0 && pad_sz > 0) {
-		printf("Padding:\n");
-		print_binary_bits_lsbfirst(pad, 0, pad_sz * 8 - 1, group_sz);
-		putchar('\n');
+	for (int i = 0; i < option_filters_count; i++) {
+		if (wisun_2fsk_filter_match(&option_filters[i], &mhr))
+			return true;
 	}
 
-push_data:
-	switch (type) {
-	case WISUN_2FSK_SFD_CODED0:
-	case WISUN_2FSK_SFD_CODED1:
-		p_frame = bufwrite_push_data(&b, encoder.buf,
-					     encoder.encode_bits / 8);
+	return false;
+}
 
-		if (option_verbose > 0) {
-			printf("After Convolutional:\n");
-			print_binary_bits_lsbfirst(encoder.buf, 0,
-						   encoder.encode_bits - 1,
-						   group_sz);
-			putchar('\n');
+/* the PSDU is saved with the TAP header or the FCS when the link type
+ * asks for them. The frame time is the decoding start time and the SHR
+ * offset in the input.
+ *
+ * The FCS is saved only with the TAP header, whose FCS type TLV tells the
+ * FCS32 of Wi-SUN. LINKTYPE_IEEE802_15_4_WITHFCS is decoded as FCS16 by
+ * wireshark unless the FCS length preference is changed.
+ */
+static void wisun_2fsk_frame_write_pcap(const struct wisun_2fsk_frame *f)
+{
+	const uint8_t *p_psdu = f->buf + f->preamble_sz / 8 + 2 + sizeof(f->phr);
+	size_t fcs_sz = f->phr & WISUN_2FSK_PHR_FCS_TYPE_CRC16 ? 2 : 4;
+	size_t psdu_sz = f->phy_payload_sz - sizeof(f->phr);
+	uint64_t ts = option_pcap.start_ns
+		+ (uint64_t)(f->offset * 1e9 / option_pcap.symbol_rate);
+	uint8_t tap[64];
+	struct iovec iov[2];
+	int iovcnt = 0;
+
+	if (option_pcap.linktype == LINKTYPE_IEEE802_15_4_TAP) {
+		int coded = f->type == WISUN_2FSK_SFD_CODED0
+			 || f->type == WISUN_2FSK_SFD_CODED1;
+		size_t n = 4;
+
+		n += ieee802154_tap_put_tlv(tap + n, IEEE802154_TAP_FCS_TYPE,
+					    fcs_sz == 2 ? 1 : 2, 1);
+		n += ieee802154_tap_put_tlv(tap + n,
+					    IEEE802154_TAP_START_OF_FRAME_TS,
+					    ts, 8);
+		if (option_pcap.wisun_tlvs) {
+			n += ieee802154_tap_put_tlv(tap + n,
+					IEEE802154_TAP_WISUN_SFD,
+					wisun_2fsk_sfd_value(f->type), 2);
+			/* 0: uncoded, 1: NRNSC, 2: RSC, bit2: interleaving */
+			n += ieee802154_tap_put_tlv(tap + n,
+					IEEE802154_TAP_WISUN_FEC_MODE,
+					coded ? (1 + f->use_rsc)
+						| (f->interleaving << 2) : 0,
+					1);
+		}
+		tap[0] = 0;	/* version */
+		tap[1] = 0;
+		tap[2] = n;
+		tap[3] = n >> 8;
+
+		iov[iovcnt].iov_base = tap;
+		iov[iovcnt++].iov_len = n;
+	} else if (option_pcap.linktype == LINKTYPE_IEEE802_15_4_NOFCS) {
+		psdu_sz = psdu_sz > fcs_sz ? psdu_sz - fcs_sz : 0;
+	}
+
+	iov[iovcnt].iov_base = (void *)p_psdu;
+	iov[iovcnt++].iov_len = psdu_sz;
+	wisun_fsk_pcap_writer_add(option_pcap.w, ts, iov, iovcnt);
+}
+
+static void wisun_2fsk_frame_print(const struct wisun_2fsk_frame *f)
+{
+	size_t binary_size = f->preamble_sz + (2 /* sfd */ + f->phy_payload_sz) * 8;
+
+	/* drop the unwanted frames before formatting */
+	if (!wisun_2fsk_frame_match_filters(f))
+		return;
+
+	/* PHR and PSDU bytes */
+	WISUN_FSK_SDT3(frame_emitted, f->offset, f->phy_payload_sz,
+		       f->channel);
+
+	/* the pcap writer has its own lock */
+	if (option_pcap.w) {
+		wisun_2fsk_frame_write_pcap(f);
+		return;
+	}
+
+	/* channelized frames may be printed from several decode threads */
+	flockfile(stdout);
+
+	if (f->source)
+		printf("%s: ", f->source);
+	if (f->channel >= 0)
+		printf("ch%d: ", f->channel);
+
+	wisun_2fsk_print_packet(f->buf, binary_size, f->preamble_sz, f->type,
+				f->phy_payload_sz - sizeof(f->phr));
+
+	funlockfile(stdout);
+}
+
+/* Get the PHY payload bytes after the PHR based on the PHR.
+ * Return -1 if the PHR can not be decoded.
+ */
+static int wisun_2fsk_frame_payload_size(const struct wisun_2fsk_frame *f,
+					 int use_rsc, int interleaving,
+					 size_t *ret_payload_sz)
+{
+	const uint8_t *p_phr = f->buf + f->preamble_sz / 8 + 2 /* sfd */;
+	struct fec_block_decoder d;
+	size_t frame_length, pad_sz;
+	uint8_t phr_le[2];
+	uint16_t phr;
+
+	if (f->type != WISUN_2FSK_SFD_CODED0 && f->type != WISUN_2FSK_SFD_CODED1) {
+		phr = wisun_2fsk_fix_phr_order(buffer_peek_u16_b1b0(p_phr));
+		*ret_payload_sz = phr >> 5;
+		WISUN_FSK_SDT2(phr_decoded, phr, *ret_payload_sz);
+		return 0;
+	}
+
+	fec_block_decoder_init(&d, use_rsc, interleaving);
+	if (fec_block_decode(&d, p_phr, 1, phr_le) < 0) {
+		WISUN_FSK_SDT3(fec_fail, 0, use_rsc, interleaving);
+		return -1;
+	}
+
+	phr = wisun_2fsk_fix_phr_order(buffer_peek_u16_b1b0(phr_le));
+	frame_length = phr >> 5;
+	pad_sz = number_is_even(sizeof(phr) + frame_length) ? 2 : 1;
+
+	/* the length will be double after convolutional */
+	*ret_payload_sz = (frame_length + pad_sz) * 2;
+	WISUN_FSK_SDT2(phr_decoded, phr, *ret_payload_sz);
+	return 0;
+}
+
+/* FEC and interleaving hypothesis of a coded frame */
+struct wisun_2fsk_fec_hypothesis {
+	int		use_rsc;
+	int		interleaving;
+	uint16_t	phr;
+	int		score;
+};
+
+#define WISUN_2FSK_FEC_HYPOTHESES	4
+
+/* Decode the 4 bytes coded PHR under all FEC and interleaving hypotheses,
+ * the decodable ones are sorted by how plausible the PHR is. @available is
+ * the coded bytes after the PHR in the input, SIZE_MAX if unknown.
+ * Return the hypotheses count.
+ */
+static int wisun_2fsk_rank_fec_hypotheses(const uint8_t *coded_phr,
+					  size_t available,
+					  struct wisun_2fsk_fec_hypothesis *hyps)
+{
+	int n = 0;
+
+	for (int i = 0; i < WISUN_2FSK_FEC_HYPOTHESES; i++) {
+		struct wisun_2fsk_fec_hypothesis h = {
+			.use_rsc = i & 1,
+			.interleaving = !!(i & 2),
+		};
+		struct fec_block_decoder d;
+		size_t frame_length, payload_sz;
+		uint8_t phr_le[2];
+		int j;
+
+		fec_block_decoder_init(&d, h.use_rsc, h.interleaving);
+		if (fec_block_decode(&d, coded_phr, 1, phr_le) < 0)
+			continue;
+
+		h.phr = wisun_2fsk_fix_phr_order(buffer_peek_u16_b1b0(phr_le));
+		frame_length = h.phr >> 5;
+		payload_sz = (frame_length
+			      + (number_is_even(2 + frame_length) ? 2 : 1)) * 2;
+
+		/* the PSDU has at least 1 byte data and the FCS */
+		if (frame_length > 4)
+			h.score += 4;
+		if (payload_sz <= available)
+			h.score += 4;
+		if (!(h.phr & (0b110 | WISUN_2FSK_PHR_MODE_SWITCH)))
+			h.score += 2;
+		if (!(h.phr & WISUN_2FSK_PHR_FCS_TYPE_CRC16))
+			h.score += 1;
+
+		for (j = n; j > 0 && hyps[j - 1].score < h.score; j--)
+			hyps[j] = hyps[j - 1];
+		hyps[j] = h;
+		n++;
+	}
+
+	return n;
+}
+
+static void wisun_2fsk_report_fec(int use_rsc, int interleaving, uint16_t phr)
+{
+	fprintf(stderr, "auto: %s%s%s\n", use_rsc ? "rsc" : "nrnsc",
+		interleaving ? " interleaving" : "",
+		phr & WISUN_2FSK_PHR_DATA_WHITENING ? " whitening" : "");
+}
+
+/* count the binary chars which can be parsed by str01_to_buffer */
+static size_t str01_count_bits(const char *s, size_t max)
+{
+	size_t n = 0;
+
+	for (; *s != '\0' && n < max; s++) {
+	#if DEBUG > 0
+		if (*s == '-' || *s == ':')
+			continue;
+	#endif
+		if (*s != '0' && *s != '1')
+			break;
+		n++;
+	}
+
+	return n;
+}
+
+/* decode the first 2-FSK frame found in @str01.
+ * Only the bits of SHR and PHR are parsed first, the following bits are
+ * parsed based on the frame length in PHR, the chars after the frame are
+ * left to @ret_endp. Nothing is printed on errors if @quiet.
+ * Return the frame index in @str01, -1 if no frame can be decoded.
+ */
+static int wisun_2fsk_str01_decode_frame(const char *str01,
+					 struct wisun_2fsk_frame *f,
+					 int use_rsc, int interleaving,
+					 int skip_verify, int quiet,
+					 const char **ret_endp)
+{
+	enum wisun_2fsk_sfd_type type;
+	struct wisun_2fsk_fec_hypothesis hyps[WISUN_2FSK_FEC_HYPOTHESES];
+	size_t preamble_sz, binary_size, header_sz, payload_sz;
+	const char *endp, *payload;
+	int idx, nhyps, auto_fec;
+
+	idx = wisun_2fsk_str01_find_shr(str01, &preamble_sz, &type);
+	if (idx < 0) {
+		if (!quiet)
+			fprintf(stderr, "2-FSK SHR is not found\n");
+		return idx;
+	}
+
+	WISUN_FSK_SDT3(shr_found, idx, preamble_sz, type);
+	wisun_2fsk_frame_init(f, preamble_sz, type);
+	f->quiet = quiet;
+
+	/* preamble, sfd and phr(4 bytes after convolutional) */
+	header_sz = preamble_sz / 8 + 2 + sizeof(uint16_t);
+	if (type == WISUN_2FSK_SFD_CODED0 || type == WISUN_2FSK_SFD_CODED1)
+		header_sz += sizeof(uint16_t);
+
+	if (header_sz > sizeof(f->buf)) {
+		wisun_2fsk_frame_error(f, "2-FSK preamble is too long");
+		return -1;
+	}
+
+	binary_size = str01_to_buffer(str01 + idx, &endp, f->buf, header_sz, 1);
+	if (binary_size < header_sz * 8)
+		goto truncated;
+
+	hyps[0].use_rsc = use_rsc;
+	hyps[0].interleaving = interleaving;
+	nhyps = 1;
+
+	auto_fec = option_auto && header_sz > preamble_sz / 8 + 4;
+	if (auto_fec) {
+		size_t available = str01_count_bits(endp,
+					sizeof(f->buf) * 8) / 8;
+
+		/* the CRC is the final check, try the next one if failed */
+		nhyps = wisun_2fsk_rank_fec_hypotheses(f->buf + header_sz - 4,
+						       available, hyps);
+		if (nhyps == 0) {
+			wisun_2fsk_frame_error(f, "Error: decode PHR failed");
+			return -1;
+		}
+	}
+
+	/* the rejected hypotheses are not reported, only if all failed */
+	f->quiet = quiet || nhyps > 1;
+
+	payload = endp;
+	for (int i = 0; i < nhyps; i++) {
+		use_rsc = hyps[i].use_rsc;
+		interleaving = hyps[i].interleaving;
+
+		/* the coded PHR is decoded in place */
+		if (i > 0)
+			str01_to_buffer(str01 + idx, NULL, f->buf, header_sz, 1);
+		binary_size = header_sz * 8;
+
+		if (wisun_2fsk_frame_payload_size(f, use_rsc, interleaving,
+						  &payload_sz) < 0) {
+			wisun_2fsk_frame_error(f, "Error: decode PHR failed");
+			continue;
+		}
+
+		if (header_sz + payload_sz > sizeof(f->buf)) {
+			wisun_2fsk_frame_error(f, "2-FSK frame is too long");
+			continue;
+		}
+
+		binary_size += str01_to_buffer(payload, &endp, f->buf + header_sz,
+					       payload_sz, 1);
+		if (binary_size < (header_sz + payload_sz) * 8) {
+			if (i + 1 < nhyps)
+				continue;
+			goto truncated;
+		}
+
+		f->offset = idx;
+		if (wisun_2fsk_frame_decode(f, binary_size, use_rsc,
+					    interleaving) < 0)
+			continue;
+
+		if (!skip_verify && !wisun_2fsk_frame_check(f))
+			continue;
+
+		f->quiet = quiet;
+		if (auto_fec && !quiet)
+			wisun_2fsk_report_fec(use_rsc, interleaving, f->phr);
+
+		if (ret_endp)
+			*ret_endp = endp;
+
+		return idx;
+	}
+
+	f->quiet = quiet;
+	if (nhyps > 1)
+		wisun_2fsk_frame_error(f,
+			"Error: decode failed by all FEC hypotheses");
+	return -1;
+
+truncated:
+	f->quiet = quiet;
+	if (*endp != '\0' && !quiet) {
+		fprintf(stderr, "input binary string is bad after:\n");
+		fprintf(stderr, "%s\n", endp);
+	} else {
+		wisun_2fsk_frame_error(f, "Error: PHY payload is truncated");
+	}
+	return -1;
+}
+
+static int wisun_2fsk_packet_decode(const char *str01, int use_rsc,
+				    int interleaving, int skip_verify)
+{
+	struct wisun_2fsk_frame *f = malloc(sizeof(*f));
+	int idx;
+
+	if (!f)
+		return -1;
+
+	idx = wisun_2fsk_str01_decode_frame(str01, f, use_rsc, interleaving,
+					    skip_verify, 0, NULL);
+	if (idx >= 0) {
+		if (option_verbose > 0)
+			printf("After packet decode\n");
+
+		wisun_2fsk_frame_print(f);
+	}
+
+	free(f);
+	return idx < 0 ? -1 : 0;
+}
+
+/* URH runs the plugin again each time a message is viewed. The printed
+ * result is saved in the cache file, keyed by the plugin version, the parsed
+ * decode options and the input bits, the repeated views are printed from the
+ * cache without decoding.
+ *
+ * The cached value is the stdout size, the stdout and the stderr output,
+ * e.g. the --repair and --auto reports, a hit prints the same as a miss.
+ */
+struct wisun_2fsk_cache_value {
+	uint32_t	stdout_len;
+	char		buf[WISUN_FSK_CACHE_VALUE_MAX - sizeof(uint32_t)];
+};
+
+/* the options changing the printed result, there is no padding */
+struct wisun_2fsk_cache_key {
+	char		version[8];
+	int32_t		verbose;
+	int32_t		human;
+	int32_t		hexi, hexo;
+	int32_t		repair;
+	int32_t		autodetect;
+	int32_t		use_rsc, interleaving;
+	int32_t		skip_verify;
+	int32_t		filters_count;
+	struct {
+		int32_t		frame_type;
+		uint32_t	pan;
+		uint32_t	dst_mode, src_mode;
+		uint64_t	dst, src;
+	} filters[WISUN_2FSK_MAX_FILTERS];
+	char		str01[];
+};
+
+/* the options are the parsed ones, the order and the spelling of them on the
+ * command line doesn't change the key.
+ */
+static struct wisun_2fsk_cache_key *
+wisun_2fsk_cache_key(const char *str01, int use_rsc, int interleaving,
+		     int skip_verify, size_t *ret_key_len)
+{
+	size_t len = strlen(str01);
+	struct wisun_2fsk_cache_key *key;
+
+	key = calloc(1, sizeof(*key) + len);
+	if (!key)
+		return NULL;
+
+	strncpy(key->version, URH_WIRUN_FSK_PLUGIN_VERSION,
+		sizeof(key->version));
+	key->verbose = option_verbose;
+	key->human = option_human;
+	key->hexi = option_hexi;
+	key->hexo = option_hexo;
+	key->repair = option_repair;
+	key->autodetect = option_auto;
+	key->use_rsc = use_rsc;
+	key->interleaving = interleaving;
+	key->skip_verify = skip_verify;
+	key->filters_count = option_filters_count;
+	for (int i = 0; i < option_filters_count; i++) {
+		const struct wisun_2fsk_filter *f = &option_filters[i];
+
+		key->filters[i].frame_type = f->frame_type;
+		key->filters[i].pan = f->pan;
+		key->filters[i].dst_mode = f->dst_mode;
+		key->filters[i].src_mode = f->src_mode;
+		key->filters[i].dst = f->dst;
+		key->filters[i].src = f->src;
+	}
+	memcpy(key->str01, str01, len);
+
+	*ret_key_len = sizeof(*key) + len;
+	return key;
+}
+
+/* print the cached value, return -1 if it's broken */
+static int wisun_2fsk_cache_replay(const struct wisun_2fsk_cache_value *v,
+				   int len)
+{
+	size_t buf_len = len - sizeof(v->stdout_len);
+
+	if ((size_t)len < sizeof(v->stdout_len) || v->stdout_len > buf_len)
+		return -1;
+
+	fwrite(v->buf, 1, v->stdout_len, stdout);
+	fwrite(v->buf + v->stdout_len, 1, buf_len - v->stdout_len, stderr);
+	return 0;
+}
+
+/* Lookup the cache after the options are parsed and before the decoder is
+ * initialized, a hit costs only the cache file access. The cache file isn't created here, a missed one is
+ * saved by wisun_2fsk_packet_decode_cached.
+ * Return 1 if the result is printed from the cache, -1 on error.
+ */
+static int wisun_2fsk_cache_early_lookup(const char *str01, int use_rsc,
+					 int interleaving, int skip_verify)
+{
+	static struct wisun_2fsk_cache_value value;
+	struct wisun_2fsk_cache_key *key;
+	struct wisun_fsk_cache cache;
+	size_t key_len;
+	int n;
+
+	if (access(option_cache, F_OK) < 0)
+		return 0;
+
+	if (wisun_fsk_cache_open(&cache, option_cache) < 0)
+		return -1;
+
+	key = wisun_2fsk_cache_key(str01, use_rsc, interleaving, skip_verify,
+				   &key_len);
+	if (!key) {
+		wisun_fsk_cache_close(&cache);
+		return 0;
+	}
+
+	n = wisun_fsk_cache_lookup(&cache, key, key_len, (char *)&value,
+				   sizeof(value));
+	free(key);
+	wisun_fsk_cache_close(&cache);
+
+	return n >= 0 && wisun_2fsk_cache_replay(&value, n) == 0;
+}
+
+/* redirect @fd to a temporary file, return the file or NULL on error */
+static FILE *wisun_2fsk_capture_fd(int fd, int *ret_saved_fd)
+{
+	FILE *fp = tmpfile();
+
+	*ret_saved_fd = -1;
+	if (!fp)
+		return NULL;
+
+	*ret_saved_fd = dup(fd);
+	if (*ret_saved_fd < 0 || dup2(fileno(fp), fd) < 0) {
+		if (*ret_saved_fd >= 0)
+			close(*ret_saved_fd);
+		*ret_saved_fd = -1;
+		fclose(fp);
+		return NULL;
+	}
+
+	return fp;
+}
+
+static void wisun_2fsk_restore_fd(int fd, int saved_fd)
+{
+	dup2(saved_fd, fd);
+	close(saved_fd);
+}
+
+/* copy the captured output to @fp and @buf, return the output size */
+static size_t wisun_2fsk_capture_copy(FILE *capture, FILE *fp, char *buf,
+				      size_t buf_sz)
+{
+	char chunk[4096];
+	size_t len = 0;
+	size_t n;
+
+	rewind(capture);
+	while ((n = fread(chunk, 1, sizeof(chunk), capture)) > 0) {
+		fwrite(chunk, 1, n, fp);
+		if (len + n <= buf_sz)
+			memcpy(buf + len, chunk, n);
+		len += n;
+	}
+
+	return len;
+}
+
+static int wisun_2fsk_packet_decode_cached(const char *str01, int use_rsc,
+					   int interleaving, int skip_verify)
+{
+	static struct wisun_2fsk_cache_value value;
+	struct wisun_2fsk_cache_key *key;
+	struct wisun_fsk_cache cache;
+	size_t key_len, out_len, out_len_saved, err_len;
+	FILE *out_fp, *err_fp;
+	int stdout_fd, stderr_fd, ret = -1, n;
+
+	if (wisun_fsk_cache_open(&cache, option_cache) < 0)
+		return -1;
+
+	key = wisun_2fsk_cache_key(str01, use_rsc, interleaving, skip_verify,
+				   &key_len);
+	if (!key)
+		goto done;
+
+	/* the cache file is created or stored by another process after the
+	 * early lookup.
+	 */
+	n = wisun_fsk_cache_lookup(&cache, key, key_len, (char *)&value,
+				   sizeof(value));
+	if (n >= 0 && wisun_2fsk_cache_replay(&value, n) == 0) {
+		ret = 0;
+		goto done;
+	}
+
+	/* capture the printed result */
+	fflush(stdout);
+	fflush(stderr);
+	out_fp = wisun_2fsk_capture_fd(STDOUT_FILENO, &stdout_fd);
+	err_fp = wisun_2fsk_capture_fd(STDERR_FILENO, &stderr_fd);
+	if (!out_fp || !err_fp) {
+		if (out_fp) {
+			wisun_2fsk_restore_fd(STDOUT_FILENO, stdout_fd);
+			fclose(out_fp);
+		}
+		if (err_fp) {
+			wisun_2fsk_restore_fd(STDERR_FILENO, stderr_fd);
+			fclose(err_fp);
+		}
+		ret = wisun_2fsk_packet_decode(str01, use_rsc, interleaving,
+					       skip_verify);
+		goto done;
+	}
+
+	ret = wisun_2fsk_packet_decode(str01, use_rsc, interleaving,
+				       skip_verify);
+	fflush(stdout);
+	fflush(stderr);
+	wisun_2fsk_restore_fd(STDOUT_FILENO, stdout_fd);
+	wisun_2fsk_restore_fd(STDERR_FILENO, stderr_fd);
+
+	out_len = wisun_2fsk_capture_copy(out_fp, stdout, value.buf,
+					  sizeof(value.buf));
+	if (out_len > sizeof(value.buf))
+		out_len_saved = sizeof(value.buf);
+	else
+		out_len_saved = out_len;
+	err_len = wisun_2fsk_capture_copy(err_fp, stderr,
+					  value.buf + out_len_saved,
+					  sizeof(value.buf) - out_len_saved);
+	fclose(out_fp);
+	fclose(err_fp);
+
+	/* only the short and good results are saved */
+	if (ret == 0 && out_len + err_len <= sizeof(value.buf)) {
+		value.stdout_len = out_len;
+		wisun_fsk_cache_store(&cache, key, key_len, (char *)&value,
+				      sizeof(value.stdout_len) + out_len
+				      + err_len);
+	}
+
+done:
+	free(key);
+	wisun_fsk_cache_close(&cache);
+	return ret;
+}
+
+/* The longest preamble a streaming decoder keeps, the longer ones are
+ * reported as this size.
+ */
+#define WISUN_2FSK_STREAM_MAX_PREAMBLE	512
+/* coded PHR, the max 2047 bytes PSDU and padding after convolutional */
+#define WISUN_2FSK_MAX_CODED_PAYLOAD	(4 + (2047 + 2) * 2)
+
+enum wisun_2fsk_stream_state {
+	WISUN_2FSK_STREAM_SEARCH,	/* searching SHR */
+	WISUN_2FSK_STREAM_FRAME,	/* receiving PHR and PSDU */
+};
+
+struct wisun_2fsk_stream_decoder;
+
+typedef void (*wisun_2fsk_stream_emit_t)(struct wisun_2fsk_stream_decoder *dec,
+					 struct wisun_2fsk_frame *f);
+
+/* Decode frames from a continuous 01 stream which is feeded in chunks of
+ * any size. Each frame is decoded block by block when the bits arrive, and
+ * emitted as soon as the last bit is received.
+ */
+struct wisun_2fsk_stream_decoder {
+	int				use_rsc;
+	int				interleaving;
+	int				skip_verify;
+	int				auto_fec;	/* see option_auto */
+	int				quiet;		/* see frame quiet */
+	wisun_2fsk_stream_emit_t	emit;
+	wisun_2fsk_stream_emit_t	reject;		/* bad FCS, optional */
+	wisun_2fsk_stream_emit_t	start;		/* SHR found, optional */
+	void				*private_data;
+
+	enum wisun_2fsk_stream_state	state;
+	uint64_t			position;	/* bits processed */
+
+	/* SHR search state */
+	uint32_t			shift;		/* lsb is the newest */
+	uint16_t			runs[32];	/* alternating run length */
+	uint16_t			sfd_values[WISUN_2FSK_SFD_MAX];
+	size_t				search_bits;
+
+	/* receiving frame state */
+	struct wisun_2fsk_frame		frame;
+	uint8_t				*payload;	/* phy payload in frame */
+	int				coded;
+	struct fec_block_decoder	fec;
+	size_t				expected_bits;	/* 0: PHR not received */
+	size_t				pad_sz;
+
+	/* the raw bits after SFD of the receiving frame, they will be
+	 * replayed to the SHR search if the frame is bad.
+	 */
+	uint8_t				raw[WISUN_2FSK_MAX_CODED_PAYLOAD];
+	size_t				raw_bits;
+	uint8_t				replay[WISUN_2FSK_MAX_CODED_PAYLOAD];
+	size_t				replay_bits;
+	size_t				replay_pos;
+	uint64_t			replay_base;
+
+	uint64_t			frames;
+	uint64_t			errors;
+};
+
+static void wisun_2fsk_stream_decoder_reset_search(
+				struct wisun_2fsk_stream_decoder *dec)
+{
+	dec->state = WISUN_2FSK_STREAM_SEARCH;
+	dec->shift = 0;
+	dec->search_bits = 0;
+}
+
+static void wisun_2fsk_stream_decoder_init(struct wisun_2fsk_stream_decoder *dec,
+					   int use_rsc, int interleaving,
+					   int skip_verify,
+					   wisun_2fsk_stream_emit_t emit,
+					   void *private_data)
+{
+	memset(dec, 0, sizeof(*dec));
+
+	dec->use_rsc = use_rsc;
+	dec->interleaving = interleaving;
+	dec->skip_verify = skip_verify;
+	dec->auto_fec = option_auto;
+	dec->emit = emit;
+	dec->private_data = private_data;
+
+	/* the sfd bits in received order, the first bit is bit15 */
+	for (enum wisun_2fsk_sfd_type t = 0; t < WISUN_2FSK_SFD_MAX; t++) {
+		const char *sfd = wisun_2fsk_phy_sfd_binary_streams[t];
+
+		for (const char *p = sfd; *p != '\0'; p++)
+			dec->sfd_values[t] = (dec->sfd_values[t] << 1) | (*p - '0');
+	}
+
+	wisun_2fsk_stream_decoder_reset_search(dec);
+}
+
+static void wisun_2fsk_stream_start_frame(struct wisun_2fsk_stream_decoder *dec,
+					  enum wisun_2fsk_sfd_type type,
+					  size_t preamble_sz)
+{
+	struct wisun_2fsk_frame *f = &dec->frame;
+	uint16_t sfd = wisun_2fsk_sfd_value(type);
+
+	wisun_2fsk_frame_init(f, preamble_sz, type);
+	f->quiet = dec->quiet;
+	f->offset = dec->position - 16 - preamble_sz;
+
+	memset(f->buf, 0xaa, preamble_sz / 8); /* WISUN_2FSK_PREAMBLE */
+	f->buf[preamble_sz / 8 + 0] = (sfd >> 0) & 0xff;
+	f->buf[preamble_sz / 8 + 1] = (sfd >> 8) & 0xff;
+
+	dec->payload = f->buf + preamble_sz / 8 + 2;
+	dec->coded = type == WISUN_2FSK_SFD_CODED0
+			|| type == WISUN_2FSK_SFD_CODED1;
+	fec_block_decoder_init(&dec->fec, dec->use_rsc, dec->interleaving);
+	dec->expected_bits = 0;
+	dec->raw_bits = 0;
+	dec->state = WISUN_2FSK_STREAM_FRAME;
+
+	if (dec->start)
+		dec->start(dec, f);
+}
+
+static void wisun_2fsk_stream_search_bit(struct wisun_2fsk_stream_decoder *dec,
+					 int b)
+{
+	size_t cur = dec->search_bits++;
+	uint16_t run = 1;
+
+	if (cur > 0 && (int)(dec->shift & 1) != b) {
+		run = dec->runs[(cur - 1) % ARRAY_SIZE(dec->runs)];
+		if (run < UINT16_MAX)
+			run++;
+	}
+
+	dec->runs[cur % ARRAY_SIZE(dec->runs)] = run;
+	dec->shift = (dec->shift << 1) | b;
+
+	/* at least one preamble before the 16 bits sfd */
+	if (dec->search_bits < 16 + strlen(WISUN_2FSK_PREAMBLE))
+		return;
+
+	for (enum wisun_2fsk_sfd_type t = 0; t < WISUN_2FSK_SFD_MAX; t++) {
+		size_t preamble_sz;
+
+		if ((dec->shift & 0xffff) != dec->sfd_values[t])
+			continue;
+
+		/* the preamble is 0101... and ends with 1 just before the
+		 * sfd, count the whole WISUN_2FSK_PREAMBLE groups only.
+		 */
+		if (!((dec->shift >> 16) & 1))
+			break;
+
+		preamble_sz = dec->runs[(cur - 16) % ARRAY_SIZE(dec->runs)];
+		preamble_sz = preamble_sz / 8 * 8;
+		if (preamble_sz == 0)
+			break;
+
+		if (preamble_sz > WISUN_2FSK_STREAM_MAX_PREAMBLE)
+			preamble_sz = WISUN_2FSK_STREAM_MAX_PREAMBLE;
+
+		wisun_2fsk_stream_start_frame(dec, t, preamble_sz);
+		break;
+	}
+}
+
+static int wisun_2fsk_stream_set_phr(struct wisun_2fsk_stream_decoder *dec)
+{
+	struct wisun_2fsk_frame *f = &dec->frame;
+	size_t frame_length;
+
+	f->phr = wisun_2fsk_fix_phr_order(buffer_peek_u16_b1b0(dec->payload));
+	frame_length = f->phr >> 5;
+	f->phy_payload_sz = sizeof(f->phr) + frame_length;
+
+	if (dec->coded) {
+		dec->pad_sz = number_is_even(f->phy_payload_sz) ? 2 : 1;
+		dec->expected_bits = (f->phy_payload_sz + dec->pad_sz) * 2 * 8;
+	} else {
+		dec->pad_sz = 0;
+		dec->expected_bits = f->phy_payload_sz * 8;
+	}
+
+	return 0;
+}
+
+/* Return 1 if the frame is completed, 0 if more bits are required and
+ * negative number if the frame is bad.
+ */
+static int wisun_2fsk_stream_frame_bit(struct wisun_2fsk_stream_decoder *dec,
+				       int b)
+{
+	struct wisun_2fsk_frame *f = &dec->frame;
+	size_t n = dec->raw_bits, idx;
+	uint8_t *raw = dec->raw;
+
+	if (n / 8 >= sizeof(dec->raw))
+		return -1;
+
+	if (n % 8 == 0)
+		raw[n / 8] = 0;
+	raw[n / 8] |= (b << (n % 8));
+	dec->raw_bits = ++n;
+
+	if (dec->coded) {
+		/* 2-bit u1u0 as one symbol, 16 symbol as one block */
+		if (n % 32)
+			return 0;
+
+		idx = n / 32 - 1;
+		if (idx == 0 && dec->auto_fec) {
+			struct wisun_2fsk_fec_hypothesis
+				hyps[WISUN_2FSK_FEC_HYPOTHESES];
+
+			/* no way to look ahead, the best PHR wins */
+			if (!wisun_2fsk_rank_fec_hypotheses(raw, SIZE_MAX, hyps))
+				return -1;
+			fec_block_decoder_init(&dec->fec, hyps[0].use_rsc,
+					       hyps[0].interleaving);
+		}
+
+		if (fec_block_decode(&dec->fec, &raw[idx * 4], 1,
+				     &dec->payload[idx * 2]) < 0)
+			return -1;
+
+		if (idx == 0) {
+			wisun_2fsk_stream_set_phr(dec);
+			wisun_2fsk_fused_setup_psdu(&dec->fec, f->phr);
+		}
+	} else {
+		if (n % 8)
+			return 0;
+
+		idx = n / 8 - 1;
+		dec->payload[idx] = raw[idx];
+
+		if (idx == 1)
+			wisun_2fsk_stream_set_phr(dec);
+		else if (idx > 1 && (f->phr & WISUN_2FSK_PHR_DATA_WHITENING))
+			pn9_payload_decode_offset(&dec->payload[idx], 1,
+						  idx - sizeof(f->phr));
+	}
+
+	return n == dec->expected_bits;
+}
+
+/* @ret is the result of the last wisun_2fsk_stream_frame_bit, the FCS of a
+ * completed frame is verified. Return 1 if the frame is good.
+ */
+static int wisun_2fsk_stream_frame_check(struct wisun_2fsk_stream_decoder *dec,
+					 int ret)
+{
+	struct wisun_2fsk_frame *f = &dec->frame;
+
+	if (ret > 0) {
+		f->input_bits = f->preamble_sz + 16 + dec->raw_bits;
+		if (dec->coded) {
+			wisun_2fsk_fused_save_fcs32(f, &dec->fec);
+			f->use_rsc = dec->fec.use_rsc;
+			f->interleaving = dec->fec.interleaving;
+		}
+
+		if (f->phy_payload_sz <= sizeof(f->phr)) {
+			ret = -1;
+		} else if (!dec->skip_verify && !wisun_2fsk_frame_check(f)) {
+			if (dec->reject)
+				dec->reject(dec, f);
+			ret = -1;
+		}
+	}
+
+	if (ret > 0 && dec->coded && option_auto)
+		wisun_2fsk_report_fec(dec->fec.use_rsc, dec->fec.interleaving,
+				      f->phr);
+
+	return ret > 0;
+}
+
+static void wisun_2fsk_stream_frame_done(struct wisun_2fsk_stream_decoder *dec,
+					 int ret)
+{
+	struct wisun_2fsk_frame *f = &dec->frame;
+
+	if (wisun_2fsk_stream_frame_check(dec, ret)) {
+		dec->frames++;
+		dec->emit(dec, f);
+		wisun_2fsk_stream_decoder_reset_search(dec);
+		return;
+	}
+
+	dec->errors++;
+	dec->state = WISUN_2FSK_STREAM_SEARCH;
+
+	/* replay the bits after sfd, the search state is kept as it was
+	 * when the sfd is found.
+	 */
+	if (dec->replay_pos < dec->replay_bits) {
+		/* all raw bits are saved in the replay buffer */
+		dec->replay_pos -= dec->raw_bits;
+	} else {
+		memcpy(dec->replay, dec->raw, roundup8(dec->raw_bits));
+		dec->replay_bits = dec->raw_bits;
+		dec->replay_pos = 0;
+		dec->replay_base = dec->position - dec->raw_bits;
+	}
+
+	dec->position -= dec->raw_bits;
+}
+
+static void wisun_2fsk_stream_process_bit(struct wisun_2fsk_stream_decoder *dec,
+					  int b)
+{
+	int ret;
+
+	dec->position++;
+
+	if (dec->state == WISUN_2FSK_STREAM_SEARCH) {
+		wisun_2fsk_stream_search_bit(dec, b);
+		return;
+	}
+
+	ret = wisun_2fsk_stream_frame_bit(dec, b);
+	if (ret != 0)
+		wisun_2fsk_stream_frame_done(dec, ret);
+}
+
+static void wisun_2fsk_stream_replay(struct wisun_2fsk_stream_decoder *dec)
+{
+	while (dec->replay_pos < dec->replay_bits) {
+		size_t i = dec->replay_pos++;
+
+		wisun_2fsk_stream_process_bit(dec,
+					      (dec->replay[i / 8] >> (i % 8)) & 1);
+	}
+}
+
+static void wisun_2fsk_stream_push_bit(struct wisun_2fsk_stream_decoder *dec,
+				       int b)
+{
+	wisun_2fsk_stream_process_bit(dec, b);
+	wisun_2fsk_stream_replay(dec);
+}
+
+/* end of stream, the truncated frame is dropped and the frames hidden in
+ * its bits are searched again.
+ */
+static void wisun_2fsk_stream_flush(struct wisun_2fsk_stream_decoder *dec)
+{
+	while (dec->state == WISUN_2FSK_STREAM_FRAME) {
+		wisun_2fsk_stream_frame_done(dec, -1);
+		wisun_2fsk_stream_replay(dec);
+	}
+}
+
+/* @bits are not received(squelched), the next bit isn't continuous with the
+ * last one, but the frame offsets are still counted from the stream start.
+ */
+static void wisun_2fsk_stream_skip(struct wisun_2fsk_stream_decoder *dec,
+				   uint64_t bits)
+{
+	wisun_2fsk_stream_flush(dec);
+	wisun_2fsk_stream_decoder_reset_search(dec);
+	dec->position += bits;
+}
+
+/* the chars except '0' and '1' are ignored */
+static void wisun_2fsk_stream_feed(struct wisun_2fsk_stream_decoder *dec,
+				   const char *s, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] == '0' || s[i] == '1')
+			wisun_2fsk_stream_push_bit(dec, s[i] - '0');
+	}
+}
+
+static void wisun_2fsk_stream_print_frame(struct wisun_2fsk_stream_decoder *dec,
+					  struct wisun_2fsk_frame *f)
+{
+	wisun_2fsk_frame_print(f);
+	/* the stream may be a live pipe */
+	fflush(stdout);
+}
+
+static int wisun_2fsk_stream_decode(const char *filename, int use_rsc,
+				    int interleaving, int skip_verify)
+{
+	struct wisun_2fsk_stream_decoder *dec;
+	char chunk[4096];
+	int fd, ret = 0;
+
+	if (!strcmp(filename, "-"))
+		fd = STDIN_FILENO;
+	else
+		fd = open(filename, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "open %s failed\n", filename);
+		return -1;
+	}
+
+	dec = malloc(sizeof(*dec));
+	if (!dec) {
+		ret = -1;
+		goto done;
+	}
+
+	wisun_2fsk_stream_decoder_init(dec, use_rsc, interleaving, skip_verify,
+				       wisun_2fsk_stream_print_frame, NULL);
+
+	while (1) {
+		/* read(2) returns as soon as some bits are in the pipe */
+		ssize_t n = read(fd, chunk, sizeof(chunk));
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "read %s failed\n", filename);
+			ret = -1;
+			break;
+		} else if (n == 0) {
+			break;
+		}
+
+		wisun_2fsk_stream_feed(dec, chunk, n);
+		/* one write for the frames of a chunk */
+		if (option_pcap.w)
+			wisun_fsk_pcap_writer_flush(option_pcap.w);
+	}
+
+	wisun_2fsk_stream_flush(dec);
+
+	if (option_verbose > 0)
+		fprintf(stderr, "%" PRIu64 " frames decoded, %" PRIu64
+			" bad frames\n", dec->frames, dec->errors);
+
+	free(dec);
+done:
+	if (fd != STDIN_FILENO)
+		close(fd);
+	return ret;
+}
+
+/* Pipelined streaming decode(--pipeline), each stage runs on its own
+ * pinned thread, connected by the SPSC rings of preallocated slots:
+ *
+ *   input(read, parse) -> bits -> shr(search, collect) -> candidates
+ *   -> decode(FEC, FCS) -> frames -> output(format)
+ *
+ * The SHR search never stops at a frame, every SFD is collected with the
+ * raw bits after it as a candidate in order. The frames hidden in a bad
+ * one are found as the serial decoder replaying its bits, and the
+ * candidates inside a good frame are dropped by the decode stage.
+ *
+ * The input is never dropped, a full ring stalls the stage before it and
+ * at last the reader. Only if the input is a live stream(not a regular
+ * file), the decoded frames are dropped and counted when the output can't
+ * keep up, the decode is never blocked by a slow consumer of the output.
+ * The candidates are dropped if more than WISUN_2FSK_PIPE_CANDIDATES are
+ * nested, e.g. in the bits claimed by a long bad PHR.
+ */
+#define WISUN_2FSK_PIPE_BITS		4096
+#define WISUN_2FSK_PIPE_SLOTS		64
+/* the slots of the candidates ring, all can be collected at the same time */
+#define WISUN_2FSK_PIPE_CANDIDATES	256
+
+struct wisun_2fsk_pipe_bits {
+	size_t				n;	/* 0: end of stream */
+	uint8_t				bits[WISUN_2FSK_PIPE_BITS];
+};
+
+struct wisun_2fsk_pipe_candidate {
+	int				eof;
+	int				bad;	/* bad PHR or truncated */
+	int				done;
+	enum wisun_2fsk_sfd_type	type;
+	size_t				preamble_sz;
+	uint64_t			offset;
+	size_t				expected_bits;	/* 0: PHR not received */
+	size_t				raw_bits;	/* after the sfd */
+	uint8_t				raw[WISUN_2FSK_MAX_CODED_PAYLOAD];
+};
+
+struct wisun_2fsk_pipe_frame {
+	int				eof;
+	struct wisun_2fsk_frame		frame;
+};
+
+enum {
+	WISUN_2FSK_PIPE_RING_BITS,
+	WISUN_2FSK_PIPE_RING_CANDIDATES,
+	WISUN_2FSK_PIPE_RING_FRAMES,
+	WISUN_2FSK_PIPE_RINGS,
+};
+
+static const char *const wisun_2fsk_pipe_ring_names[] = {
+	[WISUN_2FSK_PIPE_RING_BITS]		= "bits",
+	[WISUN_2FSK_PIPE_RING_CANDIDATES]	= "candidates",
+	[WISUN_2FSK_PIPE_RING_FRAMES]		= "frames",
+};
+
+/* the stage threads, the stage i consumes the ring i */
+#define WISUN_2FSK_PIPE_THREADS		WISUN_2FSK_PIPE_RINGS
+
+struct wisun_2fsk_pipeline {
+	struct wisun_fsk_spsc		rings[WISUN_2FSK_PIPE_RINGS];
+	struct wisun_2fsk_stream_decoder *shr;		/* the search state */
+	struct wisun_2fsk_stream_decoder *decoder;
+	int				use_rsc;
+	int				interleaving;
+	int				live;	/* drop the frames */
+	int				cpus[WISUN_2FSK_PIPE_THREADS + 1];
+	uint64_t			frames;
+	uint64_t			errors;
+};
+
+/* wait for a free slot, for the lossless rings and the end of stream */
+static void *wisun_2fsk_pipe_wait_slot(struct wisun_fsk_spsc *q, size_t ahead)
+{
+	unsigned int n = 0;
+	void *slot;
+
+	while (!(slot = wisun_fsk_spsc_producer_slot(q, ahead)))
+		wisun_fsk_spsc_wait_producer(q, ahead, &n);
+
+	return slot;
+}
+
+static void *wisun_2fsk_pipe_wait_input(struct wisun_fsk_spsc *q)
+{
+	unsigned int n = 0;
+	void *slot;
+
+	while (!(slot = wisun_fsk_spsc_consumer_slot(q)))
+		wisun_fsk_spsc_wait_consumer(q, &n);
+
+	return slot;
+}
+
+static void wisun_2fsk_pipe_push_eof(struct wisun_2fsk_pipeline *p, int ring)
+{
+	void *slot = wisun_2fsk_pipe_wait_slot(&p->rings[ring], 0);
+
+	switch (ring) {
+	case WISUN_2FSK_PIPE_RING_BITS:
+		((struct wisun_2fsk_pipe_bits *)slot)->n = 0;
+		break;
+	case WISUN_2FSK_PIPE_RING_CANDIDATES:
+		((struct wisun_2fsk_pipe_candidate *)slot)->eof = 1;
+		break;
+	default:
+		((struct wisun_2fsk_pipe_frame *)slot)->eof = 1;
+		break;
+	}
+
+	wisun_fsk_spsc_publish(&p->rings[ring]);
+}
+
+/* the raw bits after the sfd by the PHR, 0 if the PHR can't be decoded */
+static size_t wisun_2fsk_pipe_frame_bits(const struct wisun_2fsk_pipeline *p,
+					 const struct wisun_2fsk_pipe_candidate *c,
+					 int coded)
+{
+	size_t phy_payload_sz;
+	uint16_t phr;
+
+	if (!coded) {
+		phr = wisun_2fsk_fix_phr_order(buffer_peek_u16_b1b0(c->raw));
+		return (sizeof(phr) + (phr >> 5)) * 8;
+	}
+
+	if (option_auto) {
+		struct wisun_2fsk_fec_hypothesis
+			hyps[WISUN_2FSK_FEC_HYPOTHESES];
+
+		if (!wisun_2fsk_rank_fec_hypotheses(c->raw, SIZE_MAX, hyps))
+			return 0;
+		phr = hyps[0].phr;
+	} else {
+		struct fec_block_decoder d;
+		uint8_t phr_le[2];
+
+		fec_block_decoder_init(&d, p->use_rsc, p->interleaving);
+		if (fec_block_decode(&d, c->raw, 1, phr_le) < 0)
+			return 0;
+		phr = wisun_2fsk_fix_phr_order(buffer_peek_u16_b1b0(phr_le));
+	}
+
+	/* with the padding, doubled by the convolutional code */
+	phy_payload_sz = sizeof(phr) + (phr >> 5);
+	return (phy_payload_sz + (number_is_even(phy_payload_sz) ? 2 : 1))
+		* 2 * 8;
+}
+
+/* append a bit to the candidate, return 1 if it's completed */
+static int wisun_2fsk_pipe_collect_bit(const struct wisun_2fsk_pipeline *p,
+				       struct wisun_2fsk_pipe_candidate *c,
+				       int b)
+{
+	int coded = c->type == WISUN_2FSK_SFD_CODED0
+			|| c->type == WISUN_2FSK_SFD_CODED1;
+	size_t n = c->raw_bits;
+
+	if (n % 8 == 0)
+		c->raw[n / 8] = 0;
+	c->raw[n / 8] |= (b << (n % 8));
+	c->raw_bits = ++n;
+
+	if (c->expected_bits == 0 && n == (coded ? 32 : 16)) {
+		c->expected_bits = wisun_2fsk_pipe_frame_bits(p, c, coded);
+		if (c->expected_bits == 0
+		    || c->expected_bits > sizeof(c->raw) * 8) {
+			c->bad = 1;
+			return 1;
+		}
+	}
+
+	return n == c->expected_bits;
+}
+
+static void *wisun_2fsk_pipe_shr_thread(void *arg)
+{
+	struct wisun_2fsk_pipeline *p = arg;
+	struct wisun_fsk_spsc *in = &p->rings[WISUN_2FSK_PIPE_RING_BITS];
+	struct wisun_fsk_spsc *out = &p->rings[WISUN_2FSK_PIPE_RING_CANDIDATES];
+	struct wisun_2fsk_pipe_candidate *inflight[WISUN_2FSK_PIPE_CANDIDATES];
+	struct wisun_2fsk_stream_decoder *dec = p->shr;
+	size_t ninflight = 0;
+
+	p->cpus[1] = wisun_fsk_pin_cpu(1);
+
+	while (1) {
+		struct wisun_2fsk_pipe_bits *b = wisun_2fsk_pipe_wait_input(in);
+
+		if (b->n == 0) {
+			wisun_fsk_spsc_release(in);
+			break;
+		}
+
+		for (size_t i = 0; i < b->n; i++) {
+			int bit = b->bits[i];
+
+			for (size_t k = 0; k < ninflight; k++) {
+				if (!inflight[k]->done)
+					inflight[k]->done =
+						wisun_2fsk_pipe_collect_bit(p,
+							inflight[k], bit);
+			}
+
+			dec->position++;
+			wisun_2fsk_stream_search_bit(dec, bit);
+			if (dec->state == WISUN_2FSK_STREAM_FRAME) {
+				struct wisun_2fsk_pipe_candidate *c = NULL;
+
+				/* keep searching in the frame bits */
+				dec->state = WISUN_2FSK_STREAM_SEARCH;
+				if (ninflight < WISUN_2FSK_PIPE_CANDIDATES)
+					c = wisun_2fsk_pipe_wait_slot(out,
+								ninflight);
+				if (c) {
+					c->eof = c->bad = c->done = 0;
+					c->type = dec->frame.type;
+					c->preamble_sz = dec->frame.preamble_sz;
+					c->offset = dec->frame.offset;
+					c->expected_bits = 0;
+					c->raw_bits = 0;
+					inflight[ninflight++] = c;
+				} else {
+					out->drops++;
+				}
+			}
+
+			/* the candidates are published in order */
+			while (ninflight > 0 && inflight[0]->done) {
+				wisun_fsk_spsc_publish(out);
+				memmove(inflight, inflight + 1,
+					--ninflight * sizeof(inflight[0]));
+			}
+		}
+
+		wisun_fsk_spsc_release(in);
+	}
+
+	/* the truncated frames at the end of stream */
+	for (size_t k = 0; k < ninflight; k++) {
+		if (!inflight[k]->done)
+			inflight[k]->bad = 1;
+		wisun_fsk_spsc_publish(out);
+	}
+
+	wisun_2fsk_pipe_push_eof(p, WISUN_2FSK_PIPE_RING_CANDIDATES);
+	return NULL;
+}
+
+static void wisun_2fsk_pipe_decode(struct wisun_2fsk_pipeline *p,
+				   const struct wisun_2fsk_pipe_candidate *c,
+				   uint64_t *skip_until)
+{
+	struct wisun_fsk_spsc *out = &p->rings[WISUN_2FSK_PIPE_RING_FRAMES];
+	struct wisun_2fsk_stream_decoder *dec = p->decoder;
+	struct wisun_2fsk_frame *f = &dec->frame;
+	uint64_t sfd = c->offset + c->preamble_sz;
+	size_t preamble_sz = c->preamble_sz, sz;
+	struct wisun_2fsk_pipe_frame *slot;
+	int ret = 0;
+
+	/* the serial decoder searches again from the end of a good frame,
+	 * only the preamble groups after it are seen.
+	 */
+	if (c->offset < *skip_until) {
+		if (sfd < *skip_until + strlen(WISUN_2FSK_PREAMBLE))
+			return;
+		if (preamble_sz > (sfd - *skip_until) / 8 * 8)
+			preamble_sz = (sfd - *skip_until) / 8 * 8;
+	}
+
+	if (c->bad) {
+		p->errors++;
+		return;
+	}
+
+	dec->position = sfd + 16;
+	wisun_2fsk_stream_start_frame(dec, c->type, preamble_sz);
+	for (size_t i = 0; i < c->raw_bits && ret == 0; i++)
+		ret = wisun_2fsk_stream_frame_bit(dec,
+						  (c->raw[i / 8] >> (i % 8)) & 1);
+
+	if (!wisun_2fsk_stream_frame_check(dec, ret)) {
+		p->errors++;
+		return;
+	}
+
+	p->frames++;
+	*skip_until = f->offset + f->input_bits;
+
+	if (p->live)
+		slot = wisun_fsk_spsc_producer_slot(out, 0);
+	else
+		slot = wisun_2fsk_pipe_wait_slot(out, 0);
+
+	if (!slot) {
+		out->drops++;
+		return;
+	}
+
+	/* the frame header and the used bytes */
+	sz = offsetof(struct wisun_2fsk_frame, buf)
+		+ preamble_sz / 8 + 2 + f->phy_payload_sz;
+	if (sz > sizeof(*f))
+		sz = sizeof(*f);
+	memcpy(&slot->frame, f, sz);
+	slot->eof = 0;
+	wisun_fsk_spsc_publish(out);
+}
+
+static void *wisun_2fsk_pipe_decode_thread(void *arg)
+{
+	struct wisun_2fsk_pipeline *p = arg;
+	struct wisun_fsk_spsc *in = &p->rings[WISUN_2FSK_PIPE_RING_CANDIDATES];
+	uint64_t skip_until = 0;
+
+	p->cpus[2] = wisun_fsk_pin_cpu(2);
+
+	while (1) {
+		struct wisun_2fsk_pipe_candidate *c =
+			wisun_2fsk_pipe_wait_input(in);
+		int eof = c->eof;
+
+		if (!eof)
+			wisun_2fsk_pipe_decode(p, c, &skip_until);
+		wisun_fsk_spsc_release(in);
+		if (eof)
+			break;
+	}
+
+	wisun_2fsk_pipe_push_eof(p, WISUN_2FSK_PIPE_RING_FRAMES);
+	return NULL;
+}
+
+static void wisun_2fsk_pipe_flush_output(void)
+{
+	fflush(stdout);
+	if (option_pcap.w)
+		wisun_fsk_pcap_writer_flush(option_pcap.w);
+}
+
+static void *wisun_2fsk_pipe_output_thread(void *arg)
+{
+	struct wisun_2fsk_pipeline *p = arg;
+	struct wisun_fsk_spsc *in = &p->rings[WISUN_2FSK_PIPE_RING_FRAMES];
+	unsigned int waited = 0;
+	int pending = 0;
+
+	p->cpus[3] = wisun_fsk_pin_cpu(3);
+
+	while (1) {
+		struct wisun_2fsk_pipe_frame *f =
+			wisun_fsk_spsc_consumer_slot(in);
+
+		if (!f) {
+			/* one write for the frames received together */
+			if (pending)
+				wisun_2fsk_pipe_flush_output();
+			pending = 0;
+			wisun_fsk_spsc_wait_consumer(in, &waited);
+			continue;
+		}
+
+		waited = 0;
+		if (f->eof) {
+			wisun_fsk_spsc_release(in);
+			break;
+		}
+
+		wisun_2fsk_frame_print(&f->frame);
+		wisun_fsk_spsc_release(in);
+		pending = 1;
+	}
+
+	wisun_2fsk_pipe_flush_output();
+	return NULL;
+}
+
+/* the input stage runs on the calling thread */
+static int wisun_2fsk_pipe_input(struct wisun_2fsk_pipeline *p, int fd,
+				 const char *filename)
+{
+	struct wisun_fsk_spsc *out = &p->rings[WISUN_2FSK_PIPE_RING_BITS];
+	int ret = 0;
+
+	p->cpus[0] = wisun_fsk_pin_cpu(0);
+
+	while (1) {
+		struct wisun_2fsk_pipe_bits *b =
+			wisun_2fsk_pipe_wait_slot(out, 0);
+		/* read(2) returns as soon as some bits are in the pipe */
+		ssize_t n = read(fd, b->bits, sizeof(b->bits));
+		size_t count = 0;
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "read %s failed\n", filename);
+			ret = -1;
+			break;
+		} else if (n == 0) {
+			break;
+		}
+
+		/* the chars except '0' and '1' are ignored */
+		for (ssize_t i = 0; i < n; i++) {
+			if (b->bits[i] == '0' || b->bits[i] == '1')
+				b->bits[count++] = b->bits[i] - '0';
+		}
+
+		if (count > 0) {
+			b->n = count;
+			wisun_fsk_spsc_publish(out);
+		}
+	}
+
+	wisun_2fsk_pipe_push_eof(p, WISUN_2FSK_PIPE_RING_BITS);
+	return ret;
+}
+
+static void wisun_2fsk_pipe_print_stats(const struct wisun_2fsk_pipeline *p)
+{
+	fprintf(stderr, "%" PRIu64 " frames decoded, %" PRIu64
+		" bad frames\n", p->frames, p->errors);
+	fprintf(stderr, "pipeline: input, shr, decode and output on cpu "
+		"%d, %d, %d, %d\n", p->cpus[0], p->cpus[1], p->cpus[2],
+		p->cpus[3]);
+
+	for (int i = 0; i < WISUN_2FSK_PIPE_RINGS; i++) {
+		const struct wisun_fsk_spsc *q = &p->rings[i];
+
+		fprintf(stderr, "pipeline %s: %zu slots, occupancy mean %.2f "
+			"max %zu, %" PRIu64 " pushed, %" PRIu64 " dropped\n",
+			wisun_2fsk_pipe_ring_names[i], q->size,
+			q->pushes ? (double)q->occupancy_sum / q->pushes : 0.0,
+			q->occupancy_max, q->pushes, q->drops);
+	}
+}
+
+static int wisun_2fsk_stream_decode_pipelined(const char *filename,
+					      int use_rsc, int interleaving,
+					      int skip_verify)
+{
+	static void *(*const stages[WISUN_2FSK_PIPE_THREADS])(void *) = {
+		wisun_2fsk_pipe_shr_thread,
+		wisun_2fsk_pipe_decode_thread,
+		wisun_2fsk_pipe_output_thread,
+	};
+	const size_t slot_sz[WISUN_2FSK_PIPE_RINGS] = {
+		sizeof(struct wisun_2fsk_pipe_bits),
+		sizeof(struct wisun_2fsk_pipe_candidate),
+		sizeof(struct wisun_2fsk_pipe_frame),
+	};
+	pthread_t threads[WISUN_2FSK_PIPE_THREADS];
+	struct wisun_2fsk_pipeline *p;
+	struct stat st;
+	int fd, started = WISUN_2FSK_PIPE_THREADS, ret = -1;
+
+	if (!strcmp(filename, "-"))
+		fd = STDIN_FILENO;
+	else
+		fd = open(filename, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "open %s failed\n", filename);
+		return -1;
+	}
+
+	/* the ring indexes are on their own cache lines, the size of the
+	 * aligned struct is a multiple of the alignment.
+	 */
+	p = aligned_alloc(WISUN_FSK_SPSC_CACHELINE, sizeof(*p));
+	if (!p)
+		goto done;
+
+	memset(p, 0, sizeof(*p));
+	p->live = fstat(fd, &st) < 0 || !S_ISREG(st.st_mode);
+	p->use_rsc = use_rsc;
+	p->interleaving = interleaving;
+	p->shr = malloc(sizeof(*p->shr));
+	p->decoder = malloc(sizeof(*p->decoder));
+	if (!p->shr || !p->decoder)
+		goto free_pipeline;
+
+	for (int i = 0; i < WISUN_2FSK_PIPE_RINGS; i++) {
+		size_t slots = i == WISUN_2FSK_PIPE_RING_CANDIDATES
+				? WISUN_2FSK_PIPE_CANDIDATES
+				: WISUN_2FSK_PIPE_SLOTS;
+
+		if (wisun_fsk_spsc_init(&p->rings[i], slots, slot_sz[i]) < 0)
+			goto free_pipeline;
+	}
+
+	wisun_2fsk_stream_decoder_init(p->shr, use_rsc, interleaving,
+				       skip_verify, NULL, p);
+	wisun_2fsk_stream_decoder_init(p->decoder, use_rsc, interleaving,
+				       skip_verify, NULL, p);
+
+	/* the lazy inited tables are shared by the stages */
+	wisun_fsk_common_init();
+
+	/* the consumers are started first, if a stage can't be started the
+	 * end of stream is sent to the ring of the next one.
+	 */
+	for (int i = WISUN_2FSK_PIPE_THREADS - 1; i >= 0; i--) {
+		if (pthread_create(&threads[i], NULL, stages[i], p)) {
+			fprintf(stderr, "create pipeline thread failed\n");
+			if (i + 1 < WISUN_2FSK_PIPE_RINGS)
+				wisun_2fsk_pipe_push_eof(p, i + 1);
+			started = WISUN_2FSK_PIPE_THREADS - 1 - i;
+			break;
+		}
+	}
+
+	if (started == WISUN_2FSK_PIPE_THREADS)
+		ret = wisun_2fsk_pipe_input(p, fd, filename);
+
+	for (int i = WISUN_2FSK_PIPE_THREADS - started;
+	     i < WISUN_2FSK_PIPE_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	if (ret == 0 && option_verbose > 0)
+		wisun_2fsk_pipe_print_stats(p);
+
+free_pipeline:
+	for (int i = 0; i < WISUN_2FSK_PIPE_RINGS; i++)
+		wisun_fsk_spsc_exit(&p->rings[i]);
+	free(p->decoder);
+	free(p->shr);
+	free(p);
+done:
+	if (fd != STDIN_FILENO)
+		close(fd);
+	return ret;
+}
+
+/* Batch decode(--batch) of many small 01 bits files, e.g. the per-burst
+ * captures of a recorder. The files are read by io_uring to a fixed set of
+ * registered buffers, each buffer has its own file and stream decoder. The
+ * reads of all buffers are in flight together and a completed chunk is
+ * decoded while the others are being read, so the files are decoded in the
+ * completion order and each frame is prefixed by its file name.
+ */
+#define WISUN_2FSK_BATCH_BUFS		32
+#define WISUN_2FSK_BATCH_BUF_SZ		(64 << 10)
+
+struct wisun_2fsk_batch_slot {
+	struct wisun_2fsk_stream_decoder	*dec;
+	const char				*name;
+	int					fd;
+	int					regular;
+	uint64_t				offset;
+};
+
+struct wisun_2fsk_batch {
+	char					**names;
+	size_t					count, next;
+	struct wisun_fsk_uring			ring;
+	struct wisun_2fsk_batch_slot		slots[WISUN_2FSK_BATCH_BUFS];
+	uint64_t				bytes, frames, errors;
+	size_t					open_errors;
+	int					use_rsc, interleaving;
+	int					skip_verify;
+};
+
+static void wisun_2fsk_batch_emit(struct wisun_2fsk_stream_decoder *dec,
+				  struct wisun_2fsk_frame *f)
+{
+	struct wisun_2fsk_batch_slot *slot = dec->private_data;
+
+	f->source = slot->name;
+	wisun_2fsk_frame_print(f);
+}
+
+static int wisun_2fsk_batch_add_name(struct wisun_2fsk_batch *b,
+				     const char *dir, const char *name)
+{
+	size_t len = strlen(name) + (dir ? strlen(dir) + 1 : 0) + 1;
+	char **names;
+	char *s;
+
+	if ((b->count & (b->count - 1)) == 0) {
+		names = realloc(b->names, (b->count ? b->count * 2 : 1)
+					  * sizeof(*names));
+		if (!names)
+			return -1;
+		b->names = names;
+	}
+
+	s = malloc(len);
+	if (!s)
+		return -1;
+
+	if (dir)
+		snprintf(s, len, "%s/%s", dir, name);
+	else
+		snprintf(s, len, "%s", name);
+
+	b->names[b->count++] = s;
+	return 0;
+}
+
+/* the regular files of the directory in alphabetical order */
+static int wisun_2fsk_batch_scan_dir(struct wisun_2fsk_batch *b,
+				     const char *dir)
+{
+	struct dirent **entries;
+	int n, ret = 0;
+
+	n = scandir(dir, &entries, NULL, alphasort);
+	if (n < 0) {
+		fprintf(stderr, "scan %s failed\n", dir);
+		return -1;
+	}
+
+	for (int i = 0; i < n; i++) {
+		struct dirent *e = entries[i];
+		int regular = e->d_type == DT_REG;
+
+		if (e->d_type == DT_UNKNOWN || e->d_type == DT_LNK) {
+			char path[4096];
+			struct stat st;
+
+			snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+			regular = stat(path, &st) == 0 && S_ISREG(st.st_mode);
+		}
+
+		if (ret == 0 && regular)
+			ret = wisun_2fsk_batch_add_name(b, dir, e->d_name);
+		free(e);
+	}
+
+	free(entries);
+	return ret;
+}
+
+/* one path each line, - for stdin */
+static int wisun_2fsk_batch_read_list(struct wisun_2fsk_batch *b,
+				      const char *filename)
+{
+	FILE *fp = stdin;
+	char *line = NULL;
+	size_t line_sz = 0;
+	ssize_t len;
+	int ret = 0;
+
+	if (strcmp(filename, "-")) {
+		fp = fopen(filename, "r");
+		if (!fp) {
+			fprintf(stderr, "open %s failed\n", filename);
+			return -1;
+		}
+	}
+
+	while (ret == 0 && (len = getline(&line, &line_sz, fp)) > 0) {
+		while (len > 0 && isspace((unsigned char)line[len - 1]))
+			line[--len] = '\0';
+		if (len > 0)
+			ret = wisun_2fsk_batch_add_name(b, NULL, line);
+	}
+
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+	return ret;
+}
+
+static int wisun_2fsk_batch_read(struct wisun_2fsk_batch *b, size_t idx)
+{
+	struct wisun_2fsk_batch_slot *slot = &b->slots[idx];
+
+	return wisun_fsk_uring_read(&b->ring, slot->fd, idx, slot->offset,
+				    b->ring.buf_sz, idx);
+}
+
+/* Open the next file in the slot, return 0 if no more files. The files
+ * can't be opened are skipped and counted in open_errors.
+ */
+static int wisun_2fsk_batch_open_next(struct wisun_2fsk_batch *b, size_t idx)
+{
+	struct wisun_2fsk_batch_slot *slot = &b->slots[idx];
+
+	while (b->next < b->count) {
+		const char *name = b->names[b->next++];
+		struct stat st;
+
+		slot->fd = open(name, O_RDONLY);
+		if (slot->fd < 0) {
+			fprintf(stderr, "open %s failed\n", name);
+			b->open_errors++;
+			continue;
+		}
+
+		slot->name = name;
+		slot->regular = fstat(slot->fd, &st) == 0
+				&& S_ISREG(st.st_mode);
+		slot->offset = 0;
+		wisun_2fsk_stream_decoder_init(slot->dec, b->use_rsc,
+					       b->interleaving, b->skip_verify,
+					       wisun_2fsk_batch_emit, slot);
+		if (wisun_2fsk_batch_read(b, idx) < 0) {
+			close(slot->fd);
+			slot->fd = -1;
+			return -1;
+		}
+		return 1;
+	}
+
+	slot->fd = -1;
+	return 0;
+}
+
+static void wisun_2fsk_batch_close(struct wisun_2fsk_batch *b, size_t idx)
+{
+	struct wisun_2fsk_batch_slot *slot = &b->slots[idx];
+
+	wisun_2fsk_stream_flush(slot->dec);
+	b->frames += slot->dec->frames;
+	b->errors += slot->dec->errors;
+	close(slot->fd);
+	slot->fd = -1;
+}
+
+static int wisun_2fsk_batch_decode(const char *path, int use_rsc,
+				   int interleaving, int skip_verify)
+{
+	struct wisun_fsk_uring_completion c;
+	struct wisun_2fsk_batch *b;
+	struct stat st;
+	int ret = 0, n;
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return -1;
+
+	b->use_rsc = use_rsc;
+	b->interleaving = interleaving;
+	b->skip_verify = skip_verify;
+
+	if (strcmp(path, "-") && stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+		ret = wisun_2fsk_batch_scan_dir(b, path);
+	else
+		ret = wisun_2fsk_batch_read_list(b, path);
+	if (ret < 0)
+		goto free_names;
+
+	if (wisun_fsk_uring_init(&b->ring, WISUN_2FSK_BATCH_BUFS,
+				 WISUN_2FSK_BATCH_BUF_SZ) < 0) {
+		ret = -1;
+		goto free_names;
+	}
+
+	for (size_t i = 0; i < WISUN_2FSK_BATCH_BUFS; i++) {
+		b->slots[i].fd = -1;
+		b->slots[i].dec = malloc(sizeof(*b->slots[i].dec));
+		if (!b->slots[i].dec) {
+			ret = -1;
+			goto free_slots;
+		}
+	}
+
+	for (size_t i = 0; i < WISUN_2FSK_BATCH_BUFS; i++) {
+		n = wisun_2fsk_batch_open_next(b, i);
+		if (n < 0)
+			ret = -1;
+		if (n <= 0)
+			break;
+	}
+
+	while ((n = wisun_fsk_uring_wait(&b->ring, &c)) > 0) {
+		size_t idx = c.user_data;
+		struct wisun_2fsk_batch_slot *slot = &b->slots[idx];
+
+		if (c.res < 0) {
+			fprintf(stderr, "read %s failed\n", slot->name);
+			ret = -1;
+		} else if (c.res > 0) {
+			wisun_2fsk_stream_feed(slot->dec, (const char *)
+					       wisun_fsk_uring_buf(&b->ring, idx),
+					       c.res);
+			slot->offset += c.res;
+			b->bytes += c.res;
+		}
+
+		/* a short read is the end of a regular file */
+		if (c.res > 0 && !(slot->regular
+				   && (size_t)c.res < b->ring.buf_sz)) {
+			if (wisun_2fsk_batch_read(b, idx) == 0)
+				continue;
+			ret = -1;
+		}
+
+		wisun_2fsk_batch_close(b, idx);
+		if (wisun_2fsk_batch_open_next(b, idx) < 0)
+			ret = -1;
+
+		/* one write for the frames of a file */
+		if (option_pcap.w)
+			wisun_fsk_pcap_writer_flush(option_pcap.w);
+	}
+
+	if (n < 0) {
+		fprintf(stderr, "wait batch reads failed\n");
+		ret = -1;
+	}
+
+	if (b->open_errors > 0) {
+		fprintf(stderr, "%zu files can't be opened\n", b->open_errors);
+		ret = -1;
+	}
+
+	if (option_verbose > 0)
+		fprintf(stderr, "batch: %zu files, %" PRIu64 " bytes by %s, "
+			"%" PRIu64 " frames decoded, %" PRIu64 " bad frames\n",
+			b->count, b->bytes,
+			b->ring.fd < 0 ? "pread" :
+			b->ring.fixed ? "io_uring(fixed buffers)" : "io_uring",
+			b->frames, b->errors);
+
+free_slots:
+	for (size_t i = 0; i < WISUN_2FSK_BATCH_BUFS; i++) {
+		if (b->slots[i].fd >= 0)
+			close(b->slots[i].fd);
+		free(b->slots[i].dec);
+	}
+	wisun_fsk_uring_exit(&b->ring);
+free_names:
+	for (size_t i = 0; i < b->count; i++)
+		free(b->names[i]);
+	free(b->names);
+	free(b);
+	return ret;
+}
+
+/* The file offsets of the recent bits, a frame is found at most a replay
+ * buffer and a frame after its first bit.
+ */
+#define WISUN_2FSK_INDEX_RECENT_BITS	(1 << 17)
+
+struct wisun_2fsk_index_builder {
+	struct wisun_fsk_index_writer	w;
+	uint64_t			*offsets;	/* RECENT_BITS ring */
+	int				err;
+};
+
+static void wisun_2fsk_index_frame(struct wisun_2fsk_stream_decoder *dec,
+				   struct wisun_2fsk_frame *f, int good)
+{
+	struct wisun_2fsk_index_builder *ib = dec->private_data;
+	struct wisun_fsk_index_entry e = {
+		.bit_offset = f->offset,
+		.file_offset = ib->offsets[f->offset
+					   % WISUN_2FSK_INDEX_RECENT_BITS],
+		.bits = f->input_bits,
+		.phr = f->phr,
+		.preamble_sz = f->preamble_sz,
+		.sfd_type = f->type,
+		.flags = good ? WISUN_FSK_INDEX_CRC_GOOD : 0,
+	};
+
+	if (wisun_fsk_index_add_entry(&ib->w, &e) < 0)
+		ib->err = -1;
+}
+
+static void wisun_2fsk_index_good_frame(struct wisun_2fsk_stream_decoder *dec,
+					struct wisun_2fsk_frame *f)
+{
+	wisun_2fsk_index_frame(dec, f, 1);
+}
+
+static void wisun_2fsk_index_bad_frame(struct wisun_2fsk_stream_decoder *dec,
+				       struct wisun_2fsk_frame *f)
+{
+	wisun_2fsk_index_frame(dec, f, 0);
+}
+
+/* search all frames in the capture @filename and save their offsets, the
+ * frames with bad FCS are also saved.
+ */
+static int wisun_2fsk_stream_build_index(const char *filename,
+					 const char *index_filename,
+					 int use_rsc, int interleaving)
+{
+	struct wisun_2fsk_index_builder ib = { 0 };
+	struct wisun_2fsk_stream_decoder *dec;
+	uint64_t file_offset = 0;
+	char chunk[4096];
+	int fd, ret = 0;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "open %s failed\n", filename);
+		return -1;
+	}
+
+	dec = malloc(sizeof(*dec));
+	ib.offsets = malloc(sizeof(*ib.offsets) * WISUN_2FSK_INDEX_RECENT_BITS);
+	if (!dec || !ib.offsets) {
+		ret = -1;
+		goto done;
+	}
+
+	wisun_fsk_index_writer_init(&ib.w);
+	/* the coded frames are indexed for any FEC options */
+	wisun_2fsk_stream_decoder_init(dec, use_rsc, interleaving, 0,
+				       wisun_2fsk_index_good_frame, &ib);
+	dec->reject = wisun_2fsk_index_bad_frame;
+	dec->auto_fec = 1;
+
+	while (ret == 0) {
+		ssize_t n = read(fd, chunk, sizeof(chunk));
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "read %s failed\n", filename);
+			ret = -1;
+			break;
+		} else if (n == 0) {
+			break;
+		}
+
+		for (ssize_t i = 0; i < n; i++) {
+			if (chunk[i] != '0' && chunk[i] != '1')
+				continue;
+
+			ib.offsets[dec->position % WISUN_2FSK_INDEX_RECENT_BITS]
+				= file_offset + i;
+			wisun_2fsk_stream_push_bit(dec, chunk[i] - '0');
+		}
+
+		file_offset += n;
+	}
+
+	wisun_2fsk_stream_flush(dec);
+
+	if (ret == 0)
+		ret = ib.err;
+	if (ret == 0)
+		ret = wisun_fsk_index_save(&ib.w, fd, index_filename);
+	if (ret == 0)
+		fprintf(stderr, "%zu frames indexed\n", ib.w.count);
+
+	wisun_fsk_index_writer_exit(&ib.w);
+done:
+	free(ib.offsets);
+	free(dec);
+	close(fd);
+	return ret;
+}
+
+/* feed @bits bits to @dec from @file_offset */
+static int wisun_2fsk_stream_feed_range(struct wisun_2fsk_stream_decoder *dec,
+					int fd, uint64_t file_offset,
+					uint64_t bits)
+{
+	char chunk[4096];
+
+	while (bits > 0) {
+		/* at least one char for each bit, more if split by others */
+		size_t len = bits + 64 < sizeof(chunk) ? bits + 64
+						       : sizeof(chunk);
+		ssize_t n = pread(fd, chunk, len, file_offset);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		} else if (n == 0) {
+			break;
+		}
+
+		for (ssize_t i = 0; i < n && bits > 0; i++) {
+			if (chunk[i] != '0' && chunk[i] != '1')
+				continue;
+
+			wisun_2fsk_stream_push_bit(dec, chunk[i] - '0');
+			bits--;
+		}
+
+		file_offset += n;
+	}
+
+	return 0;
+}
+
+/* decode the frames saved in the index only, the SHR search is skipped */
+static int wisun_2fsk_stream_decode_indexed(const char *filename,
+					    const char *index_filename,
+					    int use_rsc, int interleaving,
+					    int skip_verify)
+{
+	struct wisun_2fsk_stream_decoder *dec;
+	struct wisun_fsk_index idx;
+	int fd, ret = 0;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "open %s failed\n", filename);
+		return -1;
+	}
+
+	if (wisun_fsk_index_open(&idx, index_filename, fd) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	if (option_dump_index) {
+		printf("count %" PRIu64 " entry %u\n", idx.header->count,
+		       idx.header->entry_size);
+		for (uint64_t i = 0; i < idx.header->count; i++) {
+			const struct wisun_fsk_index_entry *e = &idx.entries[i];
+
+			printf("%" PRIu64 " %" PRIu64 " %u %04x %u %u %02x\n",
+			       e->bit_offset, e->file_offset, e->bits, e->phr,
+			       e->preamble_sz, e->sfd_type, e->flags);
+		}
+		goto done;
+	}
+
+	dec = malloc(sizeof(*dec));
+	if (!dec) {
+		ret = -1;
+		goto done;
+	}
+
+	wisun_2fsk_stream_decoder_init(dec, use_rsc, interleaving, skip_verify,
+				       wisun_2fsk_stream_print_frame, NULL);
+
+	for (uint64_t i = 0; i < idx.header->count && ret == 0; i++) {
+		const struct wisun_fsk_index_entry *e = &idx.entries[i];
+
+		/* the SHR search starts again from the preamble */
+		wisun_2fsk_stream_decoder_reset_search(dec);
+		ret = wisun_2fsk_stream_feed_range(dec, fd, e->file_offset,
+						   e->bits);
+		wisun_2fsk_stream_flush(dec);
+	}
+
+	free(dec);
+done:
+	wisun_fsk_index_close(&idx);
+	close(fd);
+	return ret;
+}
+
+/* Wideband capture channel plan for the polyphase channelizer */
+struct wisun_2fsk_channel_plan {
+	enum iq_sample_format	format;
+	double			sample_rate;
+	double			spacing;	/* channel spacing */
+	double			channel0;	/* ch0 offset to the center */
+	size_t			channels;	/* 0: all channels */
+	double			symbol_rate;
+	int			threads;	/* 0: online cpus */
+	double			squelch;	/* dB above the floor, 0: off */
+	unsigned int		resample_sps;	/* 0: not resampled */
+	int			gardner;	/* gardner timing, -1: the default */
+	int			cfo;		/* correct the frequency offset */
+	double			sps;		/* of the --demod samples */
+};
+
+#define WISUN_2FSK_CHANNEL_BLOCK	16384
+
+/* taps of each resampler branch */
+#define WISUN_2FSK_RESAMPLER_TAPS	16
+
+struct wisun_2fsk_channel {
+	int				index;
+	struct rational_resampler	rs;	/* if resample_sps */
+	float				*rs_re, *rs_im;
+	size_t				rs_sz;
+	struct fsk_demod		demod;
+	struct fsk_discriminator	disc;	/* if gardner or cfo */
+	struct symbol_sync		sync;
+	struct cfo_estimator		cfo;
+	uint64_t			cfo_sample;	/* of the block start */
+	uint64_t			cfo_bit;
+	double				rate;	/* samples per second */
+	float				*fm, *soft;
+	struct wisun_2fsk_stream_decoder *dec;
+	char				*bits;
+	size_t				bits_sz;
+};
+
+struct wisun_2fsk_channelizer;
+
+struct wisun_2fsk_channel_worker {
+	struct wisun_2fsk_channelizer	*ctx;
+	int				id;
+	pthread_t			thread;
+};
+
+struct wisun_2fsk_channelizer {
+	struct wisun_2fsk_channel	*channels;
+	size_t				nchannels;
+	struct wisun_2fsk_channel_worker *workers;
+	int				nworkers;
+	pthread_mutex_t			launch;	/* held until barriers init */
+	pthread_barrier_t		start, done;
+
+	/* double buffered channelizer outputs, the workers decode one
+	 * while the main thread is filling the other one.
+	 */
+	float				*out_re[2];
+	float				*out_im[2];
+	uint64_t			out_skip[2];	/* squelched bits */
+	size_t				out_stride;
+	size_t				out_n;
+	int				out_idx;
+	int				busy;
+	int				quit;
+
+	struct pfb_channelizer		*pfb;
+	struct nco			nco;
+	double				residual;
+	double				bits_per_sample;
+	int				gardner;
+	int				cfo;
+};
+
+static void wisun_2fsk_channel_emit(struct wisun_2fsk_stream_decoder *dec,
+				    struct wisun_2fsk_frame *f)
+{
+	struct wisun_2fsk_channel *ch = dec->private_data;
+
+	f->channel = ch->index;
+	wisun_2fsk_frame_print(f);
+
+	if (ch->cfo.len && option_verbose > 0)
+		fprintf(stderr, "ch%d: frame at %" PRIu64 ", cfo %+.0f Hz\n",
+			ch->index, f->offset, f->cfo);
+}
+
+/* latch the offset of the SHR, the block may have another preamble after
+ * it. The SFD bit is mapped back to the estimator samples of the block.
+ */
+static void wisun_2fsk_channel_start(struct wisun_2fsk_stream_decoder *dec,
+				     struct wisun_2fsk_frame *f)
+{
+	struct wisun_2fsk_channel *ch = dec->private_data;
+	double at = ch->cfo_sample
+		+ ((double)dec->position - ch->cfo_bit) * ch->demod.sps;
+
+	f->cfo = cfo_estimator_offset_at(&ch->cfo, at > 0 ? (uint64_t)at : 0)
+		* ch->rate / (2.0 * M_PI);
+}
+
+/* the hard bits of the symbol sync outputs */
+static void wisun_2fsk_soft_to_bits(const float *soft, size_t n, char *bits)
+{
+	for (size_t i = 0; i < n; i++)
+		bits[i] = '0' + (soft[i] > 0.0f);
+}
+
+static void wisun_2fsk_channel_process(struct wisun_2fsk_channelizer *ctx,
+				       size_t k)
+{
+	struct wisun_2fsk_channel *ch = &ctx->channels[k];
+	const float *re = ctx->out_re[ctx->out_idx] + k * ctx->out_stride;
+	const float *im = ctx->out_im[ctx->out_idx] + k * ctx->out_stride;
+	ssize_t n;
+
+	/* the bursts are not continuous, start the demod again */
+	if (ctx->out_skip[ctx->out_idx]) {
+		wisun_2fsk_stream_skip(ch->dec, ctx->out_skip[ctx->out_idx]);
+		fsk_demod_init(&ch->demod, ch->demod.sps);
+		fsk_discriminator_init(&ch->disc);
+		symbol_sync_init(&ch->sync, ch->sync.sps, SYMBOL_SYNC_LOOP_BW);
+		if (ctx->cfo)
+			cfo_estimator_reset(&ch->cfo);
+		if (ch->rs_sz)
+			rational_resampler_reset(&ch->rs);
+	}
+
+	n = ctx->out_n;
+	if (ch->rs_sz) {
+		n = rational_resampler_process(&ch->rs, re, im, n, ch->rs_re,
+					       ch->rs_im, ch->rs_sz);
+		/* rs_sz is the max output of a block */
+		if (n < 0) {
+			fprintf(stderr, "channel %d: resampler overflow\n",
+				ch->index);
+			return;
+		}
+		re = ch->rs_re;
+		im = ch->rs_im;
+	}
+
+	if (ctx->gardner || ctx->cfo) {
+		fsk_discriminate(&ch->disc, re, im, n, ch->fm);
+		if (ctx->cfo) {
+			ch->cfo_sample = ch->cfo.samples;
+			ch->cfo_bit = ch->dec->position;
+			cfo_estimator_process(&ch->cfo, ch->fm, n, ch->fm);
+		}
+	}
+
+	if (ctx->gardner) {
+		n = symbol_sync_process(&ch->sync, ch->fm, n, ch->soft,
+					ch->bits_sz);
+		wisun_2fsk_soft_to_bits(ch->soft, n, ch->bits);
+	} else if (ctx->cfo) {
+		n = fsk_demod_slice(&ch->demod, ch->fm, n, ch->bits,
+				    ch->bits_sz);
+	} else {
+		n = fsk_demod_process(&ch->demod, re, im, n, ch->bits,
+				      ch->bits_sz);
+	}
+	wisun_2fsk_stream_feed(ch->dec, ch->bits, n);
+}
+
+static void *wisun_2fsk_channel_worker_thread(void *arg)
+{
+	struct wisun_2fsk_channel_worker *w = arg;
+	struct wisun_2fsk_channelizer *ctx = w->ctx;
+
+	/* the barriers count the workers actually started */
+	pthread_mutex_lock(&ctx->launch);
+	pthread_mutex_unlock(&ctx->launch);
+	if (ctx->quit)
+		return NULL;
+
+	while (1) {
+		pthread_barrier_wait(&ctx->start);
+		if (ctx->quit)
+			break;
+
+		for (size_t k = w->id; k < ctx->nchannels; k += ctx->nworkers)
+			wisun_2fsk_channel_process(ctx, k);
+
+		pthread_barrier_wait(&ctx->done);
+	}
+
+	return NULL;
+}
+
+/* channelize a block and hand it to the workers, @skip_samples before the
+ * block are squelched.
+ */
+static void wisun_2fsk_channelizer_feed(struct wisun_2fsk_channelizer *ctx,
+					float *re, float *im, size_t n,
+					uint64_t skip_samples)
+{
+	int fill = ctx->busy ? !ctx->out_idx : ctx->out_idx;
+	size_t out_n;
+
+	if (ctx->residual != 0.0)
+		nco_mix(&ctx->nco, re, im, n);
+
+	out_n = pfb_channelizer_process(ctx->pfb, re, im, n,
+					ctx->out_re[fill], ctx->out_im[fill],
+					ctx->out_stride);
+	ctx->out_skip[fill] = llround(skip_samples * ctx->bits_per_sample);
+
+	if (ctx->busy)
+		pthread_barrier_wait(&ctx->done);
+
+	ctx->out_idx = fill;
+	ctx->out_n = out_n;
+	pthread_barrier_wait(&ctx->start);
+	ctx->busy = 1;
+}
+
+/* wait for the last block and stop the workers */
+static void wisun_2fsk_channelizer_stop(struct wisun_2fsk_channelizer *ctx)
+{
+	if (ctx->busy)
+		pthread_barrier_wait(&ctx->done);
+	ctx->quit = 1;
+	pthread_barrier_wait(&ctx->start);
+
+	for (int i = 0; i < ctx->nworkers; i++)
+		pthread_join(ctx->workers[i].thread, NULL);
+
+	pthread_barrier_destroy(&ctx->start);
+	pthread_barrier_destroy(&ctx->done);
+	pthread_mutex_destroy(&ctx->launch);
+}
+
+struct wisun_2fsk_iq_block {
+	float		*re;
+	float		*im;
+	size_t		n;
+	int		active;
+};
+
+static int wisun_2fsk_channelizer_decode(const char *filename,
+					 const struct wisun_2fsk_channel_plan *plan,
+					 int use_rsc, int interleaving,
+					 int skip_verify)
+{
+	struct wisun_2fsk_channelizer ctx = { 0 };
+	size_t sample_sz = iq_sample_size(plan->format), m, nchannels;
+	struct wisun_2fsk_iq_block blocks[2] = { 0 };
+	size_t nblocks = 0, fed_blocks = 0;
+	uint64_t skip_samples = 0;
+	struct burst_detector bd = { 0 };
+	double out_rate, sps;
+	struct pfb_channelizer pfb;
+	size_t *bins = NULL;
+	void *raw = NULL;
+	long base_bin;
+	int ret = -1, eof = 0, nworkers, before_active = 0;
+	FILE *fp;
+
+	if (plan->sample_rate <= 0 || plan->spacing <= 0
+	    || plan->symbol_rate <= 0) {
+		fprintf(stderr, "Invalid channel plan\n");
+		return -1;
+	}
+
+	m = (size_t)(plan->sample_rate / plan->spacing + 0.5);
+	if (m < 2 || fabs(m * plan->spacing - plan->sample_rate)
+			> plan->sample_rate * 1e-9) {
+		fprintf(stderr, "sample rate should be multiple of the channel "
+			"spacing\n");
+		return -1;
+	}
+
+	nchannels = plan->channels ? plan->channels : m;
+	if (nchannels > m) {
+		fprintf(stderr, "too many channels, only %zu can be split\n", m);
+		return -1;
+	}
+
+	/* move channel 0 to the nearest fft bin */
+	base_bin = lround(plan->channel0 / plan->spacing);
+	ctx.residual = plan->channel0 - base_bin * plan->spacing;
+	nco_init(&ctx.nco, -ctx.residual, plan->sample_rate);
+
+	bins = calloc(nchannels, sizeof(*bins));
+	if (!bins)
+		return -1;
+
+	for (size_t k = 0; k < nchannels; k++)
+		bins[k] = (size_t)(((base_bin + (long)k) % (long)m + m) % m);
+
+	if (pfb_channelizer_init(&pfb, m, 8, true, bins, nchannels) < 0) {
+		free(bins);
+		return -1;
+	}
+
+	out_rate = plan->sample_rate / pfb.decimation;
+	sps = plan->resample_sps ? plan->resample_sps
+				 : out_rate / plan->symbol_rate;
+	if (sps < 2.0) {
+		fprintf(stderr, "channel sample rate %.0f is too low for "
+			"symbol rate %.0f\n", out_rate, plan->symbol_rate);
+		goto free_pfb;
+	}
+
+	if (option_verbose > 0)
+		fprintf(stderr, "channelizer: %zu bins, decimation %zu, "
+			"%.2f samples per symbol\n", m, pfb.decimation, sps);
+
+	ctx.pfb = &pfb;
+	ctx.gardner = plan->gardner > 0;
+	ctx.cfo = plan->cfo;
+	ctx.bits_per_sample = plan->symbol_rate / plan->sample_rate;
+
+	/* the power is averaged over about 4 symbols */
+	if (plan->squelch > 0
+	    && burst_detector_init(&bd, plan->squelch,
+				   4 * plan->sample_rate / plan->symbol_rate
+					/ BURST_DETECT_SEGMENT) < 0)
+		goto free_pfb;
+
+	if (!strcmp(filename, "-"))
+		fp = stdin;
+	else
+		fp = fopen(filename, "rb");
+
+	if (!fp) {
+		fprintf(stderr, "open %s failed\n", filename);
+		goto free_pfb;
+	}
+
+	ctx.nchannels = nchannels;
+	ctx.out_stride = WISUN_2FSK_CHANNEL_BLOCK / pfb.decimation + 1;
+	ctx.channels = calloc(nchannels, sizeof(*ctx.channels));
+	raw = malloc(WISUN_2FSK_CHANNEL_BLOCK * sample_sz);
+	for (int i = 0; i < 2; i++) {
+		blocks[i].re = malloc(WISUN_2FSK_CHANNEL_BLOCK * sizeof(float));
+		blocks[i].im = malloc(WISUN_2FSK_CHANNEL_BLOCK * sizeof(float));
+		ctx.out_re[i] = malloc(nchannels * ctx.out_stride * sizeof(float));
+		ctx.out_im[i] = malloc(nchannels * ctx.out_stride * sizeof(float));
+		if (!blocks[i].re || !blocks[i].im
+		    || !ctx.out_re[i] || !ctx.out_im[i])
+			goto free_buffers;
+	}
+
+	if (!ctx.channels || !raw)
+		goto free_buffers;
+
+	for (size_t k = 0; k < nchannels; k++) {
+		struct wisun_2fsk_channel *ch = &ctx.channels[k];
+
+		ch->index = (int)k;
+		ch->bits_sz = ctx.out_stride;
+		if (plan->resample_sps) {
+			/* to resample_sps * symbol_rate */
+			if (rational_resampler_init(&ch->rs,
+					lround(plan->resample_sps
+					       * plan->symbol_rate),
+					lround(out_rate),
+					WISUN_2FSK_RESAMPLER_TAPS) < 0) {
+				fprintf(stderr, "can't resample %.0f to %.0f\n",
+					out_rate,
+					plan->resample_sps * plan->symbol_rate);
+				goto free_buffers;
+			}
+
+			if (k == 0 && option_verbose > 0)
+				fprintf(stderr, "resampler: %u/%u, %u taps\n",
+					ch->rs.up, ch->rs.down,
+					ch->rs.up * ch->rs.taps);
+
+			ch->rs_sz = rational_resampler_max_output(&ch->rs,
+							ctx.out_stride);
+			ch->rs_re = malloc(ch->rs_sz * sizeof(float));
+			ch->rs_im = malloc(ch->rs_sz * sizeof(float));
+			if (!ch->rs_re || !ch->rs_im)
+				goto free_buffers;
+			ch->bits_sz = ch->rs_sz;
+		}
+
+		ch->bits = malloc(ch->bits_sz);
+		ch->dec = malloc(sizeof(*ch->dec));
+		if (!ch->bits || !ch->dec)
+			goto free_buffers;
+
+		if (plan->gardner > 0 || plan->cfo) {
+			ch->fm = malloc(ch->bits_sz * sizeof(float));
+			if (!ch->fm)
+				goto free_buffers;
+			fsk_discriminator_init(&ch->disc);
+		}
+
+		if (plan->gardner > 0) {
+			ch->soft = malloc(ch->bits_sz * sizeof(float));
+			if (!ch->soft)
+				goto free_buffers;
+			symbol_sync_init(&ch->sync, sps, SYMBOL_SYNC_LOOP_BW);
+		}
+
+		ch->rate = sps * plan->symbol_rate;
+		if (plan->cfo && cfo_estimator_init(&ch->cfo, sps) < 0)
+			goto free_buffers;
+
+		fsk_demod_init(&ch->demod, sps);
+		wisun_2fsk_stream_decoder_init(ch->dec, use_rsc, interleaving,
+					       skip_verify,
+					       wisun_2fsk_channel_emit, ch);
+		/* the false SFDs in noise are common on the idle channels */
+		ch->dec->quiet = option_verbose == 0;
+		if (plan->cfo)
+			ch->dec->start = wisun_2fsk_channel_start;
+	}
+
+	nworkers = plan->threads > 0 ? plan->threads
+				     : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworkers < 1)
+		nworkers = 1;
+	if ((size_t)nworkers > nchannels)
+		nworkers = (int)nchannels;
+
+	ctx.workers = calloc(nworkers, sizeof(*ctx.workers));
+	if (!ctx.workers)
+		goto free_buffers;
+
+	/* the lazy inited tables are shared by all decode threads */
+	wisun_fsk_common_init();
+
+	pthread_mutex_init(&ctx.launch, NULL);
+	pthread_mutex_lock(&ctx.launch);
+
+	for (int i = 0; i < nworkers; i++) {
+		struct wisun_2fsk_channel_worker *w = &ctx.workers[i];
+
+		w->ctx = &ctx;
+		w->id = i;
+		if (pthread_create(&w->thread, NULL,
+				   wisun_2fsk_channel_worker_thread, w))
+			break;
+		ctx.nworkers++;
+	}
+
+	/* the workers quit at launch if the barriers are not ready */
+	if (pthread_barrier_init(&ctx.start, NULL, ctx.nworkers + 1)) {
+		ctx.quit = 1;
+	} else if (pthread_barrier_init(&ctx.done, NULL, ctx.nworkers + 1)) {
+		pthread_barrier_destroy(&ctx.start);
+		ctx.quit = 1;
+	}
+	pthread_mutex_unlock(&ctx.launch);
+
+	if (ctx.quit) {
+		fprintf(stderr, "init the decode barriers failed\n");
+		for (int i = 0; i < ctx.nworkers; i++)
+			pthread_join(ctx.workers[i].thread, NULL);
+		pthread_mutex_destroy(&ctx.launch);
+		goto free_buffers;
+	}
+
+	if (ctx.nworkers != nworkers) {
+		fprintf(stderr, "create decode threads failed\n");
+		wisun_2fsk_channelizer_stop(&ctx);
+		goto free_buffers;
+	}
+
+	while (!eof) {
+		struct wisun_2fsk_iq_block *b = &blocks[nblocks % 2];
+		struct wisun_2fsk_iq_block *prev = &blocks[(nblocks + 1) % 2];
+		size_t n = fread(raw, sample_sz, WISUN_2FSK_CHANNEL_BLOCK, fp);
+
+		eof = n < WISUN_2FSK_CHANNEL_BLOCK;
+		nblocks++;
+
+		iq_samples_to_float(plan->format, raw, n, b->re, b->im);
+		b->active = plan->squelch <= 0
+			|| burst_detector_process(&bd, b->re, b->im, n) > 0;
+		if (eof) {
+			/* flush the last symbols out of the filter */
+			size_t pad = WISUN_2FSK_CHANNEL_BLOCK - n;
+
+			if (pad > pfb.len)
+				pad = pfb.len;
+
+			memset(b->re + n, 0, pad * sizeof(float));
+			memset(b->im + n, 0, pad * sizeof(float));
+			n += pad;
+		}
+		b->n = n;
+
+		if (plan->squelch <= 0) {
+			wisun_2fsk_channelizer_feed(&ctx, b->re, b->im, b->n, 0);
+			fed_blocks++;
+			continue;
+		}
+
+		/* The blocks before and after a burst are the guard margins,
+		 * which cover the filter delay and the burst edges. So the
+		 * previous block is decided once this one is detected.
+		 */
+		if (nblocks > 1) {
+			if (before_active || prev->active || b->active) {
+				wisun_2fsk_channelizer_feed(&ctx, prev->re,
+							    prev->im, prev->n,
+							    skip_samples);
+				skip_samples = 0;
+				fed_blocks++;
+			} else {
+				skip_samples += prev->n;
+			}
+			before_active = prev->active;
+		}
+
+		if (eof && (before_active || b->active)) {
+			wisun_2fsk_channelizer_feed(&ctx, b->re, b->im, b->n,
+						    skip_samples);
+			fed_blocks++;
+		}
+	}
+
+	if (option_verbose > 0 && plan->squelch > 0)
+		fprintf(stderr, "squelch: %zu of %zu blocks demodulated\n",
+			fed_blocks, nblocks);
+
+	wisun_2fsk_channelizer_stop(&ctx);
+
+	for (size_t k = 0; k < nchannels; k++)
+		wisun_2fsk_stream_flush(ctx.channels[k].dec);
+
+	ret = 0;
+
+free_buffers:
+	if (ctx.channels) {
+		for (size_t k = 0; k < nchannels; k++) {
+			free(ctx.channels[k].bits);
+			free(ctx.channels[k].dec);
+			free(ctx.channels[k].rs_re);
+			free(ctx.channels[k].rs_im);
+			free(ctx.channels[k].fm);
+			free(ctx.channels[k].soft);
+			rational_resampler_exit(&ctx.channels[k].rs);
+			cfo_estimator_exit(&ctx.channels[k].cfo);
+		}
+	}
+	free(ctx.channels);
+	free(ctx.workers);
+	for (int i = 0; i < 2; i++) {
+		free(ctx.out_re[i]);
+		free(ctx.out_im[i]);
+	}
+	for (int i = 0; i < 2; i++) {
+		free(blocks[i].re);
+		free(blocks[i].im);
+	}
+	free(raw);
+	if (fp != stdin)
+		fclose(fp);
+free_pfb:
+	burst_detector_exit(&bd);
+	pfb_channelizer_exit(&pfb);
+	free(bins);
+	return ret;
+}
+
+#define WISUN_2FSK_DEMOD_BLOCK		16384
+
+/* Decode the demodulated(frequency) samples, e.g. exported by URH, float32
+ * little endian, @sps samples per symbol. The symbols are sampled by the
+ * gardner loop, or at the nominal period if not @gardner.
+ */
+static int wisun_2fsk_demod_decode(const char *filename, double sps,
+				   int gardner, const char *soft_output,
+				   int use_rsc, int interleaving,
+				   int skip_verify)
+{
+	struct wisun_2fsk_stream_decoder *dec = NULL;
+	struct symbol_sync sync;
+	FILE *fp = stdin, *fp_soft = NULL;
+	size_t soft_sz = WISUN_2FSK_DEMOD_BLOCK, samples = 0, symbols = 0;
+	float *x = NULL, *soft = NULL;
+	char *bits = NULL;
+	int ret = -1;
+
+	if (sps < 2 || sps > 64) {
+		fprintf(stderr, "Invalid samples per symbol: %g\n", sps);
+		return -1;
+	}
+
+	if (strcmp(filename, "-")) {
+		fp = fopen(filename, "rb");
+		if (!fp) {
+			fprintf(stderr, "open %s failed\n", filename);
+			return -1;
+		}
+	}
+
+	if (soft_output) {
+		fp_soft = strcmp(soft_output, "-") ? fopen(soft_output, "wb")
+						   : stdout;
+		if (!fp_soft) {
+			fprintf(stderr, "open %s failed\n", soft_output);
+			goto done;
+		}
+	}
+
+	x = malloc(WISUN_2FSK_DEMOD_BLOCK * sizeof(*x));
+	soft = malloc(soft_sz * sizeof(*soft));
+	bits = malloc(soft_sz);
+	dec = malloc(sizeof(*dec));
+	if (!x || !soft || !bits || !dec)
+		goto done;
+
+	symbol_sync_init(&sync, sps, gardner ? SYMBOL_SYNC_LOOP_BW : 0.0f);
+	wisun_2fsk_stream_decoder_init(dec, use_rsc, interleaving, skip_verify,
+				       wisun_2fsk_stream_print_frame, NULL);
+
+	while (1) {
+		size_t n = fread(x, sizeof(*x), WISUN_2FSK_DEMOD_BLOCK, fp);
+
+		if (n == 0)
+			break;
+
+		samples += n;
+		n = symbol_sync_process(&sync, x, n, soft, soft_sz);
+		symbols += n;
+
+		if (fp_soft && fwrite(soft, sizeof(*soft), n, fp_soft) != n) {
+			fprintf(stderr, "write %s failed\n", soft_output);
+			goto done;
+		}
+
+		wisun_2fsk_soft_to_bits(soft, n, bits);
+		wisun_2fsk_stream_feed(dec, bits, n);
+	}
+
+	if (ferror(fp)) {
+		fprintf(stderr, "read %s failed\n", filename);
+		goto done;
+	}
+
+	wisun_2fsk_stream_flush(dec);
+	if (option_verbose > 0)
+		fprintf(stderr, "timing: %zu samples, %zu symbols, "
+			"%.4f samples per symbol\n", samples, symbols,
+			symbols ? (double)samples / symbols : 0.0);
+	ret = 0;
+
+done:
+	if (fp_soft && fp_soft != stdout)
+		fclose(fp_soft);
+	if (fp != stdin)
+		fclose(fp);
+	free(dec);
+	free(bits);
+	free(soft);
+	free(x);
+	return ret;
+}
+
+#define WISUN_2FSK_IQ_BLOCK_SYMBOLS	256
+
+/* the modulator and the sample buffers of an IQ output, several frames can
+ * be written to it as one continuous stream.
+ */
+struct wisun_2fsk_iq_writer {
+	const struct wisun_2fsk_iq_output	*out;
+	struct gfsk_modulator			mod;
+	size_t					block, n;
+	float					*re, *im;
+	void					*raw;
+	FILE					*fp;
+};
+
+static void wisun_2fsk_iq_writer_free(struct wisun_2fsk_iq_writer *w)
+{
+	free(w->re);
+	free(w->im);
+	free(w->raw);
+	gfsk_modulator_exit(&w->mod);
+}
+
+static int wisun_2fsk_iq_writer_open(struct wisun_2fsk_iq_writer *w,
+				     const struct wisun_2fsk_iq_output *out)
+{
+	memset(w, 0, sizeof(*w));
+	w->out = out;
+	w->block = (WISUN_2FSK_IQ_BLOCK_SYMBOLS + 8) * out->sps;
+
+	if (gfsk_modulator_init(&w->mod, out->sps, out->mod_index, out->bt) < 0) {
+		fprintf(stderr, "Invalid GFSK modulator parameters\n");
+		return -1;
+	}
+
+	w->re = malloc(w->block * sizeof(float));
+	w->im = malloc(w->block * sizeof(float));
+	w->raw = malloc(w->block * iq_sample_size(out->format));
+	if (!w->re || !w->im || !w->raw) {
+		wisun_2fsk_iq_writer_free(w);
+		return -1;
+	}
+
+	if (!strcmp(out->filename, "-"))
+		w->fp = stdout;
+	else
+		w->fp = fopen(out->filename, "wb");
+
+	if (!w->fp) {
+		fprintf(stderr, "open %s failed\n", out->filename);
+		wisun_2fsk_iq_writer_free(w);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int wisun_2fsk_iq_writer_drain(struct wisun_2fsk_iq_writer *w)
+{
+	size_t sample_sz = iq_sample_size(w->out->format);
+
+	iq_samples_from_float(w->out->format, w->re, w->im, w->n, w->raw);
+	if (fwrite(w->raw, sample_sz, w->n, w->fp) != w->n) {
+		fprintf(stderr, "write IQ samples failed\n");
+		return -1;
+	}
+
+	w->n = 0;
+	return 0;
+}
+
+static int wisun_2fsk_iq_writer_write(struct wisun_2fsk_iq_writer *w,
+				      const uint8_t *buf, size_t binary_size)
+{
+	for (size_t i = 0; i < binary_size; i++) {
+		w->n += gfsk_modulate_bit(&w->mod, (buf[i / 8] >> (i % 8)) & 1,
+					  w->re + w->n, w->im + w->n);
+
+		if (w->n + w->out->sps > w->block
+		    && wisun_2fsk_iq_writer_drain(w) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* flush the tail of the gaussian filter and close */
+static int wisun_2fsk_iq_writer_close(struct wisun_2fsk_iq_writer *w)
+{
+	int ret;
+
+	w->n += gfsk_modulator_flush(&w->mod, w->re + w->n, w->im + w->n,
+				     w->block - w->n);
+	ret = wisun_2fsk_iq_writer_drain(w);
+
+	if (w->fp != stdout)
+		fclose(w->fp);
+	else
+		fflush(w->fp);
+
+	wisun_2fsk_iq_writer_free(w);
+	return ret;
+}
+
+static int wisun_2fsk_write_iq(const struct wisun_2fsk_iq_output *out,
+			       const uint8_t *buf, size_t binary_size)
+{
+	struct wisun_2fsk_iq_writer w;
+	int ret;
+
+	if (wisun_2fsk_iq_writer_open(&w, out) < 0)
+		return -1;
+
+	ret = wisun_2fsk_iq_writer_write(&w, buf, binary_size);
+	if (wisun_2fsk_iq_writer_close(&w) < 0)
+		ret = -1;
+
+	return ret;
+}
+
+static size_t wisun_2fsk_fec_padding(uint8_t *buf, size_t frame_length,
+				     enum wisun_2fsk_sfd_type type,
+				     uint8_t memory_state)
+{
+	static const uint8_t rsc_tail_bits[] = {
+		[0] = 0b000,
+		[1] = 0b001,
+		[2] = 0b011,
+		[3] = 0b010,
+		[4] = 0b111,
+		[5] = 0b110,
+		[6] = 0b100,
+		[7] = 0b101,
+	};
+	uint8_t pad[2] = { 0b11010000, 0b11010000 };
+	size_t len = 2 /* Lphr */ + frame_length;
+	size_t pad_sz = 1 + number_is_even(len);
+
+	memory_state &= 0b111;
+
+	if (type != WISUN_2FSK_SFD_CODED0 && type != WISUN_2FSK_SFD_CODED1) {
+		/* no padding */
+		return 0;
+	}
+
+	if (type == WISUN_2FSK_SFD_CODED0) /* RSC */
+		pad[0] |= rsc_tail_bits[memory_state];
+
+	memcpy(buf, pad, pad_sz);
+	return pad_sz;
+}
+
+/* append PHR, PSDU and FCS to @b stage by stage, the result of each stage is
+ * printed in verbose mode. @data has 2 bytes space for PHR before the
+ * @frame_length bytes input and 4 bytes space for FCS after it.
+ */
+static int wisun_2fsk_frame_encode_staged(struct bufwrite *b, uint8_t *data,
+					  size_t frame_length,
+					  enum wisun_2fsk_sfd_type type,
+					  uint16_t phr_options,
+					  int use_rsc, int interleaving)
+{
+	size_t group_sz = option_human ? 4 : 0;
+	uint8_t fec[2048] = { 0 };
+	struct wisun_2fsk_fec_encoder encoder = { 0 };
+	size_t data_idx = 2, whitening_sz = 0;
+	uint8_t *p_frame, *p_phr = data, *p_whitening;
+	uint8_t pad[2];
+	size_t pad_sz = 0;
+	uint16_t phr = 0;
+
+	encoder.buf = fec;
+	encoder.bufsz = sizeof(fec);
+
+	/* append crc */
+	if (phr_options & WISUN_2FSK_PHR_FCS_TYPE_CRC16) {
+		fprintf(stderr, "FCS16 is not supported now\n");
+		return -1;
+	} else {
+		uint32_t c32 = ieee_802154_fcs32(IEEE_802154_FCS32_INIT,
+						 &data[data_idx],
+						 frame_length);
+
+		data_idx += frame_length;
+		data[data_idx++] = (c32 >>  0) & 0xff;
+		data[data_idx++] = (c32 >>  8) & 0xff;
+		data[data_idx++] = (c32 >> 16) & 0xff;
+		data[data_idx++] = (c32 >> 24) & 0xff;
+		frame_length += 4;
+	}
+
+	/* fill phr */
+	phr = wisun_2fsk_make_phr(phr_options, frame_length);
+	p_phr[0] = (phr >> 0) & 0xff;
+	p_phr[1] = (phr >> 8) & 0xff;
+
+	if (option_verbose > 0) {
+		printf("PHR, DATA, CRC:\n");
+		print_binary_bits_lsbfirst(data, 0,
+					   (frame_length + sizeof(phr)) * 8 - 1,
+					   group_sz);
+		putchar('\n');
+	}
+
+	if (type != WISUN_2FSK_SFD_CODED0 && type != WISUN_2FSK_SFD_CODED1)
+		goto push_data;
+
+	/* encode it */
+	if (use_rsc) {
+		encoder.m = RSC_INIT_M;
+		foreach_bit_in_buffer_lsbfirst(data, data_idx * 8,
+					       wisun_2fsk_rsc_input_bit,
+					       &encoder);
+
+		if (option_verbose > 0) {
+			printf("Memory state(M0-M2): %d%d%d\n",
+				(encoder.m >> 2) & 1,
+				(encoder.m >> 1) & 1,
+				(encoder.m >> 0) & 1);
+		}
+
+		pad_sz = wisun_2fsk_fec_padding(pad, frame_length, type,
+						encoder.m);
+		foreach_bit_in_buffer_lsbfirst(pad, pad_sz * 8,
+					       wisun_2fsk_rsc_input_bit,
+					       &encoder);
+	} else {
+		encoder.m = NRNSC_INIT_M;
+		foreach_bit_in_buffer_lsbfirst(data, data_idx * 8,
+					       wisun_2fsk_nrnsc_input_bit,
+					       &encoder);
+
+		pad_sz = wisun_2fsk_fec_padding(pad, frame_length, type, 0);
+		foreach_bit_in_buffer_lsbfirst(pad, pad_sz * 8,
+					       wisun_2fsk_nrnsc_input_bit,
+					       &encoder);
+	}
+
+	if (option_verbose > 0 && pad_sz > 0) {
+		printf("Padding:\n");
+		print_binary_bits_lsbfirst(pad, 0, pad_sz * 8 - 1, group_sz);
+		putchar('\n');
+	}
+
+push_data:
+	switch (type) {
+	case WISUN_2FSK_SFD_CODED0:
+	case WISUN_2FSK_SFD_CODED1:
+		p_frame = bufwrite_push_data(b, encoder.buf,
+					     encoder.encode_bits / 8);
+
+		if (option_verbose > 0) {
+			printf("After Convolutional:\n");
+			print_binary_bits_lsbfirst(encoder.buf, 0,
+						   encoder.encode_bits - 1,
+						   group_sz);
+			putchar('\n');
 		}
 
 		if (interleaving) {
@@ -1194,247 +4487,2157 @@ push_data:
 					  encoder.encode_bits,
 					  p_frame);
 
-			if (option_verbose > 0) {
-				printf("After Interleaving:\n");
-				print_binary_bits_lsbfirst(p_frame, 0,
-					encoder.encode_bits - 1, group_sz);
-				putchar('\n');
+			if (option_verbose > 0) {
+				printf("After Interleaving:\n");
+				print_binary_bits_lsbfirst(p_frame, 0,
+					encoder.encode_bits - 1, group_sz);
+				putchar('\n');
+			}
+		}
+
+		p_whitening = p_frame + sizeof(phr) * 2;
+		whitening_sz = encoder.encode_bits / 8 - sizeof(phr) * 2;
+		break;
+	default:
+		p_frame = bufwrite_push_data(b, data, data_idx);
+
+		p_whitening = p_frame + sizeof(phr);
+		whitening_sz = data_idx - sizeof(phr);
+		break;
+	}
+
+	if (phr_options & WISUN_2FSK_PHR_DATA_WHITENING) {
+		WISUN_FSK_SDT2(whitening, whitening_sz, 1);
+		pn9_payload_decode(p_whitening, whitening_sz);
+
+		if (option_verbose > 0) {
+			printf("After Whitening:\n");
+			print_binary_bits_lsbfirst(p_frame, 0,
+						   encoder.encode_bits - 1,
+						   group_sz);
+			putchar('\n');
+		}
+	}
+
+	return 0;
+}
+
+/* append PHR, PSDU and FCS to @b in one pass, see fec_block_encode */
+static int wisun_2fsk_frame_encode_fused(struct bufwrite *b,
+					 const uint8_t *psdu, size_t data_sz,
+					 enum wisun_2fsk_sfd_type type,
+					 uint16_t phr_options,
+					 int use_rsc, int interleaving)
+{
+	int coded = type == WISUN_2FSK_SFD_CODED0
+			|| type == WISUN_2FSK_SFD_CODED1;
+	size_t frame_length = data_sz + 4, max_sz, pad_sz;
+	struct fec_block_encoder e;
+	uint8_t phr_le[2], fcs[4], pad[2];
+	uint16_t phr;
+	uint32_t c32;
+
+	if (phr_options & WISUN_2FSK_PHR_FCS_TYPE_CRC16) {
+		fprintf(stderr, "FCS16 is not supported now\n");
+		return -1;
+	}
+
+	max_sz = sizeof(phr) + frame_length;
+	if (coded)
+		max_sz = (max_sz + sizeof(pad)) * 2;
+	if (b->len + max_sz > b->size) {
+		b->err -= b->len + max_sz - b->size;
+		return -1;
+	}
+
+	fec_block_encoder_init(&e, coded, use_rsc, interleaving,
+			       b->buf + b->len);
+
+	phr = wisun_2fsk_make_phr(phr_options, frame_length);
+	phr_le[0] = (phr >> 0) & 0xff;
+	phr_le[1] = (phr >> 8) & 0xff;
+	fec_block_encode(&e, phr_le, sizeof(phr_le));
+
+	/* the short PSDU is padded when computing FCS */
+	e.whitening = !!(phr_options & WISUN_2FSK_PHR_DATA_WHITENING);
+	if (data_sz >= sizeof(fcs))
+		e.crc_bytes = data_sz;
+	fec_block_encode(&e, psdu, data_sz);
+
+	if (data_sz >= sizeof(fcs))
+		c32 = e.crc ^ 0xffffffff;
+	else
+		c32 = ieee_802154_fcs32(IEEE_802154_FCS32_INIT, psdu, data_sz);
+
+	for (size_t i = 0; i < sizeof(fcs); i++)
+		fcs[i] = (c32 >> (i * 8)) & 0xff;
+	fec_block_encode(&e, fcs, sizeof(fcs));
+
+	if (coded) {
+		pad_sz = wisun_2fsk_fec_padding(pad, frame_length, type,
+						use_rsc ? e.m : 0);
+		fec_block_encode(&e, pad, pad_sz);
+	}
+
+	if (e.whitening)
+		WISUN_FSK_SDT2(whitening, e.len - sizeof(phr) * (coded + 1),
+			       1);
+	b->len += e.len;
+	return 0;
+}
+
+/* parse the encode input string to @data after 2 bytes PHR space.
+ * Return the input bytes, 0 if the input is bad.
+ */
+static size_t wisun_2fsk_parse_encode_input(const char *arg, uint8_t *data,
+					    size_t data_sz,
+					    uint16_t phr_options)
+{
+	size_t data_idx, data_res;
+
+	/* reverse space for phr, crc, padding and tail bits */
+	data_idx = sizeof(uint16_t);
+	data_res = sizeof(uint16_t);
+	data_res += phr_options & WISUN_2FSK_PHR_FCS_TYPE_CRC16 ? 2 : 4;
+
+	if (option_hexi)
+		return strict_strhex_to_buffer(arg, &data[data_idx],
+					       data_sz - data_res);
+
+	{
+		size_t binary_size;
+
+		binary_size = strict_str01_to_buffer(arg, &data[data_idx],
+						     data_sz - data_res,
+						     1);
+		if (!binary_size)
+			return 0;
+
+		if (binary_size % 8) {
+			fprintf(stderr, "not byte aligned\n");
+			return 0;
+		}
+
+		return binary_size / 8;
+	}
+}
+
+static void wisun_2fsk_push_shr(struct bufwrite *b, size_t preamble_sz,
+				enum wisun_2fsk_sfd_type type)
+{
+	/* fill the WISUN_2FSK_PREAMBLE bits in lsb first */
+	for (size_t i = 0; i < preamble_sz / 8; i++)
+		bufwrite_push_le8(b, 0xaa);
+
+	/* fill SFD */
+	bufwrite_push_le16(b, wisun_2fsk_sfd_value(type));
+}
+
+static void wisun_2fsk_print_encoded(const struct bufwrite *b)
+{
+	size_t group_sz = option_human ? 4 : 0;
+
+	if (option_verbose > 0)
+		printf("SHR, PHR, PSDU\n");
+
+	if (option_hexo)
+		print_hex_bytes(b->buf, b->len);
+	else
+		print_binary_bits_lsbfirst(b->buf, 0, b->len * 8 - 1, group_sz);
+	putchar('\n');
+}
+
+static int wisun_2fsk_packet_encode(const char *arg,
+				    size_t preamble_sz,
+				    enum wisun_2fsk_sfd_type type,
+				    uint16_t phr_options,
+				    int use_rsc,
+				    int interleaving)
+{
+	size_t group_sz = option_human ? 4 : 0;
+	uint8_t buf[4096] = { 0 }, data[1024] = { 0 };
+	size_t frame_length = 0, data_idx = sizeof(uint16_t);
+	struct bufwrite b;
+	int ret;
+
+	bufwrite_init(&b, buf, sizeof(buf));
+	wisun_2fsk_push_shr(&b, preamble_sz, type);
+
+	frame_length = wisun_2fsk_parse_encode_input(arg, data, sizeof(data),
+						     phr_options);
+	if (!frame_length)
+		return -1;
+
+	WISUN_FSK_SDT2(encode_start, frame_length, type);
+
+	if (option_verbose > 0) {
+		printf("Input:\n");
+		print_binary_bits_lsbfirst(&data[data_idx], 0,
+					   frame_length * 8 - 1,
+					   group_sz);
+		putchar('\n');
+
+		ret = wisun_2fsk_frame_encode_staged(&b, data, frame_length,
+						     type, phr_options,
+						     use_rsc, interleaving);
+	} else {
+		ret = wisun_2fsk_frame_encode_fused(&b, &data[data_idx],
+						    frame_length, type,
+						    phr_options, use_rsc,
+						    interleaving);
+	}
+
+	WISUN_FSK_SDT2(frame_encoded, b.len, ret);
+	if (ret < 0)
+		return ret;
+
+	if (option_iq_output.filename)
+		return wisun_2fsk_write_iq(&option_iq_output, b.buf, b.len * 8);
+
+	wisun_2fsk_print_encoded(&b);
+	return 0;
+}
+
+struct wisun_2fsk_batch_frame {
+	uint8_t		data[1024];	/* PHR, PSDU and FCS */
+	size_t		data_sz;
+	size_t		encoded;	/* bytes of data already encoded */
+	uint8_t		m;
+	uint8_t		buf[4096];
+	struct bufwrite	b;
+};
+
+/* FEC encode the data of all coded frames, the frames are bit-sliced and
+ * encoded FEC_BITSLICE_LANES at a time until the shortest one is done.
+ */
+static void wisun_2fsk_batch_fec_encode(struct wisun_2fsk_batch_frame *frames,
+					size_t n, int use_rsc)
+{
+	while (1) {
+		const uint8_t *in[FEC_BITSLICE_LANES];
+		uint8_t *out[FEC_BITSLICE_LANES];
+		uint8_t m[FEC_BITSLICE_LANES];
+		size_t lanes = 0, bytes = SIZE_MAX;
+
+		for (size_t i = 0; i < n; i++) {
+			struct wisun_2fsk_batch_frame *f = &frames[i];
+			size_t remain = f->data_sz - f->encoded;
+
+			if (remain == 0)
+				continue;
+
+			if (remain < bytes)
+				bytes = remain;
+		}
+
+		if (bytes == SIZE_MAX)
+			break;
+
+		for (size_t i = 0; i < n; i++) {
+			struct wisun_2fsk_batch_frame *f = &frames[i];
+
+			if (f->encoded == f->data_sz)
+				continue;
+
+			in[lanes] = f->data + f->encoded;
+			out[lanes] = f->b.buf + f->b.len + f->encoded * 2;
+			m[lanes] = f->m;
+			lanes++;
+		}
+
+		fec_bitslice_encode(use_rsc, m, in, out, lanes, bytes);
+
+		for (size_t i = 0, k = 0; i < n; i++) {
+			struct wisun_2fsk_batch_frame *f = &frames[i];
+
+			if (f->encoded == f->data_sz)
+				continue;
+
+			f->m = m[k++];
+			f->encoded += bytes;
+		}
+	}
+}
+
+/* encode several packets with the same options, one line for each */
+static int wisun_2fsk_packet_encode_batch(char *const *args, size_t nargs,
+					  size_t preamble_sz,
+					  enum wisun_2fsk_sfd_type type,
+					  uint16_t phr_options,
+					  int use_rsc, int interleaving)
+{
+	int coded = type == WISUN_2FSK_SFD_CODED0
+			|| type == WISUN_2FSK_SFD_CODED1;
+	struct wisun_2fsk_batch_frame *frames;
+	int ret = 0;
+
+	if (option_verbose > 0 || (phr_options & WISUN_2FSK_PHR_FCS_TYPE_CRC16)) {
+		for (size_t i = 0; i < nargs && ret == 0; i++)
+			ret = wisun_2fsk_packet_encode(args[i], preamble_sz,
+						       type, phr_options,
+						       use_rsc, interleaving);
+		return ret;
+	}
+
+	frames = malloc(sizeof(*frames) * FEC_BITSLICE_LANES);
+	if (!frames)
+		return -1;
+
+	for (size_t base = 0; base < nargs; base += FEC_BITSLICE_LANES) {
+		size_t n = nargs - base;
+
+		if (n > FEC_BITSLICE_LANES)
+			n = FEC_BITSLICE_LANES;
+
+		for (size_t i = 0; i < n; i++) {
+			struct wisun_2fsk_batch_frame *f = &frames[i];
+			size_t frame_length;
+			uint16_t phr;
+			uint32_t c32;
+
+			frame_length = wisun_2fsk_parse_encode_input(
+						args[base + i], f->data,
+						sizeof(f->data), phr_options);
+			if (!frame_length) {
+				ret = -1;
+				goto done;
+			}
+
+			bufwrite_init(&f->b, f->buf, sizeof(f->buf));
+			wisun_2fsk_push_shr(&f->b, preamble_sz, type);
+
+			if (!coded) {
+				wisun_2fsk_frame_encode_fused(&f->b,
+						&f->data[sizeof(phr)],
+						frame_length, type,
+						phr_options, use_rsc,
+						interleaving);
+				f->data_sz = f->encoded = 0;
+				continue;
+			}
+
+			c32 = ieee_802154_fcs32(IEEE_802154_FCS32_INIT,
+						&f->data[sizeof(phr)],
+						frame_length);
+			for (size_t j = 0; j < sizeof(c32); j++)
+				f->data[sizeof(phr) + frame_length + j] =
+					(c32 >> (j * 8)) & 0xff;
+			frame_length += sizeof(c32);
+
+			phr = wisun_2fsk_make_phr(phr_options, frame_length);
+			f->data[0] = (phr >> 0) & 0xff;
+			f->data[1] = (phr >> 8) & 0xff;
+
+			f->data_sz = sizeof(phr) + frame_length;
+			f->encoded = 0;
+			f->m = use_rsc ? RSC_INIT_M : NRNSC_INIT_M;
+		}
+
+		if (coded)
+			wisun_2fsk_batch_fec_encode(frames, n, use_rsc);
+
+		for (size_t i = 0; i < n; i++) {
+			struct wisun_2fsk_batch_frame *f = &frames[i];
+
+			if (coded) {
+				uint8_t *p_frame = f->b.buf + f->b.len;
+				size_t coded_sz, pad_sz;
+				uint8_t pad[2];
+
+				pad_sz = wisun_2fsk_fec_padding(pad,
+						f->data_sz - sizeof(uint16_t),
+						type, use_rsc ? f->m : 0);
+				fec_encode_bytes(use_rsc, &f->m, pad, pad_sz,
+						 p_frame + f->data_sz * 2);
+
+				coded_sz = (f->data_sz + pad_sz) * 2;
+				if (interleaving)
+					interleaving_bits(p_frame, coded_sz * 8,
+							  p_frame);
+				if (phr_options & WISUN_2FSK_PHR_DATA_WHITENING)
+					pn9_payload_decode(p_frame + 4,
+							   coded_sz - 4);
+
+				f->b.len += coded_sz;
+			}
+
+			wisun_2fsk_print_encoded(&f->b);
+		}
+	}
+
+done:
+	free(frames);
+	return ret;
+}
+
+/* the PSDU without FCS of a 802.15.4 pcap packet, return -1 if the link
+ * type is not supported.
+ */
+static int wisun_2fsk_pcap_packet_psdu(const struct wisun_fsk_pcap_packet *pkt,
+				       const uint8_t **ret_psdu,
+				       size_t *ret_len)
+{
+	const uint8_t *p = pkt->data;
+	size_t len = pkt->len, fcs_sz = 0;
+
+	switch (pkt->linktype) {
+	case LINKTYPE_IEEE802_15_4_NOFCS:
+		break;
+	case LINKTYPE_IEEE802_15_4_WITHFCS:
+		/* the FCS of Wi-SUN is FCS32 */
+		fcs_sz = 4;
+		break;
+	case LINKTYPE_IEEE802_15_4_TAP:
+		{
+			size_t hdr_sz;
+
+			if (len < 4)
+				return -1;
+
+			hdr_sz = p[2] | (p[3] << 8);
+			if (hdr_sz < 4 || hdr_sz > len)
+				return -1;
+
+			/* no FCS if the FCS type TLV is missing */
+			for (size_t pos = 4; pos + 4 <= hdr_sz; ) {
+				uint16_t type = p[pos] | (p[pos + 1] << 8);
+				uint16_t tlv_len = p[pos + 2] | (p[pos + 3] << 8);
+
+				if (pos + 4 + tlv_len > hdr_sz)
+					return -1;
+
+				if (type == IEEE802154_TAP_FCS_TYPE && tlv_len == 1)
+					fcs_sz = p[pos + 4] == 1 ? 2
+						: p[pos + 4] == 2 ? 4 : 0;
+
+				pos += 4 + ((tlv_len + 3) & ~3);
+			}
+
+			p += hdr_sz;
+			len -= hdr_sz;
+		}
+		break;
+	default:
+		return -1;
+	}
+
+	if (len < fcs_sz)
+		return -1;
+
+	*ret_psdu = p;
+	*ret_len = len - fcs_sz;
+	return 0;
+}
+
+/* Encode all the 802.15.4 packets in a pcap/pcapng file with the same
+ * options, one line each or a continuous IQ stream. The PSDU is encoded
+ * from the read buffer directly, and the output buffer is reused.
+ */
+static int wisun_2fsk_packet_encode_pcap(const char *filename,
+					 size_t preamble_sz,
+					 enum wisun_2fsk_sfd_type type,
+					 uint16_t phr_options,
+					 int use_rsc, int interleaving)
+{
+	/* SHR, PHR, the max 2047 bytes PSDU and padding after FEC */
+	size_t buf_sz = preamble_sz / 8 + 2 + (2 + 2047 + 2) * 2;
+	size_t fcs_sz = phr_options & WISUN_2FSK_PHR_FCS_TYPE_CRC16 ? 2 : 4;
+	struct wisun_2fsk_iq_writer iq;
+	struct wisun_fsk_pcap_reader r;
+	struct wisun_fsk_pcap_packet pkt;
+	uint64_t frames = 0, skipped = 0;
+	uint8_t *buf;
+	int ret;
+
+	buf = malloc(buf_sz);
+	if (!buf)
+		return -1;
+
+	if (wisun_fsk_pcap_reader_open(&r, filename) < 0) {
+		free(buf);
+		return -1;
+	}
+
+	if (option_iq_output.filename
+	    && wisun_2fsk_iq_writer_open(&iq, &option_iq_output) < 0) {
+		wisun_fsk_pcap_reader_close(&r);
+		free(buf);
+		return -1;
+	}
+
+	while ((ret = wisun_fsk_pcap_reader_next(&r, &pkt)) > 0) {
+		const uint8_t *psdu;
+		struct bufwrite b;
+		size_t len;
+
+		if (wisun_2fsk_pcap_packet_psdu(&pkt, &psdu, &len) < 0
+		    || len + fcs_sz > 2047) {
+			skipped++;
+			continue;
+		}
+
+		bufwrite_init(&b, buf, buf_sz);
+		wisun_2fsk_push_shr(&b, preamble_sz, type);
+		ret = wisun_2fsk_frame_encode_fused(&b, psdu, len, type,
+						    phr_options, use_rsc,
+						    interleaving);
+		if (ret < 0)
+			break;
+
+		if (option_iq_output.filename)
+			ret = wisun_2fsk_iq_writer_write(&iq, b.buf, b.len * 8);
+		else
+			wisun_2fsk_print_encoded(&b);
+
+		if (ret < 0)
+			break;
+		frames++;
+	}
+
+	if (option_iq_output.filename && wisun_2fsk_iq_writer_close(&iq) < 0)
+		ret = -1;
+
+	if (skipped > 0 || option_verbose > 0)
+		fprintf(stderr, "%" PRIu64 " frames encoded, %" PRIu64
+			" skipped\n", frames, skipped);
+
+	wisun_fsk_pcap_reader_close(&r);
+	free(buf);
+	return ret < 0 ? -1 : 0;
+}
+
+/* A registered frame which is regenerated by patching byte ranges of its
+ * PSDU. The FCS32 is updated by the CRC of the changed bits, the uncoded
+ * frame re-whitens the changed bytes only, and the coded frame re-encodes
+ * the changed blocks only, so the cost depends on the change, not the frame
+ * length. The RSC memory state never joins the saved one again, the blocks
+ * after the change are patched by a XOR.
+ */
+#define WISUN_2FSK_TEMPLATE_MAX_DATA	(2047 - 4)	/* PSDU without FCS32 */
+
+struct wisun_2fsk_template {
+	enum wisun_2fsk_sfd_type	type;
+	uint16_t			phr_options;
+	int				coded;
+	int				use_rsc;
+	int				interleaving;
+
+	/* the PSDU data, FCS32 and the FEC padding */
+	uint8_t				psdu[WISUN_2FSK_TEMPLATE_MAX_DATA + 4 + 2];
+	size_t				data_sz;
+	uint32_t			fcs32;
+
+	/* FEC memory state before each 2 bytes block of the PSDU */
+	uint8_t				m[(WISUN_2FSK_TEMPLATE_MAX_DATA + 4 + 2) / 2 + 1];
+
+	/* the FEC is affine, a memory state difference of an unchanged block
+	 * flips its coded bits by the zero input response of the difference.
+	 */
+	uint8_t				zir[8][4];
+	uint8_t				zir_m[8];
+
+	/* the preamble, SFD and the coded PHR and PSDU */
+	uint8_t				buf[32 + 2 + 4
+					    + (WISUN_2FSK_TEMPLATE_MAX_DATA + 4
+					       + 2) * 2];
+	struct bufwrite			b;
+	uint8_t				*p_psdu;	/* PSDU in buf */
+};
+
+static int wisun_2fsk_template_init(struct wisun_2fsk_template *t,
+				    const uint8_t *data, size_t data_sz,
+				    size_t preamble_sz,
+				    enum wisun_2fsk_sfd_type type,
+				    uint16_t phr_options,
+				    int use_rsc, int interleaving)
+{
+	size_t frame_length = data_sz + sizeof(t->fcs32);
+	uint8_t m, phr_le[2], tmp[4];
+	uint16_t phr;
+
+	if (data_sz > WISUN_2FSK_TEMPLATE_MAX_DATA) {
+		fprintf(stderr, "template data is too long: %zu > %d\n",
+			data_sz, WISUN_2FSK_TEMPLATE_MAX_DATA);
+		return -1;
+	}
+
+	t->type = type;
+	t->phr_options = phr_options;
+	t->coded = type == WISUN_2FSK_SFD_CODED0 || type == WISUN_2FSK_SFD_CODED1;
+	t->use_rsc = use_rsc;
+	t->interleaving = interleaving;
+
+	bufwrite_init(&t->b, t->buf, sizeof(t->buf));
+	wisun_2fsk_push_shr(&t->b, preamble_sz, type);
+	t->p_psdu = t->buf + t->b.len + (t->coded ? 4 : 2);
+	if (wisun_2fsk_frame_encode_fused(&t->b, data, data_sz, type,
+					  phr_options, use_rsc,
+					  interleaving) < 0)
+		return -1;
+
+	memcpy(t->psdu, data, data_sz);
+	t->data_sz = data_sz;
+	t->fcs32 = ieee_802154_fcs32(IEEE_802154_FCS32_INIT, data, data_sz);
+	for (size_t i = 0; i < sizeof(t->fcs32); i++)
+		t->psdu[data_sz + i] = (t->fcs32 >> (i * 8)) & 0xff;
+
+	if (!t->coded)
+		return 0;
+
+	/* replay the FEC to save the memory state of each block */
+	phr = wisun_2fsk_make_phr(phr_options, frame_length);
+	phr_le[0] = (phr >> 0) & 0xff;
+	phr_le[1] = (phr >> 8) & 0xff;
+	m = use_rsc ? RSC_INIT_M : NRNSC_INIT_M;
+	fec_encode_bytes(use_rsc, &m, phr_le, sizeof(phr_le), tmp);
+
+	for (size_t i = 0; i < frame_length; i += 2) {
+		t->m[i / 2] = m;
+		fec_encode_bytes(use_rsc, &m, &t->psdu[i],
+				 i + 1 < frame_length ? 2 : 1, tmp);
+	}
+
+	if (frame_length % 2 == 0)
+		t->m[frame_length / 2] = m;
+
+	for (uint8_t d = 0; d < 8; d++) {
+		struct fec_block_encoder e;
+		static const uint8_t zeros[2];
+
+		fec_block_encoder_init(&e, 1, use_rsc, interleaving,
+				       t->zir[d]);
+		e.m = d;
+		fec_block_encode(&e, zeros, sizeof(zeros));
+		t->zir_m[d] = e.m;
+	}
+
+	/* the coded bits are affine, the response of state 0 is the offset */
+	for (int d = 7; d >= 0; d--) {
+		t->zir_m[d] ^= t->zir_m[0];
+		for (size_t i = 0; i < sizeof(t->zir[d]); i++)
+			t->zir[d][i] ^= t->zir[0][i];
+	}
+
+	return 0;
+}
+
+static void wisun_2fsk_template_encoder_init(struct wisun_2fsk_template *t,
+					     struct fec_block_encoder *e,
+					     size_t block)
+{
+	fec_block_encoder_init(e, 1, t->use_rsc, t->interleaving,
+			       t->p_psdu + block * 4);
+	e->whitening = !!(t->phr_options & WISUN_2FSK_PHR_DATA_WHITENING);
+	e->pn9_pos = block * 4 % PN9_TABLE_SIZE;
+	e->m = t->m[block];
+}
+
+/* re-encode the coded PSDU blocks from @block to @stop, the blocks after
+ * the byte @end are patched by the zero input response of the memory state
+ * difference until it's zero. The last block with the padding is encoded
+ * if @stop is beyond it.
+ */
+static size_t wisun_2fsk_template_encode_blocks(struct wisun_2fsk_template *t,
+						size_t block, size_t end,
+						size_t stop)
+{
+	size_t frame_length = t->data_sz + sizeof(t->fcs32);
+	size_t last = frame_length / 2;	/* the block has the padding */
+	struct fec_block_encoder e;
+
+	wisun_2fsk_template_encoder_init(t, &e, block);
+
+	for (; block < last && block < stop; block++) {
+		uint8_t d;
+
+		fec_block_encode(&e, &t->psdu[block * 2], 2);
+		if ((block + 1) * 2 < end) {
+			t->m[block + 1] = e.m;
+			continue;
+		}
+
+		d = e.m ^ t->m[block + 1];
+		for (block++; d && block < last && block < stop; block++) {
+			uint8_t *p = t->p_psdu + block * 4;
+			uint32_t w, zir;
+
+			memcpy(&w, p, sizeof(w));
+			memcpy(&zir, t->zir[d], sizeof(zir));
+			w ^= zir;
+			memcpy(p, &w, sizeof(w));
+			t->m[block] ^= d;
+			d = t->zir_m[d];
+		}
+		t->m[block] ^= d;
+
+		/* the padding depends on the final memory state */
+		if (!d || block < last)
+			return block;
+		break;
+	}
+
+	if (block < last)
+		return block;
+
+	/* the padding has the RSC tail bits of the final memory state */
+	wisun_2fsk_template_encoder_init(t, &e, last);
+	fec_block_encode(&e, &t->psdu[last * 2], frame_length - last * 2);
+	fec_block_encode(&e, &t->psdu[frame_length],
+			 wisun_2fsk_fec_padding(&t->psdu[frame_length],
+						frame_length, t->type,
+						t->use_rsc ? e.m : 0));
+	return last + 1;
+}
+
+/* replace the PSDU data at @offset by @patch(@n bytes) */
+static int wisun_2fsk_template_patch(struct wisun_2fsk_template *t,
+				     size_t offset, const uint8_t *patch,
+				     size_t n)
+{
+	uint8_t delta[WISUN_2FSK_TEMPLATE_MAX_DATA];
+	size_t fcs_offset = t->data_sz, tail;
+
+	if (offset > t->data_sz || n > t->data_sz - offset)
+		return -1;
+
+	for (size_t i = 0; i < n; i++)
+		delta[i] = t->psdu[offset + i] ^ patch[i];
+
+	/* the short PSDU is padded to 4 bytes when computing FCS */
+	tail = (t->data_sz < 4 ? 4 : t->data_sz) - offset - n;
+	t->fcs32 ^= ieee_802154_fcs32_delta(delta, n, tail);
+
+	memcpy(&t->psdu[offset], patch, n);
+	for (size_t i = 0; i < sizeof(t->fcs32); i++)
+		t->psdu[fcs_offset + i] = (t->fcs32 >> (i * 8)) & 0xff;
+
+	if (!t->coded) {
+		memcpy(t->p_psdu + offset, patch, n);
+		memcpy(t->p_psdu + fcs_offset, &t->psdu[fcs_offset],
+		       sizeof(t->fcs32));
+		if (t->phr_options & WISUN_2FSK_PHR_DATA_WHITENING) {
+			pn9_payload_decode_offset(t->p_psdu + offset, n,
+						  offset);
+			pn9_payload_decode_offset(t->p_psdu + fcs_offset,
+						  sizeof(t->fcs32), fcs_offset);
+		}
+		return 0;
+	}
+
+	/* the data blocks, then the FCS blocks which are always changed */
+	wisun_2fsk_template_encode_blocks(t, offset / 2, offset + n,
+					  fcs_offset / 2);
+	wisun_2fsk_template_encode_blocks(t, fcs_offset / 2,
+					  fcs_offset + sizeof(t->fcs32),
+					  SIZE_MAX);
+
+	return 0;
+}
+
+/* parse the patches "offset:bytes[,offset:bytes]..." and apply them */
+static int wisun_2fsk_template_apply(struct wisun_2fsk_template *t,
+				     const char *arg)
+{
+	while (*arg != '\0') {
+		uint8_t patch[WISUN_2FSK_TEMPLATE_MAX_DATA];
+		char bytes[WISUN_2FSK_TEMPLATE_MAX_DATA * 8 + 1];
+		const char *comma;
+		unsigned long offset;
+		size_t len, n;
+		char *endp;
+
+		offset = strtoul(arg, &endp, 0);
+		if (endp == arg || *endp != ':') {
+			fprintf(stderr, "bad patch: %s\n", arg);
+			return -1;
+		}
+
+		arg = endp + 1;
+		comma = strchr(arg, ',');
+		len = comma ? (size_t)(comma - arg) : strlen(arg);
+		if (len >= sizeof(bytes)) {
+			fprintf(stderr, "patch is too long at offset %lu\n",
+				offset);
+			return -1;
+		}
+		memcpy(bytes, arg, len);
+		bytes[len] = '\0';
+		arg += len + !!comma;
+
+		if (option_hexi) {
+			n = strict_strhex_to_buffer(bytes, patch, sizeof(patch));
+		} else {
+			n = strict_str01_to_buffer(bytes, patch, sizeof(patch), 1);
+			if (n % 8) {
+				fprintf(stderr, "not byte aligned\n");
+				return -1;
+			}
+			n /= 8;
+		}
+
+		if (!n || wisun_2fsk_template_patch(t, offset, patch, n) < 0) {
+			fprintf(stderr, "bad patch at offset %lu\n", offset);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* encode the base frame @args[0] once, and print a variant for each of the
+ * patches in @args[1...], the patches are accumulated.
+ */
+static int wisun_2fsk_packet_encode_template(char *const *args, size_t nargs,
+					     size_t preamble_sz,
+					     enum wisun_2fsk_sfd_type type,
+					     uint16_t phr_options,
+					     int use_rsc, int interleaving)
+{
+	struct wisun_2fsk_template *t;
+	uint8_t data[WISUN_2FSK_TEMPLATE_MAX_DATA + 8];
+	size_t frame_length;
+	int ret = -1;
+
+	if (phr_options & WISUN_2FSK_PHR_FCS_TYPE_CRC16) {
+		fprintf(stderr, "FCS16 is not supported now\n");
+		return -1;
+	}
+
+	t = malloc(sizeof(*t));
+	if (!t)
+		return -1;
+
+	frame_length = wisun_2fsk_parse_encode_input(args[0], data,
+						     sizeof(data), phr_options);
+	if (!frame_length)
+		goto done;
+
+	if (wisun_2fsk_template_init(t, &data[sizeof(uint16_t)], frame_length,
+				     preamble_sz, type, phr_options,
+				     use_rsc, interleaving) < 0)
+		goto done;
+
+	wisun_2fsk_print_encoded(&t->b);
+	for (size_t i = 1; i < nargs; i++) {
+		if (wisun_2fsk_template_apply(t, args[i]) < 0)
+			goto done;
+		wisun_2fsk_print_encoded(&t->b);
+	}
+
+	ret = 0;
+done:
+	free(t);
+	return ret;
+}
+
+enum {
+	OPTION_PACKET,
+	OPTION_PN9,
+	OPTION_RSC,
+	OPTION_NRNSC,
+	OPTION_INTERLEAVING,
+	OPTION_HELP,
+	OPTION_VERBOSE,
+	OPTION_VERSION,
+	OPTION_DECODE,
+	OPTION_ENCODE,
+	OPTION_HEXI,
+	OPTION_HEXO,
+	OPTION_HUMAN,
+	OPTION_SKIP_VERIFY,
+	OPTION_SFD,
+	OPTION_PREAMBLE_SIZE,
+	OPTION_WHITENING,
+	OPTION_CHANNELIZER,
+	OPTION_IQ_FORMAT,
+	OPTION_SAMPLE_RATE,
+	OPTION_CHANNEL_SPACING,
+	OPTION_CHANNEL0,
+	OPTION_CHANNELS,
+	OPTION_SYMBOL_RATE,
+	OPTION_THREADS,
+	OPTION_IQ_OUTPUT,
+	OPTION_SPS,
+	OPTION_MOD_INDEX,
+	OPTION_BT,
+	OPTION_STREAM,
+	OPTION_REPAIR,
+	OPTION_AUTO,
+	OPTION_TEMPLATE,
+	OPTION_BUILD_INDEX,
+	OPTION_INDEX,
+	OPTION_DUMP_INDEX,
+	OPTION_CACHE,
+	OPTION_FILTER,
+	OPTION_PCAP,
+	OPTION_PCAP_LINKTYPE,
+	OPTION_EXTCAP_INTERFACES,
+	OPTION_EXTCAP_DLTS,
+	OPTION_EXTCAP_CONFIG,
+	OPTION_EXTCAP_INTERFACE,
+	OPTION_EXTCAP_VERSION,
+	OPTION_EXTCAP_CAPTURE_FILTER,
+	OPTION_CAPTURE,
+	OPTION_FIFO,
+	OPTION_INPUT,
+	OPTION_PCAP_INPUT,
+	OPTION_SIMULATE,
+	OPTION_SIM_CHANNEL,
+	OPTION_SIM_POINTS,
+	OPTION_SIM_FRAMES,
+	OPTION_SIM_LENGTH,
+	OPTION_SIM_SEED,
+	OPTION_FORCE_ISA,
+	OPTION_ISA_VERIFY,
+	OPTION_SQUELCH,
+	OPTION_RESAMPLE_SPS,
+	OPTION_DEMOD,
+	OPTION_TIMING,
+	OPTION_SOFT_OUTPUT,
+	OPTION_CFO,
+	OPTION_PIPELINE,
+	OPTION_BATCH,
+};
+
+static struct option long_options[] = {
+	/* name			has_arg,		*flag,		val */
+	{ "packet",		no_argument,		NULL,		OPTION_PACKET	},
+	{ "pn9",		no_argument,		NULL,		OPTION_PN9	},
+	{ "rsc",		no_argument,		NULL,		OPTION_RSC	},
+	{ "nrnsc",		no_argument,		NULL,		OPTION_NRNSC	},
+	{ "interleaving",	no_argument,		NULL,		OPTION_INTERLEAVING	},
+	{ "help",		no_argument,		NULL,		OPTION_HELP	},
+	{ "verbose",		no_argument,		NULL,		OPTION_VERBOSE	},
+	{ "version",		no_argument,		NULL,		OPTION_VERSION	},
+	{ "decode",		no_argument,		NULL,		OPTION_DECODE	},
+	{ "encode",		no_argument,		NULL,		OPTION_ENCODE	},
+	{ "hexi",		no_argument,		NULL,		OPTION_HEXI	},
+	{ "hexo",		no_argument,		NULL,		OPTION_HEXO	},
+	{ "human",		no_argument,		NULL,		OPTION_HUMAN	},
+	{ "skip-verify",	no_argument,		NULL,		OPTION_SKIP_VERIFY	},
+	{ "sfd",		required_argument,	NULL,		OPTION_SFD	},
+	{ "preamble-size",	required_argument,	NULL,		OPTION_PREAMBLE_SIZE	},
+	{ "whitening",		no_argument,		NULL,		OPTION_WHITENING	},
+	{ "channelizer",	no_argument,		NULL,		OPTION_CHANNELIZER	},
+	{ "iq-format",		required_argument,	NULL,		OPTION_IQ_FORMAT	},
+	{ "sample-rate",	required_argument,	NULL,		OPTION_SAMPLE_RATE	},
+	{ "channel-spacing",	required_argument,	NULL,		OPTION_CHANNEL_SPACING	},
+	{ "channel0",		required_argument,	NULL,		OPTION_CHANNEL0	},
+	{ "channels",		required_argument,	NULL,		OPTION_CHANNELS	},
+	{ "symbol-rate",	required_argument,	NULL,		OPTION_SYMBOL_RATE	},
+	{ "threads",		required_argument,	NULL,		OPTION_THREADS	},
+	{ "iq-output",		required_argument,	NULL,		OPTION_IQ_OUTPUT	},
+	{ "sps",		required_argument,	NULL,		OPTION_SPS	},
+	{ "mod-index",		required_argument,	NULL,		OPTION_MOD_INDEX	},
+	{ "bt",			required_argument,	NULL,		OPTION_BT	},
+	{ "stream",		no_argument,		NULL,		OPTION_STREAM	},
+	{ "repair",		required_argument,	NULL,		OPTION_REPAIR	},
+	{ "auto",		no_argument,		NULL,		OPTION_AUTO	},
+	{ "template",		no_argument,		NULL,		OPTION_TEMPLATE	},
+	{ "build-index",	required_argument,	NULL,		OPTION_BUILD_INDEX	},
+	{ "index",		required_argument,	NULL,		OPTION_INDEX	},
+	{ "dump-index",		no_argument,		NULL,		OPTION_DUMP_INDEX	},
+	{ "cache",		required_argument,	NULL,		OPTION_CACHE	},
+	{ "filter",		required_argument,	NULL,		OPTION_FILTER	},
+	{ "pcap",		required_argument,	NULL,		OPTION_PCAP	},
+	{ "pcap-linktype",	required_argument,	NULL,		OPTION_PCAP_LINKTYPE	},
+	{ "extcap-interfaces",	no_argument,		NULL,		OPTION_EXTCAP_INTERFACES	},
+	{ "extcap-dlts",	no_argument,		NULL,		OPTION_EXTCAP_DLTS	},
+	{ "extcap-config",	no_argument,		NULL,		OPTION_EXTCAP_CONFIG	},
+	{ "extcap-interface",	required_argument,	NULL,		OPTION_EXTCAP_INTERFACE	},
+	{ "extcap-version",	optional_argument,	NULL,		OPTION_EXTCAP_VERSION	},
+	{ "extcap-capture-filter", required_argument,	NULL,		OPTION_EXTCAP_CAPTURE_FILTER	},
+	{ "capture",		no_argument,		NULL,		OPTION_CAPTURE	},
+	{ "fifo",		required_argument,	NULL,		OPTION_FIFO	},
+	{ "input",		required_argument,	NULL,		OPTION_INPUT	},
+	{ "pcap-input",		required_argument,	NULL,		OPTION_PCAP_INPUT	},
+	{ "simulate",		no_argument,		NULL,		OPTION_SIMULATE	},
+	{ "sim-channel",	required_argument,	NULL,		OPTION_SIM_CHANNEL	},
+	{ "sim-points",		required_argument,	NULL,		OPTION_SIM_POINTS	},
+	{ "sim-frames",		required_argument,	NULL,		OPTION_SIM_FRAMES	},
+	{ "sim-length",		required_argument,	NULL,		OPTION_SIM_LENGTH	},
+	{ "sim-seed",		required_argument,	NULL,		OPTION_SIM_SEED	},
+	{ "force-isa",		required_argument,	NULL,		OPTION_FORCE_ISA	},
+	{ "isa-verify",		optional_argument,	NULL,		OPTION_ISA_VERIFY	},
+	{ "squelch",		required_argument,	NULL,		OPTION_SQUELCH	},
+	{ "resample-sps",	required_argument,	NULL,		OPTION_RESAMPLE_SPS	},
+	{ "demod",		no_argument,		NULL,		OPTION_DEMOD	},
+	{ "timing",		required_argument,	NULL,		OPTION_TIMING	},
+	{ "soft-output",	required_argument,	NULL,		OPTION_SOFT_OUTPUT	},
+	{ "cfo",		no_argument,		NULL,		OPTION_CFO	},
+	{ "pipeline",		no_argument,		NULL,		OPTION_PIPELINE	},
+	{ "batch",		no_argument,		NULL,		OPTION_BATCH	},
+	{ NULL,			0,			NULL,		0   },
+};
+
+static void print_usage(void)
+{
+	fprintf(stderr, "Usage: urh_wisun_fsk [OPTIONS] \"binary-strings\"\n");
+	fprintf(stderr, "-h --help:              show this message\n");
+	fprintf(stderr, "-V --version:           show plugin version\n");
+	fprintf(stderr, "-v --verbose:           verbose mode\n");
+	fprintf(stderr, "-d --decode:            decode a wisun 2-fsk packet\n");
+	fprintf(stderr, "-e --encode:            encode a wisun 2-fsk packet\n");
+	fprintf(stderr, "   --hexo:              print the encode/decode result in hex mode\n");
+	fprintf(stderr, "   --human:             print the output string in human format\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Available algo for encode/decode:\n");
+	fprintf(stderr, "   --packet:            encode/decode the binary string as a full packet.\n");
+	fprintf(stderr, "                        (the default algo)\n");
+	fprintf(stderr, "   --pn9:               encode/decode binary strings by PN9\n");
+	fprintf(stderr, "   --nrnsc:             encode binary strings by NRNSC encoder\n");
+	fprintf(stderr, "   --rsc                encode binary string by RSC encoder\n");
+	fprintf(stderr, "   --interleaving:      interleaving the input binary blocks\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options for decode packet(--packet):\n");
+	fprintf(stderr, "   --skip-verify:       do not verify 802.15.4 packet\n");
+	fprintf(stderr, "   --repair n:          repair up to n(1 or 2) bit errors in PSDU by FCS32\n");
+	fprintf(stderr, "   --auto:              detect RSC/NRNSC and interleaving of coded packets\n");
+	fprintf(stderr, "   --cache file:        save the results in file and reuse them\n");
+	fprintf(stderr, "   --filter expr:       print only the packets whose MAC header matches\n");
+	fprintf(stderr, "                        \"type=data,pan=abcd,dst=ffff,src=00:11:..:77\",\n");
+	fprintf(stderr, "                        type is beacon, data, ack or cmd. The terms are\n");
+	fprintf(stderr, "                        and'ed, several filters are or'ed. (also --stream)\n");
+	fprintf(stderr, "Options for encode packet(--packet):\n");
+	fprintf(stderr, "   --hexi:              the input string is hex mode, not binary 01 string\n");
+	fprintf(stderr, "                        several strings are encoded as a batch, one line each\n");
+	fprintf(stderr, "   --preamble-size:     the preamble bit length\n");
+	fprintf(stderr, "   --sfd type:          select the sfd type:\n");
+	fprintf(stderr, "                          coded0:   %04x\n", wisun_2fsk_sfd_value(WISUN_2FSK_SFD_CODED0));
+	fprintf(stderr, "                          uncoded0: %04x\n", wisun_2fsk_sfd_value(WISUN_2FSK_SFD_UNCODED0));
+	fprintf(stderr, "                          coded1:   %04x\n", wisun_2fsk_sfd_value(WISUN_2FSK_SFD_CODED1));
+	fprintf(stderr, "                          uncoded1: %04x\n", wisun_2fsk_sfd_value(WISUN_2FSK_SFD_UNCODED1));
+	fprintf(stderr, "   --whitening:         whitening phy payload data\n");
+	fprintf(stderr, "   --template:          encode the first string, then a variant for each\n");
+	fprintf(stderr, "                        patch string \"offset:bytes[,offset:bytes]...\",\n");
+	fprintf(stderr, "                        the patches are accumulated\n");
+	fprintf(stderr, "   --pcap-input file:   encode all 802.15.4 packets of a pcap/pcapng file,\n");
+	fprintf(stderr, "                        one line each or one --iq-output stream\n");
+	fprintf(stderr, "   --iq-output file:    write 2-(G)FSK IQ samples to file, - for stdout\n");
+	fprintf(stderr, "   --iq-format:         IQ sample format: cf32(default), cs16, cs8, cu8\n");
+	fprintf(stderr, "   --sps:               samples per symbol, default 8\n");
+	fprintf(stderr, "   --mod-index:         modulation index, default 1.0\n");
+	fprintf(stderr, "   --bt:                gaussian filter BT, default 0.5, 0 for 2-FSK\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Streaming decode(--stream file):\n");
+	fprintf(stderr, "   --stream:            decode all packets in a 01 bits file, - for stdin\n");
+	fprintf(stderr, "                        packets are printed once received\n");
+	fprintf(stderr, "   --build-index file:  save the offsets of all packets in the --stream file\n");
+	fprintf(stderr, "   --index file:        decode only the packets saved in the index\n");
+	fprintf(stderr, "   --dump-index:        print the --index entries: bit and file offset,\n");
+	fprintf(stderr, "                        bits, PHR, preamble bits, SFD type and flags\n");
+	fprintf(stderr, "   --pipeline:          read, SHR search, decode and output on 4 pinned\n");
+	fprintf(stderr, "                        threads, -v prints the ring stats\n");
+	fprintf(stderr, "   --batch:             decode all files of a directory, or the files listed\n");
+	fprintf(stderr, "                        in a file(- for stdin), prefixed by the file name\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Pcap output of decoded packets(--decode, --stream, --channelizer):\n");
+	fprintf(stderr, "   --pcap file:         write the PSDU to a pcap file, - for stdout\n");
+	fprintf(stderr, "                        pcapng format if the name ends with .pcapng\n");
+	fprintf(stderr, "   --pcap-linktype:     nofcs(default), tap-fcs or tap(with SFD and FEC)\n");
+	fprintf(stderr, "                        tap-fcs is the TAP header with the FCS type only\n");
+	fprintf(stderr, "   --symbol-rate:       convert the packet offset to timestamp, default 50000\n");
+	fprintf(stderr, "   --extcap-interfaces: work as a wireshark extcap, which decodes the\n");
+	fprintf(stderr, "                        --input 01 bits stream(a fifo for live decode)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Channel simulation(--simulate), with the encode packet options:\n");
+	fprintf(stderr, "   --simulate:          decode random packets after the channel, print\n");
+	fprintf(stderr, "                        PER, BER and decoder throughput of each point\n");
+	fprintf(stderr, "   --sim-channel:       awgn(default), flip or burst[:bits], burst 8 bits\n");
+	fprintf(stderr, "   --sim-points:        start:stop:step or a,b,c. Eb/N0(dB) of awgn,\n");
+	fprintf(stderr, "                        bit error rate of flip, burst rate of burst\n");
+	fprintf(stderr, "   --sim-frames:        packets of each point, default 1000\n");
+	fprintf(stderr, "   --sim-length:        PSDU bytes without FCS, default 100\n");
+	fprintf(stderr, "   --sim-seed:          random seed, default 1\n");
+	fprintf(stderr, "   --threads:           simulate threads, default online cpus\n");
+	fprintf(stderr, "   --repair, --auto:    the decode options are applied too\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Wideband IQ decode(--channelizer iq-file):\n");
+	fprintf(stderr, "   --channelizer:       split the IQ file to channels and decode all of them\n");
+	fprintf(stderr, "   --iq-format:         IQ sample format: cf32(default), cs16, cs8, cu8\n");
+	fprintf(stderr, "   --sample-rate:       IQ sample rate in Hz\n");
+	fprintf(stderr, "   --channel-spacing:   channel spacing in Hz, default 200000\n");
+	fprintf(stderr, "   --channel0:          channel 0 frequency relative to the capture center\n");
+	fprintf(stderr, "   --channels:          channel counts in the plan, default all\n");
+	fprintf(stderr, "   --symbol-rate:       symbol rate, default 50000\n");
+	fprintf(stderr, "   --threads:           decode threads, default online cpus\n");
+	fprintf(stderr, "   --squelch db:        demodulate only the bursts whose power is db above\n");
+	fprintf(stderr, "                        the noise floor, with a block before and after\n");
+	fprintf(stderr, "   --resample-sps n:    resample the channels to n samples per symbol\n");
+	fprintf(stderr, "   --timing:            symbol timing: slicer(default) or gardner\n");
+	fprintf(stderr, "   --cfo:               estimate the frequency offset by the preamble and\n");
+	fprintf(stderr, "                        correct the burst, printed by -v\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Demodulated samples decode(--demod file):\n");
+	fprintf(stderr, "   --demod:             decode the float32 frequency samples, e.g. exported\n");
+	fprintf(stderr, "                        by URH, - for stdin\n");
+	fprintf(stderr, "   --sps:               samples per symbol, can be fractional, default 8\n");
+	fprintf(stderr, "   --timing:            gardner(default) or slicer(the nominal period)\n");
+	fprintf(stderr, "   --soft-output file:  write the float32 soft symbols to file, - for stdout\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "SIMD kernels(the best one supported by the CPU is used):\n");
+	fprintf(stderr, "   --force-isa:         scalar, sse4.2, avx2 or avx512\n");
+	fprintf(stderr, "   --isa-verify[=n]:    compare the kernels of each ISA with the scalar\n");
+	fprintf(stderr, "                        ones on n(default 10000) random inputs\n");
+}
+
+enum {
+	ALGO_PACKET,
+	ALGO_PN9,
+	ALGO_NRNSC,
+	ALGO_RSC,
+	ALGO_INTERLEAVING,
+	ALGO_CHANNELIZER,
+	ALGO_STREAM,
+	ALGO_DEMOD,
+};
+
+#if DEBUG > 0
+static void test_str01_strstr(void)
+{
+	const char *base = "0-0-1-0-1-0-1";
+	const char *s;
+
+	assert(str01_strstr("0-0-1-0-1", "0101") != NULL);
+
+	s = str01_strstr(base, "0101");
+	assert(s != NULL);
+	assert(s - base == 2);
+	assert(str01_strncmp(s, "0101", 4) == 0);
+	assert(str01_strncmp(s, "0-1-0-1", 4) == 0);
+}
+
+static void test_wisun_2fsk_str01_find_shr(void)
+{
+	const char *base;
+	enum wisun_2fsk_sfd_type type;
+	size_t preamble_sz;
+	int idx;
+
+	type = WISUN_2FSK_SFD_MAX;
+	base = "01010101010101010101010101010101" "1001000001001110";
+	idx = wisun_2fsk_str01_find_shr(base, &preamble_sz, &type);
+	assert(idx == 0);
+	assert(preamble_sz == 32);
+	assert(type == WISUN_2FSK_SFD_UNCODED0);
+
+	type = WISUN_2FSK_SFD_MAX;
+	base = "0101-0101-0101-0101-0101-0101-0101-0101" "-:-:-"
+	       "1001-0000-0100-1110";
+	idx = wisun_2fsk_str01_find_shr(base, &preamble_sz, &type);
+	assert(idx == 0);
+	assert(preamble_sz == 32);
+	assert(type == WISUN_2FSK_SFD_UNCODED0);
+}
+
+static void test_rsc_input_bit(void)
+{
+	struct wisun_2fsk_fec_encoder arg = { .m = RSC_INIT_M };
+	uint8_t buf[2] = { 0x11, 0x22 }, encode_buf[sizeof(buf) * 2];
+	const uint8_t expected[sizeof(encode_buf)] = { 0x17, 0x03, 0x5c, 0x0c };
+
+	memset(encode_buf, 0, sizeof(encode_buf));
+	memset(&arg, 0, sizeof(arg));
+	arg.buf = encode_buf;
+	arg.bufsz = sizeof(encode_buf);
+
+	foreach_bit_in_buffer_lsbfirst(buf, sizeof(buf) * 8,
+				       wisun_2fsk_rsc_input_bit, &arg);
+	assert(memcmp(encode_buf, expected, sizeof(expected)) == 0);
+
+	memset(encode_buf, 0, sizeof(encode_buf));
+	memset(&arg, 0, sizeof(arg));
+	arg.buf = encode_buf;
+	arg.bufsz = sizeof(encode_buf);
+
+	foreach_bit_in_buffer_lsbfirst(&buf[0], 8,
+				       wisun_2fsk_rsc_input_bit, &arg);
+	foreach_bit_in_buffer_lsbfirst(&buf[1], 8,
+				       wisun_2fsk_rsc_input_bit, &arg);
+	assert(memcmp(encode_buf, expected, sizeof(expected)) == 0);
+}
+
+static void test_nrnsc_input_bit(void)
+{
+	struct wisun_2fsk_fec_encoder arg = { .m = RSC_INIT_M };
+	uint8_t buf[2] = { 0x11, 0x22 }, encode_buf[sizeof(buf) * 2];
+	const uint8_t expected[sizeof(encode_buf)] = { 0x04, 0x04, 0x13, 0x10 };
+
+	memset(encode_buf, 0, sizeof(encode_buf));
+	memset(&arg, 0, sizeof(arg));
+	arg.buf = encode_buf;
+	arg.bufsz = sizeof(encode_buf);
+
+	foreach_bit_in_buffer_lsbfirst(buf, sizeof(buf) * 8,
+				       wisun_2fsk_nrnsc_input_bit, &arg);
+	assert(memcmp(encode_buf, expected, sizeof(expected)) == 0);
+
+	memset(encode_buf, 0, sizeof(encode_buf));
+	memset(&arg, 0, sizeof(arg));
+	arg.buf = encode_buf;
+	arg.bufsz = sizeof(encode_buf);
+
+	foreach_bit_in_buffer_lsbfirst(&buf[0], 8,
+				       wisun_2fsk_nrnsc_input_bit, &arg);
+	foreach_bit_in_buffer_lsbfirst(&buf[1], 8,
+				       wisun_2fsk_nrnsc_input_bit, &arg);
+	assert(memcmp(encode_buf, expected, sizeof(expected)) == 0);
+}
+
+/* build a coded frame with @psdu_sz bytes PSDU(crc included) */
+static size_t test_make_coded_frame(struct wisun_2fsk_frame *f,
+				    size_t psdu_sz, uint16_t phr_options,
+				    int use_rsc, int interleaving)
+{
+	enum wisun_2fsk_sfd_type type = use_rsc ? WISUN_2FSK_SFD_CODED0
+						: WISUN_2FSK_SFD_CODED1;
+	struct wisun_2fsk_fec_encoder arg = { 0 };
+	uint8_t data[2 + 256 + 2], pad[2];
+	size_t preamble_sz = 64, pad_sz;
+	uint16_t phr = wisun_2fsk_make_phr(phr_options, psdu_sz);
+	uint8_t *p_frame;
+	uint32_t c32;
+
+	assert(psdu_sz >= 4 && psdu_sz <= 256);
+
+	data[0] = (phr >> 0) & 0xff;
+	data[1] = (phr >> 8) & 0xff;
+	for (size_t i = 0; i < psdu_sz - 4; i++)
+		data[2 + i] = (uint8_t)(i * 37 + psdu_sz);
+
+	c32 = ieee_802154_fcs32(IEEE_802154_FCS32_INIT, &data[2], psdu_sz - 4);
+	for (size_t i = 0; i < 4; i++)
+		data[2 + psdu_sz - 4 + i] = (c32 >> (i * 8)) & 0xff;
+
+	wisun_2fsk_frame_init(f, preamble_sz, type);
+	memset(f->buf, 0xaa, preamble_sz / 8);
+	f->buf[preamble_sz / 8 + 0] = wisun_2fsk_sfd_value(type) & 0xff;
+	f->buf[preamble_sz / 8 + 1] = wisun_2fsk_sfd_value(type) >> 8;
+	p_frame = f->buf + preamble_sz / 8 + 2;
+
+	arg.m = use_rsc ? RSC_INIT_M : NRNSC_INIT_M;
+	arg.buf = p_frame;
+	arg.bufsz = sizeof(f->buf) - (p_frame - f->buf);
+	foreach_bit_in_buffer_lsbfirst(data, (2 + psdu_sz) * 8,
+				       use_rsc ? wisun_2fsk_rsc_input_bit
+					       : wisun_2fsk_nrnsc_input_bit,
+				       &arg);
+	pad_sz = wisun_2fsk_fec_padding(pad, psdu_sz, type, arg.m);
+	foreach_bit_in_buffer_lsbfirst(pad, pad_sz * 8,
+				       use_rsc ? wisun_2fsk_rsc_input_bit
+					       : wisun_2fsk_nrnsc_input_bit,
+				       &arg);
+
+	if (interleaving)
+		interleaving_bits(p_frame, arg.encode_bits, p_frame);
+	if (phr_options & WISUN_2FSK_PHR_DATA_WHITENING)
+		pn9_payload_decode(p_frame + 4, arg.encode_bits / 8 - 4);
+
+	return preamble_sz + 16 + arg.encode_bits;
+}
+
+/* decode the coded PHY payload block by block */
+static void test_decode_fused_blocks(struct wisun_2fsk_frame *f,
+				     uint8_t *p, int use_rsc, int interleaving)
+{
+	struct fec_block_decoder d;
+	size_t blocks;
+
+	fec_block_decoder_init(&d, use_rsc, interleaving);
+	assert(fec_block_decode(&d, p, 1, p) == 0);
+	f->phr = wisun_2fsk_fix_phr_order(buffer_peek_u16_b1b0(p));
+	f->phy_payload_sz = sizeof(f->phr) + (f->phr >> 5);
+	blocks = (f->phr >> 5)
+		 + (number_is_even(f->phy_payload_sz) ? 2 : 1);
+	blocks = blocks * 2 / 4;
+
+	wisun_2fsk_fused_setup_psdu(&d, f->phr);
+	for (size_t i = 0; i < blocks; i++)
+		assert(fec_block_decode(&d, p + 4 + i * 4, 1, p + 2 + i * 2) == 0);
+	assert(d.blocks == 1 + blocks);
+	wisun_2fsk_fused_save_fcs32(f, &d);
+}
+
+static void test_wisun_2fsk_frame_decode_fused(void)
+{
+	static struct wisun_2fsk_frame staged, fused;
+	const size_t psdu_sizes[] = { 5, 7, 8, 13, 256 };
+
+	for (int flags = 0; flags < 8; flags++) {
+		uint16_t phr_options = flags & 4 ? WISUN_2FSK_PHR_DATA_WHITENING : 0;
+		int use_rsc = flags & 1, interleaving = !!(flags & 2);
+
+		for (size_t i = 0; i < ARRAY_SIZE(psdu_sizes); i++) {
+			size_t bits, payload_sz = 2 + psdu_sizes[i];
+			uint8_t *p_staged, *p_fused;
+
+			bits = test_make_coded_frame(&staged, psdu_sizes[i],
+						     phr_options, use_rsc,
+						     interleaving);
+			memcpy(&fused, &staged, sizeof(staged));
+
+			assert(wisun_2fsk_frame_decode_staged(&staged, bits,
+					use_rsc, interleaving) == 0);
+			p_staged = staged.buf + staged.preamble_sz / 8 + 2;
+			p_fused = fused.buf + fused.preamble_sz / 8 + 2;
+			assert(wisun_2fsk_frame_decode_fused(&fused, p_fused,
+					bits / 8 - (p_fused - fused.buf),
+					use_rsc, interleaving) == 0);
+
+			assert(staged.phr == fused.phr);
+			assert(staged.phy_payload_sz == payload_sz);
+			assert(fused.phy_payload_sz == payload_sz);
+			assert(staged.input_bits == fused.input_bits);
+			assert(memcmp(p_staged, p_fused, payload_sz) == 0);
+			assert(fused.fcs32_ready == (psdu_sizes[i] >= 8));
+			assert(wisun_2fsk_frame_verify(&staged));
+			assert(wisun_2fsk_frame_verify(&fused));
+
+			/* the variants keep the state across the calls */
+			memcpy(&fused, &staged, sizeof(staged));
+			test_make_coded_frame(&fused, psdu_sizes[i],
+					      phr_options, use_rsc,
+					      interleaving);
+			test_decode_fused_blocks(&fused, p_fused, use_rsc,
+						 interleaving);
+			assert(memcmp(p_staged, p_fused, payload_sz) == 0);
+			assert(fused.fcs32_ready == (psdu_sizes[i] >= 8));
+			assert(wisun_2fsk_frame_verify(&fused));
+		}
+	}
+}
+
+static void test_wisun_2fsk_frame_encode_fused(void)
+{
+	static const enum wisun_2fsk_sfd_type types[] = {
+		WISUN_2FSK_SFD_CODED0,
+		WISUN_2FSK_SFD_CODED1,
+		WISUN_2FSK_SFD_UNCODED0,
+	};
+	static uint8_t staged_buf[4096], fused_buf[4096], data[2 + 1000 + 4];
+
+	for (size_t t = 0; t < ARRAY_SIZE(types); t++) {
+		for (int flags = 0; flags < 8; flags++) {
+			uint16_t phr_options = flags & 4 ?
+				WISUN_2FSK_PHR_DATA_WHITENING : 0;
+			int use_rsc = flags & 1, interleaving = !!(flags & 2);
+
+			for (size_t sz = 0; sz <= 1000; sz += sz < 40 ? 1 : 320) {
+				struct bufwrite staged, fused;
+
+				for (size_t i = 0; i < sz; i++)
+					data[2 + i] = (uint8_t)(i * 71 + sz);
+
+				bufwrite_init(&staged, staged_buf, sizeof(staged_buf));
+				bufwrite_init(&fused, fused_buf, sizeof(fused_buf));
+
+				assert(wisun_2fsk_frame_encode_fused(&fused,
+						&data[2], sz, types[t],
+						phr_options, use_rsc,
+						interleaving) == 0);
+				assert(wisun_2fsk_frame_encode_staged(&staged,
+						data, sz, types[t],
+						phr_options, use_rsc,
+						interleaving) == 0);
+
+				assert(staged.len == fused.len);
+				assert(!memcmp(staged_buf, fused_buf, fused.len));
+			}
+		}
+	}
+}
+
+static void test_fec_bitslice_encode(void)
+{
+	static uint8_t in[FEC_BITSLICE_LANES][37];
+	static uint8_t out[FEC_BITSLICE_LANES][74], expected[74];
+	const uint8_t *pin[FEC_BITSLICE_LANES];
+	uint8_t *pout[FEC_BITSLICE_LANES];
+	uint8_t m[FEC_BITSLICE_LANES];
+
+	for (size_t k = 0; k < FEC_BITSLICE_LANES; k++) {
+		for (size_t i = 0; i < sizeof(in[k]); i++)
+			in[k][i] = (uint8_t)(k * 131 + i * 17 + (k ^ i));
+		pin[k] = in[k];
+		pout[k] = out[k];
+	}
+
+	for (int use_rsc = 0; use_rsc < 2; use_rsc++) {
+		for (size_t lanes = 1; lanes <= FEC_BITSLICE_LANES; lanes += 21) {
+			for (size_t k = 0; k < lanes; k++)
+				m[k] = k & 0b111;
+
+			fec_bitslice_encode(use_rsc, m, pin, pout, lanes,
+					    sizeof(in[0]));
+
+			for (size_t k = 0; k < lanes; k++) {
+				uint8_t m_expected = k & 0b111;
+
+				fec_encode_bytes(use_rsc, &m_expected, in[k],
+						 sizeof(in[k]), expected);
+				assert(m[k] == m_expected);
+				assert(!memcmp(out[k], expected, sizeof(expected)));
+			}
+		}
+	}
+}
+
+/* the state of a failed decoder is the same as decoding the good blocks
+ * before the bad one.
+ */
+static void test_fec_block_decode_error(void)
+{
+	uint8_t in[20], coded[sizeof(in) * 2], out[sizeof(in)];
+	int failed = 0;
+
+	for (size_t i = 0; i < sizeof(in); i++)
+		in[i] = i * 29 + 5;
+
+	for (int use_rsc = 0; use_rsc < 2; use_rsc++) {
+		struct fec_block_encoder e;
+
+		fec_block_encoder_init(&e, 1, use_rsc, 0, coded);
+		fec_block_encode(&e, in, sizeof(in));
+
+		for (size_t bit = 6 * 32; bit < 7 * 32; bit++) {
+			struct fec_block_decoder d, good;
+
+			coded[bit / 8] ^= 1 << (bit % 8);
+			fec_block_decoder_init(&d, use_rsc, 0);
+			d.crc_bytes = sizeof(in);
+			good = d;
+			if (fec_block_decode(&d, coded, sizeof(coded) / 4,
+					     out) < 0) {
+				assert(fec_block_decode(&good, coded, d.blocks,
+							out) == 0);
+				assert(d.blocks == good.blocks);
+				assert(d.crc == good.crc);
+				assert(d.crc_bytes == good.crc_bytes);
+				failed++;
+			}
+			coded[bit / 8] ^= 1 << (bit % 8);
+		}
+	}
+
+	assert(failed > 0);
+}
+
+static void test_ieee_802154_fcs32_delta(void)
+{
+	uint8_t buf[300], delta[8];
+
+	for (size_t i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7 + 3;
+
+	for (size_t len = 1; len < sizeof(buf); len += 37) {
+		for (size_t off = 0; off < len; off += 5) {
+			size_t n = len - off < sizeof(delta) ? len - off
+							     : sizeof(delta);
+			size_t tail = (len < 4 ? 4 : len) - off - n;
+			uint32_t fcs = ieee_802154_fcs32(IEEE_802154_FCS32_INIT,
+							 buf, len);
+
+			for (size_t i = 0; i < n; i++) {
+				delta[i] = (off + i) * 13 + 1;
+				buf[off + i] ^= delta[i];
 			}
+
+			fcs ^= ieee_802154_fcs32_delta(delta, n, tail);
+			assert(fcs == ieee_802154_fcs32(IEEE_802154_FCS32_INIT,
+							buf, len));
 		}
+	}
+}
 
-		p_whitening = p_frame + sizeof(phr) * 2;
-		whitening_sz = encoder.encode_bits / 8 - sizeof(phr) * 2;
-		break;
-	default:
-		p_frame = bufwrite_push_data(&b, data, data_idx);
+static void test_ieee_802154_mhr_parse(void)
+{
+	/* version 2 data, short addresses and PAN ID compression */
+	static const uint8_t data[] = {
+		0x41, 0xa8, 0x01, 0xcd, 0xab, 0x34, 0x12, 0x78, 0x56,
+	};
+	/* version 2 ack, no address, security with suppressed counter */
+	static const uint8_t ack[] = {
+		0x0a, 0x22, 0x2d, 0x25,
+	};
+	/* version 0 beacon from a short address */
+	static const uint8_t beacon[] = {
+		0x00, 0x80, 0x03, 0x34, 0x12, 0x01, 0x00,
+	};
+	struct ieee_802154_mhr mhr;
+
+	assert(ieee_802154_mhr_parse(data, sizeof(data), &mhr) == 0);
+	assert(mhr.frame_type == IEEE_802154_FRAME_DATA && mhr.seq == 1);
+	assert(mhr.dst_pan == 0xabcd && mhr.src_pan == 0xabcd);
+	assert(mhr.dst_addr == 0x1234 && mhr.src_addr == 0x5678);
+	assert(mhr.len == sizeof(data));
+	assert(ieee_802154_mhr_parse(data, sizeof(data) - 1, &mhr) < 0);
+
+	assert(ieee_802154_mhr_parse(ack, sizeof(ack), &mhr) == 0);
+	assert(mhr.frame_type == IEEE_802154_FRAME_ACK && mhr.security);
+	assert(mhr.ie_present && mhr.dst_pan == IEEE_802154_PAN_NONE);
+	assert(mhr.len == sizeof(ack));
+
+	assert(ieee_802154_mhr_parse(beacon, sizeof(beacon), &mhr) == 0);
+	assert(mhr.frame_type == IEEE_802154_FRAME_BEACON);
+	assert(mhr.dst_mode == IEEE_802154_ADDR_NONE);
+	assert(mhr.src_pan == 0x1234 && mhr.src_addr == 0x0001);
+}
 
-		p_whitening = p_frame + sizeof(phr);
-		whitening_sz = data_idx - sizeof(phr);
-		break;
+static void test_wisun_fsk_isa_kernels(void)
+{
+	for (int isa = 0; isa < WISUN_FSK_ISA_MAX; isa++) {
+		if (!wisun_fsk_isa_supported(isa))
+			continue;
+
+		for (int k = 0; k < WISUN_FSK_KERNEL_MAX; k++)
+			assert(wisun_fsk_isa_verify(isa, k, 64, isa) == 0);
 	}
+}
 
-	if (phr_options & WISUN_2FSK_PHR_DATA_WHITENING) {
-		pn9_payload_decode(p_whitening, whitening_sz);
+/* @count segments of the power @p */
+static size_t test_burst_detector_feed(struct burst_detector *b, float p,
+				       size_t count)
+{
+	float re[BURST_DETECT_SEGMENT], im[BURST_DETECT_SEGMENT] = { 0 };
+	size_t active = 0;
 
-		if (option_verbose > 0) {
-			printf("After Whitening:\n");
-			print_binary_bits_lsbfirst(p_frame, 0,
-						   encoder.encode_bits - 1,
-						   group_sz);
-			putchar('\n');
+	for (size_t i = 0; i < BURST_DETECT_SEGMENT; i++)
+		re[i] = sqrtf(p);
+
+	for (size_t i = 0; i < count; i++)
+		active += burst_detector_process(b, re, im, ARRAY_SIZE(re));
+
+	return active / BURST_DETECT_SEGMENT;
+}
+
+static void test_burst_detector(void)
+{
+	struct burst_detector b;
+
+	assert(burst_detector_init(&b, 10.0f, 8) == 0);
+
+	/* the floor is the noise once the window is filled */
+	assert(test_burst_detector_feed(&b, 1.0f, 8) == 7);
+	assert(fabs(b.floor - 1.0) < 1e-3 && !b.active);
+	assert(test_burst_detector_feed(&b, 1.0f, 100) == 0);
+
+	/* a long burst, the floor doesn't rise in it */
+	assert(test_burst_detector_feed(&b, 100.0f, 20000) >= 20000 - 8);
+	assert(fabs(b.floor - 1.0) < 0.02);
+	test_burst_detector_feed(&b, 1.0f, 8);
+	assert(!b.active);
+
+	burst_detector_exit(&b);
+}
+
+/* two preambles of different offsets in one block, the estimate of each one
+ * is kept for its frame.
+ */
+static void test_cfo_estimator_history(void)
+{
+	/* symbols: 0011 data, 0101 preamble, data, preamble, data */
+	static const size_t sections[] = { 32, 64, 64, 64, 32 };
+	const double a = 0.5, c[2] = { 0.05, -0.08 };
+	const size_t sps = 8;
+	size_t n = 0, sym = 0, ends[2];
+	struct cfo_estimator e;
+	float *x = malloc(256 * sps * sizeof(*x));
+
+	assert(x && cfo_estimator_init(&e, sps) == 0);
+
+	for (size_t k = 0; k < ARRAY_SIZE(sections); k++) {
+		double offset = c[k < 2 ? 0 : 1];
+
+		for (size_t i = 0; i < sections[k]; i++, sym++) {
+			int one = (k % 2) ? sym & 1 : (sym >> 1) & 1;
+
+			for (size_t j = 0; j < sps; j++)
+				x[n++] = sin((one ? a : -a) + offset);
 		}
+
+		if (k % 2)
+			ends[k / 2] = n - 1;
 	}
 
-	if (option_verbose > 0)
-		printf("SHR, PHR, PSDU\n");
+	cfo_estimator_process(&e, x, n, x);
+	assert(e.preambles == 2);
+	assert(fabs(cfo_estimator_offset_at(&e, ends[0]) - c[0]) < 1e-3);
+	assert(fabs(cfo_estimator_offset_at(&e, ends[1]) - c[1]) < 1e-3);
+	assert(fabs(cfo_estimator_offset(&e) - c[1]) < 1e-3);
+	assert(cfo_estimator_offset_at(&e, 0) == 0.0);
 
-	if (option_hexo)
-		print_hex_bytes(b.buf, b.len);
-	else
-		print_binary_bits_lsbfirst(b.buf, 0, b.len * 8 - 1, group_sz);
-	putchar('\n');
+	cfo_estimator_exit(&e);
+	free(x);
+}
 
-	return 0;
+/* the outputs of 3/2 are saved only if all of them fit in the buffer */
+static void test_rational_resampler_output(void)
+{
+	float re[7] = { 0 }, im[7] = { 0 }, out_re[16], out_im[16];
+	struct rational_resampler r;
+	size_t total = 0;
+
+	assert(rational_resampler_init(&r, 3, 2, 8) == 0);
+
+	for (int i = 0; i < 6; i++) {
+		/* 10 or 11 outputs of 7 inputs by the phase */
+		ssize_t n = rational_resampler_process(&r, re, im, 7, out_re,
+						       out_im, 10);
+
+		if (n < 0)
+			n = rational_resampler_process(&r, re, im, 7, out_re,
+						       out_im, 11);
+		assert(n == 10 || n == 11);
+		total += n;
+	}
+
+	/* nothing is lost by the refused calls */
+	assert(total == 6 * 7 * 3 / 2);
+	rational_resampler_exit(&r);
 }
 
-enum {
-	OPTION_PACKET,
-	OPTION_PN9,
-	OPTION_RSC,
-	OPTION_NRNSC,
-	OPTION_INTERLEAVING,
-	OPTION_HELP,
-	OPTION_VERBOSE,
-	OPTION_VERSION,
-	OPTION_DECODE,
-	OPTION_ENCODE,
-	OPTION_HEXI,
-	OPTION_HEXO,
-	OPTION_HUMAN,
-	OPTION_SKIP_VERIFY,
-	OPTION_SFD,
-	OPTION_PREAMBLE_SIZE,
-	OPTION_WHITENING,
+static void self_test(void)
+{
+	test_ieee_802154_fcs32_delta();
+	test_ieee_802154_mhr_parse();
+	test_str01_strstr();
+	test_wisun_2fsk_str01_find_shr();
+	test_rsc_input_bit();
+	test_nrnsc_input_bit();
+	test_wisun_2fsk_frame_decode_fused();
+	test_wisun_2fsk_frame_encode_fused();
+	test_fec_bitslice_encode();
+	test_fec_block_decode_error();
+	test_wisun_fsk_isa_kernels();
+	test_burst_detector();
+	test_cfo_estimator_history();
+	test_rational_resampler_output();
+}
+#endif
+
+static const char *wisun_2fsk_sfd_type_names[] = {
+	[WISUN_2FSK_SFD_CODED0] = "coded0",
+	[WISUN_2FSK_SFD_CODED1] = "coded1",
+	[WISUN_2FSK_SFD_UNCODED0] = "uncoded0",
+	[WISUN_2FSK_SFD_UNCODED1] = "uncoded1",
 };
 
-static struct option long_options[] = {
-	/* name			has_arg,		*flag,		val */
-	{ "packet",		no_argument,		NULL,		OPTION_PACKET	},
-	{ "pn9",		no_argument,		NULL,		OPTION_PN9	},
-	{ "rsc",		no_argument,		NULL,		OPTION_RSC	},
-	{ "nrnsc",		no_argument,		NULL,		OPTION_NRNSC	},
-	{ "interleaving",	no_argument,		NULL,		OPTION_INTERLEAVING	},
-	{ "help",		no_argument,		NULL,		OPTION_HELP	},
-	{ "verbose",		no_argument,		NULL,		OPTION_VERBOSE	},
-	{ "version",		no_argument,		NULL,		OPTION_VERSION	},
-	{ "decode",		no_argument,		NULL,		OPTION_DECODE	},
-	{ "encode",		no_argument,		NULL,		OPTION_ENCODE	},
-	{ "hexi",		no_argument,		NULL,		OPTION_HEXI	},
-	{ "hexo",		no_argument,		NULL,		OPTION_HEXO	},
-	{ "human",		no_argument,		NULL,		OPTION_HUMAN	},
-	{ "skip-verify",	no_argument,		NULL,		OPTION_SKIP_VERIFY	},
-	{ "sfd",		required_argument,	NULL,		OPTION_SFD	},
-	{ "preamble-size",	required_argument,	NULL,		OPTION_PREAMBLE_SIZE	},
-	{ "whitening",		no_argument,		NULL,		OPTION_WHITENING	},
-	{ NULL,			0,			NULL,		0   },
+/* The channel simulator. Each frame is generated from its own seed which
+ * depends on the seed, the point and the frame index only, so the results
+ * are the same whatever the threads are.
+ */
+#define WISUN_2FSK_SIM_MAX_POINTS	64
+
+struct wisun_2fsk_sim;
+
+struct wisun_2fsk_sim_worker {
+	struct wisun_2fsk_sim		*sim;
+	int				id;
+	pthread_t			thread;
+
+	struct wisun_2fsk_frame		frame;
+	uint64_t			errors;		/* packet errors */
+	uint64_t			undetected;	/* bad PSDU, good FCS */
+	uint64_t			bit_errors, bits;
+	uint64_t			channel_bits;
+	uint64_t			decode_ns;
 };
 
-static void print_usage(void)
+struct wisun_2fsk_sim {
+	const struct wisun_2fsk_sim_options	*opt;
+	size_t				preamble_sz;
+	enum wisun_2fsk_sfd_type	type;
+	uint16_t			phr_options;
+	int				use_rsc, interleaving;
+	double				point;
+	int				point_idx;
+	int				nworkers;
+};
+
+static uint64_t sim_splitmix64(uint64_t x)
 {
-	fprintf(stderr, "Usage: urh_wisun_fsk [OPTIONS] \"binary-strings\"\n");
-	fprintf(stderr, "-h --help:              show this message\n");
-	fprintf(stderr, "-V --version:           show plugin version\n");
-	fprintf(stderr, "-v --verbose:           verbose mode\n");
-	fprintf(stderr, "-d --decode:            decode a wisun 2-fsk packet\n");
-	fprintf(stderr, "-e --encode:            encode a wisun 2-fsk packet\n");
-	fprintf(stderr, "   --hexo:              print the encode/decode result in hex mode\n");
-	fprintf(stderr, "   --human:             print the output string in human format\n");
-	fprintf(stderr, "\n");
-	fprintf(stderr, "Available algo for encode/decode:\n");
-	fprintf(stderr, "   --packet:            encode/decode the binary string as a full packet.\n");
-	fprintf(stderr, "                        (the default algo)\n");
-	fprintf(stderr, "   --pn9:               encode/decode binary strings by PN9\n");
-	fprintf(stderr, "   --nrnsc:             encode binary strings by NRNSC encoder\n");
-	fprintf(stderr, "   --rsc                encode binary string by RSC encoder\n");
-	fprintf(stderr, "   --interleaving:      interleaving the input binary blocks\n");
-	fprintf(stderr, "\n");
-	fprintf(stderr, "Options for decode packet(--packet):\n");
-	fprintf(stderr, "   --skip-verify:       do not verify 802.15.4 packet\n");
-	fprintf(stderr, "Options for encode packet(--packet):\n");
-	fprintf(stderr, "   --hexi:              the input string is hex mode, not binary 01 string\n");
-	fprintf(stderr, "   --preamble-size:     the preamble bit length\n");
-	fprintf(stderr, "   --sfd type:          select the sfd type:\n");
-	fprintf(stderr, "                          coded0:   %04x\n", wisun_2fsk_sfd_value(WISUN_2FSK_SFD_CODED0));
-	fprintf(stderr, "                          uncoded0: %04x\n", wisun_2fsk_sfd_value(WISUN_2FSK_SFD_UNCODED0));
-	fprintf(stderr, "                          coded1:   %04x\n", wisun_2fsk_sfd_value(WISUN_2FSK_SFD_CODED1));
-	fprintf(stderr, "                          uncoded1: %04x\n", wisun_2fsk_sfd_value(WISUN_2FSK_SFD_UNCODED1));
-	fprintf(stderr, "   --whitening:         whitening phy payload data\n");
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
 }
 
-enum {
-	ALGO_PACKET,
-	ALGO_PN9,
-	ALGO_NRNSC,
-	ALGO_RSC,
-	ALGO_INTERLEAVING,
-};
+/* xorshift64* */
+static uint64_t sim_rand(uint64_t *s)
+{
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+	return *s * 0x2545f4914f6cdd1dULL;
+}
 
-#if DEBUG > 0
-static void test_str01_strstr(void)
+/* uniform in (0, 1) */
+static double sim_rand_uniform(uint64_t *s)
 {
-	const char *base = "0-0-1-0-1-0-1";
-	const char *s;
+	return ((sim_rand(s) >> 11) + 0.5) / 9007199254740992.0;
+}
 
-	assert(str01_strstr("0-0-1-0-1", "0101") != NULL);
+static double sim_rand_gaussian(uint64_t *s)
+{
+	double u = sim_rand_uniform(s), v = sim_rand_uniform(s);
 
-	s = str01_strstr(base, "0101");
-	assert(s != NULL);
-	assert(s - base == 2);
-	assert(str01_strncmp(s, "0101", 4) == 0);
-	assert(str01_strncmp(s, "0-1-0-1", 4) == 0);
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+/* the distance to the next event of rate @p */
+static size_t sim_rand_geometric(uint64_t *s, double p)
+{
+	double n;
+
+	if (p <= 0.0)
+		return SIZE_MAX;
+	if (p >= 1.0)
+		return 0;
+
+	n = floor(log(sim_rand_uniform(s)) / log1p(-p));
+	return n >= (double)SIZE_MAX ? SIZE_MAX : (size_t)n;
+}
+
+/* write the @nbits(lsb first) of @buf after the channel to @str01 */
+static void wisun_2fsk_sim_channel(const struct wisun_2fsk_sim *sim,
+				   uint64_t *rng, const uint8_t *buf,
+				   size_t nbits, char *str01)
+{
+	const struct wisun_2fsk_sim_options *opt = sim->opt;
+
+	for (size_t i = 0; i < nbits; i++)
+		str01[i] = '0' + ((buf[i / 8] >> (i % 8)) & 1);
+	str01[nbits] = '\0';
+
+	switch (opt->channel) {
+	case WISUN_2FSK_SIM_AWGN:
+		{
+			int coded = sim->type == WISUN_2FSK_SFD_CODED0
+				 || sim->type == WISUN_2FSK_SFD_CODED1;
+			double rate = coded ? 0.5 : 1.0;
+			double sigma = sqrt(1.0 / (2.0 * rate
+						* pow(10.0, sim->point / 10.0)));
+
+			/* the soft value is +-1 and the decoder slices it */
+			for (size_t i = 0; i < nbits; i++) {
+				double soft = (str01[i] == '1' ? 1.0 : -1.0)
+					+ sigma * sim_rand_gaussian(rng);
+
+				str01[i] = soft > 0 ? '1' : '0';
+			}
+		}
+		break;
+	case WISUN_2FSK_SIM_FLIP:
+	case WISUN_2FSK_SIM_BURST:
+		for (size_t i = sim_rand_geometric(rng, sim->point); i < nbits; ) {
+			if (opt->channel == WISUN_2FSK_SIM_FLIP) {
+				str01[i] ^= 1;
+				i++;
+			} else {
+				/* the bits in the burst are random */
+				for (size_t j = 0; j < opt->burst_len && i < nbits;
+				     j++, i++)
+					str01[i] ^= sim_rand(rng) >> 63;
+			}
+
+			if (i < nbits) {
+				size_t n = sim_rand_geometric(rng, sim->point);
+
+				i = n > nbits - i ? nbits : i + n;
+			}
+		}
+		break;
+	}
+}
+
+static uint64_t sim_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *wisun_2fsk_sim_worker_thread(void *arg)
+{
+	struct wisun_2fsk_sim_worker *w = arg;
+	const struct wisun_2fsk_sim *sim = w->sim;
+	size_t len = sim->opt->length;
+	size_t buf_sz = sim->preamble_sz / 8 + 2 + (2 + len + 4 + 2) * 2;
+	uint8_t *psdu = malloc(len), *buf = malloc(buf_sz);
+	char *str01 = malloc(buf_sz * 8 + 1);
+	/* each bad frame reports an error, keep them for --verbose */
+	int quiet = option_verbose == 0;
+
+	if (!psdu || !buf || !str01) {
+		w->errors = UINT64_MAX;
+		goto done;
+	}
+
+	for (size_t k = w->id; k < sim->opt->frames; k += sim->nworkers) {
+		struct wisun_2fsk_frame *f = &w->frame;
+		uint64_t rng, t;
+		size_t bit_errors = 0;
+		struct bufwrite b;
+		bool good;
+		int idx;
+
+		rng = sim_splitmix64(sim->opt->seed);
+		rng = sim_splitmix64(rng ^ sim->point_idx);
+		rng = sim_splitmix64(rng ^ k) | 1;
+
+		for (size_t i = 0; i < len; i++)
+			psdu[i] = sim_rand(&rng) >> 56;
+
+		bufwrite_init(&b, buf, buf_sz);
+		wisun_2fsk_push_shr(&b, sim->preamble_sz, sim->type);
+		if (wisun_2fsk_frame_encode_fused(&b, psdu, len, sim->type,
+						  sim->phr_options,
+						  sim->use_rsc,
+						  sim->interleaving) < 0) {
+			w->errors = UINT64_MAX;
+			break;
+		}
+
+		wisun_2fsk_sim_channel(sim, &rng, b.buf, b.len * 8, str01);
+		w->channel_bits += b.len * 8;
+
+		/* --auto picks the hypothesis by the FCS as the packet decode,
+		 * the BER of the frames failed all of them is counted by the
+		 * best ranked one.
+		 */
+		t = sim_now_ns();
+		idx = wisun_2fsk_str01_decode_frame(str01, f, sim->use_rsc,
+						    sim->interleaving,
+						    !option_auto, quiet, NULL);
+		good = idx >= 0 && (option_auto || wisun_2fsk_frame_check(f));
+		if (idx < 0 && option_auto)
+			idx = wisun_2fsk_str01_decode_frame(str01, f,
+							    sim->use_rsc,
+							    sim->interleaving,
+							    1, quiet, NULL);
+		w->decode_ns += sim_now_ns() - t;
+
+		/* the lost frames are not counted in BER */
+		if (idx >= 0 && f->phy_payload_sz == 2 + len + 4) {
+			const uint8_t *p = f->buf + f->preamble_sz / 8 + 2 + 2;
+
+			for (size_t i = 0; i < len; i++)
+				bit_errors += __builtin_popcount(p[i] ^ psdu[i]);
+			w->bit_errors += bit_errors;
+			w->bits += len * 8;
+		} else {
+			good = false;
+		}
+
+		if (good && bit_errors)
+			w->undetected++;
+		if (!good || bit_errors)
+			w->errors++;
+	}
+
+done:
+	free(psdu);
+	free(buf);
+	free(str01);
+	return NULL;
+}
+
+static int wisun_2fsk_sim_parse_points(const char *arg, double *points)
+{
+	double start, stop, step;
+	int n = 0;
+
+	if (sscanf(arg, "%lf:%lf:%lf", &start, &stop, &step) == 3) {
+		if (step <= 0.0 || stop < start)
+			goto bad;
+
+		for (double x = start; x <= stop + step * 1e-6
+		     && n < WISUN_2FSK_SIM_MAX_POINTS; x += step)
+			points[n++] = x;
+		return n;
+	}
+
+	while (*arg != '\0' && n < WISUN_2FSK_SIM_MAX_POINTS) {
+		char *endp;
+
+		points[n++] = strtod(arg, &endp);
+		if (endp == arg || (*endp != ',' && *endp != '\0'))
+			goto bad;
+		arg = *endp == ',' ? endp + 1 : endp;
+	}
+
+	if (n > 0)
+		return n;
+bad:
+	fprintf(stderr, "Invalid points: %s\n", arg);
+	return -1;
+}
+
+/* print the packet error rate, the BER after decoding and the decoder
+ * throughput of each point, one line each.
+ */
+static int wisun_2fsk_simulate(const struct wisun_2fsk_sim_options *opt,
+			       int threads, size_t preamble_sz,
+			       enum wisun_2fsk_sfd_type type,
+			       uint16_t phr_options,
+			       int use_rsc, int interleaving)
+{
+	static const char *const defaults[] = {
+		[WISUN_2FSK_SIM_AWGN]	= "0:10:1",
+		[WISUN_2FSK_SIM_FLIP]	= "0.0001,0.001,0.003,0.01,0.03",
+		[WISUN_2FSK_SIM_BURST]	= "0.00001,0.0001,0.001",
+	};
+	static const char *const names[] = {
+		[WISUN_2FSK_SIM_AWGN]	= "EbN0(dB)",
+		[WISUN_2FSK_SIM_FLIP]	= "BER",
+		[WISUN_2FSK_SIM_BURST]	= "bursts",
+	};
+	struct wisun_2fsk_sim sim = {
+		.opt = opt,
+		.preamble_sz = preamble_sz,
+		.type = type,
+		.phr_options = phr_options,
+		.use_rsc = use_rsc,
+		.interleaving = interleaving,
+	};
+	double points[WISUN_2FSK_SIM_MAX_POINTS];
+	struct wisun_2fsk_sim_worker *workers;
+	int npoints, ret = 0;
+
+	npoints = wisun_2fsk_sim_parse_points(opt->points ? opt->points
+						: defaults[opt->channel],
+					      points);
+	if (npoints < 0)
+		return -1;
+
+	if (opt->length < 1 || opt->length + 4 > 2047) {
+		fprintf(stderr, "Invalid PSDU length %zu\n", opt->length);
+		return -1;
+	}
+
+	sim.nworkers = threads > 0 ? threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (sim.nworkers < 1)
+		sim.nworkers = 1;
+
+	workers = calloc(sim.nworkers, sizeof(*workers));
+	if (!workers)
+		return -1;
+
+	/* the lazy inited tables are shared by all decode threads */
+	wisun_fsk_common_init();
+
+	printf("%10s %8s %10s %10s %10s %10s %10s\n", names[opt->channel],
+	       "frames", "PER", "BER", "undetected", "frames/s",
+	       "Mbps/core");
+
+	for (int p = 0; p < npoints && ret == 0; p++) {
+		uint64_t errors = 0, undetected = 0, bit_errors = 0, bits = 0;
+		uint64_t channel_bits = 0, decode_ns = 0, t;
+		int started = 0;
+
+		sim.point = points[p];
+		sim.point_idx = p;
+
+		t = sim_now_ns();
+		for (int i = 0; i < sim.nworkers; i++) {
+			memset(&workers[i], 0, sizeof(workers[i]));
+			workers[i].sim = &sim;
+			workers[i].id = i;
+			if (pthread_create(&workers[i].thread, NULL,
+					   wisun_2fsk_sim_worker_thread,
+					   &workers[i]))
+				break;
+			started++;
+		}
+
+		for (int i = 0; i < started; i++) {
+			struct wisun_2fsk_sim_worker *w = &workers[i];
+
+			pthread_join(w->thread, NULL);
+			if (w->errors == UINT64_MAX)
+				ret = -1;
+			errors += w->errors;
+			undetected += w->undetected;
+			bit_errors += w->bit_errors;
+			bits += w->bits;
+			channel_bits += w->channel_bits;
+			decode_ns += w->decode_ns;
+		}
+		t = sim_now_ns() - t;
+
+		if (started != sim.nworkers || ret < 0) {
+			ret = -1;
+			break;
+		}
+
+		printf("%10g %8zu %10.3e ", points[p], opt->frames,
+		       (double)errors / opt->frames);
+		if (bits)
+			printf("%10.3e ", (double)bit_errors / bits);
+		else
+			printf("%10s ", "-");
+		printf("%10" PRIu64 " %10.0f %10.2f\n", undetected,
+		       opt->frames * 1e9 / (t ? t : 1),
+		       channel_bits * 1e3 / (decode_ns ? decode_ns : 1));
+		fflush(stdout);
+	}
+
+	if (ret < 0)
+		fprintf(stderr, "simulate failed\n");
+
+	free(workers);
+	return ret;
+}
+
+static int wisun_2fsk_pcap_output_open(struct wisun_2fsk_pcap_output *out)
+{
+	struct timespec ts;
+
+	out->w = malloc(sizeof(*out->w));
+	if (!out->w)
+		return -1;
+
+	if (wisun_fsk_pcap_writer_open(out->w, out->filename,
+				       out->linktype) < 0) {
+		free(out->w);
+		out->w = NULL;
+		return -1;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	out->start_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return 0;
 }
 
-static void test_wisun_2fsk_str01_find_shr(void)
+static int wisun_2fsk_pcap_output_close(struct wisun_2fsk_pcap_output *out)
 {
-	const char *base;
-	enum wisun_2fsk_sfd_type type;
-	size_t preamble_sz;
-	int idx;
+	int ret;
 
-	type = WISUN_2FSK_SFD_MAX;
-	base = "01010101010101010101010101010101" "1001000001001110";
-	idx = wisun_2fsk_str01_find_shr(base, &preamble_sz, &type);
-	assert(idx == 0);
-	assert(preamble_sz == 32);
-	assert(type == WISUN_2FSK_SFD_UNCODED0);
+	if (!out->w)
+		return 0;
 
-	type = WISUN_2FSK_SFD_MAX;
-	base = "0101-0101-0101-0101-0101-0101-0101-0101" "-:-:-"
-	       "1001-0000-0100-1110";
-	idx = wisun_2fsk_str01_find_shr(base, &preamble_sz, &type);
-	assert(idx == 0);
-	assert(preamble_sz == 32);
-	assert(type == WISUN_2FSK_SFD_UNCODED0);
+	ret = wisun_fsk_pcap_writer_close(out->w);
+	free(out->w);
+	out->w = NULL;
+	return ret;
 }
 
-static void test_rsc_input_bit(void)
-{
-	struct wisun_2fsk_fec_encoder arg = { .m = RSC_INIT_M };
-	uint8_t buf[2] = { 0x11, 0x22 }, encode_buf[sizeof(buf) * 2];
-	const uint8_t expected[sizeof(encode_buf)] = { 0x17, 0x03, 0x5c, 0x0c };
+/* Wireshark extcap, see doc/extcap.adoc of wireshark. The capture is a
+ * --stream decode of the --input file, the frames are written to the fifo
+ * of wireshark as pcap with TAP header.
+ */
+#define WISUN_2FSK_EXTCAP_INTERFACE	"wisun2fsk"
 
-	memset(encode_buf, 0, sizeof(encode_buf));
-	memset(&arg, 0, sizeof(arg));
-	arg.buf = encode_buf;
-	arg.bufsz = sizeof(encode_buf);
+struct wisun_2fsk_extcap {
+	int		request;	/* OPTION_EXTCAP_* or OPTION_CAPTURE */
+	const char	*interface;
+	const char	*fifo;
+	const char	*input;
+};
 
-	foreach_bit_in_buffer_lsbfirst(buf, sizeof(buf) * 8,
-				       wisun_2fsk_rsc_input_bit, &arg);
-	assert(memcmp(encode_buf, expected, sizeof(expected)) == 0);
+static int wisun_2fsk_extcap_query(const struct wisun_2fsk_extcap *extcap)
+{
+	if (extcap->request == OPTION_EXTCAP_INTERFACES) {
+		printf("extcap {version=%s}\n", URH_WIRUN_FSK_PLUGIN_VERSION);
+		printf("interface {value=%s}{display=Wi-SUN 2-FSK decoder}\n",
+		       WISUN_2FSK_EXTCAP_INTERFACE);
+		return 0;
+	}
 
-	memset(encode_buf, 0, sizeof(encode_buf));
-	memset(&arg, 0, sizeof(arg));
-	arg.buf = encode_buf;
-	arg.bufsz = sizeof(encode_buf);
+	if (!extcap->interface
+	    || strcmp(extcap->interface, WISUN_2FSK_EXTCAP_INTERFACE)) {
+		fprintf(stderr, "extcap: unknown interface\n");
+		return -1;
+	}
 
-	foreach_bit_in_buffer_lsbfirst(&buf[0], 8,
-				       wisun_2fsk_rsc_input_bit, &arg);
-	foreach_bit_in_buffer_lsbfirst(&buf[1], 8,
-				       wisun_2fsk_rsc_input_bit, &arg);
-	assert(memcmp(encode_buf, expected, sizeof(expected)) == 0);
+	if (extcap->request == OPTION_EXTCAP_DLTS) {
+		printf("dlt {number=%d}{name=IEEE802_15_4_TAP}"
+		       "{display=IEEE 802.15.4 with TAP header}\n",
+		       LINKTYPE_IEEE802_15_4_TAP);
+		return 0;
+	}
+
+	printf("arg {number=0}{call=--input}{display=01 bits stream}"
+	       "{type=fileselect}{mustexist=true}{required=true}"
+	       "{tooltip=a fifo written by the demodulator}\n");
+	printf("arg {number=1}{call=--auto}{display=Detect FEC}"
+	       "{type=boolflag}{default=true}\n");
+	printf("arg {number=2}{call=--rsc}{display=RSC}{type=boolflag}\n");
+	printf("arg {number=3}{call=--interleaving}{display=Interleaving}"
+	       "{type=boolflag}\n");
+	printf("arg {number=4}{call=--filter}{display=MAC filter}"
+	       "{type=string}{tooltip=type=data,pan=abcd,dst=ffff}\n");
+	printf("arg {number=5}{call=--symbol-rate}{display=Symbol rate}"
+	       "{type=double}{default=50000}\n");
+	return 0;
 }
 
-static void test_nrnsc_input_bit(void)
+/* the differential test of the SIMD kernels, @isa is -1 for all of them */
+static int wisun_fsk_isa_verify_all(int isa, unsigned long rounds)
 {
-	struct wisun_2fsk_fec_encoder arg = { .m = RSC_INIT_M };
-	uint8_t buf[2] = { 0x11, 0x22 }, encode_buf[sizeof(buf) * 2];
-	const uint8_t expected[sizeof(encode_buf)] = { 0x04, 0x04, 0x13, 0x10 };
+	int ret = 0;
 
-	memset(encode_buf, 0, sizeof(encode_buf));
-	memset(&arg, 0, sizeof(arg));
-	arg.buf = encode_buf;
-	arg.bufsz = sizeof(encode_buf);
+	printf("%-8s %-14s %10s %10s\n", "isa", "kernel", "rounds",
+	       "mismatches");
 
-	foreach_bit_in_buffer_lsbfirst(buf, sizeof(buf) * 8,
-				       wisun_2fsk_nrnsc_input_bit, &arg);
-	assert(memcmp(encode_buf, expected, sizeof(expected)) == 0);
+	for (int i = WISUN_FSK_ISA_SCALAR + 1; i < WISUN_FSK_ISA_MAX; i++) {
+		if (isa >= 0 && i != isa)
+			continue;
 
-	memset(encode_buf, 0, sizeof(encode_buf));
-	memset(&arg, 0, sizeof(arg));
-	arg.buf = encode_buf;
-	arg.bufsz = sizeof(encode_buf);
+		if (!wisun_fsk_isa_supported(i)) {
+			printf("%-8s %-14s\n", wisun_fsk_isa_name(i),
+			       "unsupported");
+			continue;
+		}
 
-	foreach_bit_in_buffer_lsbfirst(&buf[0], 8,
-				       wisun_2fsk_nrnsc_input_bit, &arg);
-	foreach_bit_in_buffer_lsbfirst(&buf[1], 8,
-				       wisun_2fsk_nrnsc_input_bit, &arg);
-	assert(memcmp(encode_buf, expected, sizeof(expected)) == 0);
+		for (int k = 0; k < WISUN_FSK_KERNEL_MAX; k++) {
+			unsigned long n = wisun_fsk_isa_verify(i, k, rounds,
+							       1 + k);
+
+			printf("%-8s %-14s %10lu %10lu\n", wisun_fsk_isa_name(i),
+			       wisun_fsk_kernel_name(k), rounds, n);
+			if (n > 0)
+				ret = -1;
+		}
+	}
+
+	return ret;
 }
 
-static void self_test(void)
+static int parse_double(const char *s, double *ret)
 {
-	test_str01_strstr();
-	test_wisun_2fsk_str01_find_shr();
-	test_rsc_input_bit();
-	test_nrnsc_input_bit();
-}
-#endif
+	char *endp;
+	double n;
 
-static const char *wisun_2fsk_sfd_type_names[] = {
-	[WISUN_2FSK_SFD_CODED0] = "coded0",
-	[WISUN_2FSK_SFD_CODED1] = "coded1",
-	[WISUN_2FSK_SFD_UNCODED0] = "uncoded0",
-	[WISUN_2FSK_SFD_UNCODED1] = "uncoded1",
-};
+	n = strtod(s, &endp);
+	if (endp == s || *endp != '\0') {
+		fprintf(stderr, "Invalid number: %s\n", s);
+		return -1;
+	}
+
+	*ret = n;
+	return 0;
+}
 
 int main(int argc, char **argv)
 {
+	struct wisun_2fsk_channel_plan plan = {
+		.format = IQ_FORMAT_CF32,
+		.spacing = 200000,
+		.symbol_rate = 50000,
+		.gardner = -1,
+		.sps = 8,
+	};
 	unsigned int algo_masks = 0;
 	enum wisun_2fsk_sfd_type sfd_type = WISUN_2FSK_SFD_UNCODED0;
 	size_t packet_encode_preamble_sz = 64;
 	uint16_t phr_options = 0;
 	int decode = -1, skip_verify = 0;
-	int ret = -1;
+	struct wisun_2fsk_extcap extcap = { 0 };
+	int simulate = 0, ret = -1;
+	int force_isa = -1;
+	unsigned long isa_verify = 0;
 
 #if DEBUG > 0
 	self_test();
@@ -1541,24 +6744,451 @@ int main(int argc, char **argv)
 		case OPTION_WHITENING:
 			phr_options |= WISUN_2FSK_PHR_DATA_WHITENING;
 			break;
+
+		case OPTION_CHANNELIZER:
+			algo_masks |= (1 << ALGO_CHANNELIZER);
+			break;
+		case OPTION_STREAM:
+			algo_masks |= (1 << ALGO_STREAM);
+			break;
+		case OPTION_REPAIR:
+			if (strcmp(optarg, "1") && strcmp(optarg, "2")) {
+				fprintf(stderr, "repair 1 or 2 bit errors\n");
+				return -1;
+			}
+			option_repair = optarg[0] - '0';
+			break;
+		case OPTION_AUTO:
+			option_auto = 1;
+			break;
+		case OPTION_TEMPLATE:
+			option_template = 1;
+			break;
+		case OPTION_BUILD_INDEX:
+			option_build_index = optarg;
+			break;
+		case OPTION_INDEX:
+			option_index_file = optarg;
+			break;
+		case OPTION_DUMP_INDEX:
+			option_dump_index = 1;
+			break;
+		case OPTION_CACHE:
+			option_cache = optarg;
+			break;
+		case OPTION_PCAP:
+			option_pcap.filename = optarg;
+			break;
+		case OPTION_PCAP_LINKTYPE:
+			if (!strcmp(optarg, "nofcs")) {
+				option_pcap.linktype = LINKTYPE_IEEE802_15_4_NOFCS;
+			} else if (!strcmp(optarg, "tap-fcs")) {
+				/* the FCS32 is told by the FCS type TLV */
+				option_pcap.linktype = LINKTYPE_IEEE802_15_4_TAP;
+				option_pcap.wisun_tlvs = 0;
+			} else if (!strcmp(optarg, "withfcs")) {
+				fprintf(stderr, "withfcs(195) is taken as FCS16 "
+					"by wireshark, use tap-fcs for the "
+					"FCS32\n");
+				return -1;
+			} else if (!strcmp(optarg, "tap")) {
+				option_pcap.linktype = LINKTYPE_IEEE802_15_4_TAP;
+				option_pcap.wisun_tlvs = 1;
+			} else {
+				fprintf(stderr, "Invalid link type: %s\n", optarg);
+				return -1;
+			}
+			break;
+		case OPTION_EXTCAP_INTERFACES:
+		case OPTION_EXTCAP_DLTS:
+		case OPTION_EXTCAP_CONFIG:
+		case OPTION_CAPTURE:
+			extcap.request = c;
+			break;
+		case OPTION_EXTCAP_INTERFACE:
+			extcap.interface = optarg;
+			break;
+		case OPTION_EXTCAP_VERSION:
+		case OPTION_EXTCAP_CAPTURE_FILTER:
+			break;
+		case OPTION_FIFO:
+			extcap.fifo = optarg;
+			break;
+		case OPTION_INPUT:
+			extcap.input = optarg;
+			break;
+		case OPTION_PCAP_INPUT:
+			option_pcap_input = optarg;
+			break;
+		case OPTION_SIMULATE:
+			simulate = 1;
+			break;
+		case OPTION_SIM_CHANNEL:
+			if (!strcmp(optarg, "awgn")) {
+				option_sim.channel = WISUN_2FSK_SIM_AWGN;
+			} else if (!strcmp(optarg, "flip")) {
+				option_sim.channel = WISUN_2FSK_SIM_FLIP;
+			} else if (!strncmp(optarg, "burst", 5)) {
+				option_sim.channel = WISUN_2FSK_SIM_BURST;
+				if (optarg[5] == ':')
+					option_sim.burst_len = strtoul(optarg + 6,
+								NULL, 0);
+				if (option_sim.burst_len == 0) {
+					fprintf(stderr, "Invalid burst length\n");
+					return -1;
+				}
+			} else {
+				fprintf(stderr, "Invalid channel: %s\n", optarg);
+				return -1;
+			}
+			break;
+		case OPTION_SIM_POINTS:
+			option_sim.points = optarg;
+			break;
+		case OPTION_SIM_FRAMES:
+		case OPTION_SIM_LENGTH:
+		case OPTION_SIM_SEED:
+			{
+				unsigned long long n;
+				char *endp;
+
+				n = strtoull(optarg, &endp, 0);
+				if (endp == optarg || *endp != '\0') {
+					fprintf(stderr, "Invalid number: %s\n",
+						optarg);
+					return -1;
+				}
+
+				if (c == OPTION_SIM_FRAMES && n == 0) {
+					fprintf(stderr, "Invalid frames: %s\n",
+						optarg);
+					return -1;
+				}
+
+				if (c == OPTION_SIM_FRAMES)
+					option_sim.frames = n;
+				else if (c == OPTION_SIM_LENGTH)
+					option_sim.length = n;
+				else
+					option_sim.seed = n;
+			}
+			break;
+		case OPTION_FORCE_ISA:
+			force_isa = wisun_fsk_isa_parse(optarg);
+			if (force_isa < 0) {
+				fprintf(stderr, "Invalid ISA: %s\n", optarg);
+				return -1;
+			}
+			break;
+		case OPTION_ISA_VERIFY:
+			isa_verify = 10000;
+			if (optarg) {
+				char *endp;
+
+				isa_verify = strtoul(optarg, &endp, 0);
+				if (endp == optarg || *endp != '\0'
+				    || isa_verify == 0) {
+					fprintf(stderr, "Invalid number: %s\n",
+						optarg);
+					return -1;
+				}
+			}
+			break;
+		case OPTION_FILTER:
+			if (option_filters_count >= WISUN_2FSK_MAX_FILTERS) {
+				fprintf(stderr, "too many filters\n");
+				return -1;
+			}
+			if (wisun_2fsk_filter_parse(optarg,
+					&option_filters[option_filters_count]) < 0)
+				return -1;
+			option_filters_count++;
+			break;
+		case OPTION_IQ_FORMAT:
+			{
+				int fmt = iq_sample_format_parse(optarg);
+
+				if (fmt < 0) {
+					fprintf(stderr, "Invalid IQ format: %s\n",
+						optarg);
+					return -1;
+				}
+				plan.format = fmt;
+				option_iq_output.format = fmt;
+			}
+			break;
+		case OPTION_SAMPLE_RATE:
+			if (parse_double(optarg, &plan.sample_rate) < 0)
+				return -1;
+			break;
+		case OPTION_CHANNEL_SPACING:
+			if (parse_double(optarg, &plan.spacing) < 0)
+				return -1;
+			break;
+		case OPTION_CHANNEL0:
+			if (parse_double(optarg, &plan.channel0) < 0)
+				return -1;
+			break;
+		case OPTION_CHANNELS:
+		case OPTION_THREADS:
+			{
+				long n;
+				char *endp;
+
+				n = strtol(optarg, &endp, 10);
+				if (n <= 0 || *endp != '\0') {
+					fprintf(stderr, "Invalid number: %s\n",
+						optarg);
+					return -1;
+				}
+
+				if (c == OPTION_CHANNELS)
+					plan.channels = (size_t)n;
+				else
+					plan.threads = (int)n;
+			}
+			break;
+		case OPTION_SYMBOL_RATE:
+			if (parse_double(optarg, &plan.symbol_rate) < 0)
+				return -1;
+			break;
+		case OPTION_SQUELCH:
+			if (parse_double(optarg, &plan.squelch) < 0)
+				return -1;
+			break;
+		case OPTION_RESAMPLE_SPS:
+			{
+				double n;
+
+				if (parse_double(optarg, &n) < 0)
+					return -1;
+				if (n != 0 && (n < 2 || n > 64
+						 || n != (unsigned int)n)) {
+					fprintf(stderr, "Invalid samples per "
+						"symbol: %s\n", optarg);
+					return -1;
+				}
+				plan.resample_sps = (unsigned int)n;
+			}
+			break;
+
+		case OPTION_DEMOD:
+			algo_masks |= (1 << ALGO_DEMOD);
+			break;
+		case OPTION_TIMING:
+			if (!strcmp(optarg, "gardner")) {
+				plan.gardner = 1;
+			} else if (!strcmp(optarg, "slicer")) {
+				plan.gardner = 0;
+			} else {
+				fprintf(stderr, "Invalid timing: %s\n", optarg);
+				return -1;
+			}
+			break;
+		case OPTION_SOFT_OUTPUT:
+			option_soft_output = optarg;
+			break;
+		case OPTION_CFO:
+			plan.cfo = 1;
+			break;
+		case OPTION_PIPELINE:
+			option_pipeline = 1;
+			break;
+		case OPTION_BATCH:
+			algo_masks |= (1 << ALGO_STREAM);
+			option_batch = 1;
+			break;
+
+		case OPTION_IQ_OUTPUT:
+			option_iq_output.filename = optarg;
+			break;
+		case OPTION_SPS:
+		case OPTION_MOD_INDEX:
+		case OPTION_BT:
+			{
+				double n;
+
+				if (parse_double(optarg, &n) < 0)
+					return -1;
+
+				if (c == OPTION_SPS) {
+					/* fractional for --demod only, it's
+					 * checked after all options.
+					 */
+					if (!(n > 0 && n <= 256)) {
+						fprintf(stderr, "Invalid samples "
+							"per symbol: %s\n",
+							optarg);
+						return -1;
+					}
+					plan.sps = n;
+				}
+				else if (c == OPTION_MOD_INDEX)
+					option_iq_output.mod_index = n;
+				else
+					option_iq_output.bt = n;
+			}
+			break;
+		}
+	}
+
+	option_pcap.symbol_rate = plan.symbol_rate;
+
+	if (option_iq_output.filename && plan.sps != (unsigned int)plan.sps) {
+		fprintf(stderr, "samples per symbol of the IQ output should be "
+			"an integer: %g\n", plan.sps);
+		return -1;
+	}
+	option_iq_output.sps = (unsigned int)plan.sps;
+
+	/* a cached packet decode result is printed before anything else */
+	if (option_cache && decode != 0 && !option_pcap.filename
+	    && !simulate && !extcap.request && !isa_verify && optind < argc
+	    && (algo_masks == 0 || (algo_masks & (1 << ALGO_PACKET)))
+	    && !(algo_masks & ((1 << ALGO_CHANNELIZER) | (1 << ALGO_DEMOD)
+			       | (1 << ALGO_STREAM)))) {
+		int hit = wisun_2fsk_cache_early_lookup(argv[optind],
+					!!(algo_masks & (1 << ALGO_RSC)),
+					!!(algo_masks & (1 << ALGO_INTERLEAVING)),
+					skip_verify);
+
+		if (hit != 0)
+			return hit > 0 ? 0 : -1;
+	}
+
+	if (isa_verify)
+		return wisun_fsk_isa_verify_all(force_isa, isa_verify);
+
+	if (force_isa < 0) {
+		wisun_fsk_isa_init();
+	} else if (wisun_fsk_isa_select(force_isa) < 0) {
+		fprintf(stderr, "%s is not supported by the CPU\n",
+			wisun_fsk_isa_name(force_isa));
+		return -1;
+	}
+
+	if (extcap.request) {
+		/* a live stream decoder whose output is the wireshark fifo */
+		if (extcap.request != OPTION_CAPTURE)
+			return wisun_2fsk_extcap_query(&extcap);
+
+		if (!extcap.fifo || !extcap.input) {
+			fprintf(stderr, "extcap: --fifo and --input are required\n");
+			return -1;
+		}
+
+		option_pcap.filename = extcap.fifo;
+		option_pcap.linktype = LINKTYPE_IEEE802_15_4_TAP;
+		option_pcap.wisun_tlvs = 1;
+		/* wireshark waits the header before the first frame */
+		if (wisun_2fsk_pcap_output_open(&option_pcap) < 0
+		    || wisun_fsk_pcap_writer_flush(option_pcap.w) < 0) {
+			wisun_2fsk_pcap_output_close(&option_pcap);
+			return -1;
 		}
+
+		ret = wisun_2fsk_stream_decode(extcap.input,
+					       !!(algo_masks & (1 << ALGO_RSC)),
+					       !!(algo_masks & (1 << ALGO_INTERLEAVING)),
+					       skip_verify);
+		return wisun_2fsk_pcap_output_close(&option_pcap) < 0 ? -1 : ret;
 	}
 
+	if (simulate)
+		return wisun_2fsk_simulate(&option_sim, plan.threads,
+					   packet_encode_preamble_sz,
+					   sfd_type,
+					   phr_options,
+					   !!(algo_masks & (1 << ALGO_RSC)),
+					   !!(algo_masks & (1 << ALGO_INTERLEAVING)));
+
+	/* the packets are in the pcap file, no string argument */
+	if (option_pcap_input && decode == 0)
+		return wisun_2fsk_packet_encode_pcap(option_pcap_input,
+						     packet_encode_preamble_sz,
+						     sfd_type,
+						     phr_options,
+						     !!(algo_masks & (1 << ALGO_RSC)),
+						     !!(algo_masks & (1 << ALGO_INTERLEAVING)));
+
 	if (!(optind < argc)) {
 		print_usage();
 		return -1;
 	}
 
-	if (algo_masks == 0 || algo_masks & (1 << ALGO_PACKET)) {
+	if (option_pcap.filename && decode != 0
+	    && wisun_2fsk_pcap_output_open(&option_pcap) < 0)
+		return -1;
+
+	if (algo_masks & (1 << ALGO_CHANNELIZER)) {
+		ret = wisun_2fsk_channelizer_decode(argv[optind], &plan,
+						    !!(algo_masks & (1 << ALGO_RSC)),
+						    !!(algo_masks & (1 << ALGO_INTERLEAVING)),
+						    skip_verify);
+	} else if (algo_masks & (1 << ALGO_DEMOD)) {
+		ret = wisun_2fsk_demod_decode(argv[optind], plan.sps,
+					      plan.gardner != 0,
+					      option_soft_output,
+					      !!(algo_masks & (1 << ALGO_RSC)),
+					      !!(algo_masks & (1 << ALGO_INTERLEAVING)),
+					      skip_verify);
+	} else if ((algo_masks & (1 << ALGO_STREAM)) && option_build_index) {
+		ret = wisun_2fsk_stream_build_index(argv[optind],
+						    option_build_index,
+						    !!(algo_masks & (1 << ALGO_RSC)),
+						    !!(algo_masks & (1 << ALGO_INTERLEAVING)));
+	} else if ((algo_masks & (1 << ALGO_STREAM)) && option_index_file) {
+		ret = wisun_2fsk_stream_decode_indexed(argv[optind],
+						       option_index_file,
+						       !!(algo_masks & (1 << ALGO_RSC)),
+						       !!(algo_masks & (1 << ALGO_INTERLEAVING)),
+						       skip_verify);
+	} else if ((algo_masks & (1 << ALGO_STREAM)) && option_batch) {
+		ret = wisun_2fsk_batch_decode(argv[optind],
+					      !!(algo_masks & (1 << ALGO_RSC)),
+					      !!(algo_masks & (1 << ALGO_INTERLEAVING)),
+					      skip_verify);
+	} else if ((algo_masks & (1 << ALGO_STREAM)) && option_pipeline) {
+		ret = wisun_2fsk_stream_decode_pipelined(argv[optind],
+					       !!(algo_masks & (1 << ALGO_RSC)),
+					       !!(algo_masks & (1 << ALGO_INTERLEAVING)),
+					       skip_verify);
+	} else if (algo_masks & (1 << ALGO_STREAM)) {
+		ret = wisun_2fsk_stream_decode(argv[optind],
+					       !!(algo_masks & (1 << ALGO_RSC)),
+					       !!(algo_masks & (1 << ALGO_INTERLEAVING)),
+					       skip_verify);
+	} else if (algo_masks == 0 || algo_masks & (1 << ALGO_PACKET)) {
 		int interleaving = !!(algo_masks & (1 << ALGO_INTERLEAVING));
 		int use_rsc = !!(algo_masks & (1 << ALGO_RSC));
 
 		/* the default behavier is decode */
-		if (decode != 0)
+		if (decode != 0 && option_cache && !option_pcap.w)
+			ret = wisun_2fsk_packet_decode_cached(argv[optind],
+						       use_rsc,
+						       interleaving,
+						       skip_verify);
+		else if (decode != 0)
 			ret = wisun_2fsk_packet_decode(argv[optind],
 						       use_rsc,
 						       interleaving,
 						       skip_verify);
+		else if (option_template)
+			ret = wisun_2fsk_packet_encode_template(&argv[optind],
+						       argc - optind,
+						       packet_encode_preamble_sz,
+						       sfd_type,
+						       phr_options,
+						       use_rsc,
+						       interleaving);
+		else if (optind + 1 < argc && !option_iq_output.filename)
+			ret = wisun_2fsk_packet_encode_batch(&argv[optind],
+						       argc - optind,
+						       packet_encode_preamble_sz,
+						       sfd_type,
+						       phr_options,
+						       use_rsc,
+						       interleaving);
 		else
 			ret = wisun_2fsk_packet_encode(argv[optind],
 						       packet_encode_preamble_sz,
@@ -1584,5 +7214,8 @@ int main(int argc, char **argv)
 		ret = wisun_fsk_interleaving(argv[optind]);
 	}
 
+	if (wisun_2fsk_pcap_output_close(&option_pcap) < 0)
+		ret = -1;
+
 	return ret;
 }
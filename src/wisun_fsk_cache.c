@@ -0,0 +1,250 @@
+/*
+ * on-disk decode result cache shared by the plugin processes
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wisun_fsk_cache.h"
+
+static uint64_t mix64(uint64_t x)
+{
+	/* the splitmix64 finalizer */
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+uint64_t wisun_fsk_hash64(const void *buf, size_t len, uint64_t seed)
+{
+	const uint8_t *p = buf;
+	uint64_t h = seed ^ (len * 0x9e3779b97f4a7c15ULL);
+	uint64_t w;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&w, p, sizeof(w));
+		h = (h ^ mix64(w)) * 0x9e3779b97f4a7c15ULL;
+	}
+
+	w = 0;
+	memcpy(&w, p, len);
+	h ^= mix64(w ^ len);
+
+	return mix64(h);
+}
+
+static int cache_lock(struct wisun_fsk_cache *c, int op)
+{
+	while (flock(c->fd, op) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void cache_unlock(struct wisun_fsk_cache *c)
+{
+	flock(c->fd, LOCK_UN);
+}
+
+static void cache_header_init(struct wisun_fsk_cache_header *h)
+{
+	memcpy(h->magic, WISUN_FSK_CACHE_MAGIC, sizeof(h->magic));
+	h->version = WISUN_FSK_CACHE_VERSION;
+	h->slot_size = sizeof(struct wisun_fsk_cache_slot);
+	h->buckets = WISUN_FSK_CACHE_BUCKETS;
+	h->ways = WISUN_FSK_CACHE_WAYS;
+}
+
+/* a file which isn't a cache of this layout is never changed, it may be a
+ * mistyped capture file.
+ */
+static int cache_check_file(int fd, size_t size, size_t map_size,
+			    const char *filename)
+{
+	struct wisun_fsk_cache_header h;
+
+	if (size < sizeof(h) || pread(fd, &h, sizeof(h), 0) != sizeof(h)
+	    || memcmp(h.magic, WISUN_FSK_CACHE_MAGIC, sizeof(h.magic))) {
+		fprintf(stderr, "%s is not a cache file\n", filename);
+		return -1;
+	}
+
+	if (h.version != WISUN_FSK_CACHE_VERSION
+	    || h.slot_size != sizeof(struct wisun_fsk_cache_slot)
+	    || h.buckets != WISUN_FSK_CACHE_BUCKETS
+	    || h.ways != WISUN_FSK_CACHE_WAYS
+	    || size != map_size) {
+		fprintf(stderr, "%s is a cache of another version(%u), "
+			"remove it\n", filename, h.version);
+		return -1;
+	}
+
+	return 0;
+}
+
+int wisun_fsk_cache_open(struct wisun_fsk_cache *c, const char *filename)
+{
+	struct stat st;
+	int ret = -1;
+
+	memset(c, 0, sizeof(*c));
+	c->map_size = sizeof(struct wisun_fsk_cache_header)
+		+ sizeof(struct wisun_fsk_cache_bucket)
+					* WISUN_FSK_CACHE_BUCKETS;
+
+	c->fd = open(filename, O_RDWR | O_CREAT, 0644);
+	if (c->fd < 0) {
+		fprintf(stderr, "open %s failed\n", filename);
+		return -1;
+	}
+
+	if (cache_lock(c, LOCK_EX) < 0)
+		goto done;
+
+	if (fstat(c->fd, &st) < 0)
+		goto unlock;
+
+	/* only a new(empty) file is initialized, the slots are zero filled */
+	if (st.st_size == 0) {
+		if (ftruncate(c->fd, c->map_size) < 0)
+			goto unlock;
+	} else if (cache_check_file(c->fd, st.st_size, c->map_size,
+				    filename) < 0) {
+		goto unlock;
+	}
+
+	c->map = mmap(NULL, c->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		      c->fd, 0);
+	if (c->map == MAP_FAILED) {
+		c->map = NULL;
+		goto unlock;
+	}
+
+	if (st.st_size == 0)
+		cache_header_init(c->map);
+
+	c->buckets = (void *)((struct wisun_fsk_cache_header *)c->map + 1);
+	ret = 0;
+
+unlock:
+	cache_unlock(c);
+done:
+	if (ret < 0) {
+		fprintf(stderr, "open cache %s failed\n", filename);
+		wisun_fsk_cache_close(c);
+	}
+	return ret;
+}
+
+void wisun_fsk_cache_close(struct wisun_fsk_cache *c)
+{
+	if (c->map)
+		munmap(c->map, c->map_size);
+	if (c->fd >= 0)
+		close(c->fd);
+	memset(c, 0, sizeof(*c));
+	c->fd = -1;
+}
+
+static void cache_hash_key(const void *key, size_t key_len, uint64_t *ret_key,
+			   uint64_t *ret_check)
+{
+	*ret_key = wisun_fsk_hash64(key, key_len, 0);
+	*ret_check = wisun_fsk_hash64(key, key_len, *ret_key);
+
+	/* 0 is the empty slot */
+	if (*ret_key == 0)
+		*ret_key = 1;
+}
+
+static struct wisun_fsk_cache_slot *
+cache_find_slot(struct wisun_fsk_cache_bucket *b, uint64_t key, uint64_t check)
+{
+	for (int i = 0; i < WISUN_FSK_CACHE_WAYS; i++) {
+		struct wisun_fsk_cache_slot *s = &b->slots[i];
+
+		if (s->key == key && s->check == check)
+			return s;
+	}
+
+	return NULL;
+}
+
+int wisun_fsk_cache_lookup(struct wisun_fsk_cache *c, const void *key,
+			   size_t key_len, char *value, size_t value_sz)
+{
+	struct wisun_fsk_cache_bucket *b;
+	struct wisun_fsk_cache_slot *s;
+	uint64_t k, check;
+	int ret = -1;
+
+	cache_hash_key(key, key_len, &k, &check);
+	b = &c->buckets[k % WISUN_FSK_CACHE_BUCKETS];
+
+	/* the referenced bit is written, take the exclusive lock */
+	if (cache_lock(c, LOCK_EX) < 0)
+		return -1;
+
+	s = cache_find_slot(b, k, check);
+	if (s && s->len <= WISUN_FSK_CACHE_VALUE_MAX && s->len <= value_sz) {
+		memcpy(value, s->value, s->len);
+		s->referenced = 1;
+		ret = s->len;
+	}
+
+	cache_unlock(c);
+	return ret;
+}
+
+int wisun_fsk_cache_store(struct wisun_fsk_cache *c, const void *key,
+			  size_t key_len, const char *value, size_t len)
+{
+	struct wisun_fsk_cache_bucket *b;
+	struct wisun_fsk_cache_slot *s;
+	uint64_t k, check;
+
+	if (len > WISUN_FSK_CACHE_VALUE_MAX)
+		return -1;
+
+	cache_hash_key(key, key_len, &k, &check);
+	b = &c->buckets[k % WISUN_FSK_CACHE_BUCKETS];
+
+	if (cache_lock(c, LOCK_EX) < 0)
+		return -1;
+
+	s = cache_find_slot(b, k, check);
+	while (!s) {
+		/* clock: skip and clear the referenced slots once */
+		struct wisun_fsk_cache_slot *victim =
+			&b->slots[b->hand % WISUN_FSK_CACHE_WAYS];
+
+		b->hand = (b->hand + 1) % WISUN_FSK_CACHE_WAYS;
+		if (victim->key && victim->referenced)
+			victim->referenced = 0;
+		else
+			s = victim;
+	}
+
+	/* the key is written last, an interrupted store leaves a miss */
+	s->key = 0;
+	s->check = check;
+	s->len = len;
+	s->referenced = 1;
+	memcpy(s->value, value, len);
+	s->key = k;
+
+	cache_unlock(c);
+	return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * on-disk decode result cache shared by the plugin processes
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#ifndef WISUN_FSK_CACHE_H
+#define WISUN_FSK_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* The cache file is a memory-mapped set associative hash table with a
+ * fixed size. A key is hashed to a bucket of WISUN_FSK_CACHE_WAYS slots,
+ * the slot to be replaced is selected by the clock(second chance) of the
+ * bucket. The processes sharing the file are serialized by flock(2).
+ */
+#define WISUN_FSK_CACHE_MAGIC		"WSFSKCHE"
+#define WISUN_FSK_CACHE_VERSION		2
+#define WISUN_FSK_CACHE_BUCKETS		512
+#define WISUN_FSK_CACHE_WAYS		8
+#define WISUN_FSK_CACHE_SLOT_SIZE	2048
+
+struct wisun_fsk_cache_slot {
+	uint64_t	key;		/* 0: empty */
+	uint64_t	check;		/* another hash of the key */
+	uint32_t	len;
+	uint8_t		referenced;
+	uint8_t		reserved[3];
+	char		value[WISUN_FSK_CACHE_SLOT_SIZE - 24];
+};
+
+#define WISUN_FSK_CACHE_VALUE_MAX	(WISUN_FSK_CACHE_SLOT_SIZE - 24)
+
+struct wisun_fsk_cache_bucket {
+	uint32_t			hand;
+	uint32_t			reserved;
+	struct wisun_fsk_cache_slot	slots[WISUN_FSK_CACHE_WAYS];
+};
+
+struct wisun_fsk_cache_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	slot_size;
+	uint32_t	buckets;
+	uint32_t	ways;
+	uint64_t	reserved[5];
+};
+
+struct wisun_fsk_cache {
+	int				fd;
+	void				*map;
+	size_t				map_size;
+	struct wisun_fsk_cache_bucket	*buckets;
+};
+
+/* 64-bit hash, 8 bytes a step */
+uint64_t wisun_fsk_hash64(const void *buf, size_t len, uint64_t seed);
+
+/* open or create the cache file, a non-empty file of another layout or not
+ * a cache is refused, it's never overwritten.
+ */
+int wisun_fsk_cache_open(struct wisun_fsk_cache *c, const char *filename);
+void wisun_fsk_cache_close(struct wisun_fsk_cache *c);
+/* copy the value of @key to @value, return its length or -1 if missed */
+int wisun_fsk_cache_lookup(struct wisun_fsk_cache *c, const void *key,
+			   size_t key_len, char *value, size_t value_sz);
+/* values longer than WISUN_FSK_CACHE_VALUE_MAX are not cached */
+int wisun_fsk_cache_store(struct wisun_fsk_cache *c, const void *key,
+			  size_t key_len, const char *value, size_t len);
+
+#endif
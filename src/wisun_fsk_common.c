@@ -8,6 +8,25 @@
 #include <stdbool.h>
 #include "wisun_fsk_common.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#define WISUN_FSK_ISA_X86	1
+#include <immintrin.h>
+#endif
+
+/* the kernels bound by wisun_fsk_isa_select(), see the end of this file */
+struct wisun_fsk_isa_kernels {
+	void		(*pn9_xor)(uint8_t *buf, size_t n, size_t pos);
+	void		(*interleaving_bits)(const uint8_t *buf,
+					     size_t binary_bits, uint8_t *out);
+	uint32_t	(*crc32_update)(uint32_t crc, const uint8_t *buf,
+					size_t len);
+	int		(*fec_block_decode)(struct fec_block_decoder *d,
+					    const uint8_t *in, size_t blocks,
+					    uint8_t *out);
+};
+
+static const struct wisun_fsk_isa_kernels *isa_kernels;
+
 void bufwrite_init(struct bufwrite *b, uint8_t *buf, size_t bufsz)
 {
 	b->buf = buf;
@@ -88,7 +107,11 @@ uint32_t reverse32(uint32_t x)
 	return x;
 }
 
-static uint8_t pn9_tables[511] = { 0 };
+static uint8_t pn9_tables[PN9_TABLE_SIZE] = { 0 };
+/* the first bytes are repeated, a vector never wraps inside */
+#define PN9_TABLE_EXT		64
+static uint8_t pn9_tables_ext[PN9_TABLE_SIZE + PN9_TABLE_EXT];
+static int pn9_table_inited = 0;
 
 static uint16_t pn9_shift1(uint16_t pn9, unsigned int *xor_out)
 {
@@ -120,19 +143,38 @@ static void pn9_table_init(void)
 
 		pn9_tables[i] = n;
 	}
+
+	for (size_t i = 0; i < sizeof(pn9_tables_ext); i++)
+		pn9_tables_ext[i] = pn9_tables[i % sizeof(pn9_tables)];
 }
 
+#define init_pn9_tables_once() do {					\
+	if (!pn9_table_inited) {					\
+		pn9_table_inited = 1;					\
+		pn9_table_init();					\
+	}								\
+} while (0)
+
 void pn9_payload_decode(uint8_t *buf, size_t byte_size)
 {
-	static int pn9_table_inited = 0;
+	pn9_payload_decode_offset(buf, byte_size, 0);
+}
 
-	if (!pn9_table_inited) {
-		pn9_table_inited = 1;
-		pn9_table_init();
+/* @pos: the byte position of @buf in the pn9 tables */
+static void pn9_xor_scalar(uint8_t *buf, size_t byte_size, size_t pos)
+{
+	for (size_t i = 0; i < byte_size; i++) {
+		buf[i] ^= pn9_tables[pos];
+		if (++pos == sizeof(pn9_tables))
+			pos = 0;
 	}
+}
 
-	for (size_t i = 0; i < byte_size; i++)
-		buf[i] ^= pn9_tables[i % sizeof(pn9_tables)];
+/* @offset: the byte position of @buf in the whole whitening payload */
+void pn9_payload_decode_offset(uint8_t *buf, size_t byte_size, size_t offset)
+{
+	init_pn9_tables_once();
+	isa_kernels->pn9_xor(buf, byte_size, offset % sizeof(pn9_tables));
 }
 
 /* RSC encoder for wisun fsk, defined in <802.15.4-2020.pdf> */
@@ -393,6 +435,19 @@ int nrnsc_decode(uint8_t *m, uint8_t *encode_buf, size_t encode_bits,
 	return ret;
 }
 
+/* The tables are inited lazily, call this before sharing them between
+ * threads.
+ */
+void wisun_fsk_common_init(void)
+{
+	init_pn9_tables_once();
+	init_rsc_tables_once();
+	init_nrnsc_tables_once();
+	init_fec_block_tables();
+	init_fcs32_syndrome_tables();
+	init_fcs32_delta_tables();
+}
+
 /*
  * based on <802.15.4-2020.pdf>:
  *
@@ -425,7 +480,8 @@ static const uint8_t interleaving_symbol_target[16] = {
 	0,
 };
 
-void interleaving_bits(const uint8_t *buf, size_t binary_bits, uint8_t *out)
+static void interleaving_bits_scalar(const uint8_t *buf, size_t binary_bits,
+				     uint8_t *out)
 {
 	const uint8_t *p_buf = buf;
 	uint8_t *p_out = out;
@@ -459,6 +515,11 @@ void interleaving_bits(const uint8_t *buf, size_t binary_bits, uint8_t *out)
 	}
 }
 
+void interleaving_bits(const uint8_t *buf, size_t binary_bits, uint8_t *out)
+{
+	isa_kernels->interleaving_bits(buf, binary_bits, out);
+}
+
 static const uint32_t crc32_tables[] = {
 	0x00000000,0x77073096,0xee0e612c,0x990951ba,0x076dc419,0x706af48f,0xe963a535,0x9e6495a3,
 	0x0edb8832,0x79dcb8a4,0xe0d5e91e,0x97d2d988,0x09b64c2b,0x7eb17cbd,0xe7b82d07,0x90bf1d91,
@@ -499,6 +560,15 @@ static inline uint32_t crc32_byte(uint32_t next, uint8_t data)
 	return (next >> 8) ^ crc32_tables[(next ^ data) & 0xff];
 }
 
+static uint32_t crc32_update_scalar(uint32_t crc, const uint8_t *buf,
+				    size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		crc = crc32_byte(crc, buf[i]);
+
+	return crc;
+}
+
 uint32_t ieee_802154_fcs32(uint32_t crc, const uint8_t *buf, size_t len)
 {
 	/* Uppon transmission, if the length of the calculation field is less
@@ -506,8 +576,7 @@ uint32_t ieee_802154_fcs32(uint32_t crc, const uint8_t *buf, size_t len)
 	 * calculation field length exactly 4 octets; howerer, these pad bits
 	 * shall not be transmitted.
 	 */
-	for (uint32_t i = 0; i < len; i++)
-		crc = crc32_byte(crc, buf[i]);
+	crc = isa_kernels->crc32_update(crc, buf, len);
 
 	if (len < 4) {
 		for (size_t i = 0; i < 4 - len; i++)
@@ -538,3 +607,1479 @@ bool ieee_802154_fcs32_buf_is_good(const uint8_t *buf, size_t len)
 
 	return crc == IEEE_802154_FCS32_GOOD;
 }
+
+/* The CRC register is linear in the message, flipping the bytes of a message
+ * changes the FCS by the register of the flipped bits alone, shifted by the
+ * bytes after them. The shift is a multiplication by x^(8 * n) modulo the
+ * polynomial, all in the reflected bit order.
+ */
+#define FCS32_POLY_REFLECTED		0xedb88320
+
+static uint32_t fcs32_multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = (uint32_t)1 << 31, p = 0;
+
+	while (m) {
+		if (a & m) {
+			p ^= b;
+			if (!(a & (m - 1)))
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ FCS32_POLY_REFLECTED : b >> 1;
+	}
+
+	return p;
+}
+
+/* x^(8 * 2^k) modulo the polynomial, the small ones are also saved as the
+ * byte tables of the multiplication, which covers the longest PSDU.
+ */
+#define FCS32_X8N_BYTE_TABLES	11
+
+static uint32_t fcs32_x8n_tables[64];
+static uint32_t fcs32_x8n_byte_tables[FCS32_X8N_BYTE_TABLES][4][256];
+static int fcs32_x8n_table_inited = 0;
+
+static void fcs32_x8n_table_init(void)
+{
+	uint32_t p = (uint32_t)1 << 30; /* x^1 */
+
+	for (int k = 0; k < 3; k++)
+		p = fcs32_multmodp(p, p);
+
+	for (size_t k = 0; k < ARRAY_SIZE(fcs32_x8n_tables); k++) {
+		fcs32_x8n_tables[k] = p;
+		p = fcs32_multmodp(p, p);
+	}
+
+	for (size_t k = 0; k < FCS32_X8N_BYTE_TABLES; k++) {
+		for (int j = 0; j < 4; j++) {
+			for (uint32_t v = 0; v < 256; v++)
+				fcs32_x8n_byte_tables[k][j][v] =
+					fcs32_multmodp(fcs32_x8n_tables[k],
+						       v << (j * 8));
+		}
+	}
+}
+
+void init_fcs32_delta_tables(void)
+{
+	if (!fcs32_x8n_table_inited) {
+		fcs32_x8n_table_inited = 1;
+		fcs32_x8n_table_init();
+	}
+}
+
+/* @crc * x^(8 * n) modulo the polynomial */
+static uint32_t fcs32_shift_zeros(uint32_t crc, size_t n)
+{
+	init_fcs32_delta_tables();
+
+	for (size_t k = 0; n; n >>= 1, k++) {
+		const uint32_t (*t)[256];
+
+		if (!(n & 1))
+			continue;
+
+		if (k >= FCS32_X8N_BYTE_TABLES) {
+			crc = fcs32_multmodp(fcs32_x8n_tables[k], crc);
+			continue;
+		}
+
+		t = fcs32_x8n_byte_tables[k];
+		crc = t[0][crc & 0xff] ^ t[1][(crc >> 8) & 0xff]
+			^ t[2][(crc >> 16) & 0xff] ^ t[3][crc >> 24];
+	}
+
+	return crc;
+}
+
+uint32_t ieee_802154_fcs32_delta(const uint8_t *delta, size_t n,
+				 size_t tail_len)
+{
+	uint32_t crc = 0;
+
+	for (size_t i = 0; i < n; i++)
+		crc = crc32_byte(crc, delta[i]);
+
+	return fcs32_shift_zeros(crc, tail_len);
+}
+
+/* Lookup tables of the fused block decoder and encoder:
+ *
+ * interleaving_tables: the interleaving is a bit permutation of the 32-bit
+ * big endian block, the result is the OR of each byte's permutation. It is
+ * an involution, the same tables are used for de-interleaving.
+ *
+ * fec_byte_tables: a coded byte is 4 symbols and decoded to 4 bits.
+ * bit0~3: the decoded nibble, bit4~6: the next m, bit7: decode failed.
+ *
+ * fec_encode_tables: a byte is encoded to 16 bits in lsb first mode.
+ * bit0~15: the coded bits, bit16~18: the next m.
+ *
+ * pn9_words: 4 pn9 bytes starts from each position, in big endian.
+ */
+#define FEC_BYTE_ERROR		(1 << 7)
+
+static uint32_t interleaving_tables[4][256];
+static uint8_t rsc_byte_tables[8][256], nrnsc_byte_tables[8][256];
+static uint32_t rsc_encode_tables[8][256], nrnsc_encode_tables[8][256];
+static uint32_t pn9_words[sizeof(pn9_tables)];
+static int fec_block_table_inited = 0;
+
+static void fec_byte_table_init(uint8_t table[8][256], int use_rsc)
+{
+	for (uint8_t m = 0; m < 8; m++) {
+		for (int i = 0; i < 256; i++) {
+			uint8_t in = i, out = 0, next_m = m;
+			size_t decode_bits;
+			int ret;
+
+			if (use_rsc)
+				ret = fec_replay_decode(rsc_tables_one,
+							rsc_tables_zero,
+							&next_m, &in, 8,
+							&out, 1, &decode_bits);
+			else
+				ret = fec_replay_decode(nrnsc_tables_one,
+							nrnsc_tables_zero,
+							&next_m, &in, 8,
+							&out, 1, &decode_bits);
+
+			if (ret < 0)
+				table[m][i] = FEC_BYTE_ERROR;
+			else
+				table[m][i] = (out & 0x0f) | (next_m << 4);
+		}
+	}
+}
+
+static void fec_encode_table_init(uint32_t table[8][256], int use_rsc)
+{
+	/* the u1u0 symbol is pushed as u1 first */
+	static const uint8_t reverse2_tables[] = {
+		[0b00] = 0b00,
+		[0b01] = 0b10,
+		[0b10] = 0b01,
+		[0b11] = 0b11,
+	};
+
+	for (uint8_t m = 0; m < 8; m++) {
+		for (int i = 0; i < 256; i++) {
+			uint8_t next_m = m;
+			uint32_t coded = 0;
+
+			for (int bit = 0; bit < 8; bit++) {
+				int bi = (i >> bit) & 1;
+				uint8_t u;
+
+				if (use_rsc)
+					u = rsc_input_bit(&next_m, bi);
+				else
+					u = nrnsc_input_bit(&next_m, bi);
+
+				coded |= reverse2_tables[u] << (bit * 2);
+			}
+
+			table[m][i] = coded | (next_m << 16);
+		}
+	}
+}
+
+static void fec_block_table_init(void)
+{
+	init_pn9_tables_once();
+	init_rsc_tables_once();
+	init_nrnsc_tables_once();
+
+	for (int pos = 0; pos < 4; pos++) {
+		for (int i = 0; i < 256; i++) {
+			uint8_t in[4] = { 0 }, out[4];
+
+			in[pos] = i;
+			interleaving_bits_scalar(in, 32, out);
+			interleaving_tables[pos][i] =
+				(out[0] << 24) | (out[1] << 16)
+				| (out[2] << 8) | out[3];
+		}
+	}
+
+	fec_byte_table_init(rsc_byte_tables, 1);
+	fec_byte_table_init(nrnsc_byte_tables, 0);
+	fec_encode_table_init(rsc_encode_tables, 1);
+	fec_encode_table_init(nrnsc_encode_tables, 0);
+
+	for (size_t i = 0; i < sizeof(pn9_tables); i++) {
+		uint32_t w = 0;
+
+		for (size_t j = 0; j < 4; j++)
+			w = (w << 8) | pn9_tables[(i + j) % sizeof(pn9_tables)];
+
+		pn9_words[i] = w;
+	}
+}
+
+void init_fec_block_tables(void)
+{
+	if (!fec_block_table_inited) {
+		fec_block_table_inited = 1;
+		fec_block_table_init();
+	}
+}
+
+void fec_block_decoder_init(struct fec_block_decoder *d, int use_rsc,
+			    int interleaving)
+{
+	init_fec_block_tables();
+
+	d->use_rsc = use_rsc;
+	d->interleaving = interleaving;
+	d->whitening = 0;
+	d->m = use_rsc ? RSC_INIT_M : NRNSC_INIT_M;
+	d->pn9_pos = 0;
+	d->crc = IEEE_802154_FCS32_INIT;
+	d->crc_bytes = 0;
+	d->blocks = 0;
+}
+
+/* The fused kernels are specialized for each (FEC, interleaving, whitening,
+ * FCS32) combination: the generic bodies below are always inlined with
+ * constant flags, so the hot loops have no mode branches, and the FEC tables
+ * are addressed by symbol instead of a pointer. The variants are selected
+ * once per call through the dispatch tables.
+ */
+#define fec_always_inline	inline __attribute__((always_inline))
+
+#define FEC_VARIANT_IDX(rsc, il, wh, fcs32)				\
+	((rsc) | ((il) << 1) | ((wh) << 2) | ((fcs32) << 3))
+#define FEC_VARIANTS_MAX	16
+
+#define FEC_FOR_EACH_VARIANT(X)						\
+	X(0, 0, 0, 0) X(1, 0, 0, 0) X(0, 1, 0, 0) X(1, 1, 0, 0)		\
+	X(0, 0, 1, 0) X(1, 0, 1, 0) X(0, 1, 1, 0) X(1, 1, 1, 0)		\
+	X(0, 0, 0, 1) X(1, 0, 0, 1) X(0, 1, 0, 1) X(1, 1, 0, 1)		\
+	X(0, 0, 1, 1) X(1, 0, 1, 1) X(0, 1, 1, 1) X(1, 1, 1, 1)
+
+/* the uncoded frames have no FEC type and interleaving */
+#define FEC_UNCODED_VARIANT_IDX(wh, fcs32)	((wh) | ((fcs32) << 1))
+#define FEC_UNCODED_VARIANTS_MAX	4
+
+#define FEC_FOR_EACH_UNCODED_VARIANT(X)					\
+	X(0, 0) X(1, 0) X(0, 1) X(1, 1)
+
+static fec_always_inline uint32_t interleaving_word(uint32_t w)
+{
+	return interleaving_tables[0][w >> 24]
+		| interleaving_tables[1][(w >> 16) & 0xff]
+		| interleaving_tables[2][(w >> 8) & 0xff]
+		| interleaving_tables[3][w & 0xff];
+}
+
+struct fec_block_decode_state {
+	uint8_t		m;
+	size_t		pn9_pos;
+	uint32_t	crc;
+	size_t		blocks;
+};
+
+/* decode @blocks blocks, all the decoded bytes are crc'ed if @fcs32 */
+static fec_always_inline int
+fec_block_decode_run(struct fec_block_decode_state *st, const uint8_t *in,
+		     size_t blocks, uint8_t *out, const int use_rsc,
+		     const int interleaving, const int whitening,
+		     const int fcs32)
+{
+	uint32_t crc = st->crc;
+	size_t pos = st->pn9_pos;
+	uint8_t m = st->m;
+	int ret = 0;
+	size_t i;
+
+	for (i = 0; i < blocks; i++, in += 4, out += 2) {
+		uint32_t w = (in[0] << 24) | (in[1] << 16) | (in[2] << 8) | in[3];
+		uint8_t e0, e1, e2, e3;
+
+		if (whitening) {
+			w ^= pn9_words[pos];
+			pos = (pos + 4) % sizeof(pn9_tables);
+		}
+
+		if (interleaving)
+			w = interleaving_word(w);
+
+		#define FEC_BYTE(m, b)						\
+			(use_rsc ? rsc_byte_tables[m][b] : nrnsc_byte_tables[m][b])
+		e0 = FEC_BYTE(m, w >> 24);
+		e1 = FEC_BYTE((e0 >> 4) & 7, (w >> 16) & 0xff);
+		e2 = FEC_BYTE((e1 >> 4) & 7, (w >> 8) & 0xff);
+		e3 = FEC_BYTE((e2 >> 4) & 7, w & 0xff);
+		#undef FEC_BYTE
+		if ((e0 | e1 | e2 | e3) & FEC_BYTE_ERROR) {
+			ret = -1;
+			break;
+		}
+
+		m = (e3 >> 4) & 7;
+		out[0] = (e0 & 0x0f) | (e1 << 4);
+		out[1] = (e2 & 0x0f) | (e3 << 4);
+
+		if (fcs32)
+			crc = crc32_byte(crc32_byte(crc, out[0]), out[1]);
+	}
+
+	st->m = m;
+	st->pn9_pos = pos;
+	st->crc = crc;
+	st->blocks += i;
+	return ret;
+}
+
+static fec_always_inline int
+fec_block_decode_tmpl(struct fec_block_decoder *d, const uint8_t *in,
+		      size_t blocks, uint8_t *out, const int use_rsc,
+		      const int interleaving, const int whitening,
+		      const int fcs32)
+{
+	struct fec_block_decode_state st = {
+		.m = d->m,
+		.pn9_pos = d->pn9_pos,
+		.crc = d->crc,
+		.blocks = d->blocks,
+	};
+	size_t crc_blocks = 0;
+	int ret;
+
+	/* the crc'ed blocks, then the block with a single crc'ed byte */
+	if (fcs32) {
+		crc_blocks = d->crc_bytes / 2;
+		if (crc_blocks > blocks)
+			crc_blocks = blocks;
+	}
+
+	ret = fec_block_decode_run(&st, in, crc_blocks, out, use_rsc,
+				   interleaving, whitening, 1);
+	/* the blocks before a bad one are in the crc, even on errors */
+	if (fcs32)
+		d->crc_bytes -= (st.blocks - d->blocks) * 2;
+	if (fcs32 && ret == 0) {
+		in += crc_blocks * 4;
+		out += crc_blocks * 2;
+		blocks -= crc_blocks;
+
+		if (d->crc_bytes == 1 && blocks > 0) {
+			ret = fec_block_decode_run(&st, in, 1, out, use_rsc,
+						   interleaving, whitening, 0);
+			if (ret == 0) {
+				st.crc = crc32_byte(st.crc, out[0]);
+				d->crc_bytes = 0;
+				in += 4;
+				out += 2;
+				blocks--;
+			}
+		}
+	}
+
+	if (ret == 0)
+		ret = fec_block_decode_run(&st, in, blocks, out, use_rsc,
+					   interleaving, whitening, 0);
+
+	d->m = st.m;
+	d->pn9_pos = st.pn9_pos;
+	d->crc = st.crc;
+	d->blocks = st.blocks;
+	return ret;
+}
+
+typedef int (*fec_block_decode_fn)(struct fec_block_decoder *d,
+				   const uint8_t *in, size_t blocks,
+				   uint8_t *out);
+
+#define FEC_BLOCK_DECODE_VARIANT(rsc, il, wh, fcs32)			\
+static int fec_block_decode_##rsc##il##wh##fcs32(			\
+			struct fec_block_decoder *d, const uint8_t *in,	\
+			size_t blocks, uint8_t *out)			\
+{									\
+	return fec_block_decode_tmpl(d, in, blocks, out,		\
+				     rsc, il, wh, fcs32);		\
+}
+FEC_FOR_EACH_VARIANT(FEC_BLOCK_DECODE_VARIANT)
+
+#define FEC_BLOCK_DECODE_ENTRY(rsc, il, wh, fcs32)			\
+	[FEC_VARIANT_IDX(rsc, il, wh, fcs32)] =				\
+		fec_block_decode_##rsc##il##wh##fcs32,
+static const fec_block_decode_fn fec_block_decode_variants[] = {
+	FEC_FOR_EACH_VARIANT(FEC_BLOCK_DECODE_ENTRY)
+};
+
+static int fec_block_decode_scalar(struct fec_block_decoder *d,
+				   const uint8_t *in, size_t blocks,
+				   uint8_t *out)
+{
+	size_t idx = FEC_VARIANT_IDX(!!d->use_rsc, !!d->interleaving,
+				     !!d->whitening, d->crc_bytes > 0);
+
+	return fec_block_decode_variants[idx](d, in, blocks, out);
+}
+
+int fec_block_decode(struct fec_block_decoder *d, const uint8_t *in,
+		     size_t blocks, uint8_t *out)
+{
+	return isa_kernels->fec_block_decode(d, in, blocks, out);
+}
+
+void fec_block_encoder_init(struct fec_block_encoder *e, int fec, int use_rsc,
+			    int interleaving, uint8_t *out)
+{
+	init_fec_block_tables();
+
+	e->fec = fec;
+	e->use_rsc = use_rsc;
+	e->interleaving = interleaving;
+	e->whitening = 0;
+	e->m = use_rsc ? RSC_INIT_M : NRNSC_INIT_M;
+	e->pn9_pos = 0;
+	e->crc = IEEE_802154_FCS32_INIT;
+	e->crc_bytes = 0;
+	e->pending = 0;
+	e->npending = 0;
+	e->out = out;
+	e->len = 0;
+}
+
+static fec_always_inline void
+fec_block_encoder_push_block(struct fec_block_encoder *e, uint32_t w,
+			     const int interleaving, const int whitening)
+{
+	uint8_t *out = e->out + e->len;
+
+	if (interleaving)
+		w = interleaving_word(w);
+
+	if (whitening) {
+		w ^= pn9_words[e->pn9_pos];
+		e->pn9_pos = (e->pn9_pos + 4) % sizeof(pn9_tables);
+	}
+
+	out[0] = w >> 24;
+	out[1] = w >> 16;
+	out[2] = w >> 8;
+	out[3] = w;
+	e->len += 4;
+}
+
+/* FEC encode a byte to 16 bits, the first coded byte is the msb */
+static fec_always_inline uint32_t
+fec_block_encode_byte(struct fec_block_encoder *e, uint8_t c,
+		      const int use_rsc)
+{
+	uint32_t coded = use_rsc ? rsc_encode_tables[e->m][c]
+				 : nrnsc_encode_tables[e->m][c];
+
+	e->m = coded >> 16;
+	return ((coded & 0xff) << 8) | ((coded >> 8) & 0xff);
+}
+
+/* encode @n bytes, all of them are crc'ed if @fcs32 */
+static fec_always_inline void
+fec_block_encode_run(struct fec_block_encoder *e, const uint8_t *in, size_t n,
+		     const int fec, const int use_rsc, const int interleaving,
+		     const int whitening, const int fcs32)
+{
+	size_t i = 0;
+
+	if (!fec) {
+		for (; i < n; i++) {
+			uint8_t c = in[i];
+
+			if (fcs32)
+				e->crc = crc32_byte(e->crc, c);
+
+			if (whitening) {
+				c ^= pn9_tables[e->pn9_pos];
+				if (++e->pn9_pos == sizeof(pn9_tables))
+					e->pn9_pos = 0;
+			}
+
+			e->out[e->len++] = c;
+		}
+		return;
+	}
+
+	/* complete the block of the last call */
+	if (e->npending && n > 0) {
+		if (fcs32)
+			e->crc = crc32_byte(e->crc, in[0]);
+		fec_block_encoder_push_block(e, (e->pending << 16)
+					     | fec_block_encode_byte(e, in[0],
+								     use_rsc),
+					     interleaving, whitening);
+		e->npending = 0;
+		i++;
+	}
+
+	for (; i + 2 <= n; i += 2) {
+		uint32_t hi, lo;
+
+		if (fcs32)
+			e->crc = crc32_byte(crc32_byte(e->crc, in[i]),
+					    in[i + 1]);
+
+		hi = fec_block_encode_byte(e, in[i], use_rsc);
+		lo = fec_block_encode_byte(e, in[i + 1], use_rsc);
+		fec_block_encoder_push_block(e, (hi << 16) | lo,
+					     interleaving, whitening);
+	}
+
+	if (i < n) {
+		if (fcs32)
+			e->crc = crc32_byte(e->crc, in[i]);
+		e->pending = fec_block_encode_byte(e, in[i], use_rsc);
+		e->npending = 1;
+	}
+}
+
+static fec_always_inline void
+fec_block_encode_tmpl(struct fec_block_encoder *e, const uint8_t *in,
+		      size_t n, const int fec, const int use_rsc,
+		      const int interleaving, const int whitening,
+		      const int fcs32)
+{
+	size_t crc_n = 0;
+
+	if (fcs32) {
+		crc_n = e->crc_bytes < n ? e->crc_bytes : n;
+		e->crc_bytes -= crc_n;
+	}
+
+	fec_block_encode_run(e, in, crc_n, fec, use_rsc, interleaving,
+			     whitening, 1);
+	fec_block_encode_run(e, in + crc_n, n - crc_n, fec, use_rsc,
+			     interleaving, whitening, 0);
+}
+
+typedef void (*fec_block_encode_fn)(struct fec_block_encoder *e,
+				    const uint8_t *in, size_t n);
+
+#define FEC_BLOCK_ENCODE_VARIANT(rsc, il, wh, fcs32)			\
+static void fec_block_encode_##rsc##il##wh##fcs32(			\
+			struct fec_block_encoder *e, const uint8_t *in,	\
+			size_t n)					\
+{									\
+	fec_block_encode_tmpl(e, in, n, 1, rsc, il, wh, fcs32);		\
+}
+FEC_FOR_EACH_VARIANT(FEC_BLOCK_ENCODE_VARIANT)
+
+#define FEC_BLOCK_ENCODE_UNCODED_VARIANT(wh, fcs32)			\
+static void fec_block_encode_uncoded_##wh##fcs32(			\
+			struct fec_block_encoder *e, const uint8_t *in,	\
+			size_t n)					\
+{									\
+	fec_block_encode_tmpl(e, in, n, 0, 0, 0, wh, fcs32);		\
+}
+FEC_FOR_EACH_UNCODED_VARIANT(FEC_BLOCK_ENCODE_UNCODED_VARIANT)
+
+#define FEC_BLOCK_ENCODE_ENTRY(rsc, il, wh, fcs32)			\
+	[FEC_VARIANT_IDX(rsc, il, wh, fcs32)] =				\
+		fec_block_encode_##rsc##il##wh##fcs32,
+#define FEC_BLOCK_ENCODE_UNCODED_ENTRY(wh, fcs32)			\
+	[FEC_VARIANTS_MAX + FEC_UNCODED_VARIANT_IDX(wh, fcs32)] =	\
+		fec_block_encode_uncoded_##wh##fcs32,
+static const fec_block_encode_fn
+fec_block_encode_variants[FEC_VARIANTS_MAX + FEC_UNCODED_VARIANTS_MAX] = {
+	FEC_FOR_EACH_VARIANT(FEC_BLOCK_ENCODE_ENTRY)
+	FEC_FOR_EACH_UNCODED_VARIANT(FEC_BLOCK_ENCODE_UNCODED_ENTRY)
+};
+
+void fec_block_encode(struct fec_block_encoder *e, const uint8_t *in,
+		      size_t n)
+{
+	size_t idx;
+
+	if (e->fec)
+		idx = FEC_VARIANT_IDX(!!e->use_rsc, !!e->interleaving,
+				      !!e->whitening, e->crc_bytes > 0);
+	else
+		idx = FEC_VARIANTS_MAX
+			+ FEC_UNCODED_VARIANT_IDX(!!e->whitening,
+						  e->crc_bytes > 0);
+
+	fec_block_encode_variants[idx](e, in, n);
+}
+
+/* encode @n bytes by the byte tables, 2 bytes output for each byte */
+void fec_encode_bytes(int use_rsc, uint8_t *m, const uint8_t *in, size_t n,
+		      uint8_t *out)
+{
+	const uint32_t (*fec)[256];
+
+	init_fec_block_tables();
+	fec = use_rsc ? rsc_encode_tables : nrnsc_encode_tables;
+
+	for (size_t i = 0; i < n; i++) {
+		uint32_t coded = fec[*m & 0b111][in[i]];
+
+		out[i * 2 + 0] = coded & 0xff;
+		out[i * 2 + 1] = (coded >> 8) & 0xff;
+		*m = coded >> 16;
+	}
+}
+
+/* transpose the 64x64 bit matrix, bit k of a[i] is swapped with bit i of
+ * a[k].
+ */
+static void transpose64(uint64_t a[64])
+{
+	uint64_t mask = 0x00000000ffffffffULL;
+
+	for (int j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+		for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+			uint64_t t = ((a[k] >> j) ^ a[k | j]) & mask;
+
+			a[k] ^= t << j;
+			a[k | j] ^= t;
+		}
+	}
+}
+
+static uint64_t load_le64(const uint8_t *p, size_t n)
+{
+	uint64_t x = 0;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if (n == sizeof(x)) {
+		memcpy(&x, p, sizeof(x));
+		return x;
+	}
+#endif
+
+	for (size_t i = 0; i < n; i++)
+		x |= (uint64_t)p[i] << (i * 8);
+
+	return x;
+}
+
+static void store_le64(uint8_t *p, uint64_t x, size_t n)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if (n == sizeof(x)) {
+		memcpy(p, &x, sizeof(x));
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i < n; i++)
+		p[i] = (x >> (i * 8)) & 0xff;
+}
+
+/* encode up to 8 bytes of all lanes, the bit k of each word is the lane k */
+static void fec_bitslice_encode8(int use_rsc, uint8_t *m,
+				 const uint8_t *const in[], uint8_t *const out[],
+				 size_t lanes, size_t bytes)
+{
+	uint64_t x[64] = { 0 }, o[128];
+	uint64_t m0 = 0, m1 = 0, m2 = 0;
+
+	for (size_t k = 0; k < lanes; k++) {
+		x[k] = load_le64(in[k], bytes);
+		m0 |= (uint64_t)((m[k] >> 0) & 1) << k;
+		m1 |= (uint64_t)((m[k] >> 1) & 1) << k;
+		m2 |= (uint64_t)((m[k] >> 2) & 1) << k;
+	}
+
+	transpose64(x);
+
+	/* the symbol of each input bit is pushed as u1 then u0 */
+	for (size_t i = 0; i < bytes * 8; i++) {
+		uint64_t bi = x[i], u1, u0, next;
+
+		if (use_rsc) {
+			next = bi ^ m0 ^ m1 ^ m2;
+			u0 = bi;
+			u1 = next ^ m1 ^ m0;
+		} else {
+			next = bi;
+			u0 = ~(bi ^ m2 ^ m1 ^ m0);
+			u1 = ~(bi ^ m1 ^ m0);
+		}
+
+		o[i * 2 + 0] = u1;
+		o[i * 2 + 1] = u0;
+
+		m0 = m1;
+		m1 = m2;
+		m2 = next;
+	}
+
+	for (size_t i = bytes * 16; i < ARRAY_SIZE(o); i++)
+		o[i] = 0;
+
+	transpose64(&o[0]);
+	transpose64(&o[64]);
+
+	for (size_t k = 0; k < lanes; k++) {
+		size_t n = bytes * 2;
+
+		store_le64(out[k], o[k], n < 8 ? n : 8);
+		if (n > 8)
+			store_le64(out[k] + 8, o[64 + k], n - 8);
+	}
+
+	for (size_t k = 0; k < lanes; k++)
+		m[k] = ((m0 >> k) & 1) | (((m1 >> k) & 1) << 1)
+				    | (((m2 >> k) & 1) << 2);
+}
+
+void fec_bitslice_encode(int use_rsc, uint8_t *m, const uint8_t *const in[],
+			 uint8_t *const out[], size_t lanes, size_t bytes)
+{
+	const uint8_t *pin[FEC_BITSLICE_LANES];
+	uint8_t *pout[FEC_BITSLICE_LANES];
+
+	for (size_t k = 0; k < lanes; k++) {
+		pin[k] = in[k];
+		pout[k] = out[k];
+	}
+
+	for (size_t done = 0; done < bytes; done += 8) {
+		size_t n = bytes - done < 8 ? bytes - done : 8;
+
+		fec_bitslice_encode8(use_rsc, m, pin, pout, lanes, n);
+
+		for (size_t k = 0; k < lanes; k++) {
+			pin[k] += n;
+			pout[k] += n * 2;
+		}
+	}
+}
+
+/* FCS32 syndrome of a single bit error, the difference of the FCS32 residue
+ * caused by flipping a bit which is @k bits before the end of the checked
+ * buffer. The CRC is linear, so it doesn't depend on the buffer contents or
+ * length, one table serves all frames:
+ *
+ *   s[0] = poly
+ *   s[k + 1] = (s[k] >> 1) ^ (s[k] & 1 ? poly : 0)
+ *
+ * A syndrome to distance hash index makes each lookup O(1).
+ */
+#define FCS32_SYNDROME_HASH_SIZE	32768	/* power of 2, > max bits */
+
+struct fcs32_syndrome_slot {
+	uint32_t	syndrome;
+	uint16_t	k;
+	uint16_t	used;
+};
+
+static uint32_t fcs32_syndromes[IEEE_802154_FCS32_REPAIR_MAX_BITS];
+static struct fcs32_syndrome_slot fcs32_syndrome_hash[FCS32_SYNDROME_HASH_SIZE];
+static int fcs32_syndrome_inited = 0;
+
+static size_t fcs32_syndrome_hash_idx(uint32_t syndrome)
+{
+	return (syndrome * 0x9e3779b1u) >> 17;
+}
+
+static void fcs32_syndrome_init(void)
+{
+	uint32_t s = FCS32_POLY_REFLECTED;
+
+	for (size_t k = 0; k < ARRAY_SIZE(fcs32_syndromes); k++) {
+		size_t idx = fcs32_syndrome_hash_idx(s);
+
+		fcs32_syndromes[k] = s;
+
+		while (fcs32_syndrome_hash[idx].used)
+			idx = (idx + 1) % FCS32_SYNDROME_HASH_SIZE;
+
+		fcs32_syndrome_hash[idx].syndrome = s;
+		fcs32_syndrome_hash[idx].k = k;
+		fcs32_syndrome_hash[idx].used = 1;
+
+		s = (s >> 1) ^ (s & 1 ? FCS32_POLY_REFLECTED : 0);
+	}
+}
+
+void init_fcs32_syndrome_tables(void)
+{
+	if (!fcs32_syndrome_inited) {
+		fcs32_syndrome_inited = 1;
+		fcs32_syndrome_init();
+	}
+}
+
+/* Return the bit distance of @syndrome, -1 if it is not a single bit error
+ * within @nbits.
+ */
+static long fcs32_syndrome_lookup(uint32_t syndrome, size_t nbits)
+{
+	size_t idx = fcs32_syndrome_hash_idx(syndrome);
+
+	while (fcs32_syndrome_hash[idx].used) {
+		if (fcs32_syndrome_hash[idx].syndrome == syndrome)
+			return fcs32_syndrome_hash[idx].k < nbits ?
+				fcs32_syndrome_hash[idx].k : -1;
+
+		idx = (idx + 1) % FCS32_SYNDROME_HASH_SIZE;
+	}
+
+	return -1;
+}
+
+/* The short buffer is checked with zero padding between the payload and the
+ * FCS, see ieee_802154_fcs32_buf_is_good. Map the bit distance in the
+ * checked buffer to the bit index of @buf, -1 if it is a padding bit.
+ */
+static long fcs32_distance_to_bit(size_t k, size_t len)
+{
+	size_t checked_len = len < 8 ? 8 : len;
+	size_t byte = checked_len - 1 - k / 8, bit = 7 - k % 8;
+
+	if (len < 8) {
+		size_t payload_sz = len - 4;
+
+		if (byte >= payload_sz && byte < 4)
+			return -1;
+		else if (byte >= 4)
+			byte = byte - 4 + payload_sz;
+	}
+
+	return byte * 8 + bit;
+}
+
+int ieee_802154_fcs32_repair(uint8_t *buf, size_t len, int max_errors,
+			     size_t *ret_bits)
+{
+	size_t checked_len = len < 8 ? 8 : len, nbits = checked_len * 8;
+	uint32_t syndrome = IEEE_802154_FCS32_INIT;
+	long a = -1, b = -1;
+
+	if (len <= sizeof(syndrome) || nbits > IEEE_802154_FCS32_REPAIR_MAX_BITS)
+		return -1;
+
+	init_fcs32_syndrome_tables();
+
+	if (len < 8) {
+		uint8_t padding[8] = { 0 };
+
+		memcpy(padding, buf, len - 4);
+		memcpy(&padding[4], &buf[len - 4], 4);
+		syndrome = ieee_802154_fcs32(syndrome, padding, sizeof(padding));
+	} else {
+		syndrome = ieee_802154_fcs32(syndrome, buf, len);
+	}
+
+	syndrome ^= IEEE_802154_FCS32_GOOD;
+	if (syndrome == 0)
+		return 0;
+
+	a = fcs32_syndrome_lookup(syndrome, nbits);
+	if (a >= 0) {
+		a = fcs32_distance_to_bit(a, len);
+		if (a < 0)
+			return -1;
+
+		buf[a / 8] ^= 1 << (a % 8);
+		ret_bits[0] = a;
+		return 1;
+	}
+
+	if (max_errors < 2)
+		return -1;
+
+	/* s = s[i] ^ s[j], the pair is unique only if no other pair matches */
+	for (size_t i = 0; i < nbits; i++) {
+		long j = fcs32_syndrome_lookup(syndrome ^ fcs32_syndromes[i],
+					       nbits);
+
+		if (j <= (long)i)
+			continue;
+
+		if (a >= 0) /* ambiguous */
+			return -1;
+
+		a = i;
+		b = j;
+	}
+
+	if (a < 0)
+		return -1;
+
+	a = fcs32_distance_to_bit(a, len);
+	b = fcs32_distance_to_bit(b, len);
+	if (a < 0 || b < 0)
+		return -1;
+
+	buf[a / 8] ^= 1 << (a % 8);
+	buf[b / 8] ^= 1 << (b % 8);
+	ret_bits[0] = a < b ? a : b;
+	ret_bits[1] = a < b ? b : a;
+	return 2;
+}
+
+static uint64_t peek_le(const uint8_t *p, size_t n)
+{
+	uint64_t v = 0;
+
+	while (n-- > 0)
+		v = (v << 8) | p[n];
+
+	return v;
+}
+
+/* IEEE 802.15.4-2015 Table 7-2, PAN ID fields of frame version 2 */
+static void ieee_802154_mhr_v2_pan(struct ieee_802154_mhr *mhr,
+				   int compression, int *dst_pan, int *src_pan)
+{
+	int dst = mhr->dst_mode != IEEE_802154_ADDR_NONE;
+	int src = mhr->src_mode != IEEE_802154_ADDR_NONE;
+
+	*dst_pan = *src_pan = 0;
+
+	if (!dst && !src) {
+		*dst_pan = compression;
+	} else if (dst && !src) {
+		*dst_pan = !compression;
+	} else if (!dst && src) {
+		*src_pan = !compression;
+	} else if (mhr->dst_mode == IEEE_802154_ADDR_EXT
+		   && mhr->src_mode == IEEE_802154_ADDR_EXT) {
+		*dst_pan = !compression;
+	} else {
+		*dst_pan = 1;
+		*src_pan = !compression;
+	}
+}
+
+int ieee_802154_mhr_parse(const uint8_t *buf, size_t len,
+			  struct ieee_802154_mhr *mhr)
+{
+	static const uint8_t addr_size[4] = { 0, 0, 2, 8 };
+	int compression, dst_pan, src_pan;
+	size_t pos = 2;
+
+	if (len < 2)
+		return -1;
+
+	memset(mhr, 0, sizeof(*mhr));
+	mhr->fc = buf[0] | (buf[1] << 8);
+	mhr->frame_type = mhr->fc & 0x7;
+	mhr->security = !!(mhr->fc & (1 << 3));
+	compression = !!(mhr->fc & (1 << 6));
+	mhr->dst_mode = (mhr->fc >> 10) & 0x3;
+	mhr->frame_version = (mhr->fc >> 12) & 0x3;
+	mhr->src_mode = (mhr->fc >> 14) & 0x3;
+	mhr->dst_pan = mhr->src_pan = IEEE_802154_PAN_NONE;
+	mhr->seq = -1;
+
+	/* the multipurpose, fragment and extended frames have other FC */
+	if (mhr->frame_type > IEEE_802154_FRAME_CMD
+	    || mhr->dst_mode == 1 || mhr->src_mode == 1)
+		return -1;
+
+	if (mhr->frame_version == 2) {
+		mhr->ie_present = !!(mhr->fc & (1 << 9));
+		ieee_802154_mhr_v2_pan(mhr, compression, &dst_pan, &src_pan);
+	} else {
+		dst_pan = mhr->dst_mode != IEEE_802154_ADDR_NONE;
+		src_pan = mhr->src_mode != IEEE_802154_ADDR_NONE && !compression;
+	}
+
+	if (!(mhr->frame_version == 2 && (mhr->fc & (1 << 8)))) {
+		if (pos + 1 > len)
+			return -1;
+		mhr->seq = buf[pos++];
+	}
+
+	if (pos + dst_pan * 2 + addr_size[mhr->dst_mode] + src_pan * 2
+	    + addr_size[mhr->src_mode] > len)
+		return -1;
+
+	if (dst_pan) {
+		mhr->dst_pan = peek_le(&buf[pos], 2);
+		pos += 2;
+	}
+
+	mhr->dst_addr = peek_le(&buf[pos], addr_size[mhr->dst_mode]);
+	pos += addr_size[mhr->dst_mode];
+
+	if (src_pan) {
+		mhr->src_pan = peek_le(&buf[pos], 2);
+		pos += 2;
+	} else if (mhr->src_mode != IEEE_802154_ADDR_NONE) {
+		/* the source is in the destination PAN */
+		mhr->src_pan = mhr->dst_pan;
+	}
+
+	mhr->src_addr = peek_le(&buf[pos], addr_size[mhr->src_mode]);
+	pos += addr_size[mhr->src_mode];
+
+	if (mhr->security) {
+		static const uint8_t key_id_size[4] = { 0, 1, 5, 9 };
+		uint8_t sc;
+
+		if (pos + 1 > len)
+			return -1;
+
+		sc = buf[pos++];
+		/* the frame counter is suppressed in version 2 */
+		if (!(mhr->frame_version == 2 && (sc & (1 << 5))))
+			pos += 4;
+		pos += key_id_size[(sc >> 3) & 0x3];
+		if (pos > len)
+			return -1;
+	}
+
+	mhr->len = pos;
+	return 0;
+}
+
+/*
+ * Runtime dispatch of the SIMD variants.
+ *
+ * The variants of each ISA are built from the same bodies below by the
+ * target attribute, with the vector width of the ISA, so one binary runs on
+ * any x86_64 CPU. The CPU is probed once by wisun_fsk_isa_init() and the
+ * kernels are called by the pointers of the selected table.
+ */
+static const char *const wisun_fsk_isa_names[WISUN_FSK_ISA_MAX] = {
+	[WISUN_FSK_ISA_SCALAR]	= "scalar",
+	[WISUN_FSK_ISA_SSE42]	= "sse4.2",
+	[WISUN_FSK_ISA_AVX2]	= "avx2",
+	[WISUN_FSK_ISA_AVX512]	= "avx512",
+};
+
+static const char *const wisun_fsk_kernel_names[WISUN_FSK_KERNEL_MAX] = {
+	[WISUN_FSK_KERNEL_PN9]		= "pn9",
+	[WISUN_FSK_KERNEL_INTERLEAVING]	= "interleaving",
+	[WISUN_FSK_KERNEL_FCS32]	= "fcs32",
+	[WISUN_FSK_KERNEL_FEC_DECODE]	= "fec_decode",
+};
+
+const char *wisun_fsk_isa_name(enum wisun_fsk_isa isa)
+{
+	return isa < WISUN_FSK_ISA_MAX ? wisun_fsk_isa_names[isa] : "unknown";
+}
+
+const char *wisun_fsk_kernel_name(enum wisun_fsk_kernel k)
+{
+	return k < WISUN_FSK_KERNEL_MAX ? wisun_fsk_kernel_names[k] : "unknown";
+}
+
+int wisun_fsk_isa_parse(const char *name)
+{
+	for (int isa = 0; isa < WISUN_FSK_ISA_MAX; isa++) {
+		if (!strcmp(name, wisun_fsk_isa_names[isa]))
+			return isa;
+	}
+
+	return -1;
+}
+
+/* The de-interleaving is a transpose of the 4x4 matrix of 2-bit symbols,
+ * one row a byte, see interleaving_symbol_target. It's done by two delta
+ * swaps of the little endian word @x: the 2x2 sub-matrices first, then the
+ * symbols inside them. @x can be a vector of words.
+ */
+#define INTERLEAVING_TRANSPOSE(x, t) do {				\
+	t = ((x >> 20) ^ x) & 0x00000f0f;				\
+	x ^= t ^ (t << 20);						\
+	t = ((x >> 10) ^ x) & 0x00330033;				\
+	x ^= t ^ (t << 10);						\
+} while (0)
+
+#define FEC_ISA_CHUNK_BLOCKS	64
+/* the chunk isn't worth for a few blocks, e.g. the PHR */
+#define FEC_ISA_MIN_BLOCKS	8
+
+/* De-whiten and de-interleave a chunk of blocks by the vector kernels, then
+ * FEC decode them by the scalar variant without these stages.
+ */
+static fec_always_inline int
+fec_block_decode_isa_tmpl(struct fec_block_decoder *d, const uint8_t *in,
+			  size_t blocks, uint8_t *out,
+			  void (*pn9_xor)(uint8_t *, size_t, size_t),
+			  void (*deinterleave)(const uint8_t *, size_t,
+					       uint8_t *))
+{
+	uint8_t chunk[FEC_ISA_CHUNK_BLOCKS * 4];
+
+	if ((!d->whitening && !d->interleaving)
+	    || blocks < FEC_ISA_MIN_BLOCKS)
+		return fec_block_decode_scalar(d, in, blocks, out);
+
+	while (blocks > 0) {
+		size_t n = blocks < FEC_ISA_CHUNK_BLOCKS
+				? blocks : FEC_ISA_CHUNK_BLOCKS;
+		size_t idx = FEC_VARIANT_IDX(!!d->use_rsc, 0, 0,
+					     d->crc_bytes > 0);
+
+		memcpy(chunk, in, n * 4);
+		if (d->whitening)
+			pn9_xor(chunk, n * 4, d->pn9_pos);
+		if (d->interleaving)
+			deinterleave(chunk, n * 32, chunk);
+
+		if (fec_block_decode_variants[idx](d, chunk, n, out) < 0)
+			return -1;
+
+		if (d->whitening)
+			d->pn9_pos = (d->pn9_pos + n * 4) % sizeof(pn9_tables);
+		in += n * 4;
+		out += n * 2;
+		blocks -= n;
+	}
+
+	return 0;
+}
+
+#ifdef WISUN_FSK_ISA_X86
+/* The reflected CRC32 folded by carry-less multiplication, based on
+ * <Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction>
+ * of Intel. @len >= 64, the register isn't inverted like crc32_byte.
+ */
+#define CRC32_PCLMUL_BODY()						\
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);\
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);\
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);		\
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);\
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);		\
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;				\
+									\
+	x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));		\
+	x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));		\
+	x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));		\
+	x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));		\
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));			\
+	buf += 64;							\
+	len -= 64;							\
+									\
+	/* fold 4 x 128 bits in parallel */				\
+	for (; len >= 64; buf += 64, len -= 64) {			\
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);		\
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);		\
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);		\
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);		\
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);		\
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);		\
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);		\
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);		\
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),		\
+			_mm_loadu_si128((const __m128i *)(buf + 0x00)));\
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),		\
+			_mm_loadu_si128((const __m128i *)(buf + 0x10)));\
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),		\
+			_mm_loadu_si128((const __m128i *)(buf + 0x20)));\
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),		\
+			_mm_loadu_si128((const __m128i *)(buf + 0x30)));\
+	}								\
+									\
+	/* to 128 bits */						\
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);			\
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);			\
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);			\
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);			\
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);			\
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);			\
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);			\
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);			\
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);			\
+									\
+	for (; len >= 16; buf += 16, len -= 16) {			\
+		x2 = _mm_loadu_si128((const __m128i *)buf);		\
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);		\
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);		\
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);		\
+	}								\
+									\
+	/* to 64 bits */						\
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);			\
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);			\
+	x2 = _mm_srli_si128(x1, 4);					\
+	x1 = _mm_and_si128(x1, mask32);					\
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);			\
+	x1 = _mm_xor_si128(x1, x2);					\
+									\
+	/* Barrett reduction to 32 bits */				\
+	x2 = _mm_and_si128(x1, mask32);					\
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);			\
+	x2 = _mm_and_si128(x2, mask32);					\
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);			\
+	x1 = _mm_xor_si128(x1, x2);					\
+									\
+	crc = _mm_extract_epi32(x1, 1);
+
+/* Define the kernels of ISA @name, built with @isa_target and the @width
+ * bytes vectors of the gcc vector extensions.
+ */
+#define WISUN_FSK_ISA_VARIANT(name, isa_target, width)			\
+typedef uint8_t isa_u8_##name __attribute__((vector_size(width)));	\
+typedef uint32_t isa_u32_##name __attribute__((vector_size(width)));	\
+									\
+static __attribute__((target(isa_target))) void				\
+pn9_xor_##name(uint8_t *buf, size_t n, size_t pos)			\
+{									\
+	size_t i = 0;							\
+									\
+	for (; i + width <= n; i += width) {				\
+		isa_u8_##name a, b;					\
+									\
+		memcpy(&a, buf + i, width);				\
+		memcpy(&b, pn9_tables_ext + pos, width);		\
+		a ^= b;							\
+		memcpy(buf + i, &a, width);				\
+									\
+		pos += width;						\
+		if (pos >= sizeof(pn9_tables))				\
+			pos -= sizeof(pn9_tables);			\
+	}								\
+									\
+	pn9_xor_scalar(buf + i, n - i, pos);				\
+}									\
+									\
+static __attribute__((target(isa_target))) void				\
+interleaving_bits_##name(const uint8_t *buf, size_t binary_bits,	\
+			 uint8_t *out)					\
+{									\
+	size_t n = binary_bits / 32 * 4, i = 0;				\
+									\
+	for (; i + width <= n; i += width) {				\
+		isa_u32_##name x, t;					\
+									\
+		memcpy(&x, buf + i, width);				\
+		INTERLEAVING_TRANSPOSE(x, t);				\
+		memcpy(out + i, &x, width);				\
+	}								\
+									\
+	for (; i < n; i += 4) {						\
+		uint32_t x, t;						\
+									\
+		memcpy(&x, buf + i, 4);					\
+		INTERLEAVING_TRANSPOSE(x, t);				\
+		memcpy(out + i, &x, 4);					\
+	}								\
+}									\
+									\
+static __attribute__((target(isa_target ",pclmul"))) uint32_t		\
+crc32_update_##name(uint32_t crc, const uint8_t *buf, size_t len)	\
+{									\
+	if (len >= 64) {						\
+		CRC32_PCLMUL_BODY()					\
+	}								\
+									\
+	return crc32_update_scalar(crc, buf, len);			\
+}									\
+									\
+static __attribute__((target(isa_target))) int				\
+fec_block_decode_##name(struct fec_block_decoder *d, const uint8_t *in,\
+			size_t blocks, uint8_t *out)			\
+{									\
+	return fec_block_decode_isa_tmpl(d, in, blocks, out,		\
+					 pn9_xor_##name,		\
+					 interleaving_bits_##name);	\
+}
+
+WISUN_FSK_ISA_VARIANT(sse42, "sse4.2", 16)
+WISUN_FSK_ISA_VARIANT(avx2, "avx2", 32)
+WISUN_FSK_ISA_VARIANT(avx512, "avx512f,avx512bw", 64)
+
+#define WISUN_FSK_ISA_ENTRY(isa, name)					\
+	[isa] = {							\
+		.pn9_xor		= pn9_xor_##name,		\
+		.interleaving_bits	= interleaving_bits_##name,	\
+		.crc32_update		= crc32_update_##name,		\
+		.fec_block_decode	= fec_block_decode_##name,	\
+	},
+#else
+#define WISUN_FSK_ISA_ENTRY(isa, name)
+#endif
+
+static const struct wisun_fsk_isa_kernels
+wisun_fsk_isa_kernels_table[WISUN_FSK_ISA_MAX] = {
+	[WISUN_FSK_ISA_SCALAR] = {
+		.pn9_xor		= pn9_xor_scalar,
+		.interleaving_bits	= interleaving_bits_scalar,
+		.crc32_update		= crc32_update_scalar,
+		.fec_block_decode	= fec_block_decode_scalar,
+	},
+	WISUN_FSK_ISA_ENTRY(WISUN_FSK_ISA_SSE42, sse42)
+	WISUN_FSK_ISA_ENTRY(WISUN_FSK_ISA_AVX2, avx2)
+	WISUN_FSK_ISA_ENTRY(WISUN_FSK_ISA_AVX512, avx512)
+};
+
+static const struct wisun_fsk_isa_kernels *isa_kernels =
+	&wisun_fsk_isa_kernels_table[WISUN_FSK_ISA_SCALAR];
+
+bool wisun_fsk_isa_supported(enum wisun_fsk_isa isa)
+{
+#ifdef WISUN_FSK_ISA_X86
+	__builtin_cpu_init();
+
+	switch (isa) {
+	case WISUN_FSK_ISA_SCALAR:
+		return true;
+	case WISUN_FSK_ISA_SSE42:
+		return __builtin_cpu_supports("sse4.2")
+			&& __builtin_cpu_supports("pclmul");
+	case WISUN_FSK_ISA_AVX2:
+		return wisun_fsk_isa_supported(WISUN_FSK_ISA_SSE42)
+			&& __builtin_cpu_supports("avx2");
+	case WISUN_FSK_ISA_AVX512:
+		return wisun_fsk_isa_supported(WISUN_FSK_ISA_AVX2)
+			&& __builtin_cpu_supports("avx512f")
+			&& __builtin_cpu_supports("avx512bw");
+	default:
+		return false;
+	}
+#else
+	return isa == WISUN_FSK_ISA_SCALAR;
+#endif
+}
+
+int wisun_fsk_isa_select(enum wisun_fsk_isa isa)
+{
+	if (!wisun_fsk_isa_supported(isa))
+		return -1;
+
+	isa_kernels = &wisun_fsk_isa_kernels_table[isa];
+	return 0;
+}
+
+enum wisun_fsk_isa wisun_fsk_isa_current(void)
+{
+	return isa_kernels - wisun_fsk_isa_kernels_table;
+}
+
+enum wisun_fsk_isa wisun_fsk_isa_init(void)
+{
+	enum wisun_fsk_isa isa = WISUN_FSK_ISA_MAX - 1;
+
+	while (isa > WISUN_FSK_ISA_SCALAR && !wisun_fsk_isa_supported(isa))
+		isa--;
+
+	wisun_fsk_isa_select(isa);
+	return isa;
+}
+
+static uint64_t isa_verify_rand(uint64_t *s)
+{
+	/* splitmix64 */
+	uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static void isa_verify_fill(uint64_t *s, uint8_t *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		buf[i] = isa_verify_rand(s);
+}
+
+#define ISA_VERIFY_MAX_BYTES		2048
+
+/* a random valid coded frame, or with a flipped bit sometimes */
+static int isa_verify_fec_decode(const struct wisun_fsk_isa_kernels *ref,
+				 const struct wisun_fsk_isa_kernels *k,
+				 uint64_t *s)
+{
+	uint8_t psdu[ISA_VERIFY_MAX_BYTES / 2], coded[ISA_VERIFY_MAX_BYTES];
+	uint8_t out_ref[ISA_VERIFY_MAX_BYTES / 2], out[ISA_VERIFY_MAX_BYTES / 2];
+	struct fec_block_decoder d_ref, d;
+	struct fec_block_encoder e;
+	uint64_t r = isa_verify_rand(s);
+	size_t n = 2 * (1 + r % (sizeof(psdu) / 2));
+	int use_rsc = (r >> 16) & 1, interleaving = (r >> 17) & 1;
+	int whitening = (r >> 18) & 1;
+	size_t pn9_pos = (r >> 20) % sizeof(pn9_tables);
+	int ret_ref, ret;
+
+	isa_verify_fill(s, psdu, n);
+	fec_block_encoder_init(&e, 1, use_rsc, interleaving, coded);
+	e.whitening = whitening;
+	e.pn9_pos = pn9_pos;
+	fec_block_encode(&e, psdu, n);
+
+	if (((r >> 32) & 3) == 0) {
+		size_t bit = (r >> 34) % (e.len * 8);
+
+		coded[bit / 8] ^= 1 << (bit % 8);
+	}
+
+	fec_block_decoder_init(&d_ref, use_rsc, interleaving);
+	d_ref.whitening = whitening;
+	d_ref.pn9_pos = pn9_pos;
+	d_ref.crc_bytes = (r >> 40) % (n + 1);
+	d = d_ref;
+	memset(out_ref, 0, sizeof(out_ref));
+	memset(out, 0, sizeof(out));
+
+	ret_ref = ref->fec_block_decode(&d_ref, coded, e.len / 4, out_ref);
+	ret = k->fec_block_decode(&d, coded, e.len / 4, out);
+	if (ret != ret_ref || memcmp(out, out_ref, sizeof(out)))
+		return -1;
+
+	/* the state of a failed decoder is not used */
+	if (ret == 0 && (d.m != d_ref.m || d.pn9_pos != d_ref.pn9_pos
+			 || d.crc != d_ref.crc || d.crc_bytes != d_ref.crc_bytes))
+		return -1;
+
+	return 0;
+}
+
+static int isa_verify_round(const struct wisun_fsk_isa_kernels *ref,
+			    const struct wisun_fsk_isa_kernels *k,
+			    enum wisun_fsk_kernel kernel, uint64_t *s)
+{
+	uint8_t in[ISA_VERIFY_MAX_BYTES];
+	uint8_t a[ISA_VERIFY_MAX_BYTES], b[ISA_VERIFY_MAX_BYTES];
+	uint64_t r = isa_verify_rand(s);
+	size_t len = r % (sizeof(in) + 1), pos, bits;
+
+	isa_verify_fill(s, in, sizeof(in));
+	memcpy(a, in, sizeof(a));
+	memcpy(b, in, sizeof(b));
+
+	switch (kernel) {
+	case WISUN_FSK_KERNEL_PN9:
+		pos = (r >> 32) % sizeof(pn9_tables);
+		ref->pn9_xor(a, len, pos);
+		k->pn9_xor(b, len, pos);
+		break;
+	case WISUN_FSK_KERNEL_INTERLEAVING:
+		/* the trailing bits of a partial block are not touched */
+		bits = (r >> 32) % (len * 8 + 1);
+		ref->interleaving_bits(in, bits, a);
+		k->interleaving_bits(in, bits, b);
+		break;
+	case WISUN_FSK_KERNEL_FCS32:
+		return ref->crc32_update(r >> 32, in, len)
+			== k->crc32_update(r >> 32, in, len) ? 0 : -1;
+	case WISUN_FSK_KERNEL_FEC_DECODE:
+		return isa_verify_fec_decode(ref, k, s);
+	default:
+		return -1;
+	}
+
+	return memcmp(a, b, sizeof(a)) ? -1 : 0;
+}
+
+unsigned long wisun_fsk_isa_verify(enum wisun_fsk_isa isa,
+				   enum wisun_fsk_kernel kernel,
+				   unsigned long rounds, uint64_t seed)
+{
+	const struct wisun_fsk_isa_kernels *ref, *k;
+	unsigned long mismatches = 0;
+
+	wisun_fsk_common_init();
+	ref = &wisun_fsk_isa_kernels_table[WISUN_FSK_ISA_SCALAR];
+	k = &wisun_fsk_isa_kernels_table[isa];
+
+	for (unsigned long i = 0; i < rounds; i++) {
+		if (isa_verify_round(ref, k, kernel, &seed) < 0)
+			mismatches++;
+	}
+
+	return mismatches;
+}
@@ -18,6 +18,47 @@ struct bufwrite {
 	int	err;
 };
 
+#define number_is_even(n)		(((n) & 1) == 0)
+
+void wisun_fsk_common_init(void);
+
+/* The hot kernels(PN9, interleaving, FCS32 and the fused FEC decoder) have
+ * variants for the SIMD extensions of x86_64. wisun_fsk_isa_init() probes
+ * the CPU and binds the best variants, the scalar ones are used before that
+ * and on the other architectures.
+ */
+enum wisun_fsk_isa {
+	WISUN_FSK_ISA_SCALAR,
+	WISUN_FSK_ISA_SSE42,	/* and PCLMULQDQ */
+	WISUN_FSK_ISA_AVX2,
+	WISUN_FSK_ISA_AVX512,	/* AVX512F and AVX512BW */
+	WISUN_FSK_ISA_MAX,
+};
+
+enum wisun_fsk_kernel {
+	WISUN_FSK_KERNEL_PN9,
+	WISUN_FSK_KERNEL_INTERLEAVING,
+	WISUN_FSK_KERNEL_FCS32,
+	WISUN_FSK_KERNEL_FEC_DECODE,
+	WISUN_FSK_KERNEL_MAX,
+};
+
+const char *wisun_fsk_isa_name(enum wisun_fsk_isa isa);
+const char *wisun_fsk_kernel_name(enum wisun_fsk_kernel k);
+/* return the ISA of @name, -1 if unknown */
+int wisun_fsk_isa_parse(const char *name);
+bool wisun_fsk_isa_supported(enum wisun_fsk_isa isa);
+enum wisun_fsk_isa wisun_fsk_isa_init(void);
+/* bind the variants of @isa, -1 if the CPU doesn't support it */
+int wisun_fsk_isa_select(enum wisun_fsk_isa isa);
+enum wisun_fsk_isa wisun_fsk_isa_current(void);
+/* Run the @isa variant of @kernel and the scalar one on @rounds random
+ * inputs, return the rounds whose results are different.
+ */
+unsigned long wisun_fsk_isa_verify(enum wisun_fsk_isa isa,
+				   enum wisun_fsk_kernel kernel,
+				   unsigned long rounds, uint64_t seed);
+
 void bufwrite_init(struct bufwrite *b, uint8_t *buf, size_t bufsize);
 
 uint8_t *bufwrite_push_le8(struct bufwrite *b, uint8_t u8);
@@ -29,7 +70,11 @@ uint8_t reverse8(uint8_t x);
 uint16_t reverse16(uint16_t x);
 uint32_t reverse32(uint32_t x);
 
+/* the PN9 sequence repeats every PN9_TABLE_SIZE bytes */
+#define PN9_TABLE_SIZE		511
+
 void pn9_payload_decode(uint8_t *buf, size_t byte_size);
+void pn9_payload_decode_offset(uint8_t *buf, size_t byte_size, size_t offset);
 
 #define RSC_INIT_M	0
 #define NRNSC_INIT_M	0
@@ -44,11 +89,128 @@ int nrnsc_decode(uint8_t *m, uint8_t *encode_buf, size_t encode_bits,
 
 void interleaving_bits(const uint8_t *buf, size_t binary_bits, uint8_t *out);
 
+/* Fused decoder of the 32-bit coded blocks, each block is de-whitened,
+ * de-interleaved, FEC decoded to 2 bytes and feeded to the running FCS32
+ * in registers, without the staged passes over the whole buffer.
+ */
+struct fec_block_decoder {
+	int		use_rsc;
+	int		interleaving;
+	int		whitening;	/* can be changed after the PHR block */
+	uint8_t		m;
+	size_t		pn9_pos;
+	uint32_t	crc;
+	size_t		crc_bytes;	/* decoded bytes still to be crc'ed */
+	size_t		blocks;		/* decoded, the next one failed on error */
+};
+
+void init_fec_block_tables(void);
+void fec_block_decoder_init(struct fec_block_decoder *d, int use_rsc,
+			    int interleaving);
+/* decode @blocks 4-byte blocks to 2 bytes each, @out can be the same buffer
+ * as @in. Return -1 if any symbol is not decodable.
+ */
+int fec_block_decode(struct fec_block_decoder *d, const uint8_t *in,
+		     size_t blocks, uint8_t *out);
+
+/* Fused encoder, the input bytes are crc'ed, FEC encoded, interleaved and
+ * whitened block by block and written to the final output buffer.
+ */
+struct fec_block_encoder {
+	int		fec;		/* 0: uncoded, the bytes are only whitened */
+	int		use_rsc;
+	int		interleaving;
+	int		whitening;	/* can be changed after the PHR */
+	uint8_t		m;
+	size_t		pn9_pos;
+	uint32_t	crc;
+	size_t		crc_bytes;	/* input bytes still to be crc'ed */
+	uint32_t	pending;	/* coded bits of the first byte in block */
+	int		npending;
+	uint8_t		*out;
+	size_t		len;		/* bytes written to @out */
+};
+
+void fec_block_encoder_init(struct fec_block_encoder *e, int fec, int use_rsc,
+			    int interleaving, uint8_t *out);
+/* the coded frame has even bytes, a block is written for each 2 bytes */
+void fec_block_encode(struct fec_block_encoder *e, const uint8_t *in,
+		      size_t n);
+
+/* encode @n bytes to @out by the byte tables, 2 bytes for each byte */
+void fec_encode_bytes(int use_rsc, uint8_t *m, const uint8_t *in, size_t n,
+		      uint8_t *out);
+
+/* Bit-sliced FEC encoder, the same @bytes of up to 64 independent frames
+ * are encoded together. The frames are transposed so that each bit of a
+ * 64-bit word is one frame, and the memory states of all frames are updated
+ * by plain XOR of the words. @m is the memory state of each lane.
+ */
+#define FEC_BITSLICE_LANES	64
+
+void fec_bitslice_encode(int use_rsc, uint8_t *m, const uint8_t *const in[],
+			 uint8_t *const out[], size_t lanes, size_t bytes);
+
 uint16_t ieee_802154_fcs16(uint16_t crc, const uint8_t *buf, size_t sz);
 
 #define IEEE_802154_FCS32_INIT		0xffffffff
 #define IEEE_802154_FCS32_GOOD		0x2144df1c
 uint32_t ieee_802154_fcs32(uint32_t crc, const uint8_t *buf, size_t sz);
 bool ieee_802154_fcs32_buf_is_good(const uint8_t *buf, size_t len);
+/* The FCS32 change when the bytes of a message are xor'ed with @delta(@n
+ * bytes), which is followed by @tail_len bytes(including the padding of a
+ * short message). The cost is O(@n + log(@tail_len)).
+ */
+void init_fcs32_delta_tables(void);
+uint32_t ieee_802154_fcs32_delta(const uint8_t *delta, size_t n,
+				 size_t tail_len);
+
+/* Repair up to @max_errors(1 or 2) bit errors in the PSDU @buf(FCS included)
+ * by the CRC syndrome, the flipped bit index(lsb first) are saved in
+ * @ret_bits. Return the repaired bits, 0 if the FCS is good already, -1 if
+ * the errors can't be located or the location is ambiguous.
+ */
+#define IEEE_802154_FCS32_REPAIR_MAX_BITS	(2047 * 8)
+
+void init_fcs32_syndrome_tables(void);
+int ieee_802154_fcs32_repair(uint8_t *buf, size_t len, int max_errors,
+			     size_t *ret_bits);
+
+/* The 802.15.4 MAC header(MHR), the addresses are saved in host order */
+#define IEEE_802154_FRAME_BEACON		0
+#define IEEE_802154_FRAME_DATA			1
+#define IEEE_802154_FRAME_ACK			2
+#define IEEE_802154_FRAME_CMD			3
+#define IEEE_802154_FRAME_MULTIPURPOSE		5
+#define IEEE_802154_FRAME_FRAG			6
+#define IEEE_802154_FRAME_EXTENDED		7
+
+#define IEEE_802154_ADDR_NONE			0
+#define IEEE_802154_ADDR_SHORT			2
+#define IEEE_802154_ADDR_EXT			3
+
+#define IEEE_802154_PAN_NONE			0xffffffff
+
+struct ieee_802154_mhr {
+	uint16_t	fc;
+	uint8_t		frame_type;
+	uint8_t		frame_version;
+	uint8_t		security;
+	uint8_t		ie_present;
+	int		seq;			/* -1: suppressed */
+	uint32_t	dst_pan;		/* IEEE_802154_PAN_NONE: absent */
+	uint32_t	src_pan;
+	uint8_t		dst_mode;
+	uint8_t		src_mode;
+	uint64_t	dst_addr;
+	uint64_t	src_addr;
+	size_t		len;			/* without IEs */
+};
+
+/* parse the MHR of the PSDU @buf(@len bytes, FCS excluded), the PAN ID
+ * compression is resolved. Return -1 if the MHR is truncated or invalid.
+ */
+int ieee_802154_mhr_parse(const uint8_t *buf, size_t len,
+			  struct ieee_802154_mhr *mhr);
 
 #endif
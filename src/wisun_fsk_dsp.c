@@ -0,0 +1,1181 @@
+/*
+ * dsp helper functions for demodulating wisun fsk from IQ samples
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "wisun_fsk_common.h"
+#include "wisun_fsk_dsp.h"
+
+static const char *iq_sample_format_names[IQ_FORMAT_MAX] = {
+	[IQ_FORMAT_CF32] = "cf32",
+	[IQ_FORMAT_CS16] = "cs16",
+	[IQ_FORMAT_CS8]  = "cs8",
+	[IQ_FORMAT_CU8]  = "cu8",
+};
+
+int iq_sample_format_parse(const char *name)
+{
+	for (int fmt = 0; fmt < IQ_FORMAT_MAX; fmt++) {
+		if (!strcmp(name, iq_sample_format_names[fmt]))
+			return fmt;
+	}
+
+	return -1;
+}
+
+const char *iq_sample_format_name(enum iq_sample_format fmt)
+{
+	if (fmt < IQ_FORMAT_MAX)
+		return iq_sample_format_names[fmt];
+
+	return "unknown";
+}
+
+size_t iq_sample_size(enum iq_sample_format fmt)
+{
+	switch (fmt) {
+	case IQ_FORMAT_CF32:
+		return 2 * sizeof(float);
+	case IQ_FORMAT_CS16:
+		return 2 * sizeof(int16_t);
+	case IQ_FORMAT_CS8:
+	case IQ_FORMAT_CU8:
+		return 2;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+void iq_samples_to_float(enum iq_sample_format fmt, const void *raw, size_t n,
+			 float *re, float *im)
+{
+	switch (fmt) {
+	case IQ_FORMAT_CF32: {
+		const float *p = raw;
+
+		for (size_t i = 0; i < n; i++) {
+			re[i] = p[2 * i + 0];
+			im[i] = p[2 * i + 1];
+		}
+		break;
+	}
+	case IQ_FORMAT_CS16: {
+		const int16_t *p = raw;
+
+		for (size_t i = 0; i < n; i++) {
+			re[i] = p[2 * i + 0] * (1.0f / 32768.0f);
+			im[i] = p[2 * i + 1] * (1.0f / 32768.0f);
+		}
+		break;
+	}
+	case IQ_FORMAT_CS8: {
+		const int8_t *p = raw;
+
+		for (size_t i = 0; i < n; i++) {
+			re[i] = p[2 * i + 0] * (1.0f / 128.0f);
+			im[i] = p[2 * i + 1] * (1.0f / 128.0f);
+		}
+		break;
+	}
+	case IQ_FORMAT_CU8: {
+		const uint8_t *p = raw;
+
+		for (size_t i = 0; i < n; i++) {
+			re[i] = (p[2 * i + 0] - 127.5f) * (1.0f / 128.0f);
+			im[i] = (p[2 * i + 1] - 127.5f) * (1.0f / 128.0f);
+		}
+		break;
+	}
+	default:
+		memset(re, 0, n * sizeof(*re));
+		memset(im, 0, n * sizeof(*im));
+		break;
+	}
+}
+
+static float saturate(float x, float limit)
+{
+	if (x > limit)
+		return limit;
+	else if (x < -limit)
+		return -limit;
+
+	return x;
+}
+
+void iq_samples_from_float(enum iq_sample_format fmt, const float *re,
+			   const float *im, size_t n, void *raw)
+{
+	switch (fmt) {
+	case IQ_FORMAT_CF32: {
+		float *p = raw;
+
+		for (size_t i = 0; i < n; i++) {
+			p[2 * i + 0] = re[i];
+			p[2 * i + 1] = im[i];
+		}
+		break;
+	}
+	case IQ_FORMAT_CS16: {
+		int16_t *p = raw;
+
+		for (size_t i = 0; i < n; i++) {
+			p[2 * i + 0] = lrintf(saturate(re[i] * 32767.0f, 32767.0f));
+			p[2 * i + 1] = lrintf(saturate(im[i] * 32767.0f, 32767.0f));
+		}
+		break;
+	}
+	case IQ_FORMAT_CS8: {
+		int8_t *p = raw;
+
+		for (size_t i = 0; i < n; i++) {
+			p[2 * i + 0] = lrintf(saturate(re[i] * 127.0f, 127.0f));
+			p[2 * i + 1] = lrintf(saturate(im[i] * 127.0f, 127.0f));
+		}
+		break;
+	}
+	case IQ_FORMAT_CU8: {
+		uint8_t *p = raw;
+
+		for (size_t i = 0; i < n; i++) {
+			p[2 * i + 0] = lrintf(saturate(re[i] * 127.0f, 127.0f) + 127.5f);
+			p[2 * i + 1] = lrintf(saturate(im[i] * 127.0f, 127.0f) + 127.5f);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static int is_power_of_2(size_t n)
+{
+	return n && (n & (n - 1)) == 0;
+}
+
+int fft_plan_init(struct fft_plan *p, size_t n)
+{
+	memset(p, 0, sizeof(*p));
+
+	if (n == 0)
+		return -1;
+
+	p->n = n;
+	p->radix2 = is_power_of_2(n);
+	p->cos_tbl = malloc(n * sizeof(float));
+	p->sin_tbl = malloc(n * sizeof(float));
+	p->bitrev = malloc(n * sizeof(uint32_t));
+	if (!p->cos_tbl || !p->sin_tbl || !p->bitrev) {
+		fft_plan_exit(p);
+		return -1;
+	}
+
+	for (size_t k = 0; k < n; k++) {
+		double w = 2.0 * M_PI * k / n;
+
+		p->cos_tbl[k] = cos(w);
+		p->sin_tbl[k] = sin(w);
+	}
+
+	if (p->radix2) {
+		size_t bits = 0;
+
+		while ((1UL << bits) < n)
+			bits++;
+
+		for (size_t k = 0; k < n; k++) {
+			uint32_t r = 0;
+
+			for (size_t b = 0; b < bits; b++)
+				r |= ((k >> b) & 1) << (bits - 1 - b);
+			p->bitrev[k] = r;
+		}
+	}
+
+	return 0;
+}
+
+void fft_plan_exit(struct fft_plan *p)
+{
+	free(p->cos_tbl);
+	free(p->sin_tbl);
+	free(p->bitrev);
+	memset(p, 0, sizeof(*p));
+}
+
+/* @tmp should have 2 * n floats space, only used by the non radix-2 plan */
+void fft_inverse(const struct fft_plan *p, float *re, float *im, float *tmp)
+{
+	size_t n = p->n;
+
+	if (!p->radix2) {
+		float *t_re = tmp, *t_im = tmp + n;
+
+		for (size_t k = 0; k < n; k++) {
+			float acc_re = 0.0f, acc_im = 0.0f;
+			size_t w = 0;
+
+			for (size_t j = 0; j < n; j++) {
+				float c = p->cos_tbl[w], s = p->sin_tbl[w];
+
+				acc_re += re[j] * c - im[j] * s;
+				acc_im += re[j] * s + im[j] * c;
+
+				w += k;
+				if (w >= n)
+					w -= n;
+			}
+
+			t_re[k] = acc_re;
+			t_im[k] = acc_im;
+		}
+
+		memcpy(re, t_re, n * sizeof(float));
+		memcpy(im, t_im, n * sizeof(float));
+		return;
+	}
+
+	for (size_t k = 0; k < n; k++) {
+		size_t r = p->bitrev[k];
+
+		if (r > k) {
+			float t;
+
+			t = re[k]; re[k] = re[r]; re[r] = t;
+			t = im[k]; im[k] = im[r]; im[r] = t;
+		}
+	}
+
+	for (size_t len = 2; len <= n; len <<= 1) {
+		size_t half = len / 2, step = n / len;
+
+		for (size_t i = 0; i < n; i += len) {
+			for (size_t j = 0; j < half; j++) {
+				float wr = p->cos_tbl[j * step];
+				float wi = p->sin_tbl[j * step];
+				size_t a = i + j, b = a + half;
+				float tr, ti;
+
+				tr = re[b] * wr - im[b] * wi;
+				ti = re[b] * wi + im[b] * wr;
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+void nco_init(struct nco *nco, double freq, double sample_rate)
+{
+	nco->phase = 0.0;
+	nco->step = 2.0 * M_PI * freq / sample_rate;
+}
+
+void nco_mix(struct nco *nco, float *re, float *im, size_t n)
+{
+	/* rotate a unit phasor, resync it from the phase once per call */
+	double c = cos(nco->phase), s = sin(nco->phase);
+	double dc = cos(nco->step), ds = sin(nco->step);
+
+	for (size_t i = 0; i < n; i++) {
+		float r = re[i], q = im[i];
+		double t;
+
+		re[i] = r * c - q * s;
+		im[i] = r * s + q * c;
+
+		t = c * dc - s * ds;
+		s = c * ds + s * dc;
+		c = t;
+	}
+
+	nco->phase = fmod(nco->phase + nco->step * n, 2.0 * M_PI);
+}
+
+/* blackman windowed sinc lowpass, @fc is normalized to the sample rate */
+static void design_lowpass(float *h, size_t len, double fc)
+{
+	double sum = 0.0;
+
+	for (size_t i = 0; i < len; i++) {
+		double x = i - (len - 1) / 2.0;
+		double w = 0.42 - 0.5 * cos(2.0 * M_PI * i / (len - 1))
+			+ 0.08 * cos(4.0 * M_PI * i / (len - 1));
+		double sinc = x == 0.0 ? 2.0 * fc
+				       : sin(2.0 * M_PI * fc * x) / (M_PI * x);
+
+		h[i] = sinc * w;
+		sum += h[i];
+	}
+
+	for (size_t i = 0; i < len; i++)
+		h[i] /= sum;
+}
+
+int pfb_channelizer_init(struct pfb_channelizer *c, size_t m, size_t taps,
+			 bool oversample, const size_t *bins, size_t nbins)
+{
+	float *h;
+
+	memset(c, 0, sizeof(*c));
+
+	if (m < 2 || taps < 2)
+		return -1;
+
+	c->m = m;
+	c->taps = taps;
+	c->len = m * taps;
+	c->decimation = (oversample && number_is_even(m)) ? m / 2 : m;
+	c->bins = bins;
+	c->nbins = nbins;
+	c->rot = 0;
+
+	c->coeffs = malloc(c->len * sizeof(float));
+	c->hist_re = calloc(c->len * 2, sizeof(float));
+	c->hist_im = calloc(c->len * 2, sizeof(float));
+	c->v_re = malloc(m * sizeof(float));
+	c->v_im = malloc(m * sizeof(float));
+	c->tmp = malloc(m * 2 * sizeof(float));
+	h = malloc(c->len * sizeof(float));
+	if (!c->coeffs || !c->hist_re || !c->hist_im || !c->v_re || !c->v_im
+	    || !c->tmp || !h || fft_plan_init(&c->fft, m) < 0) {
+		free(h);
+		pfb_channelizer_exit(c);
+		return -1;
+	}
+
+	design_lowpass(h, c->len, 0.5 / m);
+
+	/* branch p is saved in reversed order, so the inner loop walks both
+	 * the coeffs and the history forward:
+	 * coeffs[p * m + r'] = h[p * m + m - 1 - r']
+	 */
+	for (size_t p = 0; p < taps; p++) {
+		for (size_t r = 0; r < m; r++)
+			c->coeffs[p * m + r] = h[p * m + m - 1 - r];
+	}
+
+	free(h);
+	return 0;
+}
+
+void pfb_channelizer_exit(struct pfb_channelizer *c)
+{
+	free(c->coeffs);
+	free(c->hist_re);
+	free(c->hist_im);
+	free(c->v_re);
+	free(c->v_im);
+	free(c->tmp);
+	fft_plan_exit(&c->fft);
+	memset(c, 0, sizeof(*c));
+}
+
+/* y_k = exp(-2 * pi * i * k * t / m) * sum_r v_r * exp(2 * pi * i * k * r / m)
+ * where v_r is the polyphase branch r output and t is the sample index,
+ * the exp(-t) rotation is done by circular shifting v before the fft.
+ */
+static void pfb_channelizer_output(struct pfb_channelizer *c, size_t t,
+				   float *out_re, float *out_im,
+				   size_t out_stride)
+{
+	const float *w_re = c->hist_re + c->hist_pos;
+	const float *w_im = c->hist_im + c->hist_pos;
+	size_t m = c->m, shift = c->rot;
+	float *acc_re = c->tmp, *acc_im = c->tmp + m;
+
+	memset(acc_re, 0, m * sizeof(float));
+	memset(acc_im, 0, m * sizeof(float));
+
+	for (size_t p = 0; p < c->taps; p++) {
+		const float *coeffs = &c->coeffs[p * m];
+		const float *x_re = &w_re[(c->taps - 1 - p) * m];
+		const float *x_im = &w_im[(c->taps - 1 - p) * m];
+
+		for (size_t r = 0; r < m; r++) {
+			acc_re[r] += coeffs[r] * x_re[r];
+			acc_im[r] += coeffs[r] * x_im[r];
+		}
+	}
+
+	/* v_r = acc[m - 1 - r], u[(r - shift) % m] = v_r */
+	for (size_t r = 0; r < m; r++) {
+		size_t v_idx = m - 1 - r;
+		size_t u_idx = (v_idx + m - shift) % m;
+
+		c->v_re[u_idx] = acc_re[r];
+		c->v_im[u_idx] = acc_im[r];
+	}
+
+	fft_inverse(&c->fft, c->v_re, c->v_im, c->tmp);
+
+	for (size_t k = 0; k < c->nbins; k++) {
+		out_re[k * out_stride + t] = c->v_re[c->bins[k]];
+		out_im[k * out_stride + t] = c->v_im[c->bins[k]];
+	}
+}
+
+size_t pfb_channelizer_process(struct pfb_channelizer *c,
+			       const float *re, const float *im, size_t n,
+			       float *out_re, float *out_im, size_t out_stride)
+{
+	size_t outputs = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		/* the history is mirrored, the latest len samples are always
+		 * continuous start from hist_pos.
+		 */
+		c->hist_re[c->hist_pos] = c->hist_re[c->hist_pos + c->len] = re[i];
+		c->hist_im[c->hist_pos] = c->hist_im[c->hist_pos + c->len] = im[i];
+		if (++c->hist_pos == c->len)
+			c->hist_pos = 0;
+
+		if (++c->fill == c->decimation) {
+			c->fill = 0;
+			if (outputs < out_stride)
+				pfb_channelizer_output(c, outputs++, out_re,
+						       out_im, out_stride);
+		}
+
+		if (++c->rot == c->m)
+			c->rot = 0;
+	}
+
+	return outputs;
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int t = a % b;
+
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+int rational_resampler_init(struct rational_resampler *r, unsigned int up,
+			    unsigned int down, unsigned int taps)
+{
+	unsigned int g = gcd(up, down);
+	size_t len;
+	float *h;
+
+	memset(r, 0, sizeof(*r));
+
+	if (up == 0 || down == 0 || taps < 2)
+		return -1;
+
+	up /= g;
+	down /= g;
+	if (up > RESAMPLER_MAX_UP)
+		return -1;
+
+	r->up = up;
+	r->down = down;
+	r->taps = taps;
+	len = (size_t)up * taps;
+
+	r->coeffs = malloc(len * sizeof(float));
+	r->hist_re = calloc(taps * 2, sizeof(float));
+	r->hist_im = calloc(taps * 2, sizeof(float));
+	h = malloc(len * sizeof(float));
+	if (!r->coeffs || !r->hist_re || !r->hist_im || !h) {
+		free(h);
+		rational_resampler_exit(r);
+		return -1;
+	}
+
+	/* cut at the lower nyquist rate, the gain @up restores the power
+	 * lost in the zero stuffing.
+	 */
+	design_lowpass(h, len, 0.5 / (up > down ? up : down));
+
+	/* branch p is h[p + j * up], saved in reversed order, so the dot
+	 * product walks both the coeffs and the history forward.
+	 */
+	for (unsigned int p = 0; p < up; p++) {
+		for (unsigned int j = 0; j < taps; j++)
+			r->coeffs[p * taps + taps - 1 - j] = h[p + j * up] * up;
+	}
+
+	free(h);
+	return 0;
+}
+
+void rational_resampler_exit(struct rational_resampler *r)
+{
+	free(r->coeffs);
+	free(r->hist_re);
+	free(r->hist_im);
+	memset(r, 0, sizeof(*r));
+}
+
+void rational_resampler_reset(struct rational_resampler *r)
+{
+	memset(r->hist_re, 0, r->taps * 2 * sizeof(float));
+	memset(r->hist_im, 0, r->taps * 2 * sizeof(float));
+	r->hist_pos = 0;
+	r->phase = 0;
+}
+
+size_t rational_resampler_max_output(const struct rational_resampler *r,
+				     size_t n)
+{
+	return n * r->up / r->down + 1;
+}
+
+/* the complex dot product of real @h, by 8 lanes of the gcc vector
+ * extensions.
+ */
+static void dot_real_complex(const float *h, const float *x_re,
+			     const float *x_im, size_t n, float *ret_re,
+			     float *ret_im)
+{
+	typedef float v8sf __attribute__((vector_size(32)));
+	v8sf acc_re = { 0 }, acc_im = { 0 };
+	float sum_re = 0.0f, sum_im = 0.0f;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		v8sf c, r, q;
+
+		memcpy(&c, h + i, sizeof(c));
+		memcpy(&r, x_re + i, sizeof(r));
+		memcpy(&q, x_im + i, sizeof(q));
+		acc_re += c * r;
+		acc_im += c * q;
+	}
+
+	for (int k = 0; k < 8; k++) {
+		sum_re += acc_re[k];
+		sum_im += acc_im[k];
+	}
+
+	for (; i < n; i++) {
+		sum_re += h[i] * x_re[i];
+		sum_im += h[i] * x_im[i];
+	}
+
+	*ret_re = sum_re;
+	*ret_im = sum_im;
+}
+
+ssize_t rational_resampler_process(struct rational_resampler *r,
+				   const float *re, const float *im, size_t n,
+				   float *out_re, float *out_im, size_t out_sz)
+{
+	size_t outputs = 0;
+
+	/* the outputs are at phase, phase + down, ... before n * up */
+	if (n * r->up > r->phase
+	    && (n * r->up - r->phase + r->down - 1) / r->down > out_sz)
+		return -1;
+
+	for (size_t i = 0; i < n; i++) {
+		/* the last taps samples are continuous from hist_pos */
+		r->hist_re[r->hist_pos] = r->hist_re[r->hist_pos + r->taps] = re[i];
+		r->hist_im[r->hist_pos] = r->hist_im[r->hist_pos + r->taps] = im[i];
+		if (++r->hist_pos == r->taps)
+			r->hist_pos = 0;
+
+		/* the outputs between this input and the next one */
+		for (; r->phase < r->up; r->phase += r->down) {
+			dot_real_complex(&r->coeffs[r->phase * r->taps],
+					 r->hist_re + r->hist_pos,
+					 r->hist_im + r->hist_pos,
+					 r->taps, &out_re[outputs],
+					 &out_im[outputs]);
+			outputs++;
+		}
+		r->phase -= r->up;
+	}
+
+	return outputs;
+}
+
+void fsk_demod_init(struct fsk_demod *d, float sps)
+{
+	memset(d, 0, sizeof(*d));
+	d->sps = sps;
+	d->next = sps;
+}
+
+/* take the sign @s of a sample, save a bit in the symbol middle */
+static size_t fsk_demod_decide(struct fsk_demod *d, int s, char *bits)
+{
+	d->next -= 1.0f;
+	if (s != d->last) {
+		/* resync to the middle of the new symbol */
+		d->last = s;
+		d->next = d->sps / 2.0f - 0.5f;
+	}
+
+	if (d->next <= 0.0f) {
+		*bits = '0' + s;
+		d->next += d->sps;
+		return 1;
+	}
+
+	return 0;
+}
+
+size_t fsk_demod_process(struct fsk_demod *d, const float *re, const float *im,
+			 size_t n, char *bits, size_t bits_sz)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < n && count < bits_sz; i++) {
+		/* the sign of the phase difference is the sign of the cross
+		 * product, no atan2 is required for hard slicing.
+		 */
+		float cross = im[i] * d->prev_re - re[i] * d->prev_im;
+
+		d->prev_re = re[i];
+		d->prev_im = im[i];
+		count += fsk_demod_decide(d, cross > 0.0f, bits + count);
+	}
+
+	return count;
+}
+
+size_t fsk_demod_slice(struct fsk_demod *d, const float *freq, size_t n,
+		       char *bits, size_t bits_sz)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < n && count < bits_sz; i++)
+		count += fsk_demod_decide(d, freq[i] > 0.0f, bits + count);
+
+	return count;
+}
+
+int burst_detector_init(struct burst_detector *b, float on_db, size_t window)
+{
+	memset(b, 0, sizeof(*b));
+
+	if (window < 1)
+		window = 1;
+
+	b->hist = calloc(window, sizeof(*b->hist));
+	if (!b->hist)
+		return -1;
+
+	b->window = window;
+	b->on = powf(10.0f, on_db / 10.0f);
+	b->off = powf(10.0f, (on_db - BURST_DETECT_HYSTERESIS_DB) / 10.0f);
+	if (b->off < 1.0f)
+		b->off = 1.0f;
+
+	return 0;
+}
+
+void burst_detector_exit(struct burst_detector *b)
+{
+	free(b->hist);
+	b->hist = NULL;
+}
+
+/* the mean power of a segment, by 8 lanes of the gcc vector extensions */
+static float segment_power(const float *re, const float *im, size_t n)
+{
+	typedef float v8sf __attribute__((vector_size(32)));
+	v8sf acc = { 0 };
+	float sum = 0.0f;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		v8sf r, q;
+
+		memcpy(&r, re + i, sizeof(r));
+		memcpy(&q, im + i, sizeof(q));
+		acc += r * r + q * q;
+	}
+
+	for (int k = 0; k < 8; k++)
+		sum += acc[k];
+
+	for (; i < n; i++)
+		sum += re[i] * re[i] + im[i] * im[i];
+
+	return sum / n;
+}
+
+/* the floor rises 1dB in about 2300 segments */
+#define BURST_DETECT_FLOOR_RISE		1.0001
+/* -120dBFS, the floor of an all-zero input */
+#define BURST_DETECT_FLOOR_MIN		1e-12
+
+size_t burst_detector_process(struct burst_detector *b, const float *re,
+			      const float *im, size_t n)
+{
+	size_t active = 0;
+
+	for (size_t i = 0; i < n; i += BURST_DETECT_SEGMENT) {
+		size_t len = n - i < BURST_DETECT_SEGMENT
+				? n - i : BURST_DETECT_SEGMENT;
+		float p = segment_power(re + i, im + i, len);
+		double avg;
+
+		b->sum += p - b->hist[b->hist_pos];
+		b->hist[b->hist_pos] = p;
+		if (++b->hist_pos == b->window)
+			b->hist_pos = 0;
+
+		/* the average isn't valid until the window is filled, nothing
+		 * is squelched before it.
+		 */
+		if (b->filled < b->window && ++b->filled < b->window) {
+			active += len;
+			continue;
+		}
+
+		avg = b->sum / b->window;
+		if (avg < BURST_DETECT_FLOOR_MIN)
+			avg = BURST_DETECT_FLOOR_MIN;
+
+		/* the floor doesn't rise in a burst, a long frame would be cut */
+		if (b->floor == 0.0 || avg < b->floor)
+			b->floor = avg;
+		else if (!b->active)
+			b->floor *= BURST_DETECT_FLOOR_RISE;
+
+		if (b->active)
+			b->active = avg > b->floor * b->off;
+		else
+			b->active = avg > b->floor * b->on;
+
+		if (b->active)
+			active += len;
+	}
+
+	return active;
+}
+
+void fsk_discriminator_init(struct fsk_discriminator *d)
+{
+	d->prev_re = 0.0f;
+	d->prev_im = 0.0f;
+}
+
+/* avoid the division by zero of the silence */
+#define FSK_DISCRIMINATOR_MIN_POWER	1e-12f
+
+void fsk_discriminate(struct fsk_discriminator *d, const float *re,
+		      const float *im, size_t n, float *out)
+{
+	typedef float v8sf __attribute__((vector_size(32)));
+	size_t i = 1;
+
+	if (n == 0)
+		return;
+
+	out[0] = (im[0] * d->prev_re - re[0] * d->prev_im)
+		/ (re[0] * re[0] + im[0] * im[0] + FSK_DISCRIMINATOR_MIN_POWER);
+
+	/* 8 samples a step, the previous samples are loaded unaligned */
+	for (; i + 8 <= n; i += 8) {
+		v8sf r, q, pr, pq;
+
+		memcpy(&r, re + i, sizeof(r));
+		memcpy(&q, im + i, sizeof(q));
+		memcpy(&pr, re + i - 1, sizeof(pr));
+		memcpy(&pq, im + i - 1, sizeof(pq));
+
+		r = (q * pr - r * pq)
+			/ (r * r + q * q + FSK_DISCRIMINATOR_MIN_POWER);
+		memcpy(out + i, &r, sizeof(r));
+	}
+
+	for (; i < n; i++)
+		out[i] = (im[i] * re[i - 1] - re[i] * im[i - 1])
+			/ (re[i] * re[i] + im[i] * im[i]
+			   + FSK_DISCRIMINATOR_MIN_POWER);
+
+	d->prev_re = re[n - 1];
+	d->prev_im = im[n - 1];
+}
+
+int cfo_estimator_init(struct cfo_estimator *e, float sps)
+{
+	memset(e, 0, sizeof(*e));
+
+	e->sps = (size_t)(sps + 0.5f);
+	if (e->sps < 1)
+		e->sps = 1;
+	e->len = e->sps * CFO_ESTIMATE_SYMBOLS;
+
+	e->delay = malloc(e->sps * sizeof(*e->delay));
+	e->u = malloc(e->len * sizeof(*e->u));
+	e->v = malloc(e->len * sizeof(*e->v));
+	if (!e->delay || !e->u || !e->v) {
+		cfo_estimator_exit(e);
+		return -1;
+	}
+
+	cfo_estimator_reset(e);
+	return 0;
+}
+
+void cfo_estimator_exit(struct cfo_estimator *e)
+{
+	free(e->delay);
+	free(e->u);
+	free(e->v);
+	e->delay = e->u = e->v = NULL;
+}
+
+void cfo_estimator_reset(struct cfo_estimator *e)
+{
+	memset(e->delay, 0, e->sps * sizeof(*e->delay));
+	memset(e->u, 0, e->len * sizeof(*e->u));
+	memset(e->v, 0, e->len * sizeof(*e->v));
+	e->delay_pos = e->pos = e->filled = 0;
+	e->su = e->suu = e->svv = 0.0;
+	e->cfo = e->dev = 0.0f;
+	e->detected = 0;
+	e->history_pos = e->history_len = 0;
+}
+
+void cfo_estimator_process(struct cfo_estimator *e, const float *x, size_t n,
+			   float *out)
+{
+	const double len = e->len;
+
+	for (size_t i = 0; i < n; i++) {
+		float xi = x[i], prev = e->delay[e->delay_pos];
+		float u = xi + prev, v = xi - prev;
+		double mean_u, var_u, ratio;
+
+		e->delay[e->delay_pos] = xi;
+		if (++e->delay_pos == e->sps)
+			e->delay_pos = 0;
+
+		e->su += u - e->u[e->pos];
+		e->suu += u * u - e->u[e->pos] * e->u[e->pos];
+		e->svv += v * v - e->v[e->pos] * e->v[e->pos];
+		e->u[e->pos] = u;
+		e->v[e->pos] = v;
+		if (++e->pos == e->len)
+			e->pos = 0;
+
+		if (e->filled < e->len + e->sps) {
+			e->filled++;
+			out[i] = xi - e->cfo;
+			continue;
+		}
+
+		mean_u = e->su / len;
+		var_u = e->suu / len - mean_u * mean_u;
+		ratio = e->svv > 0.0 ? var_u * len / e->svv : 1.0;
+		if (ratio >= CFO_ESTIMATE_RATIO) {
+			e->detected = 0;
+		} else if (!e->detected || ratio < e->best) {
+			struct cfo_estimate *h;
+
+			/* the window is sliding to the sfd, the best window
+			 * of the preamble is taken.
+			 */
+			if (!e->detected) {
+				e->preambles++;
+				if (e->history_len > 0)
+					e->history_pos = (e->history_pos + 1)
+						% CFO_ESTIMATE_HISTORY;
+				if (e->history_len < CFO_ESTIMATE_HISTORY)
+					e->history_len++;
+			}
+			e->detected = 1;
+			e->best = ratio;
+			e->cfo = mean_u / 2.0;
+			e->dev = sqrt(e->svv / len) / 2.0;
+
+			h = &e->history[e->history_pos];
+			h->at = e->samples + i;
+			h->cfo = e->cfo;
+			h->dev = e->dev;
+		}
+
+		out[i] = xi - e->cfo;
+	}
+
+	e->samples += n;
+}
+
+static double cfo_offset(float cfo, float dev)
+{
+	/* sin(c + a) = cfo + dev and sin(a - c) = dev - cfo, where c is the
+	 * offset and a is the deviation.
+	 */
+	double hi = fmin(1.0, fmax(-1.0, dev + cfo));
+	double lo = fmin(1.0, fmax(-1.0, dev - cfo));
+
+	return (asin(hi) - asin(lo)) / 2.0;
+}
+
+double cfo_estimator_offset(const struct cfo_estimator *e)
+{
+	return cfo_offset(e->cfo, e->dev);
+}
+
+double cfo_estimator_offset_at(const struct cfo_estimator *e, uint64_t at)
+{
+	for (size_t i = 0; i < e->history_len; i++) {
+		const struct cfo_estimate *h = &e->history[(e->history_pos
+				+ CFO_ESTIMATE_HISTORY - i) % CFO_ESTIMATE_HISTORY];
+
+		if (h->at <= at)
+			return cfo_offset(h->cfo, h->dev);
+	}
+
+	return 0.0;
+}
+
+void symbol_sync_init(struct symbol_sync *s, float sps, float loop_bw)
+{
+	/* the critically damped 2nd order loop, the gain of the normalized
+	 * error is about pi for a transition.
+	 */
+	const float zeta = 0.7071f, kted = (float)M_PI;
+	float theta = loop_bw / (zeta + 0.25f / zeta);
+	float d = 1.0f + 2.0f * zeta * theta + theta * theta;
+
+	memset(s, 0, sizeof(*s));
+	s->sps = sps;
+	s->period = sps;
+	s->mf_len = (size_t)(sps + 0.5f);
+	if (s->mf_len > SYMBOL_SYNC_MAX_SPS)
+		s->mf_len = SYMBOL_SYNC_MAX_SPS;
+	s->kp = 4.0f * zeta * theta / d / kted;
+	s->ki = 4.0f * theta * theta / d / kted;
+}
+
+/* catmull-rom interpolation between y1 and y2, 0 <= mu < 1 */
+static float cubic_interpolate(const float y[4], float mu)
+{
+	return y[1] + 0.5f * mu * (y[2] - y[0]
+		+ mu * (2.0f * y[0] - 5.0f * y[1] + 4.0f * y[2] - y[3]
+		+ mu * (3.0f * (y[1] - y[2]) + y[3] - y[0])));
+}
+
+static float clampf(float x, float limit)
+{
+	return x > limit ? limit : (x < -limit ? -limit : x);
+}
+
+size_t symbol_sync_process(struct symbol_sync *s, const float *x, size_t n,
+			   float *soft, size_t soft_sz)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		/* the running sum of the last mf_len samples */
+		s->mf_sum += x[i] - s->mf[s->mf_pos];
+		s->mf[s->mf_pos] = x[i];
+		if (++s->mf_pos == s->mf_len)
+			s->mf_pos = 0;
+
+		s->hist[0] = s->hist[1];
+		s->hist[1] = s->hist[2];
+		s->hist[2] = s->hist[3];
+		s->hist[3] = s->mf_sum / s->mf_len;
+		s->pos -= 1.0f;
+
+		/* the strobes between hist[1] and hist[2] */
+		while (s->pos < 1.0f) {
+			float mu = s->pos > 0.0f ? s->pos : 0.0f;
+			float y = cubic_interpolate(s->hist, mu);
+
+			if (s->mid_next) {
+				s->mid = y;
+			} else {
+				float e, adj;
+
+				s->amp += 0.05f * (fabsf(y) - s->amp);
+				e = s->mid * (s->prev - y)
+					/ (s->amp * s->amp + 1e-20f);
+				e = clampf(e, 1.0f);
+
+				s->integ = clampf(s->integ + s->ki * e,
+						  SYMBOL_SYNC_MAX_DEVIATION);
+				adj = clampf(s->kp * e + s->integ,
+					     SYMBOL_SYNC_MAX_DEVIATION);
+				s->period = s->sps * (1.0f + adj);
+				s->prev = y;
+
+				if (count < soft_sz)
+					soft[count++] = y;
+			}
+
+			s->mid_next = !s->mid_next;
+			s->pos += s->period / 2.0f;
+		}
+	}
+
+	return count;
+}
+
+static float sin_tbl[1 << GFSK_SIN_TABLE_BITS];
+static int sin_tbl_inited = 0;
+
+static void sin_table_init(void)
+{
+	if (sin_tbl_inited)
+		return;
+
+	for (size_t i = 0; i < ARRAY_SIZE(sin_tbl); i++)
+		sin_tbl[i] = sin(2.0 * M_PI * i / ARRAY_SIZE(sin_tbl));
+
+	sin_tbl_inited = 1;
+}
+
+static uint32_t gfsk_tbl_idx(uint32_t phase)
+{
+	return phase >> (32 - GFSK_SIN_TABLE_BITS);
+}
+
+int gfsk_modulator_init(struct gfsk_modulator *mod, unsigned int sps,
+			float mod_index, float bt)
+{
+	size_t pulse_len, patterns;
+	double *pulse, sum = 0.0;
+
+	memset(mod, 0, sizeof(*mod));
+
+	if (sps < 1 || sps > 256 || mod_index <= 0.0f || bt < 0.0f)
+		return -1;
+
+	if (bt == 0.0f)
+		mod->span = 1;
+	else if (bt >= 0.5f)
+		mod->span = 3;
+	else if (bt >= 0.3f)
+		mod->span = 5;
+	else
+		mod->span = 7;
+
+	mod->sps = sps;
+	mod->amplitude = 1.0f;
+	pulse_len = mod->span * sps;
+	patterns = 1 << mod->span;
+
+	pulse = malloc(pulse_len * sizeof(*pulse));
+	mod->phase_tbl = malloc(patterns * sps * sizeof(*mod->phase_tbl));
+	if (!pulse || !mod->phase_tbl) {
+		free(pulse);
+		gfsk_modulator_exit(mod);
+		return -1;
+	}
+
+	/* frequency pulse: rectangle convolved with a gaussian filter,
+	 * sampled in the middle of every sample and normalized so one symbol
+	 * contributes pi * h phase.
+	 */
+	for (size_t n = 0; n < pulse_len; n++) {
+		double t = (n + 0.5) / sps - mod->span / 2.0;
+
+		if (bt == 0.0f) {
+			pulse[n] = 1.0;
+		} else {
+			double k = M_PI * bt * sqrt(2.0 / log(2.0));
+
+			pulse[n] = erf(k * (t + 0.5)) - erf(k * (t - 0.5));
+		}
+
+		sum += pulse[n];
+	}
+
+	for (size_t p = 0; p < patterns; p++) {
+		double acc = 0.0;
+
+		for (size_t j = 0; j < sps; j++) {
+			double delta = 0.0;
+
+			/* history bit b is the symbol b - span / 2 later than
+			 * the rendering one, its pulse is sampled at b * sps + j.
+			 */
+			for (size_t b = 0; b < mod->span; b++) {
+				int a = (p >> b) & 1 ? 1 : -1;
+
+				delta += a * pulse[b * sps + j] / sum;
+			}
+
+			acc += delta * mod_index * 0.5; /* in 2 * pi units */
+			mod->phase_tbl[p * sps + j] =
+				(uint32_t)llround(acc * 4294967296.0);
+		}
+	}
+
+	free(pulse);
+	sin_table_init();
+
+	/* as if an endless preamble is sent before */
+	mod->history = 0x55555555 & (patterns - 1);
+	return 0;
+}
+
+void gfsk_modulator_exit(struct gfsk_modulator *mod)
+{
+	free(mod->phase_tbl);
+	mod->phase_tbl = NULL;
+}
+
+static size_t gfsk_render_symbol(struct gfsk_modulator *mod, float *re,
+				 float *im)
+{
+	const uint32_t *cum = &mod->phase_tbl[mod->history * mod->sps];
+	const uint32_t quarter = 1 << (GFSK_SIN_TABLE_BITS - 2);
+	const uint32_t mask = (1 << GFSK_SIN_TABLE_BITS) - 1;
+	uint32_t phase = mod->phase;
+
+	/* no loop carried dependency, the phase of each sample is the base
+	 * phase plus the accumulated increments.
+	 */
+	for (size_t j = 0; j < mod->sps; j++) {
+		uint32_t idx = gfsk_tbl_idx(phase + cum[j]);
+
+		re[j] = mod->amplitude * sin_tbl[(idx + quarter) & mask];
+		im[j] = mod->amplitude * sin_tbl[idx];
+	}
+
+	mod->phase = phase + cum[mod->sps - 1];
+	return mod->sps;
+}
+
+size_t gfsk_modulate_bit(struct gfsk_modulator *mod, int bit,
+			 float *re, float *im)
+{
+	unsigned int half = mod->span / 2;
+
+	mod->history = ((mod->history << 1) | !!bit) & ((1 << mod->span) - 1);
+	if (mod->delay < half) {
+		mod->delay++;
+		return 0;
+	}
+
+	return gfsk_render_symbol(mod, re, im);
+}
+
+size_t gfsk_modulator_flush(struct gfsk_modulator *mod, float *re, float *im,
+			    size_t max_samples)
+{
+	size_t n = 0;
+
+	while (mod->delay > 0 && n + mod->sps <= max_samples) {
+		mod->history = ((mod->history << 1) | (mod->history & 1))
+				& ((1 << mod->span) - 1);
+		n += gfsk_render_symbol(mod, re + n, im + n);
+		mod->delay--;
+	}
+
+	return n;
+}
@@ -0,0 +1,301 @@
+/*
+ * dsp helper functions for demodulating wisun fsk from IQ samples
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#ifndef WISUN_FSK_DSP_H
+#define WISUN_FSK_DSP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+enum iq_sample_format {
+	IQ_FORMAT_CF32,		/* complex float32, urh .complex */
+	IQ_FORMAT_CS16,		/* complex int16, urh .complex32s */
+	IQ_FORMAT_CS8,		/* complex int8, hackrf, urh .complex16s */
+	IQ_FORMAT_CU8,		/* complex uint8, rtl-sdr, urh .complex16u */
+	IQ_FORMAT_MAX,
+};
+
+int iq_sample_format_parse(const char *name);
+const char *iq_sample_format_name(enum iq_sample_format fmt);
+size_t iq_sample_size(enum iq_sample_format fmt);
+
+/* convert @n raw IQ samples to split real/imag float arrays, range [-1, 1] */
+void iq_samples_to_float(enum iq_sample_format fmt, const void *raw, size_t n,
+			 float *re, float *im);
+
+/* convert float samples back to raw IQ samples, saturated */
+void iq_samples_from_float(enum iq_sample_format fmt, const float *re,
+			   const float *im, size_t n, void *raw);
+
+/* complex FFT, split real/imag, in place and unnormalized.
+ * radix-2 for power of two sizes, plain DFT for others.
+ */
+struct fft_plan {
+	size_t		n;
+	int		radix2;
+	float		*cos_tbl;
+	float		*sin_tbl;
+	uint32_t	*bitrev;
+};
+
+int fft_plan_init(struct fft_plan *p, size_t n);
+void fft_plan_exit(struct fft_plan *p);
+/* X[k] = sum x[j] * exp(+2 * pi * i * j * k / n) */
+void fft_inverse(const struct fft_plan *p, float *re, float *im, float *tmp);
+
+/* Numerically controlled oscillator, mix the samples by exp(i * w * t) */
+struct nco {
+	double		phase;
+	double		step;
+};
+
+void nco_init(struct nco *nco, double freq, double sample_rate);
+void nco_mix(struct nco *nco, float *re, float *im, size_t n);
+
+/* Critically or 2x over sampled polyphase filter bank channelizer.
+ * The input is split into @m evenly spaced channels, channel k is centered
+ * at k * sample_rate / m, and the output rate is sample_rate / decimation.
+ */
+struct pfb_channelizer {
+	size_t		m;		/* channels, also the fft size */
+	size_t		decimation;	/* m or m / 2 */
+	size_t		taps;		/* taps per polyphase branch */
+	size_t		len;		/* m * taps */
+	float		*coeffs;	/* reversed polyphase coeffs */
+	float		*hist_re;	/* mirrored history, 2 * len */
+	float		*hist_im;
+	size_t		hist_pos;
+	size_t		fill;		/* samples since the last output */
+	size_t		rot;		/* n * decimation % m */
+	float		*v_re;
+	float		*v_im;
+	float		*tmp;
+	const size_t	*bins;
+	size_t		nbins;
+	struct fft_plan	fft;
+};
+
+int pfb_channelizer_init(struct pfb_channelizer *c, size_t m, size_t taps,
+			 bool oversample, const size_t *bins, size_t nbins);
+void pfb_channelizer_exit(struct pfb_channelizer *c);
+/* output samples of bins[k] are saved in out_re[k * out_stride + t].
+ * Return the output samples count of each channel.
+ */
+size_t pfb_channelizer_process(struct pfb_channelizer *c,
+			       const float *re, const float *im, size_t n,
+			       float *out_re, float *out_im, size_t out_stride);
+
+/* Streaming rational resampler of complex samples, the rate is changed by
+ * @up / @down. The lowpass filter of @taps * up taps is split to @up
+ * polyphase branches of @taps taps, an output sample is the dot product of
+ * one branch and the last @taps input samples, the zero stuffed samples
+ * are never computed. The history is kept between the calls.
+ */
+#define RESAMPLER_MAX_UP		1024
+
+struct rational_resampler {
+	unsigned int	up;
+	unsigned int	down;
+	unsigned int	taps;		/* taps per branch */
+	float		*coeffs;	/* [up][taps], reversed */
+	float		*hist_re;	/* mirrored history, 2 * taps */
+	float		*hist_im;
+	size_t		hist_pos;
+	unsigned int	phase;		/* output position in the up grid */
+};
+
+/* the ratio is reduced, -1 if @up is larger than RESAMPLER_MAX_UP then */
+int rational_resampler_init(struct rational_resampler *r, unsigned int up,
+			    unsigned int down, unsigned int taps);
+void rational_resampler_exit(struct rational_resampler *r);
+void rational_resampler_reset(struct rational_resampler *r);
+/* the max output samples of @n input samples */
+size_t rational_resampler_max_output(const struct rational_resampler *r,
+				     size_t n);
+/* Return the output samples, -1 if they are more than @out_sz, nothing is
+ * processed then.
+ */
+ssize_t rational_resampler_process(struct rational_resampler *r,
+				  const float *re, const float *im, size_t n,
+				  float *out_re, float *out_im, size_t out_sz);
+
+/* 2-FSK quadrature discriminator and a zero crossing synced bit slicer */
+struct fsk_demod {
+	float		prev_re;
+	float		prev_im;
+	float		sps;		/* samples per symbol */
+	float		next;		/* samples to the next decision */
+	int		last;
+};
+
+void fsk_demod_init(struct fsk_demod *d, float sps);
+/* slice @n samples to '0'/'1' chars, return the chars saved in @bits */
+size_t fsk_demod_process(struct fsk_demod *d, const float *re, const float *im,
+			 size_t n, char *bits, size_t bits_sz);
+/* the same slicer of the frequencies(discriminator outputs) */
+size_t fsk_demod_slice(struct fsk_demod *d, const float *freq, size_t n,
+		       char *bits, size_t bits_sz);
+
+/* Energy burst detector(squelch).
+ * The power of the samples is summed by segments of BURST_DETECT_SEGMENT
+ * samples and averaged over @window segments. The noise floor follows the
+ * lowest average and rises slowly out of the bursts, it's estimated after
+ * the first @window segments. A burst starts when the average is
+ * @on_db above the floor, and ends when it falls below @on_db -
+ * BURST_DETECT_HYSTERESIS_DB.
+ */
+#define BURST_DETECT_SEGMENT		64
+#define BURST_DETECT_HYSTERESIS_DB	3.0f
+
+struct burst_detector {
+	float		on, off;	/* power ratio to the noise floor */
+	size_t		window;		/* segments averaged */
+	float		*hist;		/* power of the last segments */
+	size_t		hist_pos;
+	size_t		filled;		/* segments in hist */
+	double		sum;		/* sum of hist */
+	double		floor;		/* 0: not estimated */
+	int		active;
+};
+
+int burst_detector_init(struct burst_detector *b, float on_db, size_t window);
+void burst_detector_exit(struct burst_detector *b);
+/* Return the samples of the active segments in @n samples, a partial
+ * segment at the end is a full one.
+ */
+size_t burst_detector_process(struct burst_detector *b, const float *re,
+			      const float *im, size_t n);
+
+/* Frequency discriminator, the output is the sine of the phase step of
+ * each sample, scaled by the power of the sample.
+ */
+struct fsk_discriminator {
+	float		prev_re;
+	float		prev_im;
+};
+
+void fsk_discriminator_init(struct fsk_discriminator *d);
+void fsk_discriminate(struct fsk_discriminator *d, const float *re,
+		      const float *im, size_t n, float *out);
+
+/* Carrier frequency offset estimator of the discriminator outputs.
+ * In the 0101 preamble the frequency is anti-periodic in a symbol, so
+ * u = x[i] + x[i - sps] is twice the offset and v = x[i] - x[i - sps] is
+ * twice the deviation. Both are summed over CFO_ESTIMATE_SYMBOLS symbols,
+ * it's a preamble if the variance of u is less than CFO_ESTIMATE_RATIO of
+ * the mean power of v, which is about 1 for the noise. The offset of the
+ * best window of the last preamble is subtracted from the samples until
+ * the next preamble.
+ */
+#define CFO_ESTIMATE_SYMBOLS		16
+#define CFO_ESTIMATE_RATIO		0.05f
+/* the estimates of the last preambles kept for cfo_estimator_offset_at */
+#define CFO_ESTIMATE_HISTORY		8
+
+struct cfo_estimate {
+	uint64_t	at;		/* the sample of the last update */
+	float		cfo, dev;
+};
+
+struct cfo_estimator {
+	size_t		sps;		/* rounded */
+	size_t		len;		/* sps * CFO_ESTIMATE_SYMBOLS */
+	float		*delay;		/* the last sps samples */
+	float		*u, *v;		/* the last len u and v */
+	size_t		delay_pos, pos, filled;
+	double		su, suu, svv;
+	float		cfo;		/* in the discriminator unit */
+	float		dev;		/* the deviation */
+	uint64_t	preambles;	/* preamble detections */
+	int		detected;
+	double		best;		/* the ratio of the detected cfo */
+	uint64_t	samples;	/* processed since init */
+	struct cfo_estimate history[CFO_ESTIMATE_HISTORY];
+	size_t		history_pos;	/* the newest one */
+	size_t		history_len;
+};
+
+int cfo_estimator_init(struct cfo_estimator *e, float sps);
+void cfo_estimator_exit(struct cfo_estimator *e);
+/* forget the offset and the samples, for a new burst */
+void cfo_estimator_reset(struct cfo_estimator *e);
+/* @out = @x - offset, @out can be @x */
+void cfo_estimator_process(struct cfo_estimator *e, const float *x, size_t n,
+			   float *out);
+/* the offset of the last preamble in radians per sample */
+double cfo_estimator_offset(const struct cfo_estimator *e);
+/* the offset subtracted from the sample @at, counted from init, 0 if it's
+ * older than the history or the last reset.
+ */
+double cfo_estimator_offset_at(const struct cfo_estimator *e, uint64_t at);
+
+/* Gardner symbol timing recovery of the demodulated(frequency) samples.
+ * The samples are averaged over a symbol(the matched filter of the NRZ
+ * pulse) first, and interpolated(cubic) at the symbol centers and at the
+ * middle points between them. The timing error of a symbol is
+ * mid * (prev - cur), normalized by the symbol amplitude, and the symbol
+ * period is adjusted by a PI loop of @loop_bw(normalized to the symbol
+ * rate) bandwidth.
+ */
+#define SYMBOL_SYNC_LOOP_BW		0.03f
+/* the max period change, relative to the nominal one */
+#define SYMBOL_SYNC_MAX_DEVIATION	0.05f
+
+#define SYMBOL_SYNC_MAX_SPS		64
+
+struct symbol_sync {
+	float		sps;		/* nominal samples per symbol */
+	float		mf[SYMBOL_SYNC_MAX_SPS];
+	size_t		mf_len, mf_pos;
+	double		mf_sum;
+	float		kp, ki;
+	float		integ;		/* the integrator of the loop */
+	float		period;		/* the tracked samples per symbol */
+	float		pos;		/* the next strobe from hist[1] */
+	int		mid_next;	/* the next strobe is a middle point */
+	float		hist[4];	/* the last 4 samples */
+	float		prev;		/* the last symbol */
+	float		mid;
+	float		amp;		/* mean |symbol| */
+};
+
+/* 2 <= @sps <= SYMBOL_SYNC_MAX_SPS */
+void symbol_sync_init(struct symbol_sync *s, float sps, float loop_bw);
+/* Return the symbols saved in @soft, the sign is the hard bit */
+size_t symbol_sync_process(struct symbol_sync *s, const float *x, size_t n,
+			   float *soft, size_t soft_sz);
+
+/* Phase continuous 2-(G)FSK modulator.
+ * The frequency pulse of a symbol spans @span symbols, the phase increments
+ * of every sample are precomputed for all the neighbour bit patterns, so
+ * each symbol is rendered by table lookups only.
+ */
+#define GFSK_SIN_TABLE_BITS	12
+
+struct gfsk_modulator {
+	unsigned int	sps;		/* samples per symbol */
+	unsigned int	span;		/* pulse span in symbols, odd */
+	uint32_t	*phase_tbl;	/* [1 << span][sps], accumulated */
+	uint32_t	phase;		/* 2^32 = 2 * pi */
+	uint32_t	history;	/* the last span bits, lsb is the newest */
+	unsigned int	delay;		/* bits pushed but not rendered */
+	float		amplitude;
+};
+
+/* @bt: the gaussian filter bandwidth-time product, 0 for plain 2-FSK */
+int gfsk_modulator_init(struct gfsk_modulator *mod, unsigned int sps,
+			float mod_index, float bt);
+void gfsk_modulator_exit(struct gfsk_modulator *mod);
+/* the first span / 2 bits are only used to fill the history, modulated
+ * after the following bits are pushed. Return the samples count.
+ */
+size_t gfsk_modulate_bit(struct gfsk_modulator *mod, int bit,
+			 float *re, float *im);
+/* flush the bits left in the history, repeating the last bit */
+size_t gfsk_modulator_flush(struct gfsk_modulator *mod, float *re, float *im,
+			    size_t max_samples);
+
+#endif
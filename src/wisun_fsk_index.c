@@ -0,0 +1,203 @@
+/*
+ * sidecar frame index of the binary string capture files
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wisun_fsk_index.h"
+
+void wisun_fsk_index_writer_init(struct wisun_fsk_index_writer *w)
+{
+	memset(w, 0, sizeof(*w));
+}
+
+void wisun_fsk_index_writer_exit(struct wisun_fsk_index_writer *w)
+{
+	free(w->entries);
+	memset(w, 0, sizeof(*w));
+}
+
+static int grow_array(void **array, size_t *size, size_t count,
+		      size_t elem_size)
+{
+	size_t new_size;
+	void *p;
+
+	if (count < *size)
+		return 0;
+
+	new_size = *size ? *size * 2 : 1024;
+	p = realloc(*array, new_size * elem_size);
+	if (!p)
+		return -1;
+
+	*array = p;
+	*size = new_size;
+	return 0;
+}
+
+int wisun_fsk_index_add_entry(struct wisun_fsk_index_writer *w,
+			      const struct wisun_fsk_index_entry *e)
+{
+	if (grow_array((void **)&w->entries, &w->entries_size, w->count,
+		       sizeof(*e)) < 0)
+		return -1;
+
+	w->entries[w->count++] = *e;
+	return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+
+	while (len > 0) {
+		ssize_t n = write(fd, p, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int compare_entry(const void *a, const void *b)
+{
+	const struct wisun_fsk_index_entry *ea = a, *eb = b;
+
+	return (ea->bit_offset > eb->bit_offset)
+		- (ea->bit_offset < eb->bit_offset);
+}
+
+int wisun_fsk_index_save(struct wisun_fsk_index_writer *w, int capture_fd,
+			 const char *filename)
+{
+	struct wisun_fsk_index_header h = { 0 };
+	struct stat st;
+	int fd, ret = 0;
+
+	if (fstat(capture_fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		fprintf(stderr, "the capture is not a regular file\n");
+		return -1;
+	}
+
+	/* the bad frames are reported after the frames hidden in them */
+	qsort(w->entries, w->count, sizeof(*w->entries), compare_entry);
+
+	memcpy(h.magic, WISUN_FSK_INDEX_MAGIC, sizeof(h.magic));
+	h.version = WISUN_FSK_INDEX_VERSION;
+	h.entry_size = sizeof(struct wisun_fsk_index_entry);
+	h.capture_size = st.st_size;
+	h.capture_mtime_sec = st.st_mtim.tv_sec;
+	h.capture_mtime_nsec = st.st_mtim.tv_nsec;
+	h.count = w->count;
+
+	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "create %s failed\n", filename);
+		return -1;
+	}
+
+	if (write_all(fd, &h, sizeof(h)) < 0
+	    || write_all(fd, w->entries, w->count * sizeof(*w->entries)) < 0) {
+		fprintf(stderr, "write %s failed\n", filename);
+		ret = -1;
+	}
+
+	close(fd);
+	return ret;
+}
+
+int wisun_fsk_index_open(struct wisun_fsk_index *idx, const char *filename,
+			 int capture_fd)
+{
+	const struct wisun_fsk_index_header *h;
+	struct stat st, capture_st;
+	size_t expected;
+	int fd;
+
+	memset(idx, 0, sizeof(*idx));
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "open %s failed\n", filename);
+		return -1;
+	}
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*h)) {
+		fprintf(stderr, "%s is not an index\n", filename);
+		close(fd);
+		return -1;
+	}
+
+	idx->map_size = st.st_size;
+	idx->map = mmap(NULL, idx->map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (idx->map == MAP_FAILED) {
+		fprintf(stderr, "mmap %s failed\n", filename);
+		idx->map = NULL;
+		return -1;
+	}
+
+	h = idx->header = idx->map;
+	if (memcmp(h->magic, WISUN_FSK_INDEX_MAGIC, sizeof(h->magic))
+	    || h->version != WISUN_FSK_INDEX_VERSION
+	    || h->entry_size != sizeof(struct wisun_fsk_index_entry)) {
+		fprintf(stderr, "%s is not an index\n", filename);
+		goto fail;
+	}
+
+	expected = sizeof(*h) + h->count * h->entry_size;
+	if (h->count > idx->map_size || expected != idx->map_size) {
+		fprintf(stderr, "%s is truncated\n", filename);
+		goto fail;
+	}
+
+	if (fstat(capture_fd, &capture_st) < 0
+	    || (uint64_t)capture_st.st_size != h->capture_size
+	    || capture_st.st_mtim.tv_sec != h->capture_mtime_sec
+	    || capture_st.st_mtim.tv_nsec != h->capture_mtime_nsec) {
+		fprintf(stderr, "%s is stale, the capture is changed\n",
+			filename);
+		goto fail;
+	}
+
+	/* each bit is one char at least in the capture */
+	idx->entries = (const void *)(h + 1);
+	for (uint64_t i = 0; i < h->count; i++) {
+		const struct wisun_fsk_index_entry *e = &idx->entries[i];
+
+		if (e->bits == 0 || e->file_offset >= h->capture_size
+		    || e->bits > h->capture_size - e->file_offset) {
+			fprintf(stderr, "%s: entry %llu is out of the capture\n",
+				filename, (unsigned long long)i);
+			goto fail;
+		}
+	}
+
+	return 0;
+
+fail:
+	wisun_fsk_index_close(idx);
+	return -1;
+}
+
+void wisun_fsk_index_close(struct wisun_fsk_index *idx)
+{
+	if (idx->map)
+		munmap(idx->map, idx->map_size);
+	memset(idx, 0, sizeof(*idx));
+}
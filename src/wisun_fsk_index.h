@@ -0,0 +1,71 @@
+/*
+ * sidecar frame index of the binary string capture files
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#ifndef WISUN_FSK_INDEX_H
+#define WISUN_FSK_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* The index file is a header and the frame entries sorted by offset, all in
+ * host byte order and naturally aligned so that it can be mmap'ed and used
+ * in place. The index is bound to the capture by its size and mtime.
+ *
+ * The capture may have other chars than '0' and '1', each entry saves both
+ * the bit offset and the file offset of the frame.
+ */
+#define WISUN_FSK_INDEX_MAGIC		"WSFSKIDX"
+#define WISUN_FSK_INDEX_VERSION		1
+
+struct wisun_fsk_index_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	entry_size;
+	uint64_t	capture_size;
+	int64_t		capture_mtime_sec;
+	int64_t		capture_mtime_nsec;
+	uint64_t	count;		/* frame entries */
+};
+
+#define WISUN_FSK_INDEX_CRC_GOOD	(1 << 0)
+
+struct wisun_fsk_index_entry {
+	uint64_t	bit_offset;	/* the first preamble bit */
+	uint64_t	file_offset;	/* the char of the first preamble bit */
+	uint32_t	bits;		/* SHR, PHR and PHY payload */
+	uint16_t	phr;
+	uint16_t	preamble_sz;	/* in bits */
+	uint8_t		sfd_type;
+	uint8_t		flags;
+	uint8_t		reserved[6];
+};
+
+struct wisun_fsk_index_writer {
+	struct wisun_fsk_index_entry	*entries;
+	size_t				count;
+	size_t				entries_size;
+};
+
+void wisun_fsk_index_writer_init(struct wisun_fsk_index_writer *w);
+void wisun_fsk_index_writer_exit(struct wisun_fsk_index_writer *w);
+int wisun_fsk_index_add_entry(struct wisun_fsk_index_writer *w,
+			      const struct wisun_fsk_index_entry *e);
+/* write the index of the capture @capture_fd to @filename */
+int wisun_fsk_index_save(struct wisun_fsk_index_writer *w, int capture_fd,
+			 const char *filename);
+
+struct wisun_fsk_index {
+	void					*map;
+	size_t					map_size;
+	const struct wisun_fsk_index_header	*header;
+	const struct wisun_fsk_index_entry	*entries;
+};
+
+/* map the index @filename and validate it against @capture_fd */
+int wisun_fsk_index_open(struct wisun_fsk_index *idx, const char *filename,
+			 int capture_fd);
+void wisun_fsk_index_close(struct wisun_fsk_index *idx);
+
+#endif
@@ -0,0 +1,512 @@
+/*
+ * pcap and pcapng writer of the decoded 802.15.4 frames
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "wisun_fsk_pcap.h"
+
+/* all the fields are written in little endian */
+static uint8_t *put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	return p + 2;
+}
+
+static uint8_t *put_le32(uint8_t *p, uint32_t v)
+{
+	p = put_le16(p, v);
+	return put_le16(p, v >> 16);
+}
+
+#define PCAP_MAGIC_NSEC			0xa1b23c4d
+#define PCAPNG_SHB			0x0a0d0d0a
+#define PCAPNG_IDB			0x00000001
+#define PCAPNG_EPB			0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC		0x1a2b3c4d
+#define PCAPNG_OPT_IF_TSRESOL		9
+
+static int write_all(int fd, const uint8_t *p, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, p, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* the lock is held by the caller */
+static int pcap_flush(struct wisun_fsk_pcap_writer *w)
+{
+	if (!w->err && w->len > 0 && write_all(w->fd, w->buf, w->len) < 0) {
+		fprintf(stderr, "write pcap failed\n");
+		w->err = -1;
+	}
+
+	w->len = 0;
+	return w->err;
+}
+
+int wisun_fsk_pcap_writer_flush(struct wisun_fsk_pcap_writer *w)
+{
+	int ret;
+
+	pthread_mutex_lock(&w->lock);
+	ret = pcap_flush(w);
+	pthread_mutex_unlock(&w->lock);
+	return ret;
+}
+
+static uint8_t *pcap_reserve(struct wisun_fsk_pcap_writer *w, size_t len)
+{
+	uint8_t *p;
+
+	if (w->len + len > sizeof(w->buf))
+		pcap_flush(w);
+
+	p = w->buf + w->len;
+	w->len += len;
+	return p;
+}
+
+static void pcap_write_header(struct wisun_fsk_pcap_writer *w)
+{
+	uint8_t *p;
+
+	if (w->format == WISUN_FSK_PCAP) {
+		p = pcap_reserve(w, 24);
+		p = put_le32(p, PCAP_MAGIC_NSEC);
+		p = put_le16(p, 2);
+		p = put_le16(p, 4);
+		p = put_le32(p, 0);		/* thiszone */
+		p = put_le32(p, 0);		/* sigfigs */
+		p = put_le32(p, WISUN_FSK_PCAP_SNAPLEN);
+		put_le32(p, w->linktype);
+		return;
+	}
+
+	p = pcap_reserve(w, 28 + 32);
+	p = put_le32(p, PCAPNG_SHB);
+	p = put_le32(p, 28);
+	p = put_le32(p, PCAPNG_BYTE_ORDER_MAGIC);
+	p = put_le16(p, 1);
+	p = put_le16(p, 0);
+	p = put_le32(p, 0xffffffff);	/* section length is unknown */
+	p = put_le32(p, 0xffffffff);
+	p = put_le32(p, 28);
+
+	p = put_le32(p, PCAPNG_IDB);
+	p = put_le32(p, 32);
+	p = put_le16(p, w->linktype);
+	p = put_le16(p, 0);
+	p = put_le32(p, WISUN_FSK_PCAP_SNAPLEN);
+	p = put_le16(p, PCAPNG_OPT_IF_TSRESOL);
+	p = put_le16(p, 1);
+	p = put_le32(p, 9);		/* 10^-9, padded */
+	p = put_le32(p, 0);		/* opt_endofopt */
+	put_le32(p, 32);
+}
+
+int wisun_fsk_pcap_writer_open(struct wisun_fsk_pcap_writer *w,
+			       const char *filename, uint32_t linktype)
+{
+	size_t len = strlen(filename);
+
+	w->format = WISUN_FSK_PCAP;
+	if (len > 7 && !strcmp(filename + len - 7, ".pcapng"))
+		w->format = WISUN_FSK_PCAPNG;
+
+	w->linktype = linktype;
+	w->err = 0;
+	w->len = 0;
+
+	if (!strcmp(filename, "-"))
+		w->fd = STDOUT_FILENO;
+	else
+		w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (w->fd < 0) {
+		fprintf(stderr, "create %s failed\n", filename);
+		return -1;
+	}
+
+	pthread_mutex_init(&w->lock, NULL);
+	pcap_write_header(w);
+	return 0;
+}
+
+int wisun_fsk_pcap_writer_add(struct wisun_fsk_pcap_writer *w, uint64_t ts_ns,
+			      const struct iovec *iov, int iovcnt)
+{
+	size_t len = 0, record_sz, padded;
+	int ret;
+	uint8_t *p;
+
+	for (int i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	if (len > WISUN_FSK_PCAP_SNAPLEN)
+		return -1;
+
+	pthread_mutex_lock(&w->lock);
+
+	if (w->format == WISUN_FSK_PCAP) {
+		padded = len;
+		record_sz = 16 + len;
+		p = pcap_reserve(w, record_sz);
+		p = put_le32(p, ts_ns / 1000000000);
+		p = put_le32(p, ts_ns % 1000000000);
+	} else {
+		padded = (len + 3) & ~3;
+		record_sz = 32 + padded;
+		p = pcap_reserve(w, record_sz);
+		p = put_le32(p, PCAPNG_EPB);
+		p = put_le32(p, record_sz);
+		p = put_le32(p, 0);		/* interface id */
+		p = put_le32(p, ts_ns >> 32);
+		p = put_le32(p, ts_ns);
+	}
+
+	p = put_le32(p, len);
+	p = put_le32(p, len);
+	for (int i = 0; i < iovcnt; i++) {
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
+		p += iov[i].iov_len;
+	}
+
+	if (w->format == WISUN_FSK_PCAPNG) {
+		memset(p, 0, padded - len);
+		put_le32(p + padded - len, record_sz);
+	}
+
+	ret = w->err;
+	pthread_mutex_unlock(&w->lock);
+	return ret;
+}
+
+int wisun_fsk_pcap_writer_close(struct wisun_fsk_pcap_writer *w)
+{
+	int ret = wisun_fsk_pcap_writer_flush(w);
+
+	if (w->fd != STDOUT_FILENO)
+		close(w->fd);
+	w->fd = -1;
+	pthread_mutex_destroy(&w->lock);
+	return ret;
+}
+
+size_t ieee802154_tap_put_tlv(uint8_t *buf, uint16_t type, uint64_t value,
+			      uint16_t len)
+{
+	size_t padded = (len + 3) & ~3;
+
+	put_le16(buf, type);
+	put_le16(buf + 2, len);
+	memset(buf + 4, 0, padded);
+	for (int i = 0; i < len; i++)
+		buf[4 + i] = value >> (i * 8);
+
+	return 4 + padded;
+}
+
+#define PCAP_MAGIC_USEC			0xa1b2c3d4
+
+static uint32_t pcap_u32(const struct wisun_fsk_pcap_reader *r,
+			 const uint8_t *p)
+{
+	if (r->swapped)
+		return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t pcap_u16(const struct wisun_fsk_pcap_reader *r,
+			 const uint8_t *p)
+{
+	return r->swapped ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+/* make sure @need bytes are available from r->pos, return 0 if the file is
+ * ended before them.
+ */
+static int pcap_reader_fill(struct wisun_fsk_pcap_reader *r, size_t need)
+{
+	if (r->len - r->pos >= need)
+		return 1;
+
+	if (need > WISUN_FSK_PCAP_MAX_BLOCK) {
+		fprintf(stderr, "pcap block is too large\n");
+		return -1;
+	}
+
+	memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+	r->len -= r->pos;
+	r->pos = 0;
+
+	if (need > r->buf_sz) {
+		uint8_t *p = realloc(r->buf, need);
+
+		if (!p)
+			return -1;
+		r->buf = p;
+		r->buf_sz = need;
+	}
+
+	while (r->len < need && !r->eof) {
+		ssize_t n = read(r->fd, r->buf + r->len, r->buf_sz - r->len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "read pcap failed\n");
+			return -1;
+		}
+
+		if (n == 0)
+			r->eof = 1;
+		r->len += n;
+	}
+
+	return r->len >= need;
+}
+
+static int pcap_reader_parse_header(struct wisun_fsk_pcap_reader *r)
+{
+	const uint8_t *p;
+	uint32_t magic;
+	int ret;
+
+	ret = pcap_reader_fill(r, 24);
+	if (ret <= 0)
+		goto bad;
+
+	p = r->buf;
+	magic = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+
+	if (magic == PCAPNG_SHB) {
+		/* the endian is decided by each section header */
+		r->format = WISUN_FSK_PCAPNG;
+		return 0;
+	}
+
+	r->format = WISUN_FSK_PCAP;
+	for (r->swapped = 0; r->swapped < 2; r->swapped++) {
+		magic = pcap_u32(r, p);
+		if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC)
+			break;
+	}
+
+	if (r->swapped == 2)
+		goto bad;
+
+	r->ts_unit_ns = magic == PCAP_MAGIC_USEC ? 1000 : 1;
+	r->linktype = pcap_u32(r, p + 20) & 0xffff;
+	r->pos = 24;
+	return 0;
+
+bad:
+	fprintf(stderr, "not a pcap or pcapng file\n");
+	return -1;
+}
+
+int wisun_fsk_pcap_reader_open(struct wisun_fsk_pcap_reader *r,
+			       const char *filename)
+{
+	memset(r, 0, sizeof(*r));
+
+	if (!strcmp(filename, "-"))
+		r->fd = STDIN_FILENO;
+	else
+		r->fd = open(filename, O_RDONLY);
+
+	if (r->fd < 0) {
+		fprintf(stderr, "open %s failed\n", filename);
+		return -1;
+	}
+
+	r->buf_sz = WISUN_FSK_PCAP_BUFSZ;
+	r->buf = malloc(r->buf_sz);
+	if (!r->buf || pcap_reader_parse_header(r) < 0) {
+		wisun_fsk_pcap_reader_close(r);
+		return -1;
+	}
+
+	return 0;
+}
+
+void wisun_fsk_pcap_reader_close(struct wisun_fsk_pcap_reader *r)
+{
+	if (r->fd >= 0 && r->fd != STDIN_FILENO)
+		close(r->fd);
+	free(r->buf);
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+static int pcap_reader_next_pcap(struct wisun_fsk_pcap_reader *r,
+				 struct wisun_fsk_pcap_packet *pkt)
+{
+	const uint8_t *p;
+	uint32_t caplen;
+	int ret;
+
+	ret = pcap_reader_fill(r, 16);
+	if (ret <= 0)
+		return ret < 0 || r->len > r->pos ? -1 : 0;
+
+	p = r->buf + r->pos;
+	caplen = pcap_u32(r, p + 8);
+	ret = pcap_reader_fill(r, 16 + (size_t)caplen);
+	if (ret <= 0)
+		return -1;
+
+	p = r->buf + r->pos;
+	pkt->linktype = r->linktype;
+	pkt->ts_ns = pcap_u32(r, p) * 1000000000ULL
+		+ pcap_u32(r, p + 4) * r->ts_unit_ns;
+	pkt->data = p + 16;
+	pkt->len = caplen;
+	r->pos += 16 + caplen;
+	return 1;
+}
+
+#define PCAPNG_SPB			0x00000003
+#define PCAPNG_PB			0x00000002	/* obsolete */
+
+/* the if_tsresol option of the interface, microseconds by default. The
+ * resolutions finer than nanoseconds or in power of 2 are not supported.
+ */
+static uint64_t pcapng_idb_ts_unit(const struct wisun_fsk_pcap_reader *r,
+				   const uint8_t *p, uint32_t block_len)
+{
+	size_t pos = 16, end = block_len - 4;
+	uint64_t unit = 1;
+
+	while (pos + 4 <= end) {
+		uint16_t code = pcap_u16(r, p + pos);
+		uint16_t len = pcap_u16(r, p + pos + 2);
+
+		if (code == 0 || pos + 4 + len > end)
+			break;
+
+		if (code == PCAPNG_OPT_IF_TSRESOL && len == 1
+		    && p[pos + 4] <= 9) {
+			for (int i = p[pos + 4]; i < 9; i++)
+				unit *= 10;
+			return unit;
+		}
+
+		pos += 4 + ((len + 3) & ~3);
+	}
+
+	return 1000;
+}
+
+static int pcap_reader_next_pcapng(struct wisun_fsk_pcap_reader *r,
+				   struct wisun_fsk_pcap_packet *pkt)
+{
+	while (1) {
+		uint32_t type, block_len, iface = 0, caplen;
+		const uint8_t *p;
+		int ret;
+
+		ret = pcap_reader_fill(r, 12);
+		if (ret <= 0)
+			return ret < 0 || r->len > r->pos ? -1 : 0;
+
+		p = r->buf + r->pos;
+		type = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+		if (type == PCAPNG_SHB) {
+			uint32_t bom = p[8] | (p[9] << 8) | (p[10] << 16)
+				     | ((uint32_t)p[11] << 24);
+
+			r->swapped = bom != PCAPNG_BYTE_ORDER_MAGIC;
+			r->nifaces = 0;
+		} else {
+			type = pcap_u32(r, p);
+		}
+
+		block_len = pcap_u32(r, p + 4);
+		if (block_len < 12 || block_len % 4) {
+			fprintf(stderr, "bad pcapng block\n");
+			return -1;
+		}
+
+		ret = pcap_reader_fill(r, block_len);
+		if (ret <= 0)
+			return -1;
+
+		p = r->buf + r->pos;
+		r->pos += block_len;
+
+		switch (type) {
+		case PCAPNG_IDB:
+			if (block_len < 20
+			    || r->nifaces >= WISUN_FSK_PCAPNG_MAX_IFACES)
+				return -1;
+			r->ifaces[r->nifaces].linktype = pcap_u16(r, p + 8);
+			r->ifaces[r->nifaces].ts_unit_ns =
+				pcapng_idb_ts_unit(r, p, block_len);
+			r->nifaces++;
+			continue;
+		case PCAPNG_EPB:
+		case PCAPNG_PB:
+			if (block_len < 32)
+				return -1;
+			iface = type == PCAPNG_EPB ? pcap_u32(r, p + 8)
+						   : pcap_u16(r, p + 8);
+			caplen = pcap_u32(r, p + 20);
+			pkt->ts_ns = ((uint64_t)pcap_u32(r, p + 12) << 32)
+				      | pcap_u32(r, p + 16);
+			pkt->data = p + 28;
+			if (caplen > block_len - 32)
+				return -1;
+			break;
+		case PCAPNG_SPB:
+			if (block_len < 16)
+				return -1;
+			caplen = pcap_u32(r, p + 8);
+			if (caplen > block_len - 16)
+				caplen = block_len - 16;
+			pkt->ts_ns = 0;
+			pkt->data = p + 12;
+			break;
+		default:
+			continue;
+		}
+
+		if (iface >= r->nifaces) {
+			fprintf(stderr, "pcapng interface %u is unknown\n",
+				iface);
+			return -1;
+		}
+
+		pkt->linktype = r->ifaces[iface].linktype;
+		pkt->ts_ns *= r->ifaces[iface].ts_unit_ns;
+		pkt->len = caplen;
+		return 1;
+	}
+}
+
+int wisun_fsk_pcap_reader_next(struct wisun_fsk_pcap_reader *r,
+			       struct wisun_fsk_pcap_packet *pkt)
+{
+	if (r->format == WISUN_FSK_PCAPNG)
+		return pcap_reader_next_pcapng(r, pkt);
+
+	return pcap_reader_next_pcap(r, pkt);
+}
@@ -0,0 +1,100 @@
+/*
+ * pcap and pcapng writer of the decoded 802.15.4 frames
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#ifndef WISUN_FSK_PCAP_H
+#define WISUN_FSK_PCAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#define LINKTYPE_IEEE802_15_4_WITHFCS	195
+#define LINKTYPE_IEEE802_15_4_NOFCS	230
+#define LINKTYPE_IEEE802_15_4_TAP	283
+
+/* the TLVs of the IEEE 802.15.4 TAP header */
+#define IEEE802154_TAP_FCS_TYPE			0
+#define IEEE802154_TAP_START_OF_FRAME_TS	5
+/* not assigned by the TAP spec, used by this tool only */
+#define IEEE802154_TAP_WISUN_SFD		0xff00
+#define IEEE802154_TAP_WISUN_FEC_MODE		0xff01
+
+enum wisun_fsk_pcap_format {
+	WISUN_FSK_PCAP,
+	WISUN_FSK_PCAPNG,
+};
+
+/* The records are saved in the buffer and written by one write(2) when the
+ * buffer is full or flushed, the timestamps are in nanoseconds. The writer
+ * can be shared by the decode threads, a record is added under its lock.
+ */
+#define WISUN_FSK_PCAP_BUFSZ		(64 << 10)
+#define WISUN_FSK_PCAP_SNAPLEN		4096
+
+struct wisun_fsk_pcap_writer {
+	pthread_mutex_t			lock;
+	int				fd;
+	enum wisun_fsk_pcap_format	format;
+	uint32_t			linktype;
+	int				err;
+	size_t				len;
+	uint8_t				buf[WISUN_FSK_PCAP_BUFSZ];
+};
+
+/* open @filename, - for stdout. The format is pcapng if the name ends with
+ * .pcapng, otherwise pcap. The header is buffered until the first flush.
+ */
+int wisun_fsk_pcap_writer_open(struct wisun_fsk_pcap_writer *w,
+			       const char *filename, uint32_t linktype);
+/* the packet data is gathered from @iov */
+int wisun_fsk_pcap_writer_add(struct wisun_fsk_pcap_writer *w, uint64_t ts_ns,
+			      const struct iovec *iov, int iovcnt);
+int wisun_fsk_pcap_writer_flush(struct wisun_fsk_pcap_writer *w);
+int wisun_fsk_pcap_writer_close(struct wisun_fsk_pcap_writer *w);
+
+/* Read the packets of a pcap or pcapng file one by one, the file is read
+ * in large chunks to a buffer which is reused by all packets.
+ */
+struct wisun_fsk_pcap_packet {
+	uint32_t		linktype;
+	uint64_t		ts_ns;
+	const uint8_t		*data;	/* valid until the next packet */
+	size_t			len;
+};
+
+#define WISUN_FSK_PCAP_MAX_BLOCK	(1 << 20)
+#define WISUN_FSK_PCAPNG_MAX_IFACES	64
+
+struct wisun_fsk_pcap_reader {
+	int				fd;
+	enum wisun_fsk_pcap_format	format;
+	int				swapped;	/* other endian */
+	uint64_t			ts_unit_ns;	/* pcap only */
+	uint32_t			linktype;	/* pcap only */
+	struct {
+		uint32_t		linktype;
+		uint64_t		ts_unit_ns;
+	}				ifaces[WISUN_FSK_PCAPNG_MAX_IFACES];
+	size_t				nifaces;
+	uint8_t				*buf;
+	size_t				buf_sz, pos, len;
+	int				eof;
+};
+
+/* open @filename, - for stdin */
+int wisun_fsk_pcap_reader_open(struct wisun_fsk_pcap_reader *r,
+			       const char *filename);
+/* Return 1 if a packet is read, 0 at the end of file or -1 on error */
+int wisun_fsk_pcap_reader_next(struct wisun_fsk_pcap_reader *r,
+			       struct wisun_fsk_pcap_packet *pkt);
+void wisun_fsk_pcap_reader_close(struct wisun_fsk_pcap_reader *r);
+
+/* append a TLV of the TAP header to @buf, the @len(<= 8) bytes integer
+ * @value is padded to 4 bytes. Return the TLV size.
+ */
+size_t ieee802154_tap_put_tlv(uint8_t *buf, uint16_t type, uint64_t value,
+			      uint16_t len);
+
+#endif
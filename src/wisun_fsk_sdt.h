@@ -0,0 +1,94 @@
+/*
+ * USDT static probes, compatible with the sys/sdt.h of systemtap
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#ifndef WISUN_FSK_SDT_H
+#define WISUN_FSK_SDT_H
+
+/* A probe is a nop in the code and a .note.stapsdt ELF note which saves the
+ * nop address and where the arguments are(register, memory or constant).
+ * bpftrace, perf and systemtap replace the nop by a breakpoint when the
+ * probe is attached, e.g.:
+ *
+ *   bpftrace -l 'usdt:./urh_wisun_fsk:*'
+ *
+ * The arguments are passed as signed 64-bit integers in the asm operands.
+ * A variable already in a register or memory costs nothing, but an
+ * expression is evaluated each time the nop is passed, even if no tracer
+ * is attached. So the probes take plain values where they can and the
+ * tracing scripts do the arithmetic, the few expressions are on the error
+ * paths or a subtraction of the encoder.
+ *
+ * Build with -DWISUN_FSK_NO_SDT to remove the probes.
+ */
+#define WISUN_FSK_SDT_PROVIDER		urh_wisun_fsk
+
+#if defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__)) \
+	&& !defined(WISUN_FSK_NO_SDT)
+
+#include <stdint.h>
+
+#ifdef __x86_64__
+#define _WISUN_FSK_SDT_CONSTRAINT	"nor"
+#else
+#define _WISUN_FSK_SDT_CONSTRAINT	"r"
+#endif
+
+#define _WISUN_FSK_SDT_STR(x)		#x
+#define _WISUN_FSK_SDT_XSTR(x)		_WISUN_FSK_SDT_STR(x)
+
+#define _WISUN_FSK_SDT_ARG(n, x)					\
+	[_sdt_arg##n] _WISUN_FSK_SDT_CONSTRAINT ((int64_t)(x))
+
+/* the note layout is the one of sys/sdt.h, the semaphore address is 0 */
+#define _WISUN_FSK_SDT_ASM(name, args)					\
+	"990:	nop\n"							\
+	".pushsection .note.stapsdt,\"?\",\"note\"\n"			\
+	".balign 4\n"							\
+	".4byte 992f-991f, 994f-993f, 3\n"				\
+	"991:	.asciz \"stapsdt\"\n"					\
+	"992:	.balign 4\n"						\
+	"993:	.8byte 990b\n"						\
+	".8byte _.stapsdt.base\n"					\
+	".8byte 0\n"							\
+	".asciz \"" _WISUN_FSK_SDT_XSTR(WISUN_FSK_SDT_PROVIDER) "\"\n"	\
+	".asciz \"" #name "\"\n"					\
+	".asciz \"" args "\"\n"						\
+	"994:	.balign 4\n"						\
+	".popsection\n"							\
+	".ifndef _.stapsdt.base\n"					\
+	".pushsection .stapsdt.base,\"aG\",\"progbits\","		\
+		".stapsdt.base,comdat\n"				\
+	".weak _.stapsdt.base\n"					\
+	".hidden _.stapsdt.base\n"					\
+	"_.stapsdt.base: .space 1\n"					\
+	".size _.stapsdt.base, 1\n"					\
+	".popsection\n"							\
+	".endif\n"
+
+#define WISUN_FSK_SDT0(name)						\
+	__asm__ __volatile__(_WISUN_FSK_SDT_ASM(name, ""))
+#define WISUN_FSK_SDT1(name, a1)					\
+	__asm__ __volatile__(_WISUN_FSK_SDT_ASM(name,			\
+		"-8@%[_sdt_arg1]")					\
+		:: _WISUN_FSK_SDT_ARG(1, a1))
+#define WISUN_FSK_SDT2(name, a1, a2)					\
+	__asm__ __volatile__(_WISUN_FSK_SDT_ASM(name,			\
+		"-8@%[_sdt_arg1] -8@%[_sdt_arg2]")			\
+		:: _WISUN_FSK_SDT_ARG(1, a1), _WISUN_FSK_SDT_ARG(2, a2))
+#define WISUN_FSK_SDT3(name, a1, a2, a3)				\
+	__asm__ __volatile__(_WISUN_FSK_SDT_ASM(name,			\
+		"-8@%[_sdt_arg1] -8@%[_sdt_arg2] -8@%[_sdt_arg3]")	\
+		:: _WISUN_FSK_SDT_ARG(1, a1), _WISUN_FSK_SDT_ARG(2, a2),\
+		   _WISUN_FSK_SDT_ARG(3, a3))
+
+#else
+
+#define WISUN_FSK_SDT0(name)				do { } while (0)
+#define WISUN_FSK_SDT1(name, a1)			do { } while (0)
+#define WISUN_FSK_SDT2(name, a1, a2)			do { } while (0)
+#define WISUN_FSK_SDT3(name, a1, a2, a3)		do { } while (0)
+
+#endif
+
+#endif
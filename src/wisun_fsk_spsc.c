@@ -0,0 +1,182 @@
+/*
+ * lock-free single producer single consumer ring of preallocated slots
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#define _GNU_SOURCE	/* CPU_SET and sched_getaffinity */
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "wisun_fsk_spsc.h"
+
+int wisun_fsk_spsc_init(struct wisun_fsk_spsc *q, size_t size, size_t slot_sz)
+{
+	memset(q, 0, sizeof(*q));
+
+	q->size = 1;
+	while (q->size < size)
+		q->size <<= 1;
+
+	/* the slots are aligned to the cache line too */
+	q->slot_sz = (slot_sz + WISUN_FSK_SPSC_CACHELINE - 1)
+			& ~(size_t)(WISUN_FSK_SPSC_CACHELINE - 1);
+	q->slots = aligned_alloc(WISUN_FSK_SPSC_CACHELINE, q->size * q->slot_sz);
+	if (!q->slots)
+		return -1;
+
+	atomic_init(&q->head, 0);
+	atomic_init(&q->tail, 0);
+	atomic_init(&q->published, 0);
+	atomic_init(&q->released, 0);
+	atomic_init(&q->consumer_waiting, 0);
+	atomic_init(&q->producer_waiting, 0);
+	return 0;
+}
+
+void wisun_fsk_spsc_exit(struct wisun_fsk_spsc *q)
+{
+	free(q->slots);
+	q->slots = NULL;
+}
+
+void *wisun_fsk_spsc_producer_slot(struct wisun_fsk_spsc *q, size_t ahead)
+{
+	size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+	if (head + ahead - tail >= q->size)
+		return NULL;
+
+	return q->slots + ((head + ahead) & (q->size - 1)) * q->slot_sz;
+}
+
+void wisun_fsk_spsc_publish(struct wisun_fsk_spsc *q)
+{
+	size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	size_t occupancy = head + 1 - tail;
+
+	q->pushes++;
+	q->occupancy_sum += occupancy;
+	if (occupancy > q->occupancy_max)
+		q->occupancy_max = occupancy;
+
+	/* the slot is written before the head is seen */
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+
+	atomic_fetch_add(&q->published, 1);
+	if (atomic_load(&q->consumer_waiting))
+		syscall(SYS_futex, &q->published, FUTEX_WAKE_PRIVATE, 1,
+			NULL, NULL, 0);
+}
+
+void *wisun_fsk_spsc_consumer_slot(struct wisun_fsk_spsc *q)
+{
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+	if (tail == head)
+		return NULL;
+
+	return q->slots + (tail & (q->size - 1)) * q->slot_sz;
+}
+
+void wisun_fsk_spsc_release(struct wisun_fsk_spsc *q)
+{
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+	/* the slot is read before the producer reuses it */
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+
+	atomic_fetch_add(&q->released, 1);
+	if (atomic_load(&q->producer_waiting))
+		syscall(SYS_futex, &q->released, FUTEX_WAKE_PRIVATE, 1,
+			NULL, NULL, 0);
+}
+
+#define WISUN_FSK_SPSC_YIELDS		64
+/* the wakeup is not lost, the timeout is a safety net only */
+#define WISUN_FSK_SPSC_TIMEOUT_NS	100000000
+
+static int spsc_yield(unsigned int *n)
+{
+	if (*n < WISUN_FSK_SPSC_YIELDS) {
+		(*n)++;
+		sched_yield();
+		return 1;
+	}
+
+	return 0;
+}
+
+static void spsc_futex_wait(_Atomic uint32_t *event, uint32_t seen)
+{
+	struct timespec ts = { .tv_nsec = WISUN_FSK_SPSC_TIMEOUT_NS };
+
+	syscall(SYS_futex, event, FUTEX_WAIT_PRIVATE, seen, &ts, NULL, 0);
+}
+
+/* The event counter is loaded before the ring is checked again, an event
+ * after that changes the counter and the futex returns at once. The other
+ * side calls FUTEX_WAKE only if a waiter is there.
+ */
+void wisun_fsk_spsc_wait_producer(struct wisun_fsk_spsc *q, size_t ahead,
+				  unsigned int *n)
+{
+	uint32_t seen;
+
+	if (spsc_yield(n))
+		return;
+
+	seen = atomic_load(&q->released);
+	atomic_store(&q->producer_waiting, 1);
+	if (!wisun_fsk_spsc_producer_slot(q, ahead))
+		spsc_futex_wait(&q->released, seen);
+	atomic_store(&q->producer_waiting, 0);
+}
+
+void wisun_fsk_spsc_wait_consumer(struct wisun_fsk_spsc *q, unsigned int *n)
+{
+	uint32_t seen;
+
+	if (spsc_yield(n))
+		return;
+
+	seen = atomic_load(&q->published);
+	atomic_store(&q->consumer_waiting, 1);
+	if (!wisun_fsk_spsc_consumer_slot(q))
+		spsc_futex_wait(&q->published, seen);
+	atomic_store(&q->consumer_waiting, 0);
+}
+
+int wisun_fsk_pin_cpu(unsigned int nth)
+{
+	cpu_set_t allowed, set;
+	int count, cpu = -1;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return -1;
+
+	count = CPU_COUNT(&allowed);
+	if (count <= 0)
+		return -1;
+
+	nth %= count;
+	for (int i = 0; i < CPU_SETSIZE; i++) {
+		if (CPU_ISSET(i, &allowed) && nth-- == 0) {
+			cpu = i;
+			break;
+		}
+	}
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	/* pid 0 is the calling thread */
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		return -1;
+
+	return cpu;
+}
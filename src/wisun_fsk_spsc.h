@@ -0,0 +1,71 @@
+/*
+ * lock-free single producer single consumer ring of preallocated slots
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#ifndef WISUN_FSK_SPSC_H
+#define WISUN_FSK_SPSC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* The slots are owned by the producer from the head to tail + size, and by
+ * the consumer from the tail to the head. The head and tail are free
+ * running counters on their own cache lines, only the producer writes the
+ * head and only the consumer writes the tail.
+ *
+ * The producer may fill several slots ahead of the head and publish them
+ * in order. The occupancy is sampled when a slot is published.
+ *
+ * A side waiting for the other one yields the cpu for a while, then sleeps
+ * on a futex of the other side's event counter, which is waked up by the
+ * next publish or release.
+ */
+#define WISUN_FSK_SPSC_CACHELINE	64
+
+struct wisun_fsk_spsc {
+	_Alignas(WISUN_FSK_SPSC_CACHELINE) _Atomic size_t head;
+	_Atomic uint32_t		published;	/* futex */
+	_Atomic int			consumer_waiting;
+	_Alignas(WISUN_FSK_SPSC_CACHELINE) _Atomic size_t tail;
+	_Atomic uint32_t		released;	/* futex */
+	_Atomic int			producer_waiting;
+
+	/* written by the producer only */
+	_Alignas(WISUN_FSK_SPSC_CACHELINE) uint64_t pushes;
+	uint64_t			drops;
+	uint64_t			occupancy_sum;
+	size_t				occupancy_max;
+
+	size_t				size;	/* power of 2 */
+	size_t				slot_sz;
+	uint8_t				*slots;
+};
+
+/* @size is rounded up to a power of 2 */
+int wisun_fsk_spsc_init(struct wisun_fsk_spsc *q, size_t size, size_t slot_sz);
+void wisun_fsk_spsc_exit(struct wisun_fsk_spsc *q);
+
+/* the @ahead'th free slot after the head, NULL if the ring is full */
+void *wisun_fsk_spsc_producer_slot(struct wisun_fsk_spsc *q, size_t ahead);
+/* publish the slot at the head to the consumer */
+void wisun_fsk_spsc_publish(struct wisun_fsk_spsc *q);
+
+/* the slot at the tail, NULL if the ring is empty */
+void *wisun_fsk_spsc_consumer_slot(struct wisun_fsk_spsc *q);
+/* give the slot at the tail back to the producer */
+void wisun_fsk_spsc_release(struct wisun_fsk_spsc *q);
+
+/* Wait a moment for a free slot or a published one, *@n is the times
+ * waited and reset by the caller when the ring is ready.
+ */
+void wisun_fsk_spsc_wait_producer(struct wisun_fsk_spsc *q, size_t ahead,
+				  unsigned int *n);
+void wisun_fsk_spsc_wait_consumer(struct wisun_fsk_spsc *q, unsigned int *n);
+
+/* Pin the calling thread to the @nth(modulo the count) cpu allowed to the
+ * process, return the cpu or -1.
+ */
+int wisun_fsk_pin_cpu(unsigned int nth);
+
+#endif
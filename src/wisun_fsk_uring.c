@@ -0,0 +1,258 @@
+/*
+ * batched asynchronous file reads by io_uring
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "wisun_fsk_uring.h"
+
+static int uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned int to_submit,
+		       unsigned int min_complete, unsigned int flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			    flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned int opcode, const void *arg,
+			  unsigned int nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_unmap(struct wisun_fsk_uring *r)
+{
+	if (r->sqes)
+		munmap(r->sqes, r->sqes_sz);
+	if (r->cq_ptr && r->cq_ptr != r->sq_ptr)
+		munmap(r->cq_ptr, r->cq_sz);
+	if (r->sq_ptr)
+		munmap(r->sq_ptr, r->sq_sz);
+	r->sqes = NULL;
+	r->sq_ptr = r->cq_ptr = NULL;
+}
+
+static int uring_map(struct wisun_fsk_uring *r, const struct io_uring_params *p)
+{
+	uint8_t *sq, *cq;
+
+	r->sq_sz = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	r->cq_sz = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_sz > r->sq_sz)
+			r->sq_sz = r->cq_sz;
+		r->cq_sz = r->sq_sz;
+	}
+
+	r->sq_ptr = mmap(NULL, r->sq_sz, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ptr == MAP_FAILED) {
+		r->sq_ptr = NULL;
+		return -1;
+	}
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ptr = r->sq_ptr;
+	} else {
+		r->cq_ptr = mmap(NULL, r->cq_sz, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_POPULATE, r->fd,
+				 IORING_OFF_CQ_RING);
+		if (r->cq_ptr == MAP_FAILED) {
+			r->cq_ptr = NULL;
+			return -1;
+		}
+	}
+
+	r->sqes_sz = p->sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = NULL;
+		return -1;
+	}
+
+	sq = r->sq_ptr;
+	r->sq_head = (unsigned int *)(sq + p->sq_off.head);
+	r->sq_tail = (unsigned int *)(sq + p->sq_off.tail);
+	r->sq_mask = (unsigned int *)(sq + p->sq_off.ring_mask);
+	r->sq_array = (unsigned int *)(sq + p->sq_off.array);
+
+	cq = r->cq_ptr;
+	r->cq_head = (unsigned int *)(cq + p->cq_off.head);
+	r->cq_tail = (unsigned int *)(cq + p->cq_off.tail);
+	r->cq_mask = (unsigned int *)(cq + p->cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+
+	return 0;
+}
+
+static int uring_open(struct wisun_fsk_uring *r)
+{
+	struct io_uring_params p;
+	struct iovec *iov;
+
+	memset(&p, 0, sizeof(p));
+	r->fd = uring_setup(r->entries, &p);
+	if (r->fd < 0)
+		return -1;
+
+	if (uring_map(r, &p) < 0)
+		return -1;
+
+	/* IORING_OP_READ_FIXED saves the page pinning of each read, the
+	 * plain reads are used if the buffers can't be registered.
+	 */
+	iov = calloc(r->nbufs, sizeof(*iov));
+	if (!iov)
+		return -1;
+
+	for (size_t i = 0; i < r->nbufs; i++) {
+		iov[i].iov_base = wisun_fsk_uring_buf(r, i);
+		iov[i].iov_len = r->buf_sz;
+	}
+
+	r->fixed = uring_register(r->fd, IORING_REGISTER_BUFFERS, iov,
+				  r->nbufs) == 0;
+	free(iov);
+	return 0;
+}
+
+int wisun_fsk_uring_init(struct wisun_fsk_uring *r, size_t nbufs,
+			 size_t buf_sz)
+{
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+	r->nbufs = nbufs;
+	r->buf_sz = buf_sz;
+
+	/* a power of 2 not less than the reads in flight */
+	r->entries = 1;
+	while (r->entries < nbufs)
+		r->entries <<= 1;
+
+	r->bufs = aligned_alloc(4096, nbufs * buf_sz);
+	r->done = calloc(r->entries, sizeof(*r->done));
+	if (!r->bufs || !r->done) {
+		wisun_fsk_uring_exit(r);
+		return -1;
+	}
+
+	if (uring_open(r) < 0) {
+		uring_unmap(r);
+		if (r->fd >= 0)
+			close(r->fd);
+		r->fd = -1;
+	}
+
+	return 0;
+}
+
+void wisun_fsk_uring_exit(struct wisun_fsk_uring *r)
+{
+	uring_unmap(r);
+	if (r->fd >= 0)
+		close(r->fd);
+	free(r->done);
+	free(r->bufs);
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+int wisun_fsk_uring_read(struct wisun_fsk_uring *r, int fd, size_t idx,
+			 uint64_t offset, size_t len, uint64_t user_data)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int tail;
+
+	if (idx >= r->nbufs || len > r->buf_sz
+	    || r->pending + r->inflight >= r->entries)
+		return -1;
+
+	if (r->fd < 0) {
+		struct wisun_fsk_uring_completion *c =
+			&r->done[r->done_tail++ & (r->entries - 1)];
+		ssize_t n;
+
+		do {
+			n = pread(fd, wisun_fsk_uring_buf(r, idx), len, offset);
+		} while (n < 0 && errno == EINTR);
+
+		c->user_data = user_data;
+		c->res = n < 0 ? -errno : (int)n;
+		r->pending++;
+		return 0;
+	}
+
+	/* only this thread writes the sq tail */
+	tail = *r->sq_tail;
+	sqe = &r->sqes[tail & *r->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = r->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)wisun_fsk_uring_buf(r, idx);
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->buf_index = idx;
+	sqe->user_data = user_data;
+	r->sq_array[tail & *r->sq_mask] = tail & *r->sq_mask;
+
+	/* the sqe is written before the kernel sees the tail */
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	r->pending++;
+	return 0;
+}
+
+int wisun_fsk_uring_wait(struct wisun_fsk_uring *r,
+			 struct wisun_fsk_uring_completion *c)
+{
+	if (r->fd < 0) {
+		if (r->done_head == r->done_tail)
+			return 0;
+		*c = r->done[r->done_head++ & (r->entries - 1)];
+		r->pending--;
+		return 1;
+	}
+
+	while (1) {
+		unsigned int head = *r->cq_head;
+		int n;
+
+		if (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+			struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+
+			c->user_data = cqe->user_data;
+			c->res = cqe->res;
+			/* the cqe is read before the kernel reuses it */
+			__atomic_store_n(r->cq_head, head + 1,
+					 __ATOMIC_RELEASE);
+			r->inflight--;
+			return 1;
+		}
+
+		if (r->pending + r->inflight == 0)
+			return 0;
+
+		/* one syscall submits all the queued reads */
+		n = uring_enter(r->fd, r->pending, 1, IORING_ENTER_GETEVENTS);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN
+			    || errno == EBUSY)
+				continue;
+			return -1;
+		}
+
+		r->pending -= n;
+		r->inflight += n;
+	}
+}
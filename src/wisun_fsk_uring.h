@@ -0,0 +1,69 @@
+/*
+ * batched asynchronous file reads by io_uring
+ * qianfan Zhao <qianfanguijin@163.com>
+ */
+#ifndef WISUN_FSK_URING_H
+#define WISUN_FSK_URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* The io_uring is set up by the raw syscalls, the reads are queued in the
+ * SQ ring and submitted together when a completion is waited. The buffers
+ * are a fixed set registered to the kernel, a read fills one of them.
+ *
+ * If io_uring is not supported(old kernel, seccomp), the reads are done by
+ * pread(2) when queued and completed in order, the callers are the same.
+ */
+struct wisun_fsk_uring_completion {
+	uint64_t			user_data;
+	int				res;	/* bytes or -errno */
+};
+
+struct wisun_fsk_uring {
+	int				fd;	/* -1: pread fallback */
+	unsigned int			entries;
+	int				fixed;	/* buffers are registered */
+
+	void				*sq_ptr, *cq_ptr;
+	size_t				sq_sz, cq_sz;
+	unsigned int			*sq_head, *sq_tail, *sq_mask;
+	unsigned int			*sq_array;
+	struct io_uring_sqe		*sqes;
+	size_t				sqes_sz;
+	unsigned int			*cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe		*cqes;
+
+	unsigned int			pending;	/* not submitted */
+	unsigned int			inflight;	/* submitted */
+
+	/* the completions of the pread fallback */
+	struct wisun_fsk_uring_completion *done;
+	unsigned int			done_head, done_tail;
+
+	uint8_t				*bufs;
+	size_t				nbufs, buf_sz;
+};
+
+/* @nbufs buffers of @buf_sz bytes, at most @nbufs reads are queued */
+int wisun_fsk_uring_init(struct wisun_fsk_uring *r, size_t nbufs,
+			 size_t buf_sz);
+void wisun_fsk_uring_exit(struct wisun_fsk_uring *r);
+
+static inline uint8_t *wisun_fsk_uring_buf(const struct wisun_fsk_uring *r,
+					   size_t idx)
+{
+	return r->bufs + idx * r->buf_sz;
+}
+
+/* queue a read of @len(<= buf_sz) bytes at @offset to the buffer @idx */
+int wisun_fsk_uring_read(struct wisun_fsk_uring *r, int fd, size_t idx,
+			 uint64_t offset, size_t len, uint64_t user_data);
+/* Submit the queued reads and wait for a completion.
+ * Return 1 if a completion is saved in @c, 0 if nothing is queued or -1 on
+ * error.
+ */
+int wisun_fsk_uring_wait(struct wisun_fsk_uring *r,
+			 struct wisun_fsk_uring_completion *c);
+
+#endif
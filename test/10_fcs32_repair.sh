@@ -0,0 +1,91 @@
+# Wisun 2-FSK FCS32 bit error repair test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+
+# $1: the 01 string
+# $2...: the bit index to be flipped
+flip_bits () {
+    local s=$1 c
+
+    shift 1
+
+    for i in "$@" ; do
+        c=${s:$i:1}
+        [ "${c}" = "0" ] && c=1 || c=0
+        s="${s:0:$i}${c}${s:$((i+1))}"
+    done
+
+    echo "${s}"
+}
+
+# $1: expected decode result
+# $2: the 01 string
+# $3...: decode options
+repair_test () {
+    local expected=$1 packet=$2
+    local decode
+
+    shift 2
+
+    printf "urh_wisun_fsk fcs32 repair test ${sequence}... "
+
+    decode=$(./urh_wisun_fsk.debug --hexo --human "$@" "${packet}" 2>/dev/null)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    else
+        printf "pass\n"
+    fi
+
+    let sequence++
+}
+
+# 64 bits preamble, 16 bits sfd and 16 bits phr before the PSDU
+psdu=96
+
+long=$(./urh_wisun_fsk.debug --packet --encode --hexi --whitening \
+       00112233445566778899)
+long_result="aaaaaaaaaaaaaaaa-7209-7010-00112233445566778899-c803a92b"
+
+# 1 byte payload, the FCS32 is computed with padding
+short=$(./urh_wisun_fsk.debug --packet --encode --hexi 11)
+short_result="aaaaaaaaaaaaaaaa-7209-a000-11-e6efe1c9"
+
+repair_test "" "$(flip_bits ${long} $((psdu + 3)))" \
+    || exit $?
+repair_test "${long_result}" "$(flip_bits ${long} $((psdu + 3)))" \
+    --repair 1 || exit $?
+repair_test "${long_result}" "$(flip_bits ${long} $((psdu + 110)))" \
+    --repair 1 || exit $?
+repair_test "" "$(flip_bits ${long} $((psdu + 3)) $((psdu + 60)))" \
+    --repair 1 || exit $?
+repair_test "${long_result}" "$(flip_bits ${long} $((psdu + 3)) $((psdu + 60)))" \
+    --repair 2 || exit $?
+repair_test "${short_result}" "$(flip_bits ${short} $((psdu + 5)))" \
+    --repair 1 || exit $?
+repair_test "${short_result}" "$(flip_bits ${short} $((psdu + 1)) $((psdu + 39)))" \
+    --repair 2 || exit $?
+
+# the repair is reported with --verbose only
+printf "urh_wisun_fsk fcs32 repair test ${sequence}... "
+report=$(./urh_wisun_fsk.debug --hexo --repair 1 \
+         "$(flip_bits ${long} $((psdu + 3)))" 2>&1 >/dev/null)
+if [ -n "${report}" ] ; then
+    printf "\nR: ${report}\nfailed\n"
+    exit 1
+fi
+report=$(./urh_wisun_fsk.debug --hexo --repair 1 --verbose \
+         "$(flip_bits ${long} $((psdu + 3)))" 2>&1 >/dev/null)
+case "${report}" in
+    *"repaired 1 bit error at PSDU bit 3"*)
+        ;;
+    *)
+        printf "\nR: ${report}\nfailed\n"
+        exit 1
+        ;;
+esac
+printf "pass\n"
+let sequence++
@@ -0,0 +1,110 @@
+# Wisun 2-FSK indexed stream decode test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+tmpdir=$(mktemp -d)
+trap "rm -rf ${tmpdir}" EXIT
+
+# $1: expected decode result
+# $2: the capture file
+# $3...: decode options
+index_decode_test () {
+    local expected=$1 capture=$2
+    local decode
+
+    shift 2
+
+    printf "urh_wisun_fsk index decode test ${sequence}... "
+
+    decode=$(./urh_wisun_fsk.debug --stream --hexo --human "$@" \
+             --index ${capture}.idx ${capture} 2>/dev/null)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    else
+        printf "pass\n"
+    fi
+
+    let sequence++
+}
+
+uncoded=$(./urh_wisun_fsk.debug --packet --encode --hexi 1122334455)
+coded=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 --rsc \
+        --interleaving --whitening 1122334455)
+uncoded_result="aaaaaaaaaaaaaaaa-7209-9000-1122334455-295aa038"
+coded_result="aaaaaaaaaaaaaaaa-72f6-9010-1122334455-295aa038"
+
+# the frames are split into lines, a bad FCS frame is indexed too
+bad=${uncoded:0:100}$((1 - ${uncoded:100:1}))${uncoded:101}
+printf "0110${uncoded}1011001${bad}0000111${uncoded}" | fold -w 13 \
+    > ${tmpdir}/uncoded.txt
+./urh_wisun_fsk.debug --stream --build-index ${tmpdir}/uncoded.txt.idx \
+    ${tmpdir}/uncoded.txt 2>/dev/null || exit $?
+
+printf "urh_wisun_fsk index decode test ${sequence}... "
+./urh_wisun_fsk.debug --stream --index ${tmpdir}/uncoded.txt.idx \
+    --dump-index ${tmpdir}/uncoded.txt > ${tmpdir}/dump || exit $?
+count=$(awk 'NR == 1 { print $2 }' ${tmpdir}/dump)
+if [ X"${count}" != X"3" ] ; then
+    printf "\nE: 3 entries\nR: ${count} entries\nfailed\n"
+    exit 1
+fi
+# WISUN_FSK_INDEX_CRC_GOOD is clear for the bad FCS frame only
+for i in 0 1 2 ; do
+    flags=$(awk -v n=$((i + 2)) 'NR == n { print $7 }' ${tmpdir}/dump)
+    if [ $(( 0x${flags} & 1 )) -ne $(( i != 1 )) ] ; then
+        printf "\nentry ${i} flags ${flags}\nfailed\n"
+        exit 1
+    fi
+done
+printf "pass\n"
+let sequence++
+
+index_decode_test \
+    "$(printf "${uncoded_result}\n${uncoded_result}")" \
+    ${tmpdir}/uncoded.txt \
+    || exit $?
+
+# the index is built once, decoded with other options later
+printf "10${coded}0001${coded}11" > ${tmpdir}/coded.txt
+./urh_wisun_fsk.debug --stream --build-index ${tmpdir}/coded.txt.idx \
+    ${tmpdir}/coded.txt 2>/dev/null || exit $?
+
+index_decode_test \
+    "$(printf "${coded_result}\n${coded_result}")" \
+    ${tmpdir}/coded.txt \
+    --rsc --interleaving \
+    || exit $?
+
+# the index is stale after the capture is changed
+printf "urh_wisun_fsk index decode test ${sequence}... "
+printf "0" >> ${tmpdir}/coded.txt
+if ./urh_wisun_fsk.debug --stream --index ${tmpdir}/coded.txt.idx \
+    ${tmpdir}/coded.txt 2>/dev/null ; then
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+# an entry out of the capture is refused, the offsets of the first entry are
+# overwritten. The entries are after the header.
+printf "urh_wisun_fsk index decode test ${sequence}... "
+entry_size=$(awk 'NR == 1 { print $4 }' ${tmpdir}/dump)
+header_size=$(( $(wc -c < ${tmpdir}/uncoded.txt.idx) - 3 * entry_size ))
+head -c 16 /dev/zero | tr '\0' '\377' | dd of=${tmpdir}/uncoded.txt.idx \
+    bs=1 seek=${header_size} conv=notrunc 2>/dev/null
+report=$(./urh_wisun_fsk.debug --stream --index ${tmpdir}/uncoded.txt.idx \
+         ${tmpdir}/uncoded.txt 2>&1 >/dev/null)
+case "${report}" in
+    *"entry 0 is out of the capture"*)
+        ;;
+    *)
+        printf "\nR: ${report}\nfailed\n"
+        exit 1
+        ;;
+esac
+printf "pass\n"
+let sequence++
@@ -0,0 +1,127 @@
+# Wisun 2-FSK decode result cache test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+tmpdir=$(mktemp -d)
+trap "rm -rf ${tmpdir}" EXIT
+
+# $1: expected decode result
+# $2...: decode options
+cache_decode_test () {
+    local expected=$1
+    local decode
+
+    shift 1
+
+    printf "urh_wisun_fsk cache decode test ${sequence}... "
+
+    decode=$(./urh_wisun_fsk.debug --packet --decode --cache ${tmpdir}/cache "$@" \
+             2>/dev/null)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    else
+        printf "pass\n"
+    fi
+
+    let sequence++
+}
+
+uncoded=$(./urh_wisun_fsk.debug --packet --encode --hexi 1122334455)
+coded=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 --rsc \
+        --interleaving --whitening 1122334455)
+uncoded_result="aaaaaaaaaaaaaaaa-7209-9000-1122334455-295aa038"
+coded_result="aaaaaaaaaaaaaaaa-72f6-9010-1122334455-295aa038"
+
+# the first one is decoded and saved, the second is loaded from the cache
+for i in 1 2 ; do
+    cache_decode_test "${uncoded_result}" --hexo --human ${uncoded} \
+        || exit $?
+    cache_decode_test "${coded_result}" --hexo --human --rsc --interleaving \
+        ${coded} || exit $?
+done
+
+# the options are a part of the key
+cache_decode_test "$(./urh_wisun_fsk.debug --decode ${uncoded})" \
+    ${uncoded} || exit $?
+
+printf "urh_wisun_fsk cache decode test ${sequence}... "
+if ! grep -q "${coded_result}" ${tmpdir}/cache ; then
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+# the failed results are not saved
+printf "urh_wisun_fsk cache decode test ${sequence}... "
+bad=${uncoded:0:100}$((1 - ${uncoded:100:1}))${uncoded:101}
+for i in 1 2 ; do
+    if ./urh_wisun_fsk.debug --decode --cache ${tmpdir}/cache ${bad} \
+        >/dev/null 2>&1 ; then
+        printf "failed\n"
+        exit 1
+    fi
+done
+printf "pass\n"
+let sequence++
+
+# the --verbose report of --repair in stderr is printed by the hits too
+printf "urh_wisun_fsk cache decode test ${sequence}... "
+bad2=${uncoded:0:110}$((1 - ${uncoded:110:1}))${uncoded:111}
+for i in 1 2 ; do
+    ./urh_wisun_fsk.debug --packet --decode --repair 1 --verbose --hexo \
+        --cache ${tmpdir}/cache ${bad2} \
+        > ${tmpdir}/out.${i} 2> ${tmpdir}/err.${i} \
+        || { printf "failed\n"; exit 1; }
+done
+if ! grep -q "repaired" ${tmpdir}/err.2 \
+   || ! cmp -s ${tmpdir}/out.1 ${tmpdir}/out.2 \
+   || ! cmp -s ${tmpdir}/err.1 ${tmpdir}/err.2 ; then
+    printf "\nE: $(cat ${tmpdir}/out.1 ${tmpdir}/err.1)\n"
+    printf "R: $(cat ${tmpdir}/out.2 ${tmpdir}/err.2)\n"
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+# the key is the parsed options, a hit is printed without decoding. The
+# saved result is changed to prove it.
+printf "urh_wisun_fsk cache decode test ${sequence}... "
+./urh_wisun_fsk.debug --packet --decode --hexo --human \
+    --cache ${tmpdir}/cache2 ${uncoded} > /dev/null 2>&1
+LC_ALL=C sed -i 's/295aa038/deadbeef/' ${tmpdir}/cache2
+for opts in "--human --hexo" "--hum --hexo" "--hexo --hum" ; do
+    decode=$(./urh_wisun_fsk.debug --packet --decode ${opts} \
+             --cache=${tmpdir}/cache2 ${uncoded} 2>/dev/null)
+    if [ X"${decode}" != X"${uncoded_result%295aa038}deadbeef" ] ; then
+        printf "\nE: ${uncoded_result%295aa038}deadbeef\nR: ${decode}\n"
+        printf "failed\n"
+        exit 1
+    fi
+done
+printf "pass\n"
+let sequence++
+
+# a file which isn't a cache is refused and never changed
+printf "urh_wisun_fsk cache decode test ${sequence}... "
+head -c 4096 /dev/zero | tr '\000' 'x' > ${tmpdir}/capture
+cp ${tmpdir}/capture ${tmpdir}/capture.orig
+for i in 1 2 ; do
+    if ./urh_wisun_fsk.debug --decode --cache ${tmpdir}/capture ${uncoded} \
+        >/dev/null 2>&1 ; then
+        printf "failed\n"
+        exit 1
+    fi
+    if ! cmp -s ${tmpdir}/capture ${tmpdir}/capture.orig ; then
+        printf "changed\nfailed\n"
+        exit 1
+    fi
+    # the same size of a cache file
+    truncate -s $(stat -c %s ${tmpdir}/cache) ${tmpdir}/capture
+    cp ${tmpdir}/capture ${tmpdir}/capture.orig
+done
+printf "pass\n"
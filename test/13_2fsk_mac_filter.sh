@@ -0,0 +1,82 @@
+# Wisun 2-FSK MAC header filter test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+tmpdir=$(mktemp -d)
+trap "rm -rf ${tmpdir}" EXIT
+
+# $1: expected decode result
+# $2...: decode options
+filter_decode_test () {
+    local expected=$1
+    local decode
+
+    shift 1
+
+    printf "urh_wisun_fsk filter decode test ${sequence}... "
+
+    decode=$(./urh_wisun_fsk.debug --hexo "$@" 2>/dev/null)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    else
+        printf "pass\n"
+    fi
+
+    let sequence++
+}
+
+# data abcd:5678 -> abcd:1234, short addresses and PAN ID compression
+data_short=41a801cdab34127856aabb
+# data abcd:08090a0b0c0d0e0f -> 0011223344556677
+data_ext=01ec02cdab77665544332211000f0e0d0c0b0a0908cc
+# version 0 beacon from 1234:0001
+beacon=008003341201000102
+
+stream=01
+for psdu in ${data_short} ${data_ext} ${beacon} ; do
+    stream=${stream}$(./urh_wisun_fsk.debug --packet --encode --hexi ${psdu})0011
+done
+echo ${stream} > ${tmpdir}/stream.txt
+
+data_short_result=aaaaaaaaaaaaaaaa097200f0${data_short}9899903e
+data_ext_result=aaaaaaaaaaaaaaaa09720058${data_ext}c7eb3b86
+beacon_result=aaaaaaaaaaaaaaaa097200b0${beacon}b83db84e
+
+filter_decode_test \
+    "$(printf "${data_short_result}\n${data_ext_result}")" \
+    --stream --filter type=data ${tmpdir}/stream.txt \
+    || exit $?
+
+filter_decode_test "${beacon_result}" \
+    --stream --filter pan=1234 ${tmpdir}/stream.txt \
+    || exit $?
+
+filter_decode_test "${data_ext_result}" \
+    --stream --filter type=data,dst=00:11:22:33:44:55:66:77 \
+    ${tmpdir}/stream.txt \
+    || exit $?
+
+# the filters are or'ed
+filter_decode_test \
+    "$(printf "${data_short_result}\n${beacon_result}")" \
+    --stream --filter src=0x5678 --filter type=beacon ${tmpdir}/stream.txt \
+    || exit $?
+
+# the dropped packet prints nothing
+filter_decode_test "" --decode --filter type=ack \
+    $(./urh_wisun_fsk.debug --packet --encode --hexi ${data_short}) \
+    || exit $?
+
+filter_decode_test "${data_short_result}" --decode --filter pan=abcd \
+    $(./urh_wisun_fsk.debug --packet --encode --hexi ${data_short}) \
+    || exit $?
+
+printf "urh_wisun_fsk filter decode test ${sequence}... "
+if ./urh_wisun_fsk.debug --filter type=foo --decode 0 2>/dev/null ; then
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
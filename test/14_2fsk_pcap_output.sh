@@ -0,0 +1,122 @@
+# Wisun 2-FSK pcap output and extcap test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+tmpdir=$(mktemp -d)
+trap "rm -rf ${tmpdir}" EXIT
+
+# $1: the pcap file
+# $2: the hex string expected in the pcap
+# $3: expected file size
+pcap_test () {
+    local pcap=$1 expected=$2 size=$3
+    local hex
+
+    printf "urh_wisun_fsk pcap output test ${sequence}... "
+
+    hex=$(od -An -v -tx1 ${pcap} | tr -d ' \n')
+    case "${hex}" in
+        *${expected}*)
+            ;;
+        *)
+            printf "\nE: ${expected}\nR: ${hex}\n"
+            printf "failed\n"
+            return 1
+            ;;
+    esac
+
+    if [ $(wc -c < ${pcap}) != ${size} ] ; then
+        printf "\nsize $(wc -c < ${pcap}) != ${size}\nfailed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+psdu=41a801cdab34127856aabb
+fcs=9899903e
+linktype_tap=1b010000
+uncoded=$(./urh_wisun_fsk.debug --packet --encode --hexi ${psdu})
+coded=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 --rsc \
+        --interleaving ${psdu})
+printf "01${uncoded}0011${coded}0" > ${tmpdir}/stream.txt
+
+# pcap header(nanosecond), 2 records without FCS
+./urh_wisun_fsk.debug --stream --auto --pcap ${tmpdir}/nofcs.pcap \
+    ${tmpdir}/stream.txt 2>/dev/null || exit $?
+pcap_test ${tmpdir}/nofcs.pcap 4d3cb2a102000400000000000000000000100000e6000000 \
+    $((24 + (16 + 11) * 2)) || exit $?
+pcap_test ${tmpdir}/nofcs.pcap 0b0000000b000000${psdu} \
+    $((24 + (16 + 11) * 2)) || exit $?
+
+# the FCS32 is saved with the TAP header of the FCS type, the TLVs of the
+# FCS type and the frame time
+./urh_wisun_fsk.debug --decode --pcap-linktype tap-fcs --pcap - ${uncoded} \
+    > ${tmpdir}/tapfcs.pcap || exit $?
+pcap_test ${tmpdir}/tapfcs.pcap 00100000${linktype_tap} \
+    $((24 + 16 + 24 + 15)) || exit $?
+pcap_test ${tmpdir}/tapfcs.pcap 270000002700000000001800000001000200000005000800 \
+    $((24 + 16 + 24 + 15)) || exit $?
+pcap_test ${tmpdir}/tapfcs.pcap ${psdu}${fcs} \
+    $((24 + 16 + 24 + 15)) || exit $?
+
+# pcapng, the TAP header has FCS type, SFD and FEC mode(RSC, interleaving)
+./urh_wisun_fsk.debug --stream --auto --pcap-linktype tap \
+    --pcap ${tmpdir}/tap.pcapng ${tmpdir}/stream.txt 2>/dev/null || exit $?
+pcap_test ${tmpdir}/tap.pcapng 0a0d0d0a1c0000004d3c2b1a01000000 \
+    $((28 + 32 + (32 + 40 + 16) * 2)) || exit $?
+pcap_test ${tmpdir}/tap.pcapng 00ff0200f672000001ff010006000000${psdu}${fcs} \
+    $((28 + 32 + (32 + 40 + 16) * 2)) || exit $?
+
+# the filtered packets are not saved
+./urh_wisun_fsk.debug --stream --auto --filter type=beacon \
+    --pcap ${tmpdir}/empty.pcap ${tmpdir}/stream.txt 2>/dev/null || exit $?
+pcap_test ${tmpdir}/empty.pcap 4d3cb2a1 24 || exit $?
+
+printf "urh_wisun_fsk extcap test ${sequence}... "
+if ! ./urh_wisun_fsk.debug --extcap-interfaces | grep -q "value=wisun2fsk" \
+    || ! ./urh_wisun_fsk.debug --extcap-dlts --extcap-interface wisun2fsk \
+        | grep -q "number=283" ; then
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+./urh_wisun_fsk.debug --capture --extcap-interface wisun2fsk \
+    --fifo ${tmpdir}/extcap.pcap --input ${tmpdir}/stream.txt --auto \
+    2>/dev/null || exit $?
+pcap_test ${tmpdir}/extcap.pcap 1b010000 $((24 + (16 + 40 + 15) * 2)) \
+    || exit $?
+
+# the linktype 195 is FCS16 for wireshark, it can't save the FCS32
+printf "urh_wisun_fsk pcap output test ${sequence}... "
+if ./urh_wisun_fsk.debug --decode --pcap-linktype withfcs --pcap - \
+       ${uncoded} > /dev/null 2>&1 ; then
+    printf "withfcs is accepted\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
+sequence=$((sequence + 1))
+
+# wireshark gets the pcap header before the first input chunk
+printf "urh_wisun_fsk pcap output test ${sequence}... "
+mkfifo ${tmpdir}/live.in ${tmpdir}/live.pcap
+./urh_wisun_fsk.debug --capture --extcap-interface wisun2fsk \
+    --fifo ${tmpdir}/live.pcap --input ${tmpdir}/live.in --auto \
+    > /dev/null 2>&1 &
+capture=$!
+timeout 10 head -c 24 ${tmpdir}/live.pcap > ${tmpdir}/live.hdr &
+header=$!
+exec 3> ${tmpdir}/live.in
+wait ${header}
+ret=$?
+exec 3>&-
+wait ${capture}
+if [ ${ret} != 0 ] || [ $(wc -c < ${tmpdir}/live.hdr) != 24 ] ; then
+    printf "no pcap header before the input\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
+sequence=$((sequence + 1))
@@ -0,0 +1,77 @@
+# Wisun 2-FSK pcap input encode test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+tmpdir=$(mktemp -d)
+trap "rm -rf ${tmpdir}" EXIT
+
+# the packets decoded to pcap are encoded back to the same bits
+# $1: pcap file name
+# $2...: options of encode and decode
+pcap_encode_test () {
+    local pcap=${tmpdir}/$1
+
+    shift 1
+
+    printf "urh_wisun_fsk pcap encode test ${sequence}... "
+
+    ./urh_wisun_fsk.debug --stream --pcap ${pcap} "$@" ${tmpdir}/stream.txt \
+        2>/dev/null || return $?
+    ./urh_wisun_fsk.debug --encode --pcap-input ${pcap} "$@" \
+        > ${tmpdir}/encoded.txt || return $?
+
+    if ! cmp -s ${tmpdir}/encoded.txt ${tmpdir}/expected.txt ; then
+        printf "failed\n"
+        diff ${tmpdir}/expected.txt ${tmpdir}/encoded.txt
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+# $1...: encode options
+make_stream () {
+    : > ${tmpdir}/stream.txt
+    : > ${tmpdir}/expected.txt
+
+    for psdu in 41a801cdab34127856aabb 008003341201000102 00 \
+        01ec02cdab77665544332211000f0e0d0c0b0a0908cc ; do
+        e=$(./urh_wisun_fsk.debug --packet --encode --hexi "$@" ${psdu})
+        echo ${e} >> ${tmpdir}/expected.txt
+        printf "0101${e}00" >> ${tmpdir}/stream.txt
+    done
+}
+
+make_stream
+pcap_encode_test nofcs.pcap || exit $?
+pcap_encode_test tapfcs.pcapng --pcap-linktype tap-fcs || exit $?
+
+make_stream --sfd coded0 --rsc --interleaving --whitening
+pcap_encode_test tap.pcap --pcap-linktype tap --sfd coded0 --rsc \
+    --interleaving --whitening || exit $?
+pcap_encode_test tap.pcapng --pcap-linktype tap --sfd coded0 --rsc \
+    --interleaving --whitening || exit $?
+
+# all packets are modulated to one IQ stream
+printf "urh_wisun_fsk pcap encode test ${sequence}... "
+./urh_wisun_fsk.debug --encode --pcap-input ${tmpdir}/tap.pcap --sfd coded0 \
+    --rsc --interleaving --whitening --iq-format cs8 --sps 4 \
+    --iq-output ${tmpdir}/stream.iq || exit $?
+bits=$(tr -d '\n' < ${tmpdir}/expected.txt | wc -c)
+size=$(wc -c < ${tmpdir}/stream.iq)
+if [ ${size} -lt $((bits * 4 * 2)) ] ; then
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+printf "urh_wisun_fsk pcap encode test ${sequence}... "
+echo "not a pcap file" > ${tmpdir}/bad.pcap
+if ./urh_wisun_fsk.debug --encode --pcap-input ${tmpdir}/bad.pcap \
+    2>/dev/null ; then
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
@@ -0,0 +1,78 @@
+# Wisun 2-FSK channel simulation test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+
+# print the point, frames, PER, BER and undetected columns
+# $@: simulate options
+simulate () {
+    ./urh_wisun_fsk.debug --simulate --sim-frames 200 --sim-length 20 "$@" \
+        | awk 'NR > 1 { print $1, $2, $3, $4, $5 }'
+}
+
+# $1: expected result
+# $2...: simulate options
+simulate_test () {
+    local expected=$1
+    local result
+
+    shift 1
+
+    printf "urh_wisun_fsk simulate test ${sequence}... "
+
+    result=$(simulate "$@")
+    if [ X"${result}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${result}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+# a clean channel, and a channel in which nothing is decoded
+simulate_test "$(printf "0 200 0.000e+00 0.000e+00 0\n0.5 200 1.000e+00 - 0")" \
+    --sim-channel flip --sim-points 0,0.5 || exit $?
+simulate_test "0 200 0.000e+00 0.000e+00 0" \
+    --sim-channel burst:16 --sfd coded0 --rsc --interleaving \
+    --sim-points 0 || exit $?
+simulate_test "20 200 0.000e+00 0.000e+00 0" \
+    --sim-channel awgn --sfd coded1 --whitening --sim-points 20 || exit $?
+
+# the noisy points, the frames and the noise are generated by the seed
+simulate_test "0.003 200 5.450e-01 3.537e-03 0" \
+    --sim-channel flip --sim-points 0.003 || exit $?
+simulate_test "9 200 7.200e-01 0.000e+00 0" \
+    --sim-channel awgn --sfd coded0 --rsc --sim-points 9 || exit $?
+# --auto finds the same FEC of the frames
+simulate_test "9 200 7.200e-01 0.000e+00 0" \
+    --sim-channel awgn --sfd coded0 --rsc --auto --sim-points 9 || exit $?
+
+# the results don't depend on the threads
+for options in "--sim-channel flip --sim-points 0.001,0.003" \
+    "--sim-channel awgn --sim-points 6:8:1 --sim-seed 7" \
+    "--sim-channel burst --sim-points 0.0002 --repair 2" ; do
+    simulate_test "$(simulate --threads 1 ${options})" --threads 3 \
+        ${options} || exit $?
+done
+
+printf "urh_wisun_fsk simulate test ${sequence}... "
+if ./urh_wisun_fsk.debug --simulate --sim-points 3:1:1 2>/dev/null \
+    || ./urh_wisun_fsk.debug --simulate --sim-channel foo 2>/dev/null \
+    || ./urh_wisun_fsk.debug --simulate --sim-frames 0 2>/dev/null ; then
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+# the bad frames are not reported without --verbose
+printf "urh_wisun_fsk simulate test ${sequence}... "
+err=$(./urh_wisun_fsk.debug --simulate --sim-frames 20 --sim-channel flip \
+      --sim-points 0.01 --auto 2>&1 >/dev/null)
+if [ -n "${err}" ] ; then
+    printf "\n${err}\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
@@ -0,0 +1,73 @@
+# SIMD kernel dispatch test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+
+# $1: isa
+isa_is_supported () {
+    ! ./urh_wisun_fsk.debug --isa-verify=1 --force-isa $1 | grep -q unsupported
+}
+
+isa_verify_test () {
+    local output result
+
+    printf "urh_wisun_fsk isa test ${sequence}... "
+
+    # all rows of the supported ISAs have no mismatches
+    output=$(./urh_wisun_fsk.debug --isa-verify=2000) || result="exit $?"
+    result=${result}$(echo "${output}" | awk 'NR > 1 && NF == 4 && $4 != 0')
+    if [ -n "${result}" ] ; then
+        printf "\nR: ${result}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+# $1: expected result
+# $2...: decode options
+isa_decode_test () {
+    local expected=$1
+    local result
+
+    shift 1
+
+    for isa in scalar sse4.2 avx2 avx512 ; do
+        isa_is_supported ${isa} || continue
+
+        printf "urh_wisun_fsk isa test ${sequence}(${isa})... "
+
+        result=$(./urh_wisun_fsk.debug --force-isa ${isa} "$@")
+        if [ X"${result}" != X"${expected}" ] ; then
+            printf "\nE: ${expected}\nR: ${result}\n"
+            printf "failed\n"
+            return 1
+        fi
+
+        printf "pass\n"
+    done
+
+    let sequence++
+}
+
+isa_verify_test || exit $?
+
+# a long whitened, interleaved RSC packet, whose blocks are decoded in chunks
+psdu=$(awk 'BEGIN { for (i = 0; i < 300; i++) printf "%02x", (i * 7) % 256 }')
+for fec in --rsc --nrnsc ; do
+    coded=$(./urh_wisun_fsk.debug --encode --packet --hexi ${fec} \
+                --interleaving --whitening --sfd coded0 ${psdu})
+    expected=$(./urh_wisun_fsk.debug --force-isa scalar --decode --packet \
+                   ${fec} --interleaving --hexo ${coded})
+    isa_decode_test "${expected}" --decode --packet ${fec} --interleaving \
+        --hexo ${coded} || exit $?
+done
+
+printf "urh_wisun_fsk isa test ${sequence}... "
+if ./urh_wisun_fsk.debug --force-isa sse5 --isa-verify 2>/dev/null ; then
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
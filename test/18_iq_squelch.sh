@@ -0,0 +1,73 @@
+# IQ burst detector(squelch) test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+capture=$(mktemp)
+trap "rm -f ${capture} ${capture}.noise" EXIT
+
+# cs8 noise of +-1, $1 bytes. The noise is the same each run and on each
+# machine, a random one may look like the preamble bits before a packet.
+# A 4096 bytes block of a LCG in the shell arithmetic is repeated.
+noise () {
+    local x=1 i s=
+
+    if [ ! -f ${capture}.noise ] ; then
+        for ((i = 0; i < 4096; i++)) ; do
+            x=$(( (x * 1103515245 + 12345) & 0x7fffffff ))
+            if (( x >> 30 )) ; then s+='\001' ; else s+='\377' ; fi
+        done
+        printf "${s}" > ${capture}.noise
+    fi
+
+    for ((i = 0; i < $1; i += 4096)) ; do
+        cat ${capture}.noise
+    done | head -c $1
+}
+
+# $1: hex PSDU
+modulate () {
+    ./urh_wisun_fsk.debug --packet --encode --hexi --sfd uncoded0 \
+        --whitening --iq-format cs8 --sps 8 --iq-output - $1
+}
+
+# $1: expected decode result
+# $2: expected squelch message
+# $3...: decode options
+squelch_test () {
+    local expected=$1 expected_msg=$2
+    local decode msg
+
+    shift 2
+
+    printf "urh_wisun_fsk squelch test ${sequence}... "
+
+    decode=$(./urh_wisun_fsk.debug --channelizer --iq-format cs8 \
+                --sample-rate 400000 --channels 1 --hexo --human -v "$@" \
+                ${capture} 2>${capture}.msg)
+    msg=$(grep squelch ${capture}.msg)
+    rm -f ${capture}.msg
+
+    if [ X"${decode}" != X"${expected}" ] || [ X"${msg}" != X"${expected_msg}" ] ; then
+        printf "\nE: ${expected}\n   ${expected_msg}\nR: ${decode}\n   ${msg}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+# two bursts in 3 seconds of noise, 74 blocks of 16384 samples
+(noise 800000; modulate 1122334455; noise 800000; modulate 66778899;
+ noise 800000) > ${capture}
+
+expected="$(printf "%s\n%s" \
+    "ch0: aaaaaaaaaaaaaaaa-7209-9010-1122334455-295aa038" \
+    "ch0: aaaaaaaaaaaaaaaa-7209-1010-66778899-b5303e14")"
+
+squelch_test "${expected}" "" || exit $?
+# each burst is demodulated with a block before and after it
+squelch_test "${expected}" "squelch: 6 of 74 blocks demodulated" \
+    --squelch 10 || exit $?
+# the bursts are under the threshold
+squelch_test "" "squelch: 0 of 74 blocks demodulated" --squelch 60 || exit $?
@@ -0,0 +1,48 @@
+# IQ rational resampler test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+
+# $1: expected decode result
+# $2: samples per symbol of the modulator
+# $3: IQ sample format
+# $4...: decode options
+resample_test () {
+    local expected=$1 sps=$2 format=$3
+    local rate=$((sps * 50000))
+    local decode
+
+    shift 3
+
+    printf "urh_wisun_fsk resample test ${sequence}... "
+
+    # 4 channels, 2x over sampled, the channel rate is rate / 2
+    decode=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 \
+                --rsc --interleaving --whitening --iq-format ${format} \
+                --sps ${sps} --iq-output - 00112233445566778899aabbccddeeff \
+             | ./urh_wisun_fsk.debug --channelizer --rsc --interleaving \
+                --iq-format ${format} --sample-rate ${rate} \
+                --channel-spacing $((rate / 4)) --channels 1 \
+                --hexo --human "$@" -)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+expected="ch0: aaaaaaaaaaaaaaaa-72f6-2810-00112233445566778899aabbccddeeff-9b750784"
+
+# 4.5, 3.5 and 2.5 samples per symbol to 8
+resample_test "${expected}" 9 cs16 --resample-sps 8 || exit $?
+resample_test "${expected}" 7 cf32 --resample-sps 8 || exit $?
+resample_test "${expected}" 5 cs8 --resample-sps 8 || exit $?
+# down sampled, 16 to 4
+resample_test "${expected}" 32 cs16 --resample-sps 4 || exit $?
+# too large ratio
+resample_test "" 9 cs16 --resample-sps 8 --symbol-rate 49999 2>/dev/null \
+    || exit $?
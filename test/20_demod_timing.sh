@@ -0,0 +1,111 @@
+# Symbol timing recovery test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+soft=$(mktemp)
+trap "rm -f ${soft}" EXIT
+
+expected="aaaaaaaaaaaaaaaa-72f6-2810-00112233445566778899aabbccddeeff-9b750784"
+
+bits=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 --rsc \
+        --interleaving --whitening 00112233445566778899aabbccddeeff)
+
+# $1: samples per symbol of the transmitter, can be fractional
+# $2: the sampling phase of the first symbol
+# print the NRZ(+1.0, -1.0) float32 samples of ${bits}
+demod_samples () {
+    echo "${bits}" | awk -v sps=$1 -v t=$2 '
+        function f32(v) {
+            return v > 0 ? "0000803f" : (v < 0 ? "000080bf" : "00000000")
+        }
+        {
+            for (i = 1; i <= length($0); i++) {
+                v = substr($0, i, 1) == "1" ? 1 : -1
+                for (t += sps; t >= 1; t--)
+                    print f32(v)
+            }
+            for (i = 0; i < 64; i++)
+                print f32(0)
+        }' | xxd -r -p
+}
+
+# $1: expected decode result
+# $2: samples per symbol of the transmitter
+# $3...: decode options
+demod_test () {
+    local expected=$1 sps=$2
+    local decode
+
+    shift 2
+
+    printf "urh_wisun_fsk demod test ${sequence}... "
+
+    decode=$(demod_samples ${sps} 0.3 \
+             | ./urh_wisun_fsk.debug --demod --rsc --interleaving --hexo \
+                --human --sps 8 "$@" -)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+demod_test "${expected}" 8 || exit $?
+# the clock of the transmitter is 1% and 2.5% slower, or 2.5% faster
+demod_test "${expected}" 8.08 || exit $?
+demod_test "${expected}" 8.2 || exit $?
+demod_test "${expected}" 7.8 --timing gardner || exit $?
+# the nominal period drifts a symbol within the packet
+demod_test "" 8.2 --timing slicer || exit $?
+
+printf "urh_wisun_fsk demod test ${sequence}... "
+# the signs of the soft symbols are the bits
+demod_samples 8.08 0.3 \
+    | ./urh_wisun_fsk.debug --demod --rsc --interleaving \
+      --soft-output ${soft} - > /dev/null
+decode=$(od -An -v -f -w4 ${soft} | awk '{ printf("%d", $1 > 0) }')
+case "${decode}" in
+*"${bits}"*)
+    ;;
+*)
+    printf "\nE: ${bits}\nR: ${decode}\nfailed\n"
+    exit 1
+    ;;
+esac
+printf "pass\n"
+let sequence++
+
+# $1: samples per symbol of the modulator
+# $2: symbol rate of the decoder
+channelizer_test () {
+    local sps=$1 symbol_rate=$2
+    local rate=$((sps * 50000))
+    local decode
+
+    printf "urh_wisun_fsk demod test ${sequence}... "
+
+    decode=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 \
+                --rsc --interleaving --whitening --sps ${sps} \
+                --iq-output - 00112233445566778899aabbccddeeff \
+             | ./urh_wisun_fsk.debug --channelizer --rsc --interleaving \
+                --sample-rate ${rate} --channel-spacing $((rate / 4)) \
+                --channels 1 --symbol-rate ${symbol_rate} --hexo --human \
+                --timing gardner -)
+
+    if [ X"${decode}" != X"ch0: ${expected}" ] ; then
+        printf "\nE: ch0: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+channelizer_test 16 50000 || exit $?
+# 8.0 samples per symbol of the channel is 8.1 of the modulator
+channelizer_test 16 49383 || exit $?
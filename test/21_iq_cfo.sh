@@ -0,0 +1,68 @@
+# Preamble carrier frequency offset estimation test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+
+# the preamble bits before the offset is estimated may be lost
+expected="ch0: 72f6-2810-00112233445566778899aabbccddeeff-9b750784"
+
+# $1: expected decode result
+# $2: the offset of the signal in the channel, Hz
+# $3: gaussian filter BT
+# $4...: decode options
+cfo_test () {
+    local expected=$1 offset=$2 bt=$3
+    local decode report hz
+
+    shift 3
+
+    printf "urh_wisun_fsk cfo test ${sequence}... "
+
+    # the channel 0 is moved, the signal is -offset in it
+    decode=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 \
+                --rsc --interleaving --whitening --sps 16 --bt ${bt} \
+                --iq-output - 00112233445566778899aabbccddeeff \
+             | ./urh_wisun_fsk.debug --channelizer --rsc --interleaving \
+                --sample-rate 800000 --channel-spacing 200000 --channels 1 \
+                --channel0 $((-offset)) --hexo --human -v "$@" - 2>&1 \
+             | grep -v "^channelizer")
+
+    report=$(echo "${decode}" | grep "cfo")
+    decode=$(echo "${decode}" | grep -v "cfo" | sed 's/^\(ch0: \)a*-/\1/')
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    # --cfo reports the estimation of each frame, the error is less than
+    # 1% of the symbol rate
+    case " $* " in
+    *" --cfo "*)
+        if [ -z "${report}" ] ; then
+            printf "\nno cfo reported\nfailed\n"
+            return 1
+        fi
+
+        hz=$(echo "${report}" | sed 's/.*cfo \([-+0-9]*\) Hz/\1/')
+        if [ $((hz - offset)) -gt 500 ] || [ $((offset - hz)) -gt 500 ]
+        then
+            printf "\n${report}\nexpected ${offset} Hz\nfailed\n"
+            return 1
+        fi
+        ;;
+    esac
+
+    printf "pass\n"
+    let sequence++
+}
+
+cfo_test "${expected}" 0 0.5 --cfo || exit $?
+cfo_test "${expected}" 5000 0.5 --cfo || exit $?
+cfo_test "${expected}" -12000 0 --cfo || exit $?
+# 80% of the deviation
+cfo_test "" 20000 0.5 || exit $?
+cfo_test "${expected}" 20000 0.5 --cfo || exit $?
+cfo_test "${expected}" -20000 0 --cfo || exit $?
+cfo_test "${expected}" 15000 0.5 --cfo --timing gardner || exit $?
@@ -0,0 +1,141 @@
+# Pipelined streaming decode test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+tmpdir=$(mktemp -d)
+trap "rm -rf ${tmpdir}" EXIT
+
+uncoded=$(./urh_wisun_fsk.debug --packet --encode --hexi 1122334455)
+whitening=$(./urh_wisun_fsk.debug --packet --encode --hexi --whitening \
+            00112233445566778899)
+coded=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 --rsc \
+        --interleaving --whitening 1122334455)
+
+# $1: the 01 stream file
+# $2...: decode options
+# the pipeline decodes the same frames as the serial decoder
+pipeline_test () {
+    local stream=$1
+    local expected decode
+
+    shift 1
+
+    printf "urh_wisun_fsk pipeline test ${sequence}... "
+
+    expected=$(./urh_wisun_fsk.debug --stream --hexo --human -v "$@" \
+               ${stream} 2>${tmpdir}/serial.log)
+    # the regular file input is lossless
+    decode=$(./urh_wisun_fsk.debug --stream --pipeline --hexo --human -v \
+             "$@" ${stream} 2>${tmpdir}/pipeline.log)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    expected=$(grep "frames decoded" ${tmpdir}/serial.log)
+    decode=$(grep "frames decoded" ${tmpdir}/pipeline.log)
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    if grep "^pipeline [a-z]*:" ${tmpdir}/pipeline.log \
+       | grep -qv " 0 dropped" ; then
+        grep "^pipeline" ${tmpdir}/pipeline.log
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+# packets with noise bits between them
+printf "0110${uncoded}1011001${whitening}0000111${uncoded}" \
+    | fold -w 7 > ${tmpdir}/1.txt
+pipeline_test ${tmpdir}/1.txt || exit $?
+
+printf "10${coded}0001${coded}11" > ${tmpdir}/2.txt
+pipeline_test ${tmpdir}/2.txt --rsc --interleaving || exit $?
+pipeline_test ${tmpdir}/2.txt --auto || exit $?
+
+# a bad PHR claims a long frame, the following packets are hidden in it
+printf "${uncoded:0:80}0000011111111111${uncoded}01${uncoded}" \
+    > ${tmpdir}/3.txt
+pipeline_test ${tmpdir}/3.txt || exit $?
+
+# the packets with 1 bit error every 7 packets, and the preamble of a packet
+# overlapped with the last bits of the previous one
+awk -v u=${uncoded} -v w=${whitening} -v c=${coded} 'BEGIN {
+    for (i = 0; i < 300; i++) {
+        p = i % 3 == 0 ? u : (i % 3 == 1 ? w : c)
+        if (i % 7 == 0) {
+            j = (i * 13) % length(p) + 1
+            b = substr(p, j, 1) == "0" ? "1" : "0"
+            p = substr(p, 1, j - 1) b substr(p, j + 1)
+        }
+        printf("%s%s", substr("0110100111", 1, i % 10), p)
+        if (i % 5 == 0)
+            printf("0101")
+    }
+}' > ${tmpdir}/4.txt
+pipeline_test ${tmpdir}/4.txt || exit $?
+pipeline_test ${tmpdir}/4.txt --rsc --interleaving || exit $?
+
+printf "urh_wisun_fsk pipeline test ${sequence}... "
+# a live stream from the pipe
+decode=$(cat ${tmpdir}/4.txt \
+         | ./urh_wisun_fsk.debug --stream --pipeline --hexo --human - \
+           2>/dev/null | wc -l)
+if [ ${decode} -eq 0 ] ; then
+    printf "\nno frames decoded\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+# the frames ring is lossy for a live stream only. The output is stalled
+# until the whole input is written, the decoder is never blocked by it.
+for i in $(seq 20) ; do
+    cat ${tmpdir}/4.txt
+done > ${tmpdir}/5.txt
+
+# the reader of the output, starts after the whole input is written
+stall_output () {
+    while [ ! -e ${tmpdir}/written ] ; do
+        sleep 0.1
+    done
+    cat > /dev/null
+}
+
+printf "urh_wisun_fsk pipeline test ${sequence}... "
+rm -f ${tmpdir}/written
+{ cat ${tmpdir}/5.txt; touch ${tmpdir}/written; } \
+    | ./urh_wisun_fsk.debug --stream --pipeline --hexo --human -v - \
+      2>${tmpdir}/live.log | stall_output
+dropped=$(awk '/^pipeline frames:/ { print $(NF - 1) }' ${tmpdir}/live.log)
+if [ -z "${dropped}" ] || [ ${dropped} -eq 0 ] ; then
+    grep "^pipeline" ${tmpdir}/live.log
+    printf "no frames dropped\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+# the same stalled output, the frames of a regular file are never dropped
+printf "urh_wisun_fsk pipeline test ${sequence}... "
+touch ${tmpdir}/written
+./urh_wisun_fsk.debug --stream --pipeline --hexo --human -v ${tmpdir}/5.txt \
+    2>${tmpdir}/file.log | { sleep 1; cat; } | wc -l > ${tmpdir}/file.lines
+frames=$(awk '/frames decoded/ { print $1 }' ${tmpdir}/file.log)
+if grep "^pipeline [a-z]*:" ${tmpdir}/file.log | grep -qv " 0 dropped" \
+   || [ "$(cat ${tmpdir}/file.lines)" != "${frames}" ] ; then
+    grep "^pipeline" ${tmpdir}/file.log
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
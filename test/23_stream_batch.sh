@@ -0,0 +1,85 @@
+# Batch decode of capture directories test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+tmpdir=$(mktemp -d)
+trap "rm -rf ${tmpdir}" EXIT
+
+uncoded=$(./urh_wisun_fsk.debug --packet --encode --hexi 1122334455)
+whitening=$(./urh_wisun_fsk.debug --packet --encode --hexi --whitening \
+            00112233445566778899)
+coded=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 --rsc \
+        --interleaving --whitening 1122334455)
+
+# per-burst captures, some of them have no packet and the large one is read
+# by several chunks
+mkdir ${tmpdir}/captures
+for i in $(seq 0 99) ; do
+    case $((i % 4)) in
+    0) printf "0110${uncoded}1011" ;;
+    1) printf "1${whitening}0000111${uncoded}" | fold -w 7 ;;
+    2) printf "10${coded}0001${coded}11" ;;
+    3) printf "0101110" ;;
+    esac > ${tmpdir}/captures/burst-$(printf "%03d" $i).txt
+done
+for i in $(seq 0 300) ; do
+    printf "0110100${uncoded}${whitening}"
+done > ${tmpdir}/captures/large.txt
+# not a regular file
+mkdir ${tmpdir}/captures/subdir
+
+# $1: the batch input, a directory or a list file
+# $2...: decode options
+# the batch decodes the same frames as --stream of each file
+batch_test () {
+    local input=$1
+    local expected decode f
+
+    shift 1
+
+    printf "urh_wisun_fsk batch test ${sequence}... "
+
+    expected=$(for f in ${tmpdir}/captures/*.txt ; do
+                   ./urh_wisun_fsk.debug --stream --hexo --human "$@" ${f} \
+                       | sed "s|^|${f}: |"
+               done | sort)
+    # the files are decoded in the read completion order
+    decode=$(./urh_wisun_fsk.debug --batch --hexo --human -v "$@" \
+             ${input} 2>${tmpdir}/batch.log | sort)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    if ! grep -q "^batch: 101 files" ${tmpdir}/batch.log ; then
+        cat ${tmpdir}/batch.log
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+batch_test ${tmpdir}/captures || exit $?
+batch_test ${tmpdir}/captures --rsc --interleaving || exit $?
+
+ls -d ${tmpdir}/captures/*.txt > ${tmpdir}/list
+batch_test ${tmpdir}/list || exit $?
+batch_test - < ${tmpdir}/list || exit $?
+
+# the other files are still decoded if one can't be opened, but it fails
+printf "urh_wisun_fsk batch test ${sequence}... "
+(echo ${tmpdir}/missing.txt ; cat ${tmpdir}/list) > ${tmpdir}/list2
+expected=$(./urh_wisun_fsk.debug --batch ${tmpdir}/list 2>/dev/null | sort)
+decode=$(./urh_wisun_fsk.debug --batch ${tmpdir}/list2 2>/dev/null | sort ;
+         exit ${PIPESTATUS[0]})
+if [ $? -eq 0 ] || [ X"${decode}" != X"${expected}" ] ; then
+    printf "\nE: ${expected}\nR: ${decode}\n"
+    printf "failed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
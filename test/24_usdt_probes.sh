@@ -0,0 +1,37 @@
+# USDT static probes test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+
+if ! which readelf > /dev/null 2>&1 ; then
+    printf "urh_wisun_fsk usdt test skipped, readelf is not found\n"
+    exit 0
+fi
+
+# $1: the binary
+# all probes are saved in the stapsdt notes with their arguments
+usdt_test () {
+    local probes
+
+    printf "urh_wisun_fsk usdt test ${sequence}... "
+
+    probes=$(readelf -n $1 | awk '
+        /Provider:/ { provider = $2 }
+        /Name:/ { name = $2 }
+        /Arguments:/ { print provider ":" name ":" NF - 1 }' | sort -u)
+
+    for p in shr_found:3 phr_decoded:2 fec_fail:3 whitening:2 \
+             crc_result:2 frame_emitted:3 encode_start:2 frame_encoded:2 ; do
+        if ! echo "${probes}" | grep -q "^urh_wisun_fsk:${p}$" ; then
+            printf "\nprobe ${p} is not found in:\n${probes}\n"
+            printf "failed\n"
+            return 1
+        fi
+    done
+
+    printf "pass\n"
+    let sequence++
+}
+
+usdt_test ./urh_wisun_fsk || exit $?
+usdt_test ./urh_wisun_fsk.debug || exit $?
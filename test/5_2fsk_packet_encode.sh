@@ -112,3 +112,96 @@ encode_test "02006a" \
             "--whitening" \
             "--human" \
             || exit $?
+
+# Sequence 8
+# Several packets are encoded in one batch, one line each.
+# ref: Sequence 7
+coded0="0101-0101-0101-0101-0101-0101-0101-0101-0110-1111-0100-1110-1100-0000-1110-1000-0110-1000-0000-1100-1010-0101-1101-1010-1011-0000-0110-1111-1001-0000-1001-1100-0001-1111-1110-0110-1010-1010-0100-1100-1010-0000-1110-1001-1001-1001-1001-1111-0001-0010-1001-1011"
+encode_test "02006a 02006a" \
+            "$(printf "${coded0}\n${coded0}")" \
+            "--hexi" \
+            "--packet" \
+            "--preamble-size" "32" \
+            "--sfd" "coded0" \
+            "--rsc" \
+            "--interleaving" \
+            "--whitening" \
+            "--human" \
+            || exit $?
+
+# Sequence 9
+# 70 frames of different lengths are more than a batch of 64 lanes, each
+# line is the same as the frame encoded on its own.
+batch_frames=$(awk 'BEGIN {
+    for (i = 1; i <= 70; i++) {
+        len = (i * 37) % 211 + 1
+        s = ""
+        for (j = 0; j < len; j++)
+            s = s sprintf("%02x", (i * 7 + j * 13) % 256)
+        printf "%s ", s
+    }
+}')
+for options in "--sfd coded0 --rsc --interleaving --whitening" \
+               "--sfd coded1 --nrnsc --whitening" \
+               "--sfd coded0 --rsc" \
+               "--sfd coded1 --nrnsc --interleaving" \
+               "--sfd uncoded0 --whitening" ; do
+    expected=""
+    for frame in ${batch_frames} ; do
+        expected="${expected}$(./urh_wisun_fsk.debug --packet --encode --hexi ${options} ${frame})
+"
+    done
+    encode_test "${batch_frames}" \
+                "${expected%?}" \
+                "--hexi" \
+                ${options} \
+                || exit $?
+done
+
+# Sequence 10
+# A template frame is patched and regenerated, the same as encoding the
+# patched frames one by one.
+template_frames="0011223344556677889900 0011ff3344556677889900 aa11ff33445566778899bb aa11ff33445566778899cc"
+for options in "--sfd coded0 --rsc --interleaving --whitening" \
+               "--sfd coded1 --nrnsc" \
+               "--sfd uncoded0 --whitening" ; do
+    encode_test "0011223344556677889900 2:ff 0:aa,10:bb 10:cc" \
+                "$(./urh_wisun_fsk.debug --packet --encode --hexi ${options} ${template_frames})" \
+                "--hexi" \
+                "--template" \
+                ${options} \
+                || exit $?
+done
+
+# Sequence 11
+# The template takes the frames longer than 1024 bytes, the patched frame is
+# decoded back. The data over the max frame length is refused.
+long_data=$(awk 'BEGIN {
+    for (i = 0; i < 1500; i++)
+        printf "%02x", (i * 7) % 256
+}')
+for options in "--sfd coded0 --rsc --interleaving --whitening" \
+               "--sfd coded1 --nrnsc" \
+               "--sfd uncoded0 --whitening" ; do
+    printf "urh_wisun_fsk packet encode test ${sequence}... "
+    encoded=$(./urh_wisun_fsk.debug --packet --encode --hexi --template \
+              ${options} ${long_data} 0:ff | tail -1)
+    decoded=$(./urh_wisun_fsk.debug --packet --decode --hexo \
+              ${options#--sfd * } ${encoded})
+    # preamble, SFD and PHR before the data, FCS32 after it
+    if [ X"${decoded:24:3000}" != X"ff${long_data:2}" ] ; then
+        printf "\nR: ${decoded}\nfailed\n"
+        exit 1
+    fi
+    printf "pass\n"
+    let sequence++
+done
+
+printf "urh_wisun_fsk packet encode test ${sequence}... "
+if ./urh_wisun_fsk.debug --packet --encode --hexi --template \
+       ${long_data}${long_data:0:1088} > /dev/null 2>&1 ; then
+    printf "the data over 2043 bytes is accepted\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
@@ -104,4 +104,65 @@ coded_packet_decode_test \
     "010101010101010101010101010101010101010101010101010101010101010110010000010011100000100000110110100000001100011101001101001101100111011100010111100110100111111111111111000010001101111100001100101000001010100010000000000000000100000010000000000000000000000011111100110110000000010100010000000100011111111111111111001001100100000010000000100000000000000000000000101000000010000000000000000000000000000000000000110001000001000010100000010001101000011001000110100001100100011010000110010001101000011000011001010000111010101100001111" \
     "--packet" "--decode" \
     "000000000000001010101010101010101010101010101010101010101010101010101010101011001000001001110000010000011011010001111101101111111111001011001001101001000111111010010110100010100001110011111111001110001000101110011011111000010000001010101001111011110100000110111011011011001110001100011111001101101110100100100001110010111010011011100000110000010011010110000000110011001010100110011110101101001001001101111110010110101000001100110011001101111111010000101110100101010001010110111010011101000001000000000110000010100111110000100101110011010110011111111111" \
-    || exit $?
\ No newline at end of file
+    || exit $?
+# Sequence 7
+# similar to seq3, the capture data after the frame is not parsed
+coded_packet_decode_test \
+    "aaaaaaaaaaaaaaaa-72f6-6010-1122-687d28f2" \
+    "--packet" "--decode" \
+    "--nrnsc" \
+    "--interleaving" \
+    "--human" "--hexo" \
+    "${seq3_inputs}0110 noise, not 01 strings" \
+    || exit $?
+
+# Sequence 8
+# same as seq2, the FEC and interleaving are detected by the coded PHR, the
+# report in stderr is checked by seq10
+coded_packet_decode_test \
+    "aaaaaaaa-72f6-e010-02006a-ba945f14" \
+    "--packet" "--decode" \
+    "--auto" \
+    "--human" "--hexo" \
+    "0101-0101-0101-0101-0101-0101-0101-0101-0110-1111-0100-1110-1100-0000-1110-1000-0110-1000-0000-1100-1010-0101-1101-1010-1011-0000-0110-1111-1001-0000-1001-1100-0001-1111-1110-0110-1010-1010-0100-1100-1010-0000-1110-1001-1001-1001-1001-1111-0001-0010-1001-1011" \
+    2>/dev/null || exit $?
+
+# Sequence 9
+# same as seq4, the detected configuration is reported in stderr
+printf "urh_wisun_fsk fec decode test ${sequence}... "
+report=$(./urh_wisun_fsk.debug --packet --decode --auto --hexo \
+         "${seq3_inputs}01100110" 2>&1 >/dev/null)
+if [ X"${report}" != X"auto: nrnsc interleaving whitening" ] ; then
+    printf "\nR: ${report}\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+# Sequence 10
+# same as seq8, the rejected FEC hypotheses are not reported
+printf "urh_wisun_fsk fec decode test ${sequence}... "
+seq8_inputs=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 \
+              --rsc --interleaving --whitening 02006a)
+report=$(./urh_wisun_fsk.debug --packet --decode --auto --hexo \
+         "${seq8_inputs}" 2>&1 >/dev/null)
+if [ X"${report}" != X"auto: rsc interleaving whitening" ] ; then
+    printf "\nR: ${report}\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
+
+# Sequence 11
+# a frame failed by all the hypotheses is reported in one line
+printf "urh_wisun_fsk fec decode test ${sequence}... "
+bad=${seq8_inputs:0:150}$((1 - ${seq8_inputs:150:1}))${seq8_inputs:151:9}
+bad=${bad}$((1 - ${seq8_inputs:160:1}))${seq8_inputs:161}
+report=$(./urh_wisun_fsk.debug --packet --decode --auto --hexo "${bad}" \
+         2>&1 >/dev/null)
+if [ $(echo "${report}" | wc -l) != 1 ] ; then
+    printf "\nR: ${report}\nfailed\n"
+    exit 1
+fi
+printf "pass\n"
+let sequence++
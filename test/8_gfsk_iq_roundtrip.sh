@@ -0,0 +1,114 @@
+# Wisun 2-FSK IQ modulate and channelizer decode round trip test
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+
+# $1: expected decode result
+# $2: IQ sample format
+# $3: samples per symbol
+# $4: encode and modulator options
+# $5: decode options
+iq_roundtrip_test () {
+    local expected=$1 format=$2 sps=$3 encode_options=$4 decode_options=$5
+    local decode
+
+    printf "urh_wisun_fsk IQ round trip test ${sequence}... "
+
+    decode=$(./urh_wisun_fsk.debug --packet --encode --hexi ${encode_options} \
+                --iq-format ${format} --sps ${sps} --iq-output - 1122334455 \
+             | ./urh_wisun_fsk.debug --channelizer ${decode_options} \
+                --iq-format ${format} --sample-rate $((sps * 50000)) \
+                --channels 1 --hexo --human -)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    else
+        printf "pass\n"
+    fi
+
+    let sequence++
+}
+
+uncoded="ch0: aaaaaaaaaaaaaaaa-7209-9010-1122334455-295aa038"
+coded="ch0: aaaaaaaaaaaaaaaa-72f6-9010-1122334455-295aa038"
+
+iq_roundtrip_test "${uncoded}" cf32 8 "--sfd uncoded0 --whitening --bt 0" "" \
+    || exit $?
+iq_roundtrip_test "${uncoded}" cs8 8 "--sfd uncoded0 --whitening --bt 0.5" "" \
+    || exit $?
+iq_roundtrip_test "${uncoded}" cu8 16 \
+    "--sfd uncoded0 --whitening --bt 0.3 --mod-index 0.5" "" \
+    || exit $?
+iq_roundtrip_test "${coded}" cs16 8 \
+    "--sfd coded0 --rsc --interleaving --whitening --bt 0.5" \
+    "--rsc --interleaving" \
+    || exit $?
+
+# the samples per symbol of the IQ output is an integer
+printf "urh_wisun_fsk IQ round trip test ${sequence}... "
+for sps in 8.5 0 -8 1e30 ; do
+    if ./urh_wisun_fsk.debug --packet --encode --hexi --sps ${sps} \
+        --iq-output /dev/null 1122334455 2>/dev/null ; then
+        printf "\n--sps ${sps} is accepted\nfailed\n"
+        exit 1
+    fi
+done
+printf "pass\n"
+let sequence++
+
+capture=$(mktemp)
+trap "rm -f ${capture}" EXIT
+
+# $1: samples per symbol
+modulate () {
+    ./urh_wisun_fsk.debug --packet --encode --hexi --sfd uncoded0 \
+        --whitening --bt 0.5 --iq-format cs8 --sps $1 --iq-output - \
+        1122334455 > ${capture}
+}
+
+# $1: expected stdout and stderr, without the channelizer plan of -v
+# $2: channel 0 frequency
+# $3: the channels(sample rate / spacing)
+# $4...: decode options
+channelizer_test () {
+    local expected=$1 channel0=$2 channels=$3
+    local decode
+
+    shift 3
+
+    printf "urh_wisun_fsk IQ round trip test ${sequence}... "
+
+    decode=$(./urh_wisun_fsk.debug --channelizer --iq-format cs8 \
+                --sample-rate $((channels * 200000)) --channel0 ${channel0} \
+                --hexo --human "$@" ${capture} 2>&1 \
+             | grep -v "^channelizer")
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    fi
+
+    printf "pass\n"
+    let sequence++
+}
+
+# the frame is in the center of 3 and 5 channels
+modulate 12
+channelizer_test "${uncoded/ch0/ch1}" -200000 3 || exit $?
+modulate 20
+channelizer_test "${uncoded/ch0/ch2}" -400000 5 || exit $?
+
+# the FCS is bad after the Q of 2 symbols are negated, the frequency of them
+# is flipped. The failed frame is reported with -v only.
+modulate 12
+for ((i = 150 * 12; i < 152 * 12; i++)) ; do
+    q=$(od -An -tu1 -j $((i * 2 + 1)) -N1 ${capture} | tr -d ' ')
+    printf "\\$(printf "%03o" $(( (256 - q) & 0xff )))" \
+        | dd of=${capture} bs=1 seek=$((i * 2 + 1)) conv=notrunc 2>/dev/null
+done
+channelizer_test "" -200000 3 || exit $?
+channelizer_test "Error: verify 802.15.4 packet failed" -200000 3 -v \
+    || exit $?
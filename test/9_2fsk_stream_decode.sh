@@ -0,0 +1,57 @@
+# Wisun 2-FSK streaming decode test scripts
+# qianfan Zhao <qianfanguijin@163.com>
+
+sequence=1
+
+# $1: expected decode result
+# $2: the 01 stream, split to lines of $3 chars
+# $4...: decode options
+stream_decode_test () {
+    local expected=$1 stream=$2 width=$3
+    local decode
+
+    shift 3
+
+    printf "urh_wisun_fsk stream decode test ${sequence}... "
+
+    decode=$(printf "${stream}" | fold -w ${width} \
+             | ./urh_wisun_fsk.debug --stream --hexo --human "$@" -)
+
+    if [ X"${decode}" != X"${expected}" ] ; then
+        printf "\nE: ${expected}\nR: ${decode}\n"
+        printf "failed\n"
+        return 1
+    else
+        printf "pass\n"
+    fi
+
+    let sequence++
+}
+
+uncoded=$(./urh_wisun_fsk.debug --packet --encode --hexi 1122334455)
+whitening=$(./urh_wisun_fsk.debug --packet --encode --hexi --whitening \
+            00112233445566778899)
+coded=$(./urh_wisun_fsk.debug --packet --encode --hexi --sfd coded0 --rsc \
+        --interleaving --whitening 1122334455)
+
+uncoded_result="aaaaaaaaaaaaaaaa-7209-9000-1122334455-295aa038"
+whitening_result="aaaaaaaaaaaaaaaa-7209-7010-00112233445566778899-c803a92b"
+coded_result="aaaaaaaaaaaaaaaa-72f6-9010-1122334455-295aa038"
+
+# packets with noise bits between them
+stream_decode_test \
+    "$(printf "${uncoded_result}\n${whitening_result}\n${uncoded_result}")" \
+    "0110${uncoded}1011001${whitening}0000111${uncoded}" 7 \
+    || exit $?
+
+stream_decode_test \
+    "$(printf "${coded_result}\n${coded_result}")" \
+    "10${coded}0001${coded}11" 1 \
+    --rsc --interleaving \
+    || exit $?
+
+# a bad PHR claims a long frame, the following packets are hidden in it
+stream_decode_test \
+    "$(printf "${uncoded_result}\n${uncoded_result}")" \
+    "${uncoded:0:80}0000011111111111${uncoded}01${uncoded}" 64 \
+    || exit $?